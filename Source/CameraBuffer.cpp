@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerabuffer.cpp
+// ============
+// per-frame camera uniform block written into a ring of uniform buffers
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraBuffer.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_CameraBlockName = "CameraBlock";
+}
+
+/***********************************************************
+ *  CameraBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraBuffer::CameraBuffer(GLStateCache* pStateCache, StreamRing* pStreamRing)
+{
+	m_pStateCache = pStateCache;
+	m_pStreamRing = pStreamRing;
+	for (int i = 0; i < RING_SIZE; i++)
+	{
+		m_bufferIDs[i] = 0;
+	}
+	m_currentBuffer = 0;
+}
+
+/***********************************************************
+ *  ~CameraBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraBuffer::~CameraBuffer()
+{
+	DestroyCameraBuffers();
+}
+
+/***********************************************************
+ *  CreateCameraBuffers()
+ *
+ *  This method is used for creating the ring of uniform
+ *  buffers and connecting the camera block binding point to
+ *  the block declared in the passed in shader program.
+ ***********************************************************/
+bool CameraBuffer::CreateCameraBuffers(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_CameraBlockName);
+	if (GL_INVALID_INDEX == blockIndex)
+	{
+		std::cout << "Uniform block not found in shader program:" << g_CameraBlockName << std::endl;
+		return false;
+	}
+	glUniformBlockBinding(programID, blockIndex, CAMERA_BLOCK_BINDING);
+
+	glGenBuffers(RING_SIZE, m_bufferIDs);
+	for (int i = 0; i < RING_SIZE; i++)
+	{
+		m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferIDs[i]);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CAMERA_BLOCK), NULL, GL_STREAM_DRAW);
+	}
+
+	m_currentBuffer = 0;
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyCameraBuffers()
+ *
+ *  This method is used for freeing the ring of buffers.
+ ***********************************************************/
+void CameraBuffer::DestroyCameraBuffers()
+{
+	if (0 != m_bufferIDs[0])
+	{
+		m_pStateCache->DeleteBuffers(RING_SIZE, m_bufferIDs);
+		for (int i = 0; i < RING_SIZE; i++)
+		{
+			m_bufferIDs[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  WriteFrame()
+ *
+ *  This method is used for writing the camera block of a
+ *  new frame.  The block goes into the oldest buffer of the
+ *  ring, which the GPU finished reading frames ago, and that
+ *  buffer is then bound for all the draws of the frame.
+ *  With the stream ring the block is copied into the mapped
+ *  region of the frame, and that range is bound instead.
+ ***********************************************************/
+void CameraBuffer::WriteFrame(const CAMERA_BLOCK& cameraBlock)
+{
+	PROFILE_ZONE("CameraBuffer::WriteFrame");
+
+	if (0 == m_bufferIDs[0])
+	{
+		return;
+	}
+
+	GLintptr offset = 0;
+	void* pBlock = m_pStreamRing->Allocate(sizeof(CAMERA_BLOCK), offset);
+	if (NULL != pBlock)
+	{
+		memcpy(pBlock, &cameraBlock, sizeof(CAMERA_BLOCK));
+		m_pStateCache->BindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_pStreamRing->GetBufferID(), offset, sizeof(CAMERA_BLOCK));
+		return;
+	}
+
+	m_currentBuffer = (m_currentBuffer + 1) % RING_SIZE;
+
+	m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferIDs[m_currentBuffer]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CAMERA_BLOCK), &cameraBlock);
+
+	m_pStateCache->BindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_bufferIDs[m_currentBuffer]);
+}
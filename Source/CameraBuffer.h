@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerabuffer.h
+// ============
+// per-frame camera uniform block written into a ring of uniform buffers
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "StreamRing.h"
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/***********************************************************
+ *  CameraBuffer
+ *
+ *  This class holds the "CameraBlock" uniform block that is
+ *  shared by the vertex and fragment shaders.  The block is
+ *  written once per frame into the next buffer of a small
+ *  ring, so the CPU never writes into a buffer that the GPU
+ *  may still be reading for one of the previous frames.
+ *  When the stream ring is available the block is written
+ *  into the frame's region of it instead, and bound as a
+ *  range, with no upload call at all.
+ ***********************************************************/
+class CameraBuffer
+{
+public:
+	// constructor
+	CameraBuffer(GLStateCache* pStateCache, StreamRing* pStreamRing);
+	// destructor
+	~CameraBuffer();
+
+	// number of buffers in the ring - one per frame in flight
+	static const int RING_SIZE = 3;
+	// uniform buffer binding point used for the camera block
+	static const GLuint CAMERA_BLOCK_BINDING = 1;
+
+	// std140 layout of the camera block - every member is a
+	// mat4 or vec4, so no padding rules come into play
+	struct CAMERA_BLOCK
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::mat4 inverseView;
+		glm::mat4 inverseProjection;
+		// xyz - camera position in world space
+		glm::vec4 viewPosition;
+		// x - time since start, y - time since last frame
+		glm::vec4 frameTime;
+	};
+
+	// create the buffer ring and attach it to the program
+	bool CreateCameraBuffers(GLuint programID);
+	// free the buffer ring
+	void DestroyCameraBuffers();
+
+	// write the block for a new frame into the next buffer
+	void WriteFrame(const CAMERA_BLOCK& cameraBlock);
+
+private:
+	// pointer to the cache the buffer binds go through
+	GLStateCache* m_pStateCache;
+	// pointer to the mapped ring the block is written into
+	StreamRing* m_pStreamRing;
+	// uniform buffer objects of the ring
+	GLuint m_bufferIDs[RING_SIZE];
+	// index of the buffer written for the current frame
+	int m_currentBuffer;
+};
+
+// the C++ layout must match the std140 layout of the shader block
+static_assert(offsetof(CameraBuffer::CAMERA_BLOCK, viewPosition) == 320, "CAMERA_BLOCK does not match std140");
+static_assert(sizeof(CameraBuffer::CAMERA_BLOCK) == 352, "CAMERA_BLOCK does not match std140");
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// keyframed camera path replayed by the benchmark
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  ~CameraPath()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraPath::~CameraPath()
+{
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a camera path from its
+ *  text form, one keyframe per line:
+ *
+ *    key <time> <position x y z> <front x y z> <zoom> <projection>
+ *
+ *  The time is in seconds and has to grow from one key to
+ *  the next, and the projection is either perspective or
+ *  ortho.  Everything after a '#' is a comment.
+ ***********************************************************/
+bool CameraPath::Load(const char* filename)
+{
+	m_keys.clear();
+	m_filename = filename;
+
+	std::ifstream textFile(filename);
+	if (!textFile)
+	{
+		std::cout << "Could not open camera path:" << filename << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(textFile, line))
+	{
+		lineNumber++;
+
+		// strip comments and skip empty lines
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string command;
+		if (!(tokens >> command))
+		{
+			continue;
+		}
+
+		bool bValid = false;
+		if (command == "key")
+		{
+			CAMERA_KEY key;
+			std::string projection;
+			bValid = (tokens >> key.time
+				>> key.position.x >> key.position.y >> key.position.z
+				>> key.front.x >> key.front.y >> key.front.z
+				>> key.zoom >> projection) ? true : false;
+			bValid = bValid && ((projection == "perspective") || (projection == "ortho"));
+			bValid = bValid && (m_keys.empty() || (key.time > m_keys.back().time));
+			bValid = bValid && (glm::length(key.front) > 0.0f);
+			if (bValid)
+			{
+				key.bOrthographic = (projection == "ortho");
+				m_keys.push_back(key);
+			}
+		}
+
+		if (false == bValid)
+		{
+			std::cout << filename << "(" << lineNumber << "): invalid camera key: " << line << std::endl;
+			m_keys.clear();
+			return false;
+		}
+	}
+
+	if (m_keys.empty())
+	{
+		std::cout << "The camera path has no keys:" << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  This method is used for getting the pose of the camera at
+ *  a time along the path.  Times before the first key or
+ *  after the last one hold that key.  The Front vectors are
+ *  blended at unit length, so keys may give them at any
+ *  length, and the projection mode is taken from the earlier
+ *  of the two keys.
+ ***********************************************************/
+CameraPath::CAMERA_KEY CameraPath::Sample(float time) const
+{
+	CAMERA_KEY pose;
+	pose.time = time;
+	pose.position = glm::vec3(0.0f, 5.0f, 12.0f);
+	pose.front = glm::vec3(0.0f, -0.5f, -2.0f);
+	pose.zoom = 80.0f;
+	pose.bOrthographic = false;
+
+	if (m_keys.empty())
+	{
+		return(pose);
+	}
+	if (time <= m_keys.front().time)
+	{
+		pose = m_keys.front();
+		pose.time = time;
+		return(pose);
+	}
+	if (time >= m_keys.back().time)
+	{
+		pose = m_keys.back();
+		pose.time = time;
+		return(pose);
+	}
+
+	// the paths are short, so the keys are searched in order
+	size_t next = 1;
+	while (m_keys[next].time <= time)
+	{
+		next++;
+	}
+	const CAMERA_KEY& from = m_keys[next - 1];
+	const CAMERA_KEY& to = m_keys[next];
+	const float blend = (time - from.time) / (to.time - from.time);
+
+	pose.position = glm::mix(from.position, to.position, blend);
+	// opposite Front vectors blend through zero halfway, where
+	// the later one is used
+	const glm::vec3 front = glm::mix(glm::normalize(from.front), glm::normalize(to.front), blend);
+	pose.front = (glm::length(front) > 0.001f) ? glm::normalize(front) : to.front;
+	pose.zoom = glm::mix(from.zoom, to.zoom, blend);
+	pose.bOrthographic = from.bOrthographic;
+
+	return(pose);
+}
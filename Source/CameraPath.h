@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// keyframed camera path replayed by the benchmark
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class loads a camera path from a text file of
+ *  keyframes and samples it at any time along the path.  The
+ *  positions, Front vectors and zoom are blended between the
+ *  two keys around the time, while the projection mode is a
+ *  switch that takes effect at the key that sets it.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// one pose of the camera along the path
+	struct CAMERA_KEY
+	{
+		// seconds from the start of the path
+		float time;
+		glm::vec3 position;
+		glm::vec3 front;
+		// field of view of the perspective projection, in degrees
+		float zoom;
+		bool bOrthographic;
+	};
+
+	// constructor
+	CameraPath();
+	// destructor
+	~CameraPath();
+
+	// load the keyframes of a text camera path
+	bool Load(const char* filename);
+
+	// get the pose of the camera at a time along the path
+	CAMERA_KEY Sample(float time) const;
+
+	// get the number of keyframes
+	int GetKeyCount() const { return((int)m_keys.size()); }
+	// get the time of the last keyframe
+	float GetDuration() const { return(m_keys.empty() ? 0.0f : m_keys.back().time); }
+	// get the file the path was loaded from
+	const std::string& GetFilename() const { return(m_filename); }
+
+private:
+	// keyframes in time order
+	std::vector<CAMERA_KEY> m_keys;
+	std::string m_filename;
+};
@@ -0,0 +1,402 @@
+///////////////////////////////////////////////////////////////////////////////
+// framebenchmark.cpp
+// ============
+// record the CPU and GPU cost of each frame and summarize it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// names of the values in the results file
+	const char* const g_MetricNames[FrameBenchmark::METRIC_COUNT] =
+	{
+		"cpuMilliseconds",
+		"frameMilliseconds",
+		"gpuMilliseconds",
+		"drawCalls",
+		"triangles",
+		"stateCalls",
+		"elidedStateCalls",
+		"fenceStallMilliseconds"
+	};
+
+	/***********************************************************
+	 *  GetPercentile()
+	 *
+	 *  This function is used for getting the nearest rank
+	 *  percentile of sorted values, which is always one of the
+	 *  recorded values.
+	 ***********************************************************/
+	double GetPercentile(const std::vector<double>& sortedValues, double percent)
+	{
+		const double rank = std::ceil(percent / 100.0 * (double)sortedValues.size());
+		const size_t index = (rank < 1.0) ? 0 : (size_t)rank - 1;
+		return(sortedValues[std::min(index, sortedValues.size() - 1)]);
+	}
+
+	/***********************************************************
+	 *  WriteJsonString()
+	 *
+	 *  This function is used for writing a quoted JSON string,
+	 *  escaping the quotes and the backslashes of Windows paths.
+	 ***********************************************************/
+	void WriteJsonString(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if ((*c == '"') || (*c == '\\'))
+			{
+				fputc('\\', file);
+			}
+			fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+}
+
+/***********************************************************
+ *  FrameBenchmark()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameBenchmark::FrameBenchmark()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		m_queries[i].timerQueryID = 0;
+		m_queries[i].primitiveQueryID = 0;
+		m_queries[i].sample = -1;
+	}
+	m_bQueriesCreated = false;
+	m_warmUpFrames = 0;
+	m_currentSample = -1;
+}
+
+/***********************************************************
+ *  ~FrameBenchmark()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameBenchmark::~FrameBenchmark()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  CreateQueries()
+ *
+ *  This method is used for creating the timer and primitive
+ *  queries of each slot of the ring.  Without them the GPU
+ *  times and triangles are recorded as zero.
+ ***********************************************************/
+bool FrameBenchmark::CreateQueries()
+{
+	Destroy();
+
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		glGenQueries(1, &m_queries[i].timerQueryID);
+		glGenQueries(1, &m_queries[i].primitiveQueryID);
+		m_queries[i].sample = -1;
+	}
+	m_bQueriesCreated = (GL_NO_ERROR == glGetError());
+
+	if (false == m_bQueriesCreated)
+	{
+		std::cout << "The benchmark could not create its GPU queries" << std::endl;
+	}
+	return(m_bQueriesCreated);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the queries of the ring.
+ ***********************************************************/
+void FrameBenchmark::Destroy()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		if (0 != m_queries[i].timerQueryID)
+		{
+			glDeleteQueries(1, &m_queries[i].timerQueryID);
+			m_queries[i].timerQueryID = 0;
+		}
+		if (0 != m_queries[i].primitiveQueryID)
+		{
+			glDeleteQueries(1, &m_queries[i].primitiveQueryID);
+			m_queries[i].primitiveQueryID = 0;
+		}
+		m_queries[i].sample = -1;
+	}
+	m_bQueriesCreated = false;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame sample.  The
+ *  frame before it ends here, so its frame time covers the
+ *  buffer swap and any wait for the GPU to catch up.  The
+ *  ring slot of the new frame is read first if a frame that
+ *  many frames back still has its results in it.
+ ***********************************************************/
+void FrameBenchmark::BeginFrame()
+{
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (m_currentSample >= 0)
+	{
+		m_samples[m_currentSample].frameMilliseconds =
+			std::chrono::duration<double, std::milli>(now - m_frameStart).count();
+	}
+
+	FRAME_SAMPLE sample;
+	sample.cpuMilliseconds = 0.0;
+	sample.frameMilliseconds = 0.0;
+	sample.gpuMilliseconds = 0.0;
+	sample.drawCalls = 0;
+	sample.triangles = 0;
+	sample.stateCalls = 0;
+	sample.elidedStateCalls = 0;
+	sample.fenceStallMilliseconds = 0.0;
+	m_currentSample = (int)m_samples.size();
+	m_samples.push_back(sample);
+
+	if (m_bQueriesCreated)
+	{
+		FRAME_QUERIES& queries = m_queries[m_currentSample % QUERY_RING_SIZE];
+		ReadQueries(queries);
+		glBeginQuery(GL_TIME_ELAPSED, queries.timerQueryID);
+		glBeginQuery(GL_PRIMITIVES_GENERATED, queries.primitiveQueryID);
+	}
+
+	m_frameStart = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  EndFrameSubmit()
+ *
+ *  This method is used for ending the queries of the frame
+ *  and recording the CPU time it took to send it, with its
+ *  draw calls, state changes and fence stalls.
+ ***********************************************************/
+void FrameBenchmark::EndFrameSubmit(unsigned int drawCalls, unsigned int stateCalls, unsigned int elidedStateCalls, double fenceStallMilliseconds)
+{
+	if (m_currentSample < 0)
+	{
+		return;
+	}
+
+	FRAME_SAMPLE& sample = m_samples[m_currentSample];
+	sample.cpuMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - m_frameStart).count();
+	sample.drawCalls = drawCalls;
+	sample.stateCalls = stateCalls;
+	sample.elidedStateCalls = elidedStateCalls;
+	sample.fenceStallMilliseconds = fenceStallMilliseconds;
+
+	if (m_bQueriesCreated)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+		m_queries[m_currentSample % QUERY_RING_SIZE].sample = m_currentSample;
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for ending the run - the last frame
+ *  ends once the GPU has finished it, and the results of
+ *  the queries still in the ring are read.
+ ***********************************************************/
+void FrameBenchmark::Finish()
+{
+	glFinish();
+
+	if (m_currentSample >= 0)
+	{
+		m_samples[m_currentSample].frameMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - m_frameStart).count();
+		m_currentSample = -1;
+	}
+
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		ReadQueries(m_queries[i]);
+	}
+}
+
+/***********************************************************
+ *  ReadQueries()
+ *
+ *  This method is used for reading the GPU time and the
+ *  triangle count of a ring slot into its sample.  By the
+ *  time a slot comes around again the GPU is normally done
+ *  with it, so this seldom waits.
+ ***********************************************************/
+void FrameBenchmark::ReadQueries(FRAME_QUERIES& queries)
+{
+	if ((queries.sample < 0) || (queries.sample >= (int)m_samples.size()))
+	{
+		queries.sample = -1;
+		return;
+	}
+
+	GLuint64 nanoseconds = 0;
+	GLuint64 primitives = 0;
+	glGetQueryObjectui64v(queries.timerQueryID, GL_QUERY_RESULT, &nanoseconds);
+	glGetQueryObjectui64v(queries.primitiveQueryID, GL_QUERY_RESULT, &primitives);
+
+	FRAME_SAMPLE& sample = m_samples[queries.sample];
+	sample.gpuMilliseconds = (double)nanoseconds / 1000000.0;
+	sample.triangles = (unsigned long long)primitives;
+	queries.sample = -1;
+}
+
+/***********************************************************
+ *  GetMetricValue()
+ *
+ *  This method is used for getting one value of a recorded
+ *  frame.
+ ***********************************************************/
+double FrameBenchmark::GetMetricValue(const FRAME_SAMPLE& sample, METRIC metric)
+{
+	switch (metric)
+	{
+	case METRIC_CPU_TIME:
+		return(sample.cpuMilliseconds);
+	case METRIC_FRAME_TIME:
+		return(sample.frameMilliseconds);
+	case METRIC_GPU_TIME:
+		return(sample.gpuMilliseconds);
+	case METRIC_DRAW_CALLS:
+		return((double)sample.drawCalls);
+	case METRIC_TRIANGLES:
+		return((double)sample.triangles);
+	case METRIC_STATE_CALLS:
+		return((double)sample.stateCalls);
+	case METRIC_ELIDED_STATE_CALLS:
+		return((double)sample.elidedStateCalls);
+	case METRIC_FENCE_STALL_TIME:
+		return(sample.fenceStallMilliseconds);
+	default:
+		return(0.0);
+	}
+}
+
+/***********************************************************
+ *  Summarize()
+ *
+ *  This method is used for getting the mean, the 50th, 95th
+ *  and 99th percentiles and the range of one value over the
+ *  frames after the warm-up.
+ ***********************************************************/
+FrameBenchmark::SUMMARY FrameBenchmark::Summarize(METRIC metric) const
+{
+	SUMMARY summary;
+	summary.mean = 0.0;
+	summary.p50 = 0.0;
+	summary.p95 = 0.0;
+	summary.p99 = 0.0;
+	summary.min = 0.0;
+	summary.max = 0.0;
+
+	std::vector<double> values;
+	for (size_t i = m_warmUpFrames; i < m_samples.size(); i++)
+	{
+		values.push_back(GetMetricValue(m_samples[i], metric));
+	}
+	if (values.empty())
+	{
+		return(summary);
+	}
+
+	std::sort(values.begin(), values.end());
+
+	double total = 0.0;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		total += values[i];
+	}
+	summary.mean = total / (double)values.size();
+	summary.p50 = GetPercentile(values, 50.0);
+	summary.p95 = GetPercentile(values, 95.0);
+	summary.p99 = GetPercentile(values, 99.0);
+	summary.min = values.front();
+	summary.max = values.back();
+
+	return(summary);
+}
+
+/***********************************************************
+ *  WriteResults()
+ *
+ *  This method is used for writing the run to a JSON file -
+ *  what was run, the summary of every value over the
+ *  measured frames, and the values of each measured frame
+ *  for plotting.
+ ***********************************************************/
+bool FrameBenchmark::WriteResults(const char* filename, const char* pathFilename, int width, int height) const
+{
+	FILE* file = fopen(filename, "w");
+	if (NULL == file)
+	{
+		std::cout << "Could not write the benchmark results:" << filename << std::endl;
+		return false;
+	}
+
+	const int measuredFrames = std::max((int)m_samples.size() - m_warmUpFrames, 0);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"cameraPath\": ");
+	WriteJsonString(file, pathFilename);
+	fprintf(file, ",\n");
+	fprintf(file, "  \"width\": %d,\n", width);
+	fprintf(file, "  \"height\": %d,\n", height);
+	fprintf(file, "  \"warmUpFrames\": %d,\n", std::min(m_warmUpFrames, (int)m_samples.size()));
+	fprintf(file, "  \"measuredFrames\": %d,\n", measuredFrames);
+	fprintf(file, "  \"gpuQueries\": %s,\n", m_bQueriesCreated ? "true" : "false");
+
+	fprintf(file, "  \"summary\": {\n");
+	for (int metric = 0; metric < METRIC_COUNT; metric++)
+	{
+		const SUMMARY summary = Summarize((METRIC)metric);
+		fprintf(file, "    \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f }%s\n",
+			g_MetricNames[metric], summary.mean, summary.p50, summary.p95, summary.p99, summary.min, summary.max,
+			(metric + 1 < METRIC_COUNT) ? "," : "");
+	}
+	fprintf(file, "  },\n");
+
+	fprintf(file, "  \"frames\": [\n");
+	for (size_t i = m_warmUpFrames; i < m_samples.size(); i++)
+	{
+		const FRAME_SAMPLE& sample = m_samples[i];
+		fprintf(file, "    { \"%s\": %.4f, \"%s\": %.4f, \"%s\": %.4f, \"%s\": %u, \"%s\": %llu, \"%s\": %u, \"%s\": %u, \"%s\": %.4f }%s\n",
+			g_MetricNames[METRIC_CPU_TIME], sample.cpuMilliseconds,
+			g_MetricNames[METRIC_FRAME_TIME], sample.frameMilliseconds,
+			g_MetricNames[METRIC_GPU_TIME], sample.gpuMilliseconds,
+			g_MetricNames[METRIC_DRAW_CALLS], sample.drawCalls,
+			g_MetricNames[METRIC_TRIANGLES], sample.triangles,
+			g_MetricNames[METRIC_STATE_CALLS], sample.stateCalls,
+			g_MetricNames[METRIC_ELIDED_STATE_CALLS], sample.elidedStateCalls,
+			g_MetricNames[METRIC_FENCE_STALL_TIME], sample.fenceStallMilliseconds,
+			(i + 1 < m_samples.size()) ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	const bool bWritten = (0 == ferror(file));
+	fclose(file);
+
+	return(bWritten);
+}
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// framebenchmark.h
+// ============
+// record the CPU and GPU cost of each frame and summarize it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <vector>
+
+/***********************************************************
+ *  FrameBenchmark
+ *
+ *  This class records the cost of every frame of a benchmark
+ *  run - the CPU time spent sending the frame, the time from
+ *  one frame to the next, the GPU time of the frame from a
+ *  timer query, the draw calls and triangles it drew, the
+ *  state changes it sent and skipped, and the time it spent
+ *  waiting for the GPU to free a stream ring region.
+ *
+ *  The query results are read a few frames later, once the
+ *  GPU has finished with them, so reading them does not
+ *  stall the frames being measured.  The first frames are a
+ *  warm-up, recorded but left out of the summary, so the
+ *  shader compiles, texture uploads and first-touch costs
+ *  do not end up in the statistics.
+ ***********************************************************/
+class FrameBenchmark
+{
+public:
+	// the recorded cost of one frame
+	struct FRAME_SAMPLE
+	{
+		double cpuMilliseconds;
+		double frameMilliseconds;
+		double gpuMilliseconds;
+		unsigned int drawCalls;
+		unsigned long long triangles;
+		// state changes sent to OpenGL and skipped as redundant
+		unsigned int stateCalls;
+		unsigned int elidedStateCalls;
+		// time spent waiting on the stream ring fences
+		double fenceStallMilliseconds;
+	};
+
+	// values recorded for each frame
+	enum METRIC
+	{
+		METRIC_CPU_TIME = 0,
+		METRIC_FRAME_TIME,
+		METRIC_GPU_TIME,
+		METRIC_DRAW_CALLS,
+		METRIC_TRIANGLES,
+		METRIC_STATE_CALLS,
+		METRIC_ELIDED_STATE_CALLS,
+		METRIC_FENCE_STALL_TIME,
+		METRIC_COUNT
+	};
+
+	// summary of one value over the measured frames
+	struct SUMMARY
+	{
+		double mean;
+		double p50;
+		double p95;
+		double p99;
+		double min;
+		double max;
+	};
+
+	// constructor
+	FrameBenchmark();
+	// destructor
+	~FrameBenchmark();
+
+	// create the queries - the context has to be current
+	bool CreateQueries();
+	// free the queries
+	void Destroy();
+
+	// set the number of frames left out of the summary
+	void SetWarmUpFrames(int frames) { m_warmUpFrames = (frames > 0) ? frames : 0; }
+
+	// start timing a frame
+	void BeginFrame();
+	// mark the end of the CPU work of the frame, once every
+	// draw has been sent
+	void EndFrameSubmit(unsigned int drawCalls, unsigned int stateCalls, unsigned int elidedStateCalls, double fenceStallMilliseconds);
+	// finish the run, waiting for the last query results
+	void Finish();
+
+	// summarize one value of the frames after the warm-up
+	SUMMARY Summarize(METRIC metric) const;
+	// write the summary and the measured frames to a JSON file
+	bool WriteResults(const char* filename, const char* pathFilename, int width, int height) const;
+
+	// get the recorded frames, warm-up included
+	const std::vector<FRAME_SAMPLE>& GetSamples() const { return(m_samples); }
+
+private:
+	// frames whose queries can be in flight at once
+	static const int QUERY_RING_SIZE = 4;
+
+	// timer and primitive queries of one frame, and the
+	// sample their results go into
+	struct FRAME_QUERIES
+	{
+		GLuint timerQueryID;
+		GLuint primitiveQueryID;
+		int sample;
+	};
+
+	FRAME_QUERIES m_queries[QUERY_RING_SIZE];
+	bool m_bQueriesCreated;
+	// recorded frames, warm-up included
+	std::vector<FRAME_SAMPLE> m_samples;
+	int m_warmUpFrames;
+	// the frame being recorded, or -1 between frames
+	int m_currentSample;
+	std::chrono::steady_clock::time_point m_frameStart;
+
+	// read the results of a ring slot into its sample
+	void ReadQueries(FRAME_QUERIES& queries);
+	// get one value of a recorded frame
+	static double GetMetricValue(const FRAME_SAMPLE& sample, METRIC metric);
+};
@@ -0,0 +1,192 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecache.cpp
+// ============
+// keep the last drawn frame, so it can be shown again without drawing it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCache.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+
+/***********************************************************
+ *  FrameCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCache::FrameCache()
+{
+	m_framebufferID = 0;
+	m_colorBufferID = 0;
+	m_depthBufferID = 0;
+	m_width = 0;
+	m_height = 0;
+	m_bHasFrame = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~FrameCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCache::~FrameCache()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for binding the framebuffer for a
+ *  new frame to be drawn into.  It is created again at the
+ *  passed in size when the window has changed size, and
+ *  nothing is bound for a minimized window.
+ ***********************************************************/
+bool FrameCache::BeginFrame(int width, int height)
+{
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	if ((0 == m_framebufferID) || (m_width != width) || (m_height != height))
+	{
+		Destroy();
+		if (CreateFramebuffer(width, height) == false)
+		{
+			Destroy();
+			return(false);
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	m_bHasFrame = false;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for copying the frame just drawn
+ *  into the back buffer of the window, and keeping it to be
+ *  shown again.
+ ***********************************************************/
+void FrameCache::Present()
+{
+	if (0 == m_framebufferID)
+	{
+		return;
+	}
+
+	BlitToWindow();
+	m_bHasFrame = true;
+	m_stats.drawnFrames++;
+}
+
+/***********************************************************
+ *  PresentAgain()
+ *
+ *  This method is used for copying the kept frame into the
+ *  back buffer of the window once more, for a window that
+ *  has to be shown again while nothing in it has changed.
+ ***********************************************************/
+void FrameCache::PresentAgain()
+{
+	if (false == m_bHasFrame)
+	{
+		return;
+	}
+
+	BlitToWindow();
+	m_stats.reusedFrames++;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the framebuffer and its
+ *  storage, leaving the default framebuffer bound.
+ ***********************************************************/
+void FrameCache::Destroy()
+{
+	if (0 != m_framebufferID)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (0 != m_colorBufferID)
+	{
+		glDeleteRenderbuffers(1, &m_colorBufferID);
+		m_colorBufferID = 0;
+	}
+	if (0 != m_depthBufferID)
+	{
+		glDeleteRenderbuffers(1, &m_depthBufferID);
+		m_depthBufferID = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+	m_bHasFrame = false;
+}
+
+/***********************************************************
+ *  CreateFramebuffer()
+ *
+ *  This method is used for creating the framebuffer object
+ *  with an RGBA color buffer and a depth buffer of the
+ *  passed in size, as the window's own buffers are.
+ ***********************************************************/
+bool FrameCache::CreateFramebuffer(int width, int height)
+{
+	PROFILE_ZONE("FrameCache::CreateFramebuffer");
+
+	glGenRenderbuffers(1, &m_colorBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBufferID);
+
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		std::cout << "The kept frame framebuffer is not complete" << std::endl;
+		return(false);
+	}
+
+	m_width = width;
+	m_height = height;
+
+	return(true);
+}
+
+/***********************************************************
+ *  BlitToWindow()
+ *
+ *  This method is used for copying the color buffer of the
+ *  framebuffer into the back buffer of the window, which is
+ *  left bound for the swap.
+ ***********************************************************/
+void FrameCache::BlitToWindow()
+{
+	PROFILE_ZONE("FrameCache::BlitToWindow");
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(
+		0, 0, m_width, m_height,
+		0, 0, m_width, m_height,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
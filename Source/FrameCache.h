@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecache.h
+// ============
+// keep the last drawn frame, so it can be shown again without drawing it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  FrameCache
+ *
+ *  This class holds a framebuffer object the frames are
+ *  drawn into instead of the window, which is then copied
+ *  into the back buffer of the window to be swapped.  The
+ *  copy stays behind after the swap, so when nothing in the
+ *  view or the scene has changed the window can be given
+ *  the same frame again with a single blit, where drawing
+ *  it would cull, sort and draw the whole scene.
+ *
+ *  The framebuffer follows the size of the window, and has
+ *  to be used on the thread the context is current on.
+ ***********************************************************/
+class FrameCache
+{
+public:
+	// constructor
+	FrameCache();
+	// destructor
+	~FrameCache();
+
+	struct FRAME_CACHE_STATS
+	{
+		// frames drawn into the framebuffer
+		unsigned int drawnFrames;
+		// frames shown again from it without drawing
+		unsigned int reusedFrames;
+	};
+
+	// bind the framebuffer to draw a new frame into, first
+	// resizing it when the window has changed size
+	bool BeginFrame(int width, int height);
+	// copy the kept frame into the back buffer of the window
+	void Present();
+	// copy the kept frame into the back buffer of the window
+	// again, without drawing it
+	void PresentAgain();
+	// free the framebuffer
+	void Destroy();
+
+	// get whether there is a frame of the passed in size to
+	// be shown again
+	bool HasFrame(int width, int height) const { return(m_bHasFrame && (m_width == width) && (m_height == height)); }
+	// get the drawn and reused frame counts
+	FRAME_CACHE_STATS GetStats() const { return(m_stats); }
+
+private:
+	// framebuffer and its color and depth storage
+	GLuint m_framebufferID;
+	GLuint m_colorBufferID;
+	GLuint m_depthBufferID;
+	int m_width;
+	int m_height;
+	// set once a whole frame was drawn into the framebuffer
+	bool m_bHasFrame;
+	FRAME_CACHE_STATS m_stats;
+
+	// create the framebuffer at the passed in size
+	bool CreateFramebuffer(int width, int height);
+	// copy the color buffer into the default framebuffer
+	void BlitToWindow();
+};
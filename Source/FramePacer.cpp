@@ -0,0 +1,405 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.cpp
+// ============
+// start the frames at an even rate, and measure how even they are
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FramePacer.h"
+#include "Profiler.h"
+
+#include "GLFW/glfw3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+const double FramePacer::BUCKET_MILLISECONDS = 0.25;
+
+// declaration of global variables
+namespace
+{
+	// time that is always spun instead of slept, on top of
+	// the overshoot the sleeps were seen to have
+	const double g_SpinSeconds = 0.0002;
+	// length of each sleep of a wait, short enough that the
+	// overshoot of one does not eat the whole wait
+	const double g_SleepSeconds = 0.001;
+	// overshoot assumed before any sleep was measured
+	const double g_InitialOvershootSeconds = 0.001;
+	// share of the difference the slowly falling estimates
+	// move by on each sample below them
+	const double g_EstimateDecay = 0.05;
+	// time the just in time start keeps in hand for the GPU
+	// and the compositor after the CPU work of the frame
+	const double g_JustInTimeMarginSeconds = 0.002;
+
+	/***********************************************************
+	 *  UpdatePeakEstimate()
+	 *
+	 *  This function is used for moving an estimate up to a
+	 *  larger sample at once, and slowly down towards a smaller
+	 *  one, so that it stays close to the worst recent case.
+	 ***********************************************************/
+	void UpdatePeakEstimate(double& estimate, double sample)
+	{
+		if (sample > estimate)
+		{
+			estimate = sample;
+		}
+		else
+		{
+			estimate += (sample - estimate) * g_EstimateDecay;
+		}
+	}
+}
+
+/***********************************************************
+ *  FramePacer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FramePacer::FramePacer()
+{
+	m_mode = PACING_VSYNC;
+	m_targetRate = 0.0;
+	m_refreshRate = 60.0;
+	m_bStarted = false;
+	m_bHasSwapped = false;
+	m_workSeconds = 0.0;
+	m_sleepOvershootSeconds = g_InitialOvershootSeconds;
+	memset(m_histogram, 0, sizeof(m_histogram));
+	m_frameCount = 0;
+	m_totalSeconds = 0.0;
+	m_totalErrorSeconds = 0.0;
+	m_maxErrorSeconds = 0.0;
+	m_missedFrames = 0;
+}
+
+/***********************************************************
+ *  ~FramePacer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	if (m_bStarted)
+	{
+		timeEndPeriod(1);
+	}
+#endif
+}
+
+/***********************************************************
+ *  ParseMode()
+ *
+ *  This method is used for reading a pacing mode from the
+ *  command line - "off", "vsync", "jit", or a frame rate
+ *  above zero for the target rate mode.
+ ***********************************************************/
+bool FramePacer::ParseMode(const char* text, PACING_MODE& mode, double& targetRate)
+{
+	targetRate = 0.0;
+	if (strcmp(text, "off") == 0)
+	{
+		mode = PACING_OFF;
+		return true;
+	}
+	if (strcmp(text, "vsync") == 0)
+	{
+		mode = PACING_VSYNC;
+		return true;
+	}
+	if (strcmp(text, "jit") == 0)
+	{
+		mode = PACING_JUST_IN_TIME;
+		return true;
+	}
+
+	char* pEnd = NULL;
+	const double rate = strtod(text, &pEnd);
+	if ((pEnd == text) || (*pEnd != '\0') || !(rate > 0.0))
+	{
+		return false;
+	}
+	mode = PACING_TARGET_RATE;
+	targetRate = rate;
+	return true;
+}
+
+/***********************************************************
+ *  SetMode()
+ *
+ *  This method is used for setting the pacing mode, and the
+ *  frame rate the target rate mode holds the frames to.
+ ***********************************************************/
+void FramePacer::SetMode(PACING_MODE mode, double targetRate)
+{
+	m_mode = mode;
+	m_targetRate = targetRate;
+	if ((PACING_TARGET_RATE == m_mode) && !(m_targetRate > 0.0))
+	{
+		m_mode = PACING_OFF;
+	}
+}
+
+/***********************************************************
+ *  SetRefreshRate()
+ *
+ *  This method is used for setting the refresh rate of the
+ *  display, which the vsync modes aim the frames at.
+ ***********************************************************/
+void FramePacer::SetRefreshRate(double refreshRate)
+{
+	if (refreshRate > 0.0)
+	{
+		m_refreshRate = refreshRate;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for setting the swap interval of the
+ *  current context for the mode - the vsync modes wait for
+ *  the display in the swap, the others pace the frames
+ *  themselves - and starting to measure.
+ ***********************************************************/
+void FramePacer::Start()
+{
+	const bool bVsync = (PACING_VSYNC == m_mode) || (PACING_JUST_IN_TIME == m_mode);
+	glfwSwapInterval(bVsync ? 1 : 0);
+
+#ifdef _WIN32
+	// the default timer resolution would make every sleep
+	// last a whole 15.6 ms tick
+	if (false == m_bStarted)
+	{
+		timeBeginPeriod(1);
+	}
+#endif
+
+	m_bStarted = true;
+	m_bHasSwapped = false;
+	m_nextDeadline = Clock::now();
+	m_frameStart = m_nextDeadline;
+}
+
+/***********************************************************
+ *  Resume()
+ *
+ *  This method is used for picking the measuring up again
+ *  after the loop waited for something to draw.  The time
+ *  since the last swap is dropped instead of going into the
+ *  histogram as one long frame, and the target rate mode
+ *  starts its cadence over.
+ ***********************************************************/
+void FramePacer::Resume()
+{
+	m_bHasSwapped = false;
+	m_nextDeadline = Clock::now();
+}
+
+/***********************************************************
+ *  WaitForFrameStart()
+ *
+ *  This method is used for waiting until the next frame
+ *  should start.  The target rate mode waits for the next
+ *  slot of its fixed cadence, dropping the slots it is more
+ *  than a frame behind on.  The just in time mode waits
+ *  until the next refresh is only the CPU work of a frame
+ *  and a margin away.  The other modes do not wait.
+ ***********************************************************/
+void FramePacer::WaitForFrameStart()
+{
+	PROFILE_ZONE("FramePacer::WaitForFrameStart");
+
+	if (PACING_TARGET_RATE == m_mode)
+	{
+		const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(1.0 / m_targetRate));
+		WaitUntil(m_nextDeadline);
+		const Clock::time_point now = Clock::now();
+		m_nextDeadline += period;
+		if (m_nextDeadline + period < now)
+		{
+			m_nextDeadline = now + period;
+		}
+	}
+	else if ((PACING_JUST_IN_TIME == m_mode) && m_bHasSwapped)
+	{
+		// the swap returned at about the last refresh
+		const double startSeconds = (1.0 / m_refreshRate) - m_workSeconds - g_JustInTimeMarginSeconds;
+		if (startSeconds > 0.0)
+		{
+			WaitUntil(m_lastSwap + std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(startSeconds)));
+		}
+	}
+
+	m_frameStart = Clock::now();
+}
+
+/***********************************************************
+ *  EndFrameWork()
+ *
+ *  This method is used for measuring the CPU work of the
+ *  frame, which the just in time start leaves room for.
+ ***********************************************************/
+void FramePacer::EndFrameWork()
+{
+	const double workSeconds = std::chrono::duration<double>(Clock::now() - m_frameStart).count();
+	UpdatePeakEstimate(m_workSeconds, workSeconds);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for recording the time since the
+ *  last buffer swap returned in the histogram, along with
+ *  how far it is from the interval the mode aims for.
+ ***********************************************************/
+void FramePacer::EndFrame()
+{
+	const Clock::time_point now = Clock::now();
+	if (m_bHasSwapped)
+	{
+		const double seconds = std::chrono::duration<double>(now - m_lastSwap).count();
+		const int bucket = std::min((int)(seconds * 1000.0 / BUCKET_MILLISECONDS), HISTOGRAM_BUCKETS - 1);
+		m_histogram[bucket]++;
+		m_frameCount++;
+		m_totalSeconds += seconds;
+
+		const double targetSeconds = GetTargetInterval();
+		if (targetSeconds > 0.0)
+		{
+			const double error = fabs(seconds - targetSeconds);
+			m_totalErrorSeconds += error;
+			m_maxErrorSeconds = std::max(m_maxErrorSeconds, error);
+			if (seconds > targetSeconds * 1.5)
+			{
+				m_missedFrames++;
+			}
+		}
+	}
+
+	m_lastSwap = now;
+	m_bHasSwapped = true;
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the frame times and the
+ *  pacing error since Start().
+ ***********************************************************/
+FramePacer::PACING_STATS FramePacer::GetStats() const
+{
+	PACING_STATS stats;
+	memset(&stats, 0, sizeof(stats));
+
+	stats.targetMilliseconds = GetTargetInterval() * 1000.0;
+	if (0 == m_frameCount)
+	{
+		return(stats);
+	}
+
+	stats.frameCount = m_frameCount;
+	stats.meanMilliseconds = m_totalSeconds * 1000.0 / m_frameCount;
+	stats.p50Milliseconds = GetPercentile(50.0);
+	stats.p95Milliseconds = GetPercentile(95.0);
+	stats.p99Milliseconds = GetPercentile(99.0);
+	if (stats.targetMilliseconds > 0.0)
+	{
+		stats.meanErrorMilliseconds = m_totalErrorSeconds * 1000.0 / m_frameCount;
+		stats.maxErrorMilliseconds = m_maxErrorSeconds * 1000.0;
+		stats.missedFrames = m_missedFrames;
+	}
+
+	return(stats);
+}
+
+/***********************************************************
+ *  GetTargetInterval()
+ *
+ *  This method is used for getting the time between frames
+ *  the mode aims for - the refresh interval for the vsync
+ *  modes, and none for the uncapped one.
+ ***********************************************************/
+double FramePacer::GetTargetInterval() const
+{
+	switch (m_mode)
+	{
+	case PACING_TARGET_RATE:
+		return(1.0 / m_targetRate);
+	case PACING_VSYNC:
+	case PACING_JUST_IN_TIME:
+		return(1.0 / m_refreshRate);
+	default:
+		return(0.0);
+	}
+}
+
+/***********************************************************
+ *  WaitUntil()
+ *
+ *  This method is used for waiting until the passed in time.
+ *  It sleeps in short steps while the time is further away
+ *  than a sleep may overshoot, learning the overshoot from
+ *  each of them, and then spins, yielding the core, for the
+ *  rest.
+ ***********************************************************/
+void FramePacer::WaitUntil(Clock::time_point deadline)
+{
+	const Clock::duration sleepTime = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(g_SleepSeconds));
+
+	Clock::time_point now = Clock::now();
+	while (std::chrono::duration<double>(deadline - now).count() > g_SleepSeconds + m_sleepOvershootSeconds + g_SpinSeconds)
+	{
+		std::this_thread::sleep_for(sleepTime);
+		const Clock::time_point woken = Clock::now();
+		const double overshoot = std::chrono::duration<double>(woken - now).count() - g_SleepSeconds;
+		UpdatePeakEstimate(m_sleepOvershootSeconds, std::max(0.0, overshoot));
+		now = woken;
+	}
+
+	while (Clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+/***********************************************************
+ *  GetPercentile()
+ *
+ *  This method is used for getting the upper edge of the
+ *  histogram bucket that the passed in percentile of the
+ *  frame times falls in.
+ ***********************************************************/
+double FramePacer::GetPercentile(double percentile) const
+{
+	const unsigned int rank = (unsigned int)ceil(percentile / 100.0 * m_frameCount);
+	unsigned int count = 0;
+	for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+	{
+		count += m_histogram[bucket];
+		if (count >= std::max(rank, 1u))
+		{
+			return((bucket + 1) * BUCKET_MILLISECONDS);
+		}
+	}
+	return(HISTOGRAM_BUCKETS * BUCKET_MILLISECONDS);
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.h
+// ============
+// start the frames at an even rate, and measure how even they are
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+
+/***********************************************************
+ *  FramePacer
+ *
+ *  This class decides when the render loop starts each
+ *  frame.  It can leave the frames uncapped, let the buffer
+ *  swap wait for the display, hold the frames to a target
+ *  rate, or wait for the display and start each frame just
+ *  early enough to be done by the next refresh, so the
+ *  camera state it draws is as recent as possible.
+ *
+ *  The waits sleep while the deadline is further away than
+ *  a sleep may overshoot, which is learned as it runs, and
+ *  spin for the rest, so the loop neither burns a core nor
+ *  misses its deadline by a timer tick.  The time between
+ *  frames is kept in a histogram, with how far it strayed
+ *  from the interval the mode aims for.
+ ***********************************************************/
+class FramePacer
+{
+public:
+	// constructor
+	FramePacer();
+	// destructor
+	~FramePacer();
+
+	enum PACING_MODE
+	{
+		// start every frame right away
+		PACING_OFF = 0,
+		// let the buffer swap wait for the display refresh
+		PACING_VSYNC,
+		// start the frames at a fixed rate without vsync
+		PACING_TARGET_RATE,
+		// wait for the display refresh, and start each frame as
+		// late as it can be and still make it
+		PACING_JUST_IN_TIME
+	};
+
+	// frame times and pacing error since Start()
+	struct PACING_STATS
+	{
+		unsigned int frameCount;
+		double meanMilliseconds;
+		double p50Milliseconds;
+		double p95Milliseconds;
+		double p99Milliseconds;
+		// interval the frames aim for, zero when uncapped
+		double targetMilliseconds;
+		// distance of the frame times from the target
+		double meanErrorMilliseconds;
+		double maxErrorMilliseconds;
+		// frames that took more than one and a half targets
+		unsigned int missedFrames;
+	};
+
+	// read a mode from a command line - "off", "vsync", "jit",
+	// or a frame rate for the target rate mode
+	static bool ParseMode(const char* text, PACING_MODE& mode, double& targetRate);
+
+	// set the mode and the frame rate of the target rate mode
+	void SetMode(PACING_MODE mode, double targetRate);
+	// set the refresh rate of the display the vsync modes wait
+	// for - it can only be queried on the main thread
+	void SetRefreshRate(double refreshRate);
+
+	// set the swap interval for the mode and start measuring -
+	// the context has to be current on the calling thread
+	void Start();
+	// start measuring again after the loop sat idle, so that
+	// the idle time is not counted as a frame
+	void Resume();
+	// wait until the next frame should start
+	void WaitForFrameStart();
+	// mark the end of the CPU work of the frame, just before
+	// the buffer swap
+	void EndFrameWork();
+	// mark the return of the buffer swap, when the frame is
+	// on its way to the display
+	void EndFrame();
+
+	// get the frame times and pacing error since Start()
+	PACING_STATS GetStats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// frame time histogram buckets - the last one holds every
+	// frame that took longer
+	static const int HISTOGRAM_BUCKETS = 400;
+	static const double BUCKET_MILLISECONDS;
+
+	PACING_MODE m_mode;
+	double m_targetRate;
+	double m_refreshRate;
+	bool m_bStarted;
+
+	// start of the frame being drawn, and when its CPU work
+	// ended and it was last swapped
+	Clock::time_point m_frameStart;
+	Clock::time_point m_lastSwap;
+	bool m_bHasSwapped;
+	// start the target rate mode aims the next frame at
+	Clock::time_point m_nextDeadline;
+
+	// CPU work a frame takes, rising at once and falling
+	// slowly, for the just in time start
+	double m_workSeconds;
+	// longest a sleep was seen to overshoot, falling slowly
+	double m_sleepOvershootSeconds;
+
+	unsigned int m_histogram[HISTOGRAM_BUCKETS];
+	unsigned int m_frameCount;
+	double m_totalSeconds;
+	double m_totalErrorSeconds;
+	double m_maxErrorSeconds;
+	unsigned int m_missedFrames;
+
+	// get the interval the mode aims the frames at, or zero
+	double GetTargetInterval() const;
+	// sleep and then spin until the passed in time
+	void WaitUntil(Clock::time_point deadline);
+	// get the frame time below which the passed in share of
+	// the frames fall
+	double GetPercentile(double percentile) const;
+};
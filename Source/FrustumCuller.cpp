@@ -0,0 +1,334 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// test the bounding boxes of the scene objects against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FRUSTUMCULLER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define FRUSTUMCULLER_NEON
+#include <arm_neon.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// one coordinate of four boxes, and the result of testing
+	// four boxes against a plane
+#if defined(FRUSTUMCULLER_SSE2)
+	typedef __m128 VECTOR4;
+	typedef __m128 MASK4;
+
+	inline VECTOR4 Load4(const float* p) { return(_mm_loadu_ps(p)); }
+	inline VECTOR4 Splat4(float s) { return(_mm_set1_ps(s)); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { return(_mm_add_ps(_mm_mul_ps(a, b), c)); }
+	inline MASK4 AllMask4() { return(_mm_castsi128_ps(_mm_set1_epi32(-1))); }
+	inline MASK4 NotNegativeMask4(VECTOR4 v) { return(_mm_cmpge_ps(v, _mm_setzero_ps())); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(_mm_and_ps(a, b)); }
+	inline int MaskBits4(MASK4 m) { return(_mm_movemask_ps(m)); }
+#elif defined(FRUSTUMCULLER_NEON)
+	typedef float32x4_t VECTOR4;
+	typedef uint32x4_t MASK4;
+
+	inline VECTOR4 Load4(const float* p) { return(vld1q_f32(p)); }
+	inline VECTOR4 Splat4(float s) { return(vdupq_n_f32(s)); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { return(vmlaq_f32(c, a, b)); }
+	inline MASK4 AllMask4() { return(vdupq_n_u32(0xFFFFFFFF)); }
+	inline MASK4 NotNegativeMask4(VECTOR4 v) { return(vcgeq_f32(v, vdupq_n_f32(0.0f))); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(vandq_u32(a, b)); }
+	inline int MaskBits4(MASK4 m)
+	{
+		const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+		uint32x4_t bits = vandq_u32(m, vld1q_u32(laneBits));
+		return((int)(vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) | vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3)));
+	}
+#else
+	struct VECTOR4
+	{
+		float v[4];
+	};
+	typedef int MASK4;
+
+	inline VECTOR4 Load4(const float* p) { VECTOR4 o = { { p[0], p[1], p[2], p[3] } }; return(o); }
+	inline VECTOR4 Splat4(float s) { VECTOR4 o = { { s, s, s, s } }; return(o); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { for (int i = 0; i < 4; i++) { c.v[i] += a.v[i] * b.v[i]; } return(c); }
+	inline MASK4 AllMask4() { return(0xF); }
+	inline MASK4 NotNegativeMask4(VECTOR4 v) { MASK4 m = 0; for (int i = 0; i < 4; i++) { m |= (v.v[i] >= 0.0f) ? (1 << i) : 0; } return(m); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(a & b); }
+	inline int MaskBits4(MASK4 m) { return(m); }
+#endif
+}
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	m_objectCount = 0;
+	memset(&m_lastCullStats, 0, sizeof(m_lastCullStats));
+}
+
+/***********************************************************
+ *  ~FrustumCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrustumCuller::~FrustumCuller()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all the objects.
+ ***********************************************************/
+void FrustumCuller::Clear()
+{
+	Resize(0);
+	memset(&m_lastCullStats, 0, sizeof(m_lastCullStats));
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for setting the number of objects.
+ *  The coordinate arrays are padded up to a whole number of
+ *  four object groups, so Cull() never reads past their end.
+ ***********************************************************/
+void FrustumCuller::Resize(int objectCount)
+{
+	if (objectCount < 0)
+	{
+		objectCount = 0;
+	}
+
+	const LOCAL_BOUNDS noBounds = { glm::vec3(0.0f), glm::vec3(0.0f), false };
+	const size_t paddedCount = ((size_t)objectCount + 3) & ~(size_t)3;
+
+	m_objectCount = objectCount;
+	m_localBounds.resize(objectCount, noBounds);
+	m_centerX.resize(paddedCount, 0.0f);
+	m_centerY.resize(paddedCount, 0.0f);
+	m_centerZ.resize(paddedCount, 0.0f);
+	m_extentX.resize(paddedCount, 0.0f);
+	m_extentY.resize(paddedCount, 0.0f);
+	m_extentZ.resize(paddedCount, 0.0f);
+	m_visibleFlags.resize(objectCount, 1);
+}
+
+/***********************************************************
+ *  SetLocalBounds()
+ *
+ *  This method is used for setting the box around an object
+ *  in its own space.  It takes effect on the next call to
+ *  SetWorldMatrix() for the object.
+ ***********************************************************/
+void FrustumCuller::SetLocalBounds(int object, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	if ((object < 0) || (object >= m_objectCount))
+	{
+		return;
+	}
+
+	m_localBounds[object].center = (boundsMin + boundsMax) * 0.5f;
+	m_localBounds[object].extent = (boundsMax - boundsMin) * 0.5f;
+	m_localBounds[object].bValid = true;
+}
+
+/***********************************************************
+ *  SetWorldMatrix()
+ *
+ *  This method is used for moving the box of an object into
+ *  world space.  The center is transformed as a point, and
+ *  each world half size is the sum of the local half sizes
+ *  along the absolute values of a row of the matrix, which
+ *  gives the smallest axis aligned box around the turned
+ *  and scaled local box.
+ ***********************************************************/
+void FrustumCuller::SetWorldMatrix(int object, const glm::mat4& worldMatrix)
+{
+	if ((object < 0) || (object >= m_objectCount) || (false == m_localBounds[object].bValid))
+	{
+		return;
+	}
+
+	const LOCAL_BOUNDS& bounds = m_localBounds[object];
+	const glm::vec3 center = glm::vec3(worldMatrix * glm::vec4(bounds.center, 1.0f));
+	const glm::vec3 extent =
+		glm::abs(glm::vec3(worldMatrix[0])) * bounds.extent.x +
+		glm::abs(glm::vec3(worldMatrix[1])) * bounds.extent.y +
+		glm::abs(glm::vec3(worldMatrix[2])) * bounds.extent.z;
+
+	m_centerX[object] = center.x;
+	m_centerY[object] = center.y;
+	m_centerZ[object] = center.z;
+	m_extentX[object] = extent.x;
+	m_extentY[object] = extent.y;
+	m_extentZ[object] = extent.z;
+}
+
+/***********************************************************
+ *  GetFrustumPlanes()
+ *
+ *  This method is used for getting the six planes of the
+ *  frustum of a view projection matrix, with their normals
+ *  pointing inwards.  Each plane is the sum or difference of
+ *  the last row and one of the others, for the OpenGL clip
+ *  space where x, y and z run from -w to w.  The planes are
+ *  not normalized - a box is tested by comparing two
+ *  distances that are both scaled by the normal length.
+ ***********************************************************/
+void FrustumCuller::GetFrustumPlanes(const glm::mat4& m, glm::vec4 planes[PLANE_COUNT])
+{
+	// glm matrices are stored by column
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+}
+
+/***********************************************************
+ *  GetWorldBounds()
+ *
+ *  This method is used for getting the world box of an
+ *  object as its lowest and highest corner.
+ ***********************************************************/
+bool FrustumCuller::GetWorldBounds(int object, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	if ((object < 0) || (object >= m_objectCount) || (false == m_localBounds[object].bValid))
+	{
+		return false;
+	}
+
+	const glm::vec3 center(m_centerX[object], m_centerY[object], m_centerZ[object]);
+	const glm::vec3 extent(m_extentX[object], m_extentY[object], m_extentZ[object]);
+	boundsMin = center - extent;
+	boundsMax = center + extent;
+	return true;
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for finding the objects whose world
+ *  box is inside the frustum of the passed in view
+ *  projection.  For each plane, the distance of a box center
+ *  is compared with the distance its half sizes reach along
+ *  the plane normal - when the center is further outside
+ *  than that, the whole box is outside.  Four boxes are
+ *  tested against each plane at once.  Objects without a box
+ *  are always visible and are left out of the counts.
+ ***********************************************************/
+void FrustumCuller::Cull(const glm::mat4& viewProjection)
+{
+	PROFILE_ZONE("FrustumCuller::Cull");
+
+	glm::vec4 planes[PLANE_COUNT];
+	GetFrustumPlanes(viewProjection, planes);
+
+	// the plane values are the same for every group of four
+	VECTOR4 normalX[PLANE_COUNT];
+	VECTOR4 normalY[PLANE_COUNT];
+	VECTOR4 normalZ[PLANE_COUNT];
+	VECTOR4 absNormalX[PLANE_COUNT];
+	VECTOR4 absNormalY[PLANE_COUNT];
+	VECTOR4 absNormalZ[PLANE_COUNT];
+	VECTOR4 planeDistance[PLANE_COUNT];
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+	{
+		normalX[plane] = Splat4(planes[plane].x);
+		normalY[plane] = Splat4(planes[plane].y);
+		normalZ[plane] = Splat4(planes[plane].z);
+		absNormalX[plane] = Splat4(std::fabs(planes[plane].x));
+		absNormalY[plane] = Splat4(std::fabs(planes[plane].y));
+		absNormalZ[plane] = Splat4(std::fabs(planes[plane].z));
+		planeDistance[plane] = Splat4(planes[plane].w);
+	}
+
+	memset(&m_lastCullStats, 0, sizeof(m_lastCullStats));
+
+	for (int first = 0; first < m_objectCount; first += 4)
+	{
+		const VECTOR4 centerX = Load4(&m_centerX[first]);
+		const VECTOR4 centerY = Load4(&m_centerY[first]);
+		const VECTOR4 centerZ = Load4(&m_centerZ[first]);
+		const VECTOR4 extentX = Load4(&m_extentX[first]);
+		const VECTOR4 extentY = Load4(&m_extentY[first]);
+		const VECTOR4 extentZ = Load4(&m_extentZ[first]);
+
+		MASK4 inside = AllMask4();
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			// signed distance of the center plus the reach of the box
+			VECTOR4 distance = MultiplyAdd4(centerX, normalX[plane], planeDistance[plane]);
+			distance = MultiplyAdd4(centerY, normalY[plane], distance);
+			distance = MultiplyAdd4(centerZ, normalZ[plane], distance);
+			distance = MultiplyAdd4(extentX, absNormalX[plane], distance);
+			distance = MultiplyAdd4(extentY, absNormalY[plane], distance);
+			distance = MultiplyAdd4(extentZ, absNormalZ[plane], distance);
+
+			inside = AndMask4(inside, NotNegativeMask4(distance));
+		}
+
+		const int insideBits = MaskBits4(inside);
+		const int last = (first + 4 < m_objectCount) ? first + 4 : m_objectCount;
+		for (int object = first; object < last; object++)
+		{
+			if (false == m_localBounds[object].bValid)
+			{
+				m_visibleFlags[object] = 1;
+				continue;
+			}
+
+			const bool bVisible = (0 != (insideBits & (1 << (object - first))));
+			m_visibleFlags[object] = bVisible ? 1 : 0;
+			m_lastCullStats.testedCount++;
+			if (bVisible)
+			{
+				m_lastCullStats.visibleCount++;
+			}
+			else
+			{
+				m_lastCullStats.culledCount++;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  SetAllVisible()
+ *
+ *  This method is used for marking every object as visible,
+ *  for frames drawn without culling.
+ ***********************************************************/
+void FrustumCuller::SetAllVisible()
+{
+	memset(&m_lastCullStats, 0, sizeof(m_lastCullStats));
+	for (int object = 0; object < m_objectCount; object++)
+	{
+		m_visibleFlags[object] = 1;
+		if (m_localBounds[object].bValid)
+		{
+			m_lastCullStats.testedCount++;
+			m_lastCullStats.visibleCount++;
+		}
+	}
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// test the bounding boxes of the scene objects against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class keeps a world space axis aligned box for every
+ *  scene object and finds the objects whose box is at least
+ *  partly inside the six planes of the view frustum, so the
+ *  objects outside of it can be left out of the frame before
+ *  any of their state is set.
+ *
+ *  Each object has a box in its own space, from the shape it
+ *  draws, and SetWorldMatrix() turns that box into the world
+ *  space box around it whenever the object moves.  The world
+ *  boxes are kept as center and half size, one array per
+ *  coordinate, so Cull() can load the boxes of four objects
+ *  at once and test them against each plane with SSE2 or
+ *  NEON where the compiler targets them, and with plain C++
+ *  otherwise.
+ *
+ *  The test is conservative - a box that is outside of no
+ *  single plane counts as visible even if it misses the
+ *  frustum near one of its corners.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+	// destructor
+	~FrustumCuller();
+
+	// planes of a frustum - left, right, bottom, top, near, far
+	static const int PLANE_COUNT = 6;
+
+	// get the planes of the frustum of a view projection, with
+	// their normals pointing inwards
+	static void GetFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[PLANE_COUNT]);
+
+	struct CULL_STATS
+	{
+		// objects with a box, and how many of them were inside
+		// and outside of the frustum
+		unsigned int testedCount;
+		unsigned int visibleCount;
+		unsigned int culledCount;
+	};
+
+	// remove all the objects
+	void Clear();
+	// set the number of objects - new objects have no box and
+	// are always visible
+	void Resize(int objectCount);
+
+	// set the box of an object in its own space
+	void SetLocalBounds(int object, glm::vec3 boundsMin, glm::vec3 boundsMax);
+	// move the box of an object into world space
+	void SetWorldMatrix(int object, const glm::mat4& worldMatrix);
+
+	// find the objects inside the frustum of a view projection
+	void Cull(const glm::mat4& viewProjection);
+	// mark every object as visible, without testing any
+	void SetAllVisible();
+	// get whether an object was inside the frustum
+	bool IsVisible(int object) const { return(0 != m_visibleFlags[object]); }
+
+	// get the world box of an object - returns false for an
+	// object without a box
+	bool GetWorldBounds(int object, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	// get the number of objects
+	int GetObjectCount() const { return(m_objectCount); }
+	// get the visible and culled counts of the last cull
+	CULL_STATS GetLastCullStats() const { return(m_lastCullStats); }
+
+private:
+	// box of an object in its own space
+	struct LOCAL_BOUNDS
+	{
+		glm::vec3 center;
+		glm::vec3 extent;
+		bool bValid;
+	};
+
+	int m_objectCount;
+	std::vector<LOCAL_BOUNDS> m_localBounds;
+	// centers and half sizes of the world boxes, one array
+	// per coordinate, padded to a multiple of four objects
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	// result of the last cull for each object
+	std::vector<uint8_t> m_visibleFlags;
+	// counts of the last cull
+	CULL_STATS m_lastCullStats;
+};
@@ -0,0 +1,582 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// track the OpenGL state and skip the calls that would not change it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+	m_frameStats.callsIssued = 0;
+	m_frameStats.callsElided = 0;
+	m_lastFrameStats = m_frameStats;
+
+	Invalidate();
+}
+
+/***********************************************************
+ *  ~GLStateCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GLStateCache::~GLStateCache()
+{
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting every shadowed value.
+ *  The next call for each piece of state is issued whatever
+ *  its value, and the cache knows the state from then on.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+	for (int i = 0; i < CAPABILITY_COUNT; i++)
+	{
+		m_capabilities[i] = UNKNOWN;
+	}
+	m_blendSourceFactor = UNKNOWN;
+	m_blendDestinationFactor = UNKNOWN;
+	m_depthFunction = UNKNOWN;
+	m_depthMask = UNKNOWN;
+	m_bClearColorValid = false;
+	m_programID = UNKNOWN;
+	m_vertexArrayID = UNKNOWN;
+	for (int i = 0; i < BUFFER_TARGET_COUNT; i++)
+	{
+		m_buffers[i] = UNKNOWN;
+	}
+	for (GLuint i = 0; i < MAX_BUFFER_BINDINGS; i++)
+	{
+		m_uniformBindings[i] = UNKNOWN;
+		m_storageBindings[i] = UNKNOWN;
+	}
+	m_activeUnit = UNKNOWN;
+	for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+		{
+			m_textures[unit][target] = UNKNOWN;
+		}
+	}
+}
+
+/***********************************************************
+ *  InvalidateVertexArray()
+ *
+ *  This method is used for forgetting the bound vertex array
+ *  and the vertex and index buffers, which are what a draw
+ *  made outside of the cache binds.
+ ***********************************************************/
+void GLStateCache::InvalidateVertexArray()
+{
+	m_vertexArrayID = UNKNOWN;
+	m_buffers[BUFFER_ARRAY] = UNKNOWN;
+	m_buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+}
+
+/***********************************************************
+ *  CountCall()
+ *
+ *  This method is used for counting a call as issued or as
+ *  elided, passing the decision through.
+ ***********************************************************/
+bool GLStateCache::CountCall(bool bIssue)
+{
+	if (bIssue)
+	{
+		m_frameStats.callsIssued++;
+	}
+	else
+	{
+		m_frameStats.callsElided++;
+	}
+	return(bIssue);
+}
+
+/***********************************************************
+ *  SetCapability()
+ *
+ *  This method is used for enabling or disabling a server
+ *  side capability.
+ ***********************************************************/
+void GLStateCache::SetCapability(GLenum capability, bool bEnabled)
+{
+	const int index = GetCapabilityIndex(capability);
+	const GLuint value = bEnabled ? 1 : 0;
+	if (index >= 0)
+	{
+		if (false == CountCall(m_capabilities[index] != value))
+		{
+			return;
+		}
+		m_capabilities[index] = value;
+	}
+	else
+	{
+		CountCall(true);
+	}
+
+	if (bEnabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+/***********************************************************
+ *  SetBlendFunc()
+ *
+ *  This method is used for setting the source and
+ *  destination blend factors.
+ ***********************************************************/
+void GLStateCache::SetBlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if (CountCall((m_blendSourceFactor != sourceFactor) || (m_blendDestinationFactor != destinationFactor)))
+	{
+		glBlendFunc(sourceFactor, destinationFactor);
+		m_blendSourceFactor = sourceFactor;
+		m_blendDestinationFactor = destinationFactor;
+	}
+}
+
+/***********************************************************
+ *  SetDepthFunc()
+ *
+ *  This method is used for setting the depth comparison.
+ ***********************************************************/
+void GLStateCache::SetDepthFunc(GLenum function)
+{
+	if (CountCall(m_depthFunction != function))
+	{
+		glDepthFunc(function);
+		m_depthFunction = function;
+	}
+}
+
+/***********************************************************
+ *  SetDepthMask()
+ *
+ *  This method is used for setting whether the draws write
+ *  their depth.
+ ***********************************************************/
+void GLStateCache::SetDepthMask(bool bWrite)
+{
+	const GLuint value = bWrite ? 1 : 0;
+	if (CountCall(m_depthMask != value))
+	{
+		glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+		m_depthMask = value;
+	}
+}
+
+/***********************************************************
+ *  SetClearColor()
+ *
+ *  This method is used for setting the color the color
+ *  buffer is cleared to.
+ ***********************************************************/
+void GLStateCache::SetClearColor(float red, float green, float blue, float alpha)
+{
+	const bool bChanged = (false == m_bClearColorValid) ||
+		(m_clearColor[0] != red) || (m_clearColor[1] != green) ||
+		(m_clearColor[2] != blue) || (m_clearColor[3] != alpha);
+	if (CountCall(bChanged))
+	{
+		glClearColor(red, green, blue, alpha);
+		m_clearColor[0] = red;
+		m_clearColor[1] = green;
+		m_clearColor[2] = blue;
+		m_clearColor[3] = alpha;
+		m_bClearColorValid = true;
+	}
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for binding a shader program.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint programID)
+{
+	if (CountCall(m_programID != programID))
+	{
+		glUseProgram(programID);
+		m_programID = programID;
+	}
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array.  The
+ *  index buffer binding belongs to the vertex array, so it
+ *  is not known after another one is bound.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vertexArrayID)
+{
+	if (CountCall(m_vertexArrayID != vertexArrayID))
+	{
+		glBindVertexArray(vertexArrayID);
+		m_vertexArrayID = vertexArrayID;
+		m_buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+	}
+}
+
+/***********************************************************
+ *  BindBuffer()
+ *
+ *  This method is used for binding a buffer to a target.
+ ***********************************************************/
+void GLStateCache::BindBuffer(GLenum target, GLuint bufferID)
+{
+	const int index = GetBufferTargetIndex(target);
+	if (index >= 0)
+	{
+		if (false == CountCall(m_buffers[index] != bufferID))
+		{
+			return;
+		}
+		m_buffers[index] = bufferID;
+	}
+	else
+	{
+		CountCall(true);
+	}
+
+	glBindBuffer(target, bufferID);
+}
+
+/***********************************************************
+ *  BindBufferBase()
+ *
+ *  This method is used for binding a buffer to an indexed
+ *  binding point of the uniform or shader storage target.
+ *  OpenGL binds it to the target as well.
+ ***********************************************************/
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint bufferID)
+{
+	GLuint* pBindings = NULL;
+	if (GL_UNIFORM_BUFFER == target)
+	{
+		pBindings = m_uniformBindings;
+	}
+	else if (GL_SHADER_STORAGE_BUFFER == target)
+	{
+		pBindings = m_storageBindings;
+	}
+
+	if ((NULL != pBindings) && (index < MAX_BUFFER_BINDINGS))
+	{
+		if (false == CountCall(pBindings[index] != bufferID))
+		{
+			return;
+		}
+		pBindings[index] = bufferID;
+	}
+	else
+	{
+		CountCall(true);
+	}
+
+	glBindBufferBase(target, index, bufferID);
+
+	const int targetIndex = GetBufferTargetIndex(target);
+	if (targetIndex >= 0)
+	{
+		m_buffers[targetIndex] = bufferID;
+	}
+}
+
+/***********************************************************
+ *  BindBufferRange()
+ *
+ *  This method is used for binding a range of a buffer to an
+ *  indexed binding point.  The shadow only holds whole
+ *  buffers, so the call is always issued, and the binding
+ *  point is marked unknown for the next whole buffer bind.
+ ***********************************************************/
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint bufferID, GLintptr offset, GLsizeiptr size)
+{
+	CountCall(true);
+	glBindBufferRange(target, index, bufferID, offset, size);
+
+	if (index < MAX_BUFFER_BINDINGS)
+	{
+		if (GL_UNIFORM_BUFFER == target)
+		{
+			m_uniformBindings[index] = UNKNOWN;
+		}
+		else if (GL_SHADER_STORAGE_BUFFER == target)
+		{
+			m_storageBindings[index] = UNKNOWN;
+		}
+	}
+
+	const int targetIndex = GetBufferTargetIndex(target);
+	if (targetIndex >= 0)
+	{
+		m_buffers[targetIndex] = bufferID;
+	}
+}
+
+/***********************************************************
+ *  SetActiveTexture()
+ *
+ *  This method is used for selecting the texture unit that
+ *  the texture binds go to.
+ ***********************************************************/
+void GLStateCache::SetActiveTexture(GLuint unit)
+{
+	if (CountCall(m_activeUnit != unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_activeUnit = unit;
+	}
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture to the active
+ *  texture unit.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLenum target, GLuint textureID)
+{
+	const int index = GetTextureTargetIndex(target);
+	if ((index >= 0) && (m_activeUnit < MAX_TEXTURE_UNITS))
+	{
+		if (false == CountCall(m_textures[m_activeUnit][index] != textureID))
+		{
+			return;
+		}
+		m_textures[m_activeUnit][index] = textureID;
+	}
+	else
+	{
+		CountCall(true);
+	}
+
+	glBindTexture(target, textureID);
+}
+
+/***********************************************************
+ *  BindTextureUnit()
+ *
+ *  This method is used for binding a texture to a texture
+ *  unit.  When it is already bound there, neither the unit
+ *  selection nor the bind is issued.
+ ***********************************************************/
+void GLStateCache::BindTextureUnit(GLuint unit, GLenum target, GLuint textureID)
+{
+	const int index = GetTextureTargetIndex(target);
+	if ((index >= 0) && (unit < MAX_TEXTURE_UNITS) && (m_textures[unit][index] == textureID))
+	{
+		CountCall(false);
+		CountCall(false);
+		return;
+	}
+
+	SetActiveTexture(unit);
+	BindTexture(target, textureID);
+}
+
+/***********************************************************
+ *  DeleteBuffers()
+ *
+ *  This method is used for deleting buffers.  OpenGL falls
+ *  back to buffer zero wherever a deleted buffer was bound,
+ *  and so does the shadow copy.
+ ***********************************************************/
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* pBufferIDs)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (0 == pBufferIDs[i])
+		{
+			continue;
+		}
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			if (m_buffers[target] == pBufferIDs[i])
+			{
+				m_buffers[target] = 0;
+			}
+		}
+		for (GLuint binding = 0; binding < MAX_BUFFER_BINDINGS; binding++)
+		{
+			if (m_uniformBindings[binding] == pBufferIDs[i])
+			{
+				m_uniformBindings[binding] = 0;
+			}
+			if (m_storageBindings[binding] == pBufferIDs[i])
+			{
+				m_storageBindings[binding] = 0;
+			}
+		}
+	}
+
+	glDeleteBuffers(count, pBufferIDs);
+}
+
+/***********************************************************
+ *  DeleteTextures()
+ *
+ *  This method is used for deleting textures, which are
+ *  unbound from every unit they were bound to.
+ ***********************************************************/
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* pTextureIDs)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (0 == pTextureIDs[i])
+		{
+			continue;
+		}
+		for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				if (m_textures[unit][target] == pTextureIDs[i])
+				{
+					m_textures[unit][target] = 0;
+				}
+			}
+		}
+	}
+
+	glDeleteTextures(count, pTextureIDs);
+}
+
+/***********************************************************
+ *  DeleteVertexArrays()
+ *
+ *  This method is used for deleting vertex arrays.  Deleting
+ *  the bound one binds vertex array zero.
+ ***********************************************************/
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* pVertexArrayIDs)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if ((0 != pVertexArrayIDs[i]) && (m_vertexArrayID == pVertexArrayIDs[i]))
+		{
+			m_vertexArrayID = 0;
+			m_buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN;
+		}
+	}
+
+	glDeleteVertexArrays(count, pVertexArrayIDs);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the call counts of a
+ *  new frame, keeping the counts of the previous one.
+ ***********************************************************/
+void GLStateCache::BeginFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats.callsIssued = 0;
+	m_frameStats.callsElided = 0;
+}
+
+/***********************************************************
+ *  GetCapabilityIndex()
+ *
+ *  This method is used for getting the slot of a tracked
+ *  capability.
+ ***********************************************************/
+int GLStateCache::GetCapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_BLEND:
+		return(CAPABILITY_BLEND);
+	case GL_DEPTH_TEST:
+		return(CAPABILITY_DEPTH_TEST);
+	case GL_CULL_FACE:
+		return(CAPABILITY_CULL_FACE);
+	case GL_SCISSOR_TEST:
+		return(CAPABILITY_SCISSOR_TEST);
+	case GL_STENCIL_TEST:
+		return(CAPABILITY_STENCIL_TEST);
+	case GL_POLYGON_OFFSET_FILL:
+		return(CAPABILITY_POLYGON_OFFSET_FILL);
+	case GL_MULTISAMPLE:
+		return(CAPABILITY_MULTISAMPLE);
+	case GL_FRAMEBUFFER_SRGB:
+		return(CAPABILITY_FRAMEBUFFER_SRGB);
+	default:
+		return(-1);
+	}
+}
+
+/***********************************************************
+ *  GetBufferTargetIndex()
+ *
+ *  This method is used for getting the slot of a tracked
+ *  buffer target.
+ ***********************************************************/
+int GLStateCache::GetBufferTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return(BUFFER_ARRAY);
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return(BUFFER_ELEMENT_ARRAY);
+	case GL_UNIFORM_BUFFER:
+		return(BUFFER_UNIFORM);
+	case GL_SHADER_STORAGE_BUFFER:
+		return(BUFFER_SHADER_STORAGE);
+	case GL_DRAW_INDIRECT_BUFFER:
+		return(BUFFER_DRAW_INDIRECT);
+	case GL_PIXEL_UNPACK_BUFFER:
+		return(BUFFER_PIXEL_UNPACK);
+	case GL_PIXEL_PACK_BUFFER:
+		return(BUFFER_PIXEL_PACK);
+	case GL_COPY_READ_BUFFER:
+		return(BUFFER_COPY_READ);
+	case GL_COPY_WRITE_BUFFER:
+		return(BUFFER_COPY_WRITE);
+	default:
+		return(-1);
+	}
+}
+
+/***********************************************************
+ *  GetTextureTargetIndex()
+ *
+ *  This method is used for getting the slot of a tracked
+ *  texture target.
+ ***********************************************************/
+int GLStateCache::GetTextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return(TEXTURE_2D);
+	case GL_TEXTURE_2D_ARRAY:
+		return(TEXTURE_2D_ARRAY);
+	case GL_TEXTURE_CUBE_MAP:
+		return(TEXTURE_CUBE_MAP);
+	case GL_TEXTURE_3D:
+		return(TEXTURE_3D);
+	default:
+		return(-1);
+	}
+}
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// track the OpenGL state and skip the calls that would not change it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class sits between the application and OpenGL for
+ *  the state that is set over and over - the capabilities,
+ *  the blend and depth state, the clear color, the bound
+ *  program, vertex array, buffers and textures.  It keeps a
+ *  shadow copy of each value, and a call that would set a
+ *  value that is already set never reaches the driver.  The
+ *  issued and skipped calls are counted per frame.
+ *
+ *  The shadow copy is only right while every change goes
+ *  through the cache.  Code that sets state directly, such
+ *  as the ShapeMeshes draws, has to be followed by one of
+ *  the Invalidate methods, and objects have to be deleted
+ *  through the cache so their bindings are forgotten.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// constructor
+	GLStateCache();
+	// destructor
+	~GLStateCache();
+
+	struct STATE_STATS
+	{
+		unsigned int callsIssued;
+		unsigned int callsElided;
+	};
+
+	// forget every shadowed value, so the next calls are issued
+	void Invalidate();
+	// forget the bound vertex array and vertex buffers, after
+	// code outside the cache has drawn
+	void InvalidateVertexArray();
+
+	// switch a capability such as GL_BLEND on or off
+	void SetCapability(GLenum capability, bool bEnabled);
+	void Enable(GLenum capability) { SetCapability(capability, true); }
+	void Disable(GLenum capability) { SetCapability(capability, false); }
+	// set the blend factors of the color and alpha together
+	void SetBlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	// set the depth comparison and whether depth is written
+	void SetDepthFunc(GLenum function);
+	void SetDepthMask(bool bWrite);
+	// set the color the color buffer is cleared to
+	void SetClearColor(float red, float green, float blue, float alpha);
+
+	// bind a shader program, vertex array or buffer
+	void UseProgram(GLuint programID);
+	void BindVertexArray(GLuint vertexArrayID);
+	void BindBuffer(GLenum target, GLuint bufferID);
+	// bind a buffer to an indexed binding point, which also
+	// binds it to the target
+	void BindBufferBase(GLenum target, GLuint index, GLuint bufferID);
+	// bind a range of a buffer to an indexed binding point -
+	// ranges are always issued, since they move every frame
+	void BindBufferRange(GLenum target, GLuint index, GLuint bufferID, GLintptr offset, GLsizeiptr size);
+
+	// select the texture unit the texture binds go to
+	void SetActiveTexture(GLuint unit);
+	// bind a texture to the active unit
+	void BindTexture(GLenum target, GLuint textureID);
+	// bind a texture to a unit, selecting it only when the
+	// texture is not already bound there
+	void BindTextureUnit(GLuint unit, GLenum target, GLuint textureID);
+
+	// delete objects, forgetting the bindings they had
+	void DeleteBuffers(GLsizei count, const GLuint* pBufferIDs);
+	void DeleteTextures(GLsizei count, const GLuint* pTextureIDs);
+	void DeleteVertexArrays(GLsizei count, const GLuint* pVertexArrayIDs);
+
+	// start counting the calls for a new frame
+	void BeginFrame();
+	// get the call counts of the frame so far
+	STATE_STATS GetFrameStats() const { return(m_frameStats); }
+	// get the call counts of the last completed frame
+	STATE_STATS GetLastFrameStats() const { return(m_lastFrameStats); }
+
+private:
+	// shadow value of state that has not been set through
+	// the cache yet
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	enum CAPABILITY
+	{
+		CAPABILITY_BLEND = 0,
+		CAPABILITY_DEPTH_TEST,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_SCISSOR_TEST,
+		CAPABILITY_STENCIL_TEST,
+		CAPABILITY_POLYGON_OFFSET_FILL,
+		CAPABILITY_MULTISAMPLE,
+		CAPABILITY_FRAMEBUFFER_SRGB,
+		CAPABILITY_COUNT
+	};
+
+	enum BUFFER_TARGET
+	{
+		BUFFER_ARRAY = 0,
+		BUFFER_ELEMENT_ARRAY,
+		BUFFER_UNIFORM,
+		BUFFER_SHADER_STORAGE,
+		BUFFER_DRAW_INDIRECT,
+		BUFFER_PIXEL_UNPACK,
+		BUFFER_PIXEL_PACK,
+		BUFFER_COPY_READ,
+		BUFFER_COPY_WRITE,
+		BUFFER_TARGET_COUNT
+	};
+
+	enum TEXTURE_TARGET
+	{
+		TEXTURE_2D = 0,
+		TEXTURE_2D_ARRAY,
+		TEXTURE_CUBE_MAP,
+		TEXTURE_3D,
+		TEXTURE_TARGET_COUNT
+	};
+
+	// units and indexed binding points that are tracked -
+	// the calls for the ones above are always issued
+	static const GLuint MAX_TEXTURE_UNITS = 32;
+	static const GLuint MAX_BUFFER_BINDINGS = 16;
+
+	GLuint m_capabilities[CAPABILITY_COUNT];
+	GLenum m_blendSourceFactor;
+	GLenum m_blendDestinationFactor;
+	GLenum m_depthFunction;
+	GLuint m_depthMask;
+	float m_clearColor[4];
+	bool m_bClearColorValid;
+	GLuint m_programID;
+	GLuint m_vertexArrayID;
+	GLuint m_buffers[BUFFER_TARGET_COUNT];
+	// indexed uniform and shader storage binding points
+	GLuint m_uniformBindings[MAX_BUFFER_BINDINGS];
+	GLuint m_storageBindings[MAX_BUFFER_BINDINGS];
+	GLuint m_activeUnit;
+	GLuint m_textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+
+	// call counts of the current and last frame
+	STATE_STATS m_frameStats;
+	STATE_STATS m_lastFrameStats;
+
+	// count a call as issued or elided and return whether it
+	// has to be issued
+	bool CountCall(bool bIssue);
+
+	// map the GL enums onto the tracked slots, -1 when the
+	// enum is not tracked
+	static int GetCapabilityIndex(GLenum capability);
+	static int GetBufferTargetIndex(GLenum target);
+	static int GetTextureTargetIndex(GLenum target);
+};
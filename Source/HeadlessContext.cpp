@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlesscontext.cpp
+// ============
+// render without a window into an offscreen framebuffer
+//
+// NOTE: on Windows there is no headless context, so --headless always
+// fails in the Visual Studio build.  CMakeLists.txt is the Linux build,
+// which links libEGL, or OSMesa with -DHEADLESS_OSMESA=ON.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HeadlessContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(HEADLESS_OSMESA)
+#define HEADLESSCONTEXT_OSMESA
+#include <GL/osmesa.h>
+#elif defined(__linux__)
+#define HEADLESSCONTEXT_EGL
+// keep the X11 headers, and their macros, out of the build
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// OpenGL versions tried for the context, newest first
+	const int g_ContextVersions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 3 }, { 3, 3 } };
+	const int g_ContextVersionCount = sizeof(g_ContextVersions) / sizeof(g_ContextVersions[0]);
+}
+
+/***********************************************************
+ *  HeadlessContext()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HeadlessContext::HeadlessContext()
+{
+	m_display = NULL;
+	m_context = NULL;
+	m_framebufferID = 0;
+	m_colorBufferID = 0;
+	m_depthBufferID = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~HeadlessContext()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HeadlessContext::~HeadlessContext()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  CreateContext()
+ *
+ *  This method is used for creating a core profile context
+ *  of the newest OpenGL version the driver offers, without
+ *  any window or drawing surface, and making it current.
+ ***********************************************************/
+bool HeadlessContext::CreateContext()
+{
+	Destroy();
+
+#if defined(HEADLESSCONTEXT_EGL)
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	// the surfaceless platform needs no X11 or Wayland server
+	// and no GPU device, so it works on bare build machines
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (NULL != getPlatformDisplay)
+	{
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (EGL_NO_DISPLAY == display)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major = 0;
+	EGLint minor = 0;
+	if ((EGL_NO_DISPLAY == display) || (EGL_FALSE == eglInitialize(display, &major, &minor)))
+	{
+		std::cout << "Failed to initialize EGL" << std::endl;
+		return false;
+	}
+	m_display = display;
+
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if ((NULL == extensions) || (NULL == strstr(extensions, "EGL_KHR_surfaceless_context")))
+	{
+		std::cout << "EGL cannot make a context current without a surface" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	// the config is only used for the context, but the default
+	// surface type is window, which the surfaceless platform
+	// has no configs for
+	const EGLint configAttributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	if ((EGL_FALSE == eglChooseConfig(display, configAttributes, &config, 1, &configCount)) ||
+		(configCount < 1) ||
+		(EGL_FALSE == eglBindAPI(EGL_OPENGL_API)))
+	{
+		std::cout << "EGL has no desktop OpenGL config" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	EGLContext context = EGL_NO_CONTEXT;
+	for (int i = 0; (i < g_ContextVersionCount) && (EGL_NO_CONTEXT == context); i++)
+	{
+		const EGLint contextAttributes[] =
+		{
+			EGL_CONTEXT_MAJOR_VERSION, g_ContextVersions[i][0],
+			EGL_CONTEXT_MINOR_VERSION, g_ContextVersions[i][1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	}
+	if (EGL_NO_CONTEXT == context)
+	{
+		std::cout << "Failed to create an EGL context" << std::endl;
+		Destroy();
+		return false;
+	}
+	m_context = context;
+
+	if (EGL_FALSE == eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cout << "Failed to make the EGL context current" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	return true;
+#elif defined(HEADLESSCONTEXT_OSMESA)
+	OSMesaContext context = NULL;
+	for (int i = 0; (i < g_ContextVersionCount) && (NULL == context); i++)
+	{
+		const int contextAttributes[] =
+		{
+			OSMESA_FORMAT, OSMESA_RGBA,
+			OSMESA_DEPTH_BITS, 0,
+			OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+			OSMESA_CONTEXT_MAJOR_VERSION, g_ContextVersions[i][0],
+			OSMESA_CONTEXT_MINOR_VERSION, g_ContextVersions[i][1],
+			0
+		};
+		context = OSMesaCreateContextAttribs(contextAttributes, NULL);
+	}
+	if (NULL == context)
+	{
+		std::cout << "Failed to create an OSMesa context" << std::endl;
+		return false;
+	}
+	m_context = context;
+
+	// OSMesa needs a buffer to make the context current with,
+	// but the scene is drawn into the framebuffer object, so
+	// a single pixel is enough
+	m_contextBuffer.assign(4, 0);
+	if (GL_FALSE == OSMesaMakeCurrent(context, m_contextBuffer.data(), GL_UNSIGNED_BYTE, 1, 1))
+	{
+		std::cout << "Failed to make the OSMesa context current" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	return true;
+#else
+	std::cout << "Headless rendering needs EGL or OSMesa, which this build does not have" << std::endl;
+	return false;
+#endif
+}
+
+/***********************************************************
+ *  CreateFramebuffer()
+ *
+ *  This method is used for creating the framebuffer object
+ *  the scene is drawn into, with an RGBA color buffer and a
+ *  depth buffer of the passed in size, and binding it in
+ *  place of the default framebuffer.
+ ***********************************************************/
+bool HeadlessContext::CreateFramebuffer(int width, int height)
+{
+	if ((NULL == m_context) || (width <= 0) || (height <= 0))
+	{
+		return false;
+	}
+
+	glGenRenderbuffers(1, &m_colorBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBufferID);
+
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		std::cout << "The offscreen framebuffer is not complete" << std::endl;
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	glViewport(0, 0, m_width, m_height);
+
+	return true;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the framebuffer and then
+ *  releasing and destroying the context.
+ ***********************************************************/
+void HeadlessContext::Destroy()
+{
+	if (0 != m_framebufferID)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (0 != m_colorBufferID)
+	{
+		glDeleteRenderbuffers(1, &m_colorBufferID);
+		m_colorBufferID = 0;
+	}
+	if (0 != m_depthBufferID)
+	{
+		glDeleteRenderbuffers(1, &m_depthBufferID);
+		m_depthBufferID = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+
+#if defined(HEADLESSCONTEXT_EGL)
+	if (NULL != m_display)
+	{
+		eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (NULL != m_context)
+		{
+			eglDestroyContext((EGLDisplay)m_display, (EGLContext)m_context);
+		}
+		eglTerminate((EGLDisplay)m_display);
+	}
+#elif defined(HEADLESSCONTEXT_OSMESA)
+	if (NULL != m_context)
+	{
+		OSMesaDestroyContext((OSMesaContext)m_context);
+	}
+#endif
+	m_display = NULL;
+	m_context = NULL;
+	m_contextBuffer.clear();
+}
+
+/***********************************************************
+ *  ReadPixels()
+ *
+ *  This method is used for reading back the color buffer
+ *  once every draw sent to it has finished.  OpenGL returns
+ *  the bottom row first, so the rows are flipped into the
+ *  usual image order.
+ ***********************************************************/
+bool HeadlessContext::ReadPixels(std::vector<unsigned char>& pixels)
+{
+	if (0 == m_framebufferID)
+	{
+		return false;
+	}
+
+	const size_t rowSize = (size_t)m_width * 3;
+	std::vector<unsigned char> bottomUp(rowSize * m_height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, bottomUp.data());
+
+	pixels.resize(bottomUp.size());
+	for (int row = 0; row < m_height; row++)
+	{
+		memcpy(&pixels[row * rowSize], &bottomUp[(m_height - 1 - row) * rowSize], rowSize);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  WriteImage()
+ *
+ *  This method is used for writing the color buffer to a
+ *  binary PPM file, which any image viewer or diff tool can
+ *  read without the program needing an image encoder.
+ ***********************************************************/
+bool HeadlessContext::WriteImage(const char* filename)
+{
+	std::vector<unsigned char> pixels;
+	if (false == ReadPixels(pixels))
+	{
+		return false;
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (NULL == file)
+	{
+		std::cout << "Could not write the image:" << filename << std::endl;
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+	const bool bWritten = (pixels.size() == fwrite(pixels.data(), 1, pixels.size(), file));
+	fclose(file);
+
+	return bWritten;
+}
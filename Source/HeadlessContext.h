@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlesscontext.h
+// ============
+// render without a window into an offscreen framebuffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  HeadlessContext
+ *
+ *  This class creates an OpenGL context that needs no window
+ *  and no display server, and a framebuffer object of a
+ *  chosen size for the scene to be drawn into, so the same
+ *  rendering code can run in batch jobs and on machines with
+ *  only Mesa's software rasterizer.
+ *
+ *  On Linux the context comes from EGL on the surfaceless
+ *  Mesa platform, falling back to the default EGL display.
+ *  Building with HEADLESS_OSMESA defined uses OSMesa instead.
+ *  Other platforms have no headless context, and
+ *  CreateContext() fails - so --headless always fails in the
+ *  Visual Studio build and needs the CMake build on Linux.
+ *
+ *  The context has to be created and current before GLEW is
+ *  initialized, and the framebuffer can only be created
+ *  after that, so the two are separate steps.
+ ***********************************************************/
+class HeadlessContext
+{
+public:
+	// constructor
+	HeadlessContext();
+	// destructor
+	~HeadlessContext();
+
+	// create the context and make it current
+	bool CreateContext();
+	// create and bind the offscreen framebuffer - GLEW must be
+	// initialized first
+	bool CreateFramebuffer(int width, int height);
+	// free the framebuffer and the context
+	void Destroy();
+
+	// read the pixels of the framebuffer, as rows of RGB bytes
+	// from the top of the image down
+	bool ReadPixels(std::vector<unsigned char>& pixels);
+	// write the framebuffer to a binary PPM image file
+	bool WriteImage(const char* filename);
+
+	// get the size of the framebuffer
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+
+private:
+	// EGL display and context, or the OSMesa context and the
+	// buffer it has to be made current with
+	void* m_display;
+	void* m_context;
+	std::vector<unsigned char> m_contextBuffer;
+	// offscreen framebuffer and its color and depth storage
+	GLuint m_framebufferID;
+	GLuint m_colorBufferID;
+	GLuint m_depthBufferID;
+	int m_width;
+	int m_height;
+};
@@ -0,0 +1,496 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.cpp
+// ============
+// draw many copies of the basic shapes from one merged geometry buffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InstancedMeshes.h"
+#include "Profiler.h"
+
+#include <cstddef>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// number of instances the instance buffer starts out with
+	const size_t g_InitialInstanceCapacity = 1024;
+	// number of draw commands the command buffer starts out with
+	const size_t g_InitialCommandCapacity = 256;
+
+	// attribute locations of the per-instance values
+	const GLuint g_InstanceModelLocation = 3;		// 3 to 6, one per column
+	const GLuint g_InstanceColorLocation = 7;
+	const GLuint g_InstanceUVscaleLocation = 8;
+	const GLuint g_InstanceIndicesLocation = 9;	// texture layer and material
+
+	/***********************************************************
+	 *  UploadStreamBuffer()
+	 *
+	 *  This function is used for sending the data of a frame to
+	 *  a buffer with one upload.  The old storage is orphaned
+	 *  first, so the driver never has to wait for draws of the
+	 *  previous frame that still read it, and it doubles in size
+	 *  whenever the frame has more elements than it can hold.
+	 ***********************************************************/
+	void UploadStreamBuffer(
+		GLStateCache* pStateCache,
+		GLenum target,
+		GLuint bufferID,
+		size_t& capacity,
+		size_t elementSize,
+		size_t elementCount,
+		const void* pData)
+	{
+		while (capacity < elementCount)
+		{
+			capacity *= 2;
+		}
+
+		pStateCache->BindBuffer(target, bufferID);
+		glBufferData(target, capacity * elementSize, NULL, GL_STREAM_DRAW);
+		glBufferSubData(target, 0, elementCount * elementSize, pData);
+	}
+}
+
+/***********************************************************
+ *  InstancedMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InstancedMeshes::InstancedMeshes(GLStateCache* pStateCache, StreamRing* pStreamRing)
+{
+	memset(m_meshRanges, 0, sizeof(m_meshRanges));
+	m_pStateCache = pStateCache;
+	m_pStreamRing = pStreamRing;
+	m_vao = 0;
+	m_vertexBufferID = 0;
+	m_indexBufferID = 0;
+	m_instanceBufferID = 0;
+	m_instanceCapacity = 0;
+	m_commandBufferID = 0;
+	m_commandCapacity = 0;
+	m_instanceSourceID = 0;
+	m_instanceSourceOffset = 0;
+	m_commandSourceID = 0;
+	m_commandSourceOffset = 0;
+	m_bBaseInstance = false;
+	m_bMultiDrawIndirect = false;
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+	memset(&m_lastFrameStats, 0, sizeof(m_lastFrameStats));
+}
+
+/***********************************************************
+ *  ~InstancedMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+InstancedMeshes::~InstancedMeshes()
+{
+	DestroyMeshes();
+}
+
+/***********************************************************
+ *  CreateMeshes()
+ *
+ *  This method is used for building every basic shape and
+ *  packing them all into one vertex buffer and one index
+ *  buffer.  The indices of each shape stay relative to its
+ *  first vertex, which the draws pass as the base vertex.
+ *  The single vertex array also reads the per-instance
+ *  attributes from the shared instance buffer.
+ ***********************************************************/
+bool InstancedMeshes::CreateMeshes()
+{
+	DestroyMeshes();
+
+	// with base instance support every range can be drawn
+	// without pointing the attributes at it first, and the
+	// indirect commands need it to find their instances
+	m_bBaseInstance = (GLEW_VERSION_4_2 || GLEW_ARB_base_instance) ? true : false;
+	m_bMultiDrawIndirect = m_bBaseInstance &&
+		(GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect);
+
+	// gather all the shapes, at every level of the round ones,
+	// into one vertex and index array
+	std::vector<ShapeGeometry::SHAPE_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	ShapeGeometry::SHAPE_DATA shapeData;
+	for (int meshID = 0; meshID < SceneFile::MESH_COUNT; meshID++)
+	{
+		const int levelCount = LodSelector::HasLevels(meshID) ? LodSelector::LEVEL_COUNT : 1;
+		for (int level = 0; level < levelCount; level++)
+		{
+			if (false == ShapeGeometry::BuildMesh(meshID, shapeData, LodSelector::GetLevelSlices(level)))
+			{
+				continue;
+			}
+
+			MESH_RANGE& range = m_meshRanges[meshID][level];
+			range.firstIndex = (GLuint)indices.size();
+			range.indexCount = (GLuint)shapeData.indices.size();
+			range.baseVertex = (GLint)vertices.size();
+
+			vertices.insert(vertices.end(), shapeData.vertices.begin(), shapeData.vertices.end());
+			indices.insert(indices.end(), shapeData.indices.begin(), shapeData.indices.end());
+		}
+
+		// the shapes without levels draw their one range at any level
+		for (int level = levelCount; level < LodSelector::LEVEL_COUNT; level++)
+		{
+			m_meshRanges[meshID][level] = m_meshRanges[meshID][0];
+		}
+	}
+
+	if (indices.empty())
+	{
+		return false;
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	m_pStateCache->BindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBufferID);
+	m_pStateCache->BindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+	glBufferData(
+		GL_ARRAY_BUFFER,
+		vertices.size() * sizeof(ShapeGeometry::SHAPE_VERTEX),
+		vertices.data(),
+		GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_indexBufferID);
+	m_pStateCache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferID);
+	glBufferData(
+		GL_ELEMENT_ARRAY_BUFFER,
+		indices.size() * sizeof(uint32_t),
+		indices.data(),
+		GL_STATIC_DRAW);
+
+	// per-vertex attributes
+	const GLsizei stride = sizeof(ShapeGeometry::SHAPE_VERTEX);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ShapeGeometry::SHAPE_VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ShapeGeometry::SHAPE_VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ShapeGeometry::SHAPE_VERTEX, textureCoordinate));
+
+	// per-instance attributes
+	m_instanceCapacity = g_InitialInstanceCapacity;
+	glGenBuffers(1, &m_instanceBufferID);
+	m_instanceSourceID = m_instanceBufferID;
+	m_instanceSourceOffset = 0;
+	m_pStateCache->BindBuffer(GL_ARRAY_BUFFER, m_instanceBufferID);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(INSTANCE_DATA), NULL, GL_STREAM_DRAW);
+
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(g_InstanceModelLocation + column);
+		glVertexAttribDivisor(g_InstanceModelLocation + column, 1);
+	}
+	glEnableVertexAttribArray(g_InstanceColorLocation);
+	glVertexAttribDivisor(g_InstanceColorLocation, 1);
+	glEnableVertexAttribArray(g_InstanceUVscaleLocation);
+	glVertexAttribDivisor(g_InstanceUVscaleLocation, 1);
+	glEnableVertexAttribArray(g_InstanceIndicesLocation);
+	glVertexAttribDivisor(g_InstanceIndicesLocation, 1);
+	SetInstanceAttributes(0);
+
+	// unbind the vertex array, so no other index buffer bind
+	// lands in it
+	m_pStateCache->BindVertexArray(0);
+
+	if (m_bMultiDrawIndirect)
+	{
+		m_commandCapacity = g_InitialCommandCapacity;
+		glGenBuffers(1, &m_commandBufferID);
+		m_commandSourceID = m_commandBufferID;
+		m_commandSourceOffset = 0;
+		m_pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBufferID);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commandCapacity * sizeof(DRAW_COMMAND), NULL, GL_STREAM_DRAW);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyMeshes()
+ *
+ *  This method is used for freeing the merged shape buffers
+ *  and the instance and command buffers.
+ ***********************************************************/
+void InstancedMeshes::DestroyMeshes()
+{
+	if (0 != m_vao)
+	{
+		m_pStateCache->DeleteVertexArrays(1, &m_vao);
+		m_pStateCache->DeleteBuffers(1, &m_vertexBufferID);
+		m_pStateCache->DeleteBuffers(1, &m_indexBufferID);
+		m_vao = 0;
+		m_vertexBufferID = 0;
+		m_indexBufferID = 0;
+	}
+	memset(m_meshRanges, 0, sizeof(m_meshRanges));
+
+	if (0 != m_instanceBufferID)
+	{
+		m_pStateCache->DeleteBuffers(1, &m_instanceBufferID);
+		m_instanceBufferID = 0;
+	}
+	m_instanceCapacity = 0;
+
+	if (0 != m_commandBufferID)
+	{
+		m_pStateCache->DeleteBuffers(1, &m_commandBufferID);
+		m_commandBufferID = 0;
+	}
+	m_commandCapacity = 0;
+
+	m_instanceSourceID = 0;
+	m_instanceSourceOffset = 0;
+	m_commandSourceID = 0;
+	m_commandSourceOffset = 0;
+}
+
+/***********************************************************
+ *  ClearInstances()
+ *
+ *  This method is used for starting the instances and draws
+ *  of a new frame, keeping the memory of the previous one.
+ *  The ring region of the previous frame is no longer
+ *  drawn from.
+ ***********************************************************/
+void InstancedMeshes::ClearInstances()
+{
+	m_instances.clear();
+	m_commands.clear();
+
+	m_instanceSourceID = m_instanceBufferID;
+	m_instanceSourceOffset = 0;
+	m_commandSourceID = m_commandBufferID;
+	m_commandSourceOffset = 0;
+
+	m_lastFrameStats = m_frameStats;
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method is used for adding an instance to the frame.
+ ***********************************************************/
+int InstancedMeshes::AddInstance(const INSTANCE_DATA& instance)
+{
+	m_instances.push_back(instance);
+	m_frameStats.instanceCount++;
+
+	return((int)m_instances.size() - 1);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is used for adding a draw of a range of the
+ *  frame's instances with the passed in shape and level.
+ *  The command gets an index even for a shape that was not
+ *  built, so the draw indices of the caller stay in step -
+ *  such a command simply draws no indices.
+ ***********************************************************/
+int InstancedMeshes::AddDraw(int meshID, int level, int firstInstance, int instanceCount)
+{
+	DRAW_COMMAND command;
+	memset(&command, 0, sizeof(command));
+
+	if ((meshID >= 0) && (meshID < SceneFile::MESH_COUNT) &&
+		(level >= 0) && (level < LodSelector::LEVEL_COUNT) && (instanceCount > 0))
+	{
+		const MESH_RANGE& range = m_meshRanges[meshID][level];
+		command.count = range.indexCount;
+		command.instanceCount = (GLuint)instanceCount;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = (GLuint)firstInstance;
+	}
+
+	m_commands.push_back(command);
+	m_frameStats.drawCommands++;
+	m_frameStats.indexCount += command.count * command.instanceCount;
+
+	return((int)m_commands.size() - 1);
+}
+
+/***********************************************************
+ *  UploadInstances()
+ *
+ *  This method is used for sending all the instances of the
+ *  frame, and with multi-draw-indirect all its draw commands,
+ *  to the GPU.  Each is copied into the mapped stream ring
+ *  when it fits there, and sent with one upload into its
+ *  own buffer otherwise.
+ ***********************************************************/
+void InstancedMeshes::UploadInstances()
+{
+	PROFILE_ZONE("InstancedMeshes::UploadInstances");
+
+	if ((0 == m_instanceBufferID) || m_instances.empty())
+	{
+		return;
+	}
+
+	const size_t instanceBytes = m_instances.size() * sizeof(INSTANCE_DATA);
+	void* pInstances = m_pStreamRing->Allocate(instanceBytes, m_instanceSourceOffset);
+	if (NULL != pInstances)
+	{
+		memcpy(pInstances, m_instances.data(), instanceBytes);
+		m_instanceSourceID = m_pStreamRing->GetBufferID();
+	}
+	else
+	{
+		UploadStreamBuffer(
+			m_pStateCache,
+			GL_ARRAY_BUFFER,
+			m_instanceBufferID,
+			m_instanceCapacity,
+			sizeof(INSTANCE_DATA),
+			m_instances.size(),
+			m_instances.data());
+		m_instanceSourceID = m_instanceBufferID;
+		m_instanceSourceOffset = 0;
+	}
+
+	if ((0 != m_commandBufferID) && !m_commands.empty())
+	{
+		const size_t commandBytes = m_commands.size() * sizeof(DRAW_COMMAND);
+		void* pCommands = m_pStreamRing->Allocate(commandBytes, m_commandSourceOffset);
+		if (NULL != pCommands)
+		{
+			memcpy(pCommands, m_commands.data(), commandBytes);
+			m_commandSourceID = m_pStreamRing->GetBufferID();
+		}
+		else
+		{
+			UploadStreamBuffer(
+				m_pStateCache,
+				GL_DRAW_INDIRECT_BUFFER,
+				m_commandBufferID,
+				m_commandCapacity,
+				sizeof(DRAW_COMMAND),
+				m_commands.size(),
+				m_commands.data());
+			m_commandSourceID = m_commandBufferID;
+			m_commandSourceOffset = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  BeginDraws()
+ *
+ *  This method is used for binding the vertex array of the
+ *  merged shapes, and the commands of the frame, once for
+ *  all the draws of the frame.  They are left bound
+ *  afterwards, so the state cache skips the binds when
+ *  nothing else was bound in between.  The instances of
+ *  each frame can sit somewhere else in the stream ring, so
+ *  the instance attributes are pointed at them again.
+ ***********************************************************/
+void InstancedMeshes::BeginDraws()
+{
+	m_pStateCache->BindVertexArray(m_vao);
+	if ((0 != m_vao) && m_bBaseInstance)
+	{
+		SetInstanceAttributes(0);
+	}
+	if (0 != m_commandBufferID)
+	{
+		m_pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandSourceID);
+	}
+}
+
+/***********************************************************
+ *  DrawCommands()
+ *
+ *  This method is used for drawing a range of the uploaded
+ *  draw commands.  With multi-draw-indirect the whole range
+ *  is one call that reads the commands from the GPU copy,
+ *  otherwise each command becomes its own instanced draw.
+ ***********************************************************/
+void InstancedMeshes::DrawCommands(int firstDraw, int drawCount)
+{
+	if ((0 == m_vao) || (firstDraw < 0) || (drawCount <= 0) ||
+		((size_t)(firstDraw + drawCount) > m_commands.size()))
+	{
+		return;
+	}
+
+	if (m_bMultiDrawIndirect)
+	{
+		glMultiDrawElementsIndirect(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			(void*)(m_commandSourceOffset + firstDraw * sizeof(DRAW_COMMAND)),
+			drawCount,
+			sizeof(DRAW_COMMAND));
+		m_frameStats.drawCalls++;
+		return;
+	}
+
+	for (int draw = firstDraw; draw < firstDraw + drawCount; draw++)
+	{
+		const DRAW_COMMAND& command = m_commands[draw];
+		if ((0 == command.count) || (0 == command.instanceCount))
+		{
+			continue;
+		}
+
+		const void* pFirstIndex = (void*)(command.firstIndex * sizeof(uint32_t));
+		if (m_bBaseInstance)
+		{
+			glDrawElementsInstancedBaseVertexBaseInstance(
+				GL_TRIANGLES,
+				command.count,
+				GL_UNSIGNED_INT,
+				pFirstIndex,
+				command.instanceCount,
+				command.baseVertex,
+				command.baseInstance);
+		}
+		else
+		{
+			SetInstanceAttributes(command.baseInstance);
+			glDrawElementsInstancedBaseVertex(
+				GL_TRIANGLES,
+				command.count,
+				GL_UNSIGNED_INT,
+				pFirstIndex,
+				command.instanceCount,
+				command.baseVertex);
+		}
+		m_frameStats.drawCalls++;
+	}
+}
+
+/***********************************************************
+ *  SetInstanceAttributes()
+ *
+ *  This method is used for pointing the per-instance
+ *  attributes of the vertex array at the passed in instance
+ *  of the frame's instances.  The vertex array must be bound.
+ ***********************************************************/
+void InstancedMeshes::SetInstanceAttributes(size_t firstInstance)
+{
+	const GLsizei stride = sizeof(INSTANCE_DATA);
+	const size_t base = m_instanceSourceOffset + firstInstance * sizeof(INSTANCE_DATA);
+
+	m_pStateCache->BindBuffer(GL_ARRAY_BUFFER, m_instanceSourceID);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(
+			g_InstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, stride,
+			(void*)(base + offsetof(INSTANCE_DATA, model) + column * sizeof(glm::vec4)));
+	}
+	glVertexAttribPointer(g_InstanceColorLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(INSTANCE_DATA, color)));
+	glVertexAttribPointer(g_InstanceUVscaleLocation, 2, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(INSTANCE_DATA, UVscale)));
+	glVertexAttribIPointer(g_InstanceIndicesLocation, 2, GL_INT, stride, (void*)(base + offsetof(INSTANCE_DATA, textureLayer)));
+}
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.h
+// ============
+// draw many copies of the basic shapes from one merged geometry buffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeGeometry.h"
+#include "SceneFile.h"
+#include "LodSelector.h"
+#include "GLStateCache.h"
+#include "StreamRing.h"
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  InstancedMeshes
+ *
+ *  This class holds its own copy of every basic shape, built
+ *  by ShapeGeometry and packed into one shared vertex and
+ *  index buffer behind a single vertex array, together with
+ *  one instance buffer for the whole frame.  The round
+ *  shapes are built once for every level of LodSelector.
+ *
+ *  The instances of a frame are added in draw order, and
+ *  every run of instances that share a shape and level
+ *  becomes a draw command that points at the range of that
+ *  level in the merged buffers and at the run's range of the
+ *  instance buffer.
+ *  The instances and the commands are written into the
+ *  frame's region of the stream ring, or sent to the GPU
+ *  with one upload each when it is not available, and a
+ *  range of commands is then drawn with a single
+ *  multi-draw-indirect call.  Without GL 4.3 the commands
+ *  are drawn one at a time instead.
+ ***********************************************************/
+class InstancedMeshes
+{
+public:
+	// constructor
+	InstancedMeshes(GLStateCache* pStateCache, StreamRing* pStreamRing);
+	// destructor
+	~InstancedMeshes();
+
+	// per-instance values read by the vertex shader at the
+	// attribute locations 3 to 9
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		// texture the instance samples, -1 for a solid color
+		int textureLayer;
+		// index into the material block, -1 to keep the
+		// material set by the material uniforms
+		int materialIndex;
+	};
+
+	struct INSTANCE_STATS
+	{
+		unsigned int instanceCount;
+		// draw commands added, one per run of instances
+		unsigned int drawCommands;
+		// draw calls issued for those commands
+		unsigned int drawCalls;
+		// indices drawn over all the instances
+		unsigned int indexCount;
+	};
+
+	// build the merged shape buffers and the instance buffer
+	bool CreateMeshes();
+	// free the shape, instance and command buffers
+	void DestroyMeshes();
+
+	// remove the instances and draws of the previous frame
+	void ClearInstances();
+	// add an instance and get back its index in the buffer
+	int AddInstance(const INSTANCE_DATA& instance);
+	// add a draw of a range of instances with one shape at
+	// one level and get back its index in the draw commands
+	int AddDraw(int meshID, int level, int firstInstance, int instanceCount);
+	// send the instances and draws of the frame to the GPU
+	void UploadInstances();
+
+	// bind the merged shape buffers for the draws of the frame
+	void BeginDraws();
+	// draw a range of the uploaded draw commands
+	void DrawCommands(int firstDraw, int drawCount);
+
+	// get the instance and draw call counts of the last frame
+	INSTANCE_STATS GetLastFrameStats() const { return(m_lastFrameStats); }
+	// get the instance and draw call counts of the frame so far
+	INSTANCE_STATS GetFrameStats() const { return(m_frameStats); }
+
+private:
+	// command layout read by the indirect draw calls
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+	static_assert(sizeof(DRAW_COMMAND) == 20, "DRAW_COMMAND must match the GL indirect command");
+
+	// range of one shape in the merged buffers
+	struct MESH_RANGE
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+	};
+
+	// ranges of every shape, indexed by scene file mesh ID and
+	// level - shapes that were not built have no indices, and
+	// shapes without levels have the same range at every level
+	MESH_RANGE m_meshRanges[SceneFile::MESH_COUNT][LodSelector::LEVEL_COUNT];
+	// cache the vertex array and buffer binds go through
+	GLStateCache* m_pStateCache;
+	// mapped ring the instances and commands are written into
+	StreamRing* m_pStreamRing;
+	// vertex array and merged buffers of all the shapes
+	GLuint m_vao;
+	GLuint m_vertexBufferID;
+	GLuint m_indexBufferID;
+	// instance buffer shared by all the shapes
+	GLuint m_instanceBufferID;
+	// number of instances the instance buffer can hold
+	size_t m_instanceCapacity;
+	// indirect command buffer of the frame
+	GLuint m_commandBufferID;
+	// number of commands the command buffer can hold
+	size_t m_commandCapacity;
+	// buffers and offsets the instances and the commands of
+	// the frame were written to - the stream ring, or the
+	// buffers above at their start
+	GLuint m_instanceSourceID;
+	GLintptr m_instanceSourceOffset;
+	GLuint m_commandSourceID;
+	GLintptr m_commandSourceOffset;
+	// CPU copy of the instances of the frame
+	std::vector<INSTANCE_DATA> m_instances;
+	// CPU copy of the draw commands of the frame
+	std::vector<DRAW_COMMAND> m_commands;
+	// set when the base instance draw calls are available
+	bool m_bBaseInstance;
+	// set when the multi-draw-indirect call is available
+	bool m_bMultiDrawIndirect;
+	// counts of the current and the last frame
+	INSTANCE_STATS m_frameStats;
+	INSTANCE_STATS m_lastFrameStats;
+
+	// point the instance attributes of the vertex array at an instance
+	void SetInstanceAttributes(size_t firstInstance);
+};
+
+// the per-instance attributes are read with these offsets
+static_assert(sizeof(InstancedMeshes::INSTANCE_DATA) == 96, "INSTANCE_DATA layout changed");
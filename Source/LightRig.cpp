@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightrig.cpp
+// ============
+// manage the scene lights in a single std140 uniform buffer object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightRig.h"
+#include "Profiler.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_LightBlockName = "LightBlock";
+}
+
+/***********************************************************
+ *  LightRig()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightRig::LightRig(GLStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	// value initialization zeroes every light and the padding
+	m_lightBlock = LIGHT_BLOCK();
+	m_bufferID = 0;
+	m_lastUploadSize = 0;
+
+	// the whole block is sent with the first upload
+	m_dirtyBegin = 0;
+	m_dirtyEnd = sizeof(m_lightBlock);
+}
+
+/***********************************************************
+ *  ~LightRig()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightRig::~LightRig()
+{
+	DestroyLightBuffer();
+}
+
+/***********************************************************
+ *  CreateLightBuffer()
+ *
+ *  This method is used for creating the uniform buffer that
+ *  holds the light block and connecting it to the block
+ *  declared in the passed in shader program.
+ ***********************************************************/
+bool LightRig::CreateLightBuffer(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_LightBlockName);
+	if (GL_INVALID_INDEX == blockIndex)
+	{
+		std::cout << "Uniform block not found in shader program:" << g_LightBlockName << std::endl;
+		return false;
+	}
+
+	// catch a MAX_POINT_LIGHTS mismatch between C++ and GLSL
+	GLint blockSize = 0;
+	glGetActiveUniformBlockiv(programID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+	if (blockSize != (GLint)sizeof(LIGHT_BLOCK))
+	{
+		std::cout << "Light block size mismatch - shader:" << blockSize << ", application:" << sizeof(LIGHT_BLOCK) << std::endl;
+		return false;
+	}
+
+	glUniformBlockBinding(programID, blockIndex, LIGHT_BLOCK_BINDING);
+
+	glGenBuffers(1, &m_bufferID);
+	m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_BLOCK), &m_lightBlock, GL_DYNAMIC_DRAW);
+	m_pStateCache->BindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_bufferID);
+
+	// the buffer was just filled with the current block
+	m_dirtyBegin = m_dirtyEnd = 0;
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyLightBuffer()
+ *
+ *  This method is used for freeing the uniform buffer.
+ ***********************************************************/
+void LightRig::DestroyLightBuffer()
+{
+	if (0 != m_bufferID)
+	{
+		m_pStateCache->DeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method is used for growing the dirty byte range so
+ *  that it covers the passed in part of the light block.
+ ***********************************************************/
+void LightRig::MarkDirty(size_t offset, size_t size)
+{
+	if (m_dirtyEnd == m_dirtyBegin)
+	{
+		m_dirtyBegin = offset;
+		m_dirtyEnd = offset + size;
+	}
+	else
+	{
+		if (offset < m_dirtyBegin)
+		{
+			m_dirtyBegin = offset;
+		}
+		if (offset + size > m_dirtyEnd)
+		{
+			m_dirtyEnd = offset + size;
+		}
+	}
+}
+
+/***********************************************************
+ *  SetDirectionalLight()
+ *
+ *  This method is used for setting the directional light.
+ ***********************************************************/
+void LightRig::SetDirectionalLight(
+	glm::vec3 direction,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	bool bActive)
+{
+	DIRECTIONAL_LIGHT& light = m_lightBlock.directionalLight;
+
+	light.direction = direction;
+	light.ambient = ambient;
+	light.diffuse = diffuse;
+	light.specular = specular;
+	light.bActive = bActive;
+
+	MarkDirty(offsetof(LIGHT_BLOCK, directionalLight), sizeof(DIRECTIONAL_LIGHT));
+}
+
+/***********************************************************
+ *  AddPointLight()
+ *
+ *  This method is used for adding the next point light to
+ *  the light block.
+ ***********************************************************/
+int LightRig::AddPointLight(
+	glm::vec3 position,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	bool bActive)
+{
+	if (m_lightBlock.numPointLights >= MAX_POINT_LIGHTS)
+	{
+		std::cout << "Point light limit of " << MAX_POINT_LIGHTS << " has been reached" << std::endl;
+		return(-1);
+	}
+
+	int index = m_lightBlock.numPointLights;
+	POINT_LIGHT& light = m_lightBlock.pointLights[index];
+
+	light.position = position;
+	light.ambient = ambient;
+	light.diffuse = diffuse;
+	light.specular = specular;
+	light.bActive = bActive;
+	m_lightBlock.numPointLights++;
+
+	MarkDirty(offsetof(LIGHT_BLOCK, numPointLights), sizeof(int));
+	MarkDirty(offsetof(LIGHT_BLOCK, pointLights) + index * sizeof(POINT_LIGHT), sizeof(POINT_LIGHT));
+
+	return(index);
+}
+
+/***********************************************************
+ *  SetPointLightPosition()
+ *
+ *  This method is used for moving a point light.  Only the
+ *  position is marked as dirty.
+ ***********************************************************/
+void LightRig::SetPointLightPosition(int index, glm::vec3 position)
+{
+	if ((index < 0) || (index >= m_lightBlock.numPointLights))
+	{
+		return;
+	}
+
+	m_lightBlock.pointLights[index].position = position;
+
+	MarkDirty(
+		offsetof(LIGHT_BLOCK, pointLights) + index * sizeof(POINT_LIGHT) + offsetof(POINT_LIGHT, position),
+		sizeof(glm::vec3));
+}
+
+/***********************************************************
+ *  SetPointLightActive()
+ *
+ *  This method is used for turning a point light on or off.
+ ***********************************************************/
+void LightRig::SetPointLightActive(int index, bool bActive)
+{
+	if ((index < 0) || (index >= m_lightBlock.numPointLights))
+	{
+		return;
+	}
+
+	m_lightBlock.pointLights[index].bActive = bActive;
+
+	MarkDirty(
+		offsetof(LIGHT_BLOCK, pointLights) + index * sizeof(POINT_LIGHT) + offsetof(POINT_LIGHT, bActive),
+		sizeof(int));
+}
+
+/***********************************************************
+ *  SetSpotLight()
+ *
+ *  This method is used for setting the spot light.  The
+ *  cutoff angles are passed in degrees and stored as the
+ *  cosine values that the shader compares against.
+ ***********************************************************/
+void LightRig::SetSpotLight(
+	glm::vec3 position,
+	glm::vec3 direction,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	float constant,
+	float linear,
+	float quadratic,
+	float cutOffDegrees,
+	float outerCutOffDegrees,
+	bool bActive)
+{
+	SPOT_LIGHT& light = m_lightBlock.spotLight;
+
+	light.position = position;
+	light.direction = direction;
+	light.ambient = ambient;
+	light.diffuse = diffuse;
+	light.specular = specular;
+	light.constant = constant;
+	light.linear = linear;
+	light.quadratic = quadratic;
+	light.cutOff = glm::cos(glm::radians(cutOffDegrees));
+	light.outerCutOff = glm::cos(glm::radians(outerCutOffDegrees));
+	light.bActive = bActive;
+
+	MarkDirty(offsetof(LIGHT_BLOCK, spotLight), sizeof(SPOT_LIGHT));
+}
+
+/***********************************************************
+ *  UploadDirtyRange()
+ *
+ *  This method is used for sending the changed part of the
+ *  light block to the uniform buffer.  Nothing is sent when
+ *  no light has changed since the last upload.
+ ***********************************************************/
+void LightRig::UploadDirtyRange()
+{
+	PROFILE_ZONE("LightRig::UploadDirtyRange");
+
+	m_lastUploadSize = 0;
+
+	if ((0 == m_bufferID) || (m_dirtyEnd == m_dirtyBegin))
+	{
+		return;
+	}
+
+	m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferSubData(
+		GL_UNIFORM_BUFFER,
+		m_dirtyBegin,
+		m_dirtyEnd - m_dirtyBegin,
+		(const unsigned char*)&m_lightBlock + m_dirtyBegin);
+
+	m_lastUploadSize = m_dirtyEnd - m_dirtyBegin;
+	m_dirtyBegin = m_dirtyEnd = 0;
+}
@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightrig.h
+// ============
+// manage the scene lights in a single std140 uniform buffer object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/***********************************************************
+ *  LightRig
+ *
+ *  This class keeps a CPU copy of the "LightBlock" uniform
+ *  block declared in the fragment shader.  Changing a light
+ *  only marks the bytes it covers as dirty, and the next
+ *  call to UploadDirtyRange() sends just that range to the
+ *  uniform buffer.
+ ***********************************************************/
+class LightRig
+{
+public:
+	// constructor
+	LightRig(GLStateCache* pStateCache);
+	// destructor
+	~LightRig();
+
+	// highest number of point lights in the uniform block -
+	// must match MAX_POINT_LIGHTS in fragmentShader.glsl
+	static const int MAX_POINT_LIGHTS = 16;
+	// uniform buffer binding point used for the light block
+	static const GLuint LIGHT_BLOCK_BINDING = 0;
+
+	// the members of the following structures are laid out
+	// by the std140 rules - a vec3 followed by a scalar shares
+	// one 16 byte slot, so no explicit padding is needed there
+	struct DIRECTIONAL_LIGHT
+	{
+		glm::vec3 direction;
+		float pad0;
+		glm::vec3 ambient;
+		float pad1;
+		glm::vec3 diffuse;
+		float pad2;
+		glm::vec3 specular;
+		int bActive;
+	};
+
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		float pad0;
+		glm::vec3 ambient;
+		float pad1;
+		glm::vec3 diffuse;
+		float pad2;
+		glm::vec3 specular;
+		int bActive;
+	};
+
+	struct SPOT_LIGHT
+	{
+		glm::vec3 position;
+		float cutOff;
+		glm::vec3 direction;
+		float outerCutOff;
+		glm::vec3 ambient;
+		float constant;
+		glm::vec3 diffuse;
+		float linear;
+		glm::vec3 specular;
+		float quadratic;
+		int bActive;
+		int pad[3];
+	};
+
+	struct LIGHT_BLOCK
+	{
+		DIRECTIONAL_LIGHT directionalLight;
+		SPOT_LIGHT spotLight;
+		int numPointLights;
+		int pad[3];
+		POINT_LIGHT pointLights[MAX_POINT_LIGHTS];
+	};
+
+	// create the uniform buffer and attach it to the program
+	bool CreateLightBuffer(GLuint programID);
+	// free the uniform buffer
+	void DestroyLightBuffer();
+
+	// set the directional light
+	void SetDirectionalLight(
+		glm::vec3 direction,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		bool bActive);
+
+	// add a point light and get back its index, or -1 when
+	// the point light limit has been reached
+	int AddPointLight(
+		glm::vec3 position,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		bool bActive);
+	// move an existing point light
+	void SetPointLightPosition(int index, glm::vec3 position);
+	// turn an existing point light on or off
+	void SetPointLightActive(int index, bool bActive);
+
+	// set the spot light - the cutoff angles are in degrees
+	void SetSpotLight(
+		glm::vec3 position,
+		glm::vec3 direction,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		float constant,
+		float linear,
+		float quadratic,
+		float cutOffDegrees,
+		float outerCutOffDegrees,
+		bool bActive);
+
+	// send the changed part of the light block to the GPU
+	void UploadDirtyRange();
+	// get the number of bytes sent by the last upload
+	size_t GetLastUploadSize() const { return(m_lastUploadSize); }
+
+private:
+	// CPU copy of the uniform block
+	LIGHT_BLOCK m_lightBlock;
+	// uniform buffer object holding the light block
+	GLuint m_bufferID;
+	// cache the buffer binds go through
+	GLStateCache* m_pStateCache;
+	// byte range of the block changed since the last upload
+	size_t m_dirtyBegin;
+	size_t m_dirtyEnd;
+	// number of bytes sent by the last upload
+	size_t m_lastUploadSize;
+
+	// grow the dirty range to cover the passed in bytes
+	void MarkDirty(size_t offset, size_t size);
+};
+
+// the C++ layout must match the std140 layout of the shader block
+static_assert(sizeof(LightRig::DIRECTIONAL_LIGHT) == 64, "DIRECTIONAL_LIGHT does not match std140");
+static_assert(sizeof(LightRig::POINT_LIGHT) == 64, "POINT_LIGHT does not match std140");
+static_assert(sizeof(LightRig::SPOT_LIGHT) == 96, "SPOT_LIGHT does not match std140");
+static_assert(offsetof(LightRig::LIGHT_BLOCK, spotLight) == 64, "LIGHT_BLOCK does not match std140");
+static_assert(offsetof(LightRig::LIGHT_BLOCK, numPointLights) == 160, "LIGHT_BLOCK does not match std140");
+static_assert(offsetof(LightRig::LIGHT_BLOCK, pointLights) == 176, "LIGHT_BLOCK does not match std140");
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// lodselector.cpp
+// ============
+// pick the tessellation level of the round shapes from their size on the screen
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LodSelector.h"
+#include "SceneFile.h"
+
+#include <cmath>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const float g_Pi = 3.14159265358979f;
+
+	// slices of each level - the finest matches ShapeMeshes
+	const int g_LevelSlices[LodSelector::LEVEL_COUNT] = { 36, 24, 12, 8 };
+	// largest screen error, in pixels, before a finer level
+	// is used
+	const float g_DefaultMaxError = 0.5f;
+	// part of the largest error a coarser level has to stay
+	// under before an object moves to it
+	const float g_CoarserErrorScale = 0.5f;
+
+	/***********************************************************
+	 *  GetLevelError()
+	 *
+	 *  This function is used for getting how far the sides of a
+	 *  level are from the true circle, for a unit radius.
+	 ***********************************************************/
+	float GetLevelError(int level)
+	{
+		return(1.0f - std::cos(g_Pi / (float)g_LevelSlices[level]));
+	}
+}
+
+/***********************************************************
+ *  LodSelector()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LodSelector::LodSelector()
+{
+	m_maxError = g_DefaultMaxError;
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+}
+
+/***********************************************************
+ *  ~LodSelector()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LodSelector::~LodSelector()
+{
+}
+
+/***********************************************************
+ *  GetLevelSlices()
+ *
+ *  This method is used for getting the number of slices
+ *  around the Y axis the round shapes are built with at a
+ *  level.
+ ***********************************************************/
+int LodSelector::GetLevelSlices(int level)
+{
+	if ((level < 0) || (level >= LEVEL_COUNT))
+	{
+		return(g_LevelSlices[0]);
+	}
+	return(g_LevelSlices[level]);
+}
+
+/***********************************************************
+ *  HasLevels()
+ *
+ *  This method is used for getting whether a scene file
+ *  mesh is one of the round shapes, which are built at every
+ *  level - the other shapes only have the one level.
+ ***********************************************************/
+bool LodSelector::HasLevels(int meshID)
+{
+	switch (meshID)
+	{
+	case SceneFile::MESH_CYLINDER:
+	case SceneFile::MESH_CYLINDER_NO_TOP:
+	case SceneFile::MESH_CONE:
+	case SceneFile::MESH_SPHERE:
+	case SceneFile::MESH_HALF_SPHERE:
+	case SceneFile::MESH_TAPERED_CYLINDER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for setting the number of objects,
+ *  which all start out at the finest level.
+ ***********************************************************/
+void LodSelector::Resize(int objectCount)
+{
+	m_levels.assign((objectCount > 0) ? objectCount : 0, 0);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the selections of a new
+ *  frame, keeping the counts of the previous one.
+ ***********************************************************/
+void LodSelector::BeginFrame()
+{
+	m_lastStats = m_frameStats;
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+}
+
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for picking the level of an object
+ *  from its radius in screen pixels.  When the current level
+ *  is off by more than the largest error, the object goes to
+ *  the coarsest level that is not.  Otherwise it only goes
+ *  to coarser levels whose error is under a part of the
+ *  largest one, which keeps a gap between the distances the
+ *  object switches at in either direction.
+ ***********************************************************/
+int LodSelector::SelectLevel(int object, float screenRadius)
+{
+	if ((object < 0) || (object >= (int)m_levels.size()))
+	{
+		return(0);
+	}
+
+	const int currentLevel = m_levels[object];
+	int level = currentLevel;
+	if (screenRadius * GetLevelError(level) > m_maxError)
+	{
+		while ((level > 0) && (screenRadius * GetLevelError(level) > m_maxError))
+		{
+			level--;
+		}
+	}
+	else
+	{
+		while ((level + 1 < LEVEL_COUNT) &&
+			(screenRadius * GetLevelError(level + 1) <= m_maxError * g_CoarserErrorScale))
+		{
+			level++;
+		}
+	}
+
+	m_levels[object] = (uint8_t)level;
+	m_frameStats.levelCounts[level]++;
+	if (level != currentLevel)
+	{
+		m_frameStats.switchCount++;
+	}
+
+	return(level);
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// lodselector.h
+// ============
+// pick the tessellation level of the round shapes from their size on the screen
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  LodSelector
+ *
+ *  This class picks one of a few tessellation levels for
+ *  each object drawn with a round shape - the cylinders,
+ *  cones and spheres - from how far its flat sides are from
+ *  the true circle on the screen.  A circle of radius r cut
+ *  into n slices is off by at most r * (1 - cos(pi / n)),
+ *  so with the radius of the object in screen pixels the
+ *  coarsest level that stays under the allowed error can be
+ *  found directly.
+ *
+ *  The level of every object is kept between frames.  An
+ *  object moves to a finer level as soon as its error goes
+ *  over the limit, but only to a coarser one once that
+ *  level's error is well under it, so an object at the
+ *  distance where two levels meet does not switch back and
+ *  forth on every frame.
+ ***********************************************************/
+class LodSelector
+{
+public:
+	// constructor
+	LodSelector();
+	// destructor
+	~LodSelector();
+
+	// tessellation levels, from the finest down
+	static const int LEVEL_COUNT = 4;
+
+	// get the number of slices around the Y axis of a level
+	static int GetLevelSlices(int level);
+	// get whether a scene file mesh ID is built at every level
+	static bool HasLevels(int meshID);
+
+	struct LOD_STATS
+	{
+		// objects drawn at each level
+		unsigned int levelCounts[LEVEL_COUNT];
+		// objects that changed level
+		unsigned int switchCount;
+	};
+
+	// set the number of objects, which all start at the finest level
+	void Resize(int objectCount);
+	// set the largest screen error, in pixels, of the levels
+	void SetMaxError(float pixels) { m_maxError = pixels; }
+
+	// start the selections of a new frame
+	void BeginFrame();
+	// pick the level of an object from its radius in screen
+	// pixels, and get it back
+	int SelectLevel(int object, float screenRadius);
+	// get the level of an object picked last
+	int GetLevel(int object) const { return(m_levels[object]); }
+
+	// get the level counts of the last frame
+	LOD_STATS GetLastStats() const { return(m_lastStats); }
+
+private:
+	// level of each object
+	std::vector<uint8_t> m_levels;
+	float m_maxError;
+	// counts of the current and the last frame
+	LOD_STATS m_frameStats;
+	LOD_STATS m_lastStats;
+};
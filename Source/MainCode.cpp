@@ -8,7 +8,15 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>         // error handling and output
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, atoi, strtol
+#include <climits>          // INT_MAX
+#include <cstring>          // strcmp
+#include <algorithm>        // min, max
+#include <chrono>           // headless frame times
+#include <atomic>           // render thread stop flag
+#include <thread>           // render thread
+#include <mutex>            // render thread wake-ups
+#include <condition_variable>
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +30,17 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "GLStateCache.h"
+#include "StreamRing.h"
+#include "SceneFile.h"
+#include "HeadlessContext.h"
+#include "CameraPath.h"
+#include "FrameBenchmark.h"
+#include "Profiler.h"
+#include "TripleBuffer.h"
+#include "FramePacer.h"
+#include "FrameCache.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,13 +48,53 @@ namespace
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones by Nick Wyrwas Complete"; 
 
+	// time each headless or benchmark frame moves the clock
+	// forward by
+	const float g_FixedFrameTime = 1.0f / 60.0f;
+	// time each step of the threaded simulation moves the
+	// clock forward by
+	const double g_SimulationStep = 1.0 / 120.0;
+	// most time the simulation catches up on at once, so that
+	// a stall does not turn into a burst of steps
+	const double g_MaxSimulationLag = 0.25;
+	// size each frame's region of the stream ring starts out
+	// with - it grows when a frame writes more
+	const size_t g_StreamFrameBytes = 256 * 1024;
+	// refresh rate the frames are paced against when there is
+	// no monitor to ask, or it does not know its own rate
+	const int g_DefaultRefreshRate = 60;
+
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
+	// set when rendering into an offscreen framebuffer
+	bool g_bHeadless = false;
+	// Chrome trace the profiling zones are written to on exit,
+	// or NULL when they are not recorded
+	const char* g_TraceFilename = nullptr;
+	// how the window loops pace their frames, and the frame
+	// rate of the target rate mode
+	FramePacer::PACING_MODE g_PacingMode = FramePacer::PACING_VSYNC;
+	double g_TargetFrameRate = 0.0;
+	// set when the threaded window loop only draws a frame
+	// when the camera or the scene changed
+	bool g_bOnDemand = false;
+	// wakes the render thread of the on demand mode when a new
+	// camera state was published or the window has to be
+	// shown again
+	std::mutex g_RenderWakeMutex;
+	std::condition_variable g_RenderWakeCondition;
+	bool g_bRenderWakePending = false;
 
 	// scene manager object for managing the 3D scene prepare and render
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
 	ShaderManager* g_ShaderManager = nullptr;
+	// uniform cache object for skipping redundant shader uploads
+	UniformCache* g_UniformCache = nullptr;
+	// state cache object for skipping redundant OpenGL state changes
+	GLStateCache* g_StateCache = nullptr;
+	// stream ring object for the camera, instance and command data of each frame
+	StreamRing* g_StreamRing = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
 }
@@ -44,6 +103,24 @@ namespace
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void CreateManagers();
+void PrepareRenderer();
+bool CreateWindowRenderer();
+bool CreateHeadlessRenderer(HeadlessContext& headlessContext, int width, int height);
+void RenderFrame(const ViewManager::VIEW_SNAPSHOT& snapshot);
+void RenderThreadLoop(TripleBuffer<ViewManager::VIEW_SNAPSHOT>* pViewSnapshots, FramePacer* pFramePacer, const std::atomic<bool>* pbStop);
+void WakeRenderThread();
+void TakeRenderWake(bool bWait, const std::atomic<bool>* pbStop);
+void SetUpFramePacer(FramePacer& framePacer);
+void ReportFramePacing(const FramePacer& framePacer);
+int RunThreaded();
+int RunLockstep();
+void DestroyManagers();
+void WriteProfileTrace();
+void PrintUsage(const char* programName);
+bool IsNumber(const char* text, int minimum);
+int RunHeadless(int width, int height, int frameCount, const char* imageFilename);
+int RunBenchmark(const char* pathFilename, int warmUpFrames, int frameCount, const char* resultsFilename, int width, int height);
 
 
 /***********************************************************
@@ -53,18 +130,765 @@ bool InitializeGLEW();
  *  launched.
  ***********************************************************/
 int main(int argc, char* argv[])
+{
+	Profiler::SetThreadName("Main thread");
+
+	// the options may come in any order - the ones that change
+	// how the window runs are applied as they are found, and
+	// at most one command picks something else to run
+	enum COMMAND
+	{
+		COMMAND_WINDOW,
+		COMMAND_CONVERT_SCENE,
+		COMMAND_HEADLESS,
+		COMMAND_BENCHMARK
+	};
+	COMMAND command = COMMAND_WINDOW;
+	const char* const* commandArguments = NULL;
+	int commandArgumentCount = 0;
+	bool bLockstep = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* option = argv[i];
+		// arguments after the option, up to the next option
+		int valueCount = 0;
+		while ((i + 1 + valueCount < argc) && (strncmp(argv[i + 1 + valueCount], "--", 2) != 0))
+		{
+			valueCount++;
+		}
+		const char* const* values = argv + i + 1;
+
+		bool bValid = true;
+		if (strcmp(option, "--profile") == 0)
+		{
+			// "--profile <trace>" records the profiling zones and
+			// writes them to a Chrome trace JSON file when the
+			// application exits
+			bValid = (1 == valueCount);
+			if (bValid)
+			{
+				g_TraceFilename = values[0];
+			}
+		}
+		else if (strcmp(option, "--pace") == 0)
+		{
+			// "--pace <off|vsync|jit|frame rate>" picks how the
+			// window frames are paced
+			bValid = (1 == valueCount) && FramePacer::ParseMode(values[0], g_PacingMode, g_TargetFrameRate);
+		}
+		else if (strcmp(option, "--on-demand") == 0)
+		{
+			// "--on-demand" makes the threaded window loop sleep
+			// while nothing changes, and only draw a frame when
+			// the camera or the scene did
+			bValid = (0 == valueCount);
+			g_bOnDemand = true;
+		}
+		else if (strcmp(option, "--lockstep") == 0)
+		{
+			// "--lockstep" handles the input and draws the frames
+			// one after the other on the main thread
+			bValid = (0 == valueCount);
+			bLockstep = true;
+		}
+		else if ((COMMAND_WINDOW == command) && (strcmp(option, "--convert-scene") == 0))
+		{
+			// "--convert-scene <text scene> <binary scene>" only
+			// converts a text scene into a binary scene, without
+			// opening a window
+			bValid = (2 == valueCount);
+			command = COMMAND_CONVERT_SCENE;
+		}
+		else if ((COMMAND_WINDOW == command) && (strcmp(option, "--headless") == 0))
+		{
+			// "--headless <width> <height> <frames> <image>"
+			// renders the scene without a window or display
+			// server and writes the last frame to a PPM image
+			bValid = (4 == valueCount) &&
+				IsNumber(values[0], 1) && IsNumber(values[1], 1) && IsNumber(values[2], 1);
+			command = COMMAND_HEADLESS;
+		}
+		else if ((COMMAND_WINDOW == command) && (strcmp(option, "--benchmark") == 0))
+		{
+			// "--benchmark <camera path> <warm-up frames> <frames>
+			// <results> [<width> <height>]" replays a camera path
+			// and writes the frame statistics to a JSON file - in
+			// the window, or offscreen when a width and height
+			// follow
+			bValid = ((4 == valueCount) || (6 == valueCount)) &&
+				IsNumber(values[1], 0) && IsNumber(values[2], 1);
+			if (bValid && (6 == valueCount))
+			{
+				bValid = IsNumber(values[4], 1) && IsNumber(values[5], 1);
+			}
+			command = COMMAND_BENCHMARK;
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (false == bValid)
+		{
+			std::cerr << "invalid argument: " << option << std::endl;
+			PrintUsage(argv[0]);
+			return(EXIT_FAILURE);
+		}
+
+		if ((COMMAND_WINDOW != command) && (NULL == commandArguments))
+		{
+			commandArguments = values;
+			commandArgumentCount = valueCount;
+		}
+		i += valueCount;
+	}
+
+	if (NULL != g_TraceFilename)
+	{
+		Profiler::Start();
+		std::atexit(WriteProfileTrace);
+	}
+
+	switch (command)
+	{
+	case COMMAND_CONVERT_SCENE:
+		if (SceneFile::ConvertTextScene(commandArguments[0], commandArguments[1]) == false)
+		{
+			return(EXIT_FAILURE);
+		}
+		return(EXIT_SUCCESS);
+	case COMMAND_HEADLESS:
+		return(RunHeadless(atoi(commandArguments[0]), atoi(commandArguments[1]), atoi(commandArguments[2]), commandArguments[3]));
+	case COMMAND_BENCHMARK:
+		return(RunBenchmark(commandArguments[0], atoi(commandArguments[1]), atoi(commandArguments[2]), commandArguments[3],
+			(6 == commandArgumentCount) ? atoi(commandArguments[4]) : 0,
+			(6 == commandArgumentCount) ? atoi(commandArguments[5]) : 0));
+	default:
+		break;
+	}
+
+	if (bLockstep)
+	{
+		return(RunLockstep());
+	}
+
+	// otherwise the input and the simulation run on the main
+	// thread and the frames are drawn on a render thread
+	return(RunThreaded());
+}
+
+/***********************************************************
+ *  PrintUsage()
+ *
+ *  This function is used for printing the options the
+ *  application understands, after a malformed or unknown
+ *  one was passed in.
+ ***********************************************************/
+void PrintUsage(const char* programName)
+{
+	std::cerr << "usage: " << programName << " [options] [command]" << std::endl
+		<< "options, in any order:" << std::endl
+		<< "  --profile <trace>                  write the profiling zones to a Chrome trace" << std::endl
+		<< "  --pace <off|vsync|jit|frames per second>" << std::endl
+		<< "                                     pick how the window frames are paced" << std::endl
+		<< "  --on-demand                        only draw when the camera or the scene changed" << std::endl
+		<< "  --lockstep                         handle the input and draw on the main thread" << std::endl
+		<< "commands, at most one:" << std::endl
+		<< "  --convert-scene <text scene> <binary scene>" << std::endl
+		<< "  --headless <width> <height> <frames> <image>" << std::endl
+		<< "  --benchmark <camera path> <warm-up frames> <frames> <results> [<width> <height>]" << std::endl;
+}
+
+/***********************************************************
+ *  IsNumber()
+ *
+ *  This function is used for checking that a command line
+ *  argument is a whole number of at least the passed in
+ *  minimum, with nothing after it.
+ ***********************************************************/
+bool IsNumber(const char* text, int minimum)
+{
+	char* pEnd = NULL;
+	const long value = strtol(text, &pEnd, 10);
+	return((pEnd != text) && ('\0' == *pEnd) && (value >= minimum) && (value <= INT_MAX));
+}
+
+/***********************************************************
+ *  RunThreaded()
+ *
+ *  This function is used for running the window with the
+ *  input and the simulation on the main thread, which GLFW
+ *  needs its events handled on, and the drawing on a render
+ *  thread that the OpenGL context moves to.  The simulation
+ *  moves the camera in fixed steps and publishes the camera
+ *  state after them through a triple buffer, and the render
+ *  thread draws the newest one it finds, so a slow buffer
+ *  swap does not hold up the input and a slow update does
+ *  not hold up the swap.
+ *
+ *  In the on demand mode the loop sleeps in glfwWaitEvents()
+ *  while the camera is at rest, and only publishes a camera
+ *  state when the view manager says the view changed, so an
+ *  idle window uses next to no CPU or GPU time.
+ ***********************************************************/
+int RunThreaded()
+{
+	// open the window and prepare the 3D scene in it, or
+	// terminate the application if that fails
+	if (CreateWindowRenderer() == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// the first frames draw the camera as it was set up
+	TripleBuffer<ViewManager::VIEW_SNAPSHOT> viewSnapshots;
+	viewSnapshots.GetWriteBuffer() = g_ViewManager->GetSnapshot();
+	viewSnapshots.Publish();
+
+	FramePacer framePacer;
+	SetUpFramePacer(framePacer);
+
+	// the context can only be current on one thread at a time
+	glfwMakeContextCurrent(NULL);
+	std::atomic<bool> bStopRendering(false);
+	std::thread renderThread(RenderThreadLoop, &viewSnapshots, &framePacer, &bStopRendering);
+
+	double previousTime = glfwGetTime();
+	double lag = 0.0;
+	// set while the steps keep moving the camera, so the on
+	// demand loop keeps stepping until it comes to rest
+	bool bViewMoving = false;
+	// loop will keep running until the application is closed 
+	while (!glfwWindowShouldClose(g_Window))
+	{
+		if (g_bOnDemand && (false == bViewMoving))
+		{
+			// sleep until an event arrives - the time asleep is
+			// not caught up on, but one step is due at once for
+			// the input that woke the loop
+			{
+				PROFILE_ZONE("glfwWaitEvents");
+				glfwWaitEvents();
+			}
+			previousTime = glfwGetTime();
+			lag = g_SimulationStep;
+		}
+		else
+		{
+			// sleep until an event arrives or the next step is due
+			PROFILE_ZONE("glfwWaitEventsTimeout");
+			glfwWaitEventsTimeout(std::max(0.0, g_SimulationStep - lag));
+		}
+
+		const double currentTime = glfwGetTime();
+		lag = std::min(lag + (currentTime - previousTime), g_MaxSimulationLag);
+		previousTime = currentTime;
+
+		// the mouse moved the camera in the callbacks already,
+		// the keyboard moves it by every step that is due
+		bool bStepped = false;
+		while (lag >= g_SimulationStep)
+		{
+			PROFILE_ZONE("Simulation step");
+			g_ViewManager->UpdateSimulation((float)g_SimulationStep);
+			lag -= g_SimulationStep;
+			bStepped = true;
+		}
+
+		if (g_bOnDemand)
+		{
+			// only a changed view is published and drawn, and a
+			// damaged window is given the kept frame again
+			const bool bViewChanged = g_ViewManager->ConsumeViewChange();
+			const bool bRefresh = g_ViewManager->ConsumeRefreshRequest();
+			if (bViewChanged)
+			{
+				bViewMoving = true;
+				viewSnapshots.GetWriteBuffer() = g_ViewManager->GetSnapshot();
+				viewSnapshots.Publish();
+			}
+			else if (bStepped)
+			{
+				bViewMoving = false;
+			}
+
+			if (bViewChanged || bRefresh)
+			{
+				WakeRenderThread();
+			}
+		}
+		else if (bStepped)
+		{
+			viewSnapshots.GetWriteBuffer() = g_ViewManager->GetSnapshot();
+			viewSnapshots.Publish();
+		}
+	}
+
+	bStopRendering.store(true);
+	WakeRenderThread();
+	renderThread.join();
+	ReportFramePacing(framePacer);
+
+	// clear the allocated manager objects from memory, with
+	// the context back on this thread
+	glfwMakeContextCurrent(g_Window);
+	DestroyManagers();
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  RenderThreadLoop()
+ *
+ *  This function is used for drawing frames on the render
+ *  thread until it is told to stop.  Each frame starts when
+ *  the frame pacer says so and draws the newest camera state
+ *  the simulation published by then, or the last one again
+ *  when there is no newer one.
+ *
+ *  In the on demand mode the frames are drawn into a kept
+ *  frame and copied into the window.  Once neither the view
+ *  nor the scene is changing the thread sleeps until it is
+ *  woken, and then draws the new camera state, or shows the
+ *  kept frame again when there is none.  When the kept frame
+ *  cannot be created at the size of the window, the frames
+ *  are drawn straight into the window instead, and drawn
+ *  again on every wake-up.
+ ***********************************************************/
+void RenderThreadLoop(TripleBuffer<ViewManager::VIEW_SNAPSHOT>* pViewSnapshots, FramePacer* pFramePacer, const std::atomic<bool>* pbStop)
+{
+	Profiler::SetThreadName("Render thread");
+	glfwMakeContextCurrent(g_Window);
+	pFramePacer->Start();
+
+	FrameCache frameCache;
+	bool bSceneDirty = true;
+	// window size the kept frame could not be created at - the
+	// frames of that size are drawn straight into the window
+	int failedCacheWidth = 0;
+	int failedCacheHeight = 0;
+
+	while (false == pbStop->load())
+	{
+		if (g_bOnDemand)
+		{
+			TakeRenderWake(false == bSceneDirty, pbStop);
+			if (pbStop->load())
+			{
+				break;
+			}
+			if (false == bSceneDirty)
+			{
+				pFramePacer->Resume();
+			}
+			// the wake-up can come from a scene change as well as
+			// from a new camera state
+			bSceneDirty = bSceneDirty || g_SceneManager->IsSceneDirty();
+		}
+
+		PROFILE_ZONE("Frame");
+
+		pFramePacer->WaitForFrameStart();
+		const bool bNewView = pViewSnapshots->Update();
+		const ViewManager::VIEW_SNAPSHOT& snapshot = pViewSnapshots->GetReadBuffer();
+		if (false == g_bOnDemand)
+		{
+			RenderFrame(snapshot);
+		}
+		else if ((snapshot.framebufferWidth <= 0) || (snapshot.framebufferHeight <= 0))
+		{
+			// a minimized window has nothing to draw until a
+			// resize wakes the thread again
+			bSceneDirty = false;
+			continue;
+		}
+		else if ((snapshot.framebufferWidth == failedCacheWidth) && (snapshot.framebufferHeight == failedCacheHeight))
+		{
+			// without a kept frame every wake-up draws the frame
+			// again, straight into the window
+			RenderFrame(snapshot);
+			bSceneDirty = g_SceneManager->TakeSceneDirty();
+		}
+		else if (bNewView || bSceneDirty ||
+			(false == frameCache.HasFrame(snapshot.framebufferWidth, snapshot.framebufferHeight)))
+		{
+			if (frameCache.BeginFrame(snapshot.framebufferWidth, snapshot.framebufferHeight) == false)
+			{
+				if (0 == failedCacheWidth)
+				{
+					std::cout << "INFO: The kept frame could not be created, the frames are drawn straight into the window" << std::endl;
+				}
+				failedCacheWidth = snapshot.framebufferWidth;
+				failedCacheHeight = snapshot.framebufferHeight;
+				RenderFrame(snapshot);
+			}
+			else
+			{
+				RenderFrame(snapshot);
+				frameCache.Present();
+			}
+			// a change made while the frame was drawn stays in
+			// the flag, so it is drawn by the next frame
+			bSceneDirty = g_SceneManager->TakeSceneDirty();
+		}
+		else
+		{
+			frameCache.PresentAgain();
+		}
+		pFramePacer->EndFrameWork();
+
+		// Flips the the back buffer with the front buffer every frame.
+		{
+			PROFILE_ZONE("glfwSwapBuffers");
+			glfwSwapBuffers(g_Window);
+		}
+		pFramePacer->EndFrame();
+	}
+
+	if (g_bOnDemand)
+	{
+		const FrameCache::FRAME_CACHE_STATS stats = frameCache.GetStats();
+		std::cout << "INFO: Drew " << stats.drawnFrames << " frames on demand, and showed the kept frame "
+			<< stats.reusedFrames << " more times" << std::endl;
+	}
+	frameCache.Destroy();
+
+	glfwMakeContextCurrent(NULL);
+}
+
+/***********************************************************
+ *  WakeRenderThread()
+ *
+ *  This function is used for waking the render thread of
+ *  the on demand mode, after a new camera state was
+ *  published, the window has to be shown again, or the
+ *  thread is told to stop.
+ ***********************************************************/
+void WakeRenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_RenderWakeMutex);
+		g_bRenderWakePending = true;
+	}
+	g_RenderWakeCondition.notify_one();
+}
+
+/***********************************************************
+ *  TakeRenderWake()
+ *
+ *  This function is used for taking the wake-up of the
+ *  render thread before a frame, when the passed in flag is
+ *  set first sleeping until there is one.  The frame takes
+ *  the newest camera state after this, so anything that is
+ *  published later wakes the thread again.
+ ***********************************************************/
+void TakeRenderWake(bool bWait, const std::atomic<bool>* pbStop)
+{
+	std::unique_lock<std::mutex> lock(g_RenderWakeMutex);
+	if (bWait)
+	{
+		PROFILE_ZONE("Wait for a change");
+		g_RenderWakeCondition.wait(lock, [pbStop]() { return(g_bRenderWakePending || pbStop->load()); });
+	}
+	g_bRenderWakePending = false;
+}
+
+/***********************************************************
+ *  RunLockstep()
+ *
+ *  This function is used for running the window with the
+ *  input, the update and the drawing of each frame one
+ *  after the other on the main thread, paced by the frame
+ *  pacer.  The events are polled once the frame may start,
+ *  so the input it draws is as recent as it can be.
+ ***********************************************************/
+int RunLockstep()
+{
+	// open the window and prepare the 3D scene in it, or
+	// terminate the application if that fails
+	if (CreateWindowRenderer() == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	FramePacer framePacer;
+	SetUpFramePacer(framePacer);
+	framePacer.Start();
+
+	// loop will keep running until the application is closed 
+	// or until an error has occurred
+	while (!glfwWindowShouldClose(g_Window))
+	{
+		PROFILE_ZONE("Frame");
+
+		framePacer.WaitForFrameStart();
+
+		// query the latest GLFW events
+		{
+			PROFILE_ZONE("glfwPollEvents");
+			glfwPollEvents();
+		}
+
+		RenderFrame(g_ViewManager->UpdateView());
+		framePacer.EndFrameWork();
+
+		// Flips the the back buffer with the front buffer every frame.
+		{
+			PROFILE_ZONE("glfwSwapBuffers");
+			glfwSwapBuffers(g_Window);
+		}
+		framePacer.EndFrame();
+	}
+	ReportFramePacing(framePacer);
+
+	// clear the allocated manager objects from memory
+	DestroyManagers();
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  SetUpFramePacer()
+ *
+ *  This function is used for giving the frame pacer the
+ *  mode from the command line and the refresh rate of the
+ *  display, which GLFW only reports on the main thread.
+ ***********************************************************/
+void SetUpFramePacer(FramePacer& framePacer)
+{
+	framePacer.SetMode(g_PacingMode, g_TargetFrameRate);
+
+	// a machine without a connected display has no monitor
+	int refreshRate = g_DefaultRefreshRate;
+	GLFWmonitor* pMonitor = glfwGetPrimaryMonitor();
+	if (NULL != pMonitor)
+	{
+		const GLFWvidmode* pVideoMode = glfwGetVideoMode(pMonitor);
+		if ((NULL != pVideoMode) && (pVideoMode->refreshRate > 0))
+		{
+			refreshRate = pVideoMode->refreshRate;
+		}
+	}
+	framePacer.SetRefreshRate(refreshRate);
+}
+
+/***********************************************************
+ *  ReportFramePacing()
+ *
+ *  This function is used for printing the frame times and
+ *  the pacing error of a window run.
+ ***********************************************************/
+void ReportFramePacing(const FramePacer& framePacer)
+{
+	const FramePacer::PACING_STATS stats = framePacer.GetStats();
+	if (0 == stats.frameCount)
+	{
+		return;
+	}
+
+	std::cout << "INFO: Paced " << stats.frameCount << " frames - mean " << stats.meanMilliseconds
+		<< " ms, p50 " << stats.p50Milliseconds << " ms, p95 " << stats.p95Milliseconds
+		<< " ms, p99 " << stats.p99Milliseconds << " ms" << std::endl;
+	if (stats.targetMilliseconds > 0.0)
+	{
+		std::cout << "INFO: Pacing error against " << stats.targetMilliseconds << " ms - mean "
+			<< stats.meanErrorMilliseconds << " ms, max " << stats.maxErrorMilliseconds << " ms, "
+			<< stats.missedFrames << " missed frames" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  RunHeadless()
+ *
+ *  This function is used for rendering the scene into an
+ *  offscreen framebuffer of the passed in size, with no
+ *  window and no display server.  The clock moves by a fixed
+ *  step and every texture is loaded before the first frame,
+ *  so the same command line always draws the same frames.
+ *  Each frame is waited for before the next one starts, its
+ *  time is measured, and the last frame is written out.
+ ***********************************************************/
+int RunHeadless(int width, int height, int frameCount, const char* imageFilename)
+{
+	if ((width <= 0) || (height <= 0) || (frameCount <= 0))
+	{
+		std::cerr << "usage: --headless <width> <height> <frames> <image.ppm>" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	HeadlessContext headlessContext;
+	if (CreateHeadlessRenderer(headlessContext, width, height) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// the frames must not depend on how fast the images decode
+	g_SceneManager->FinishTextureLoading();
+
+	double totalMilliseconds = 0.0;
+	double minMilliseconds = 0.0;
+	double maxMilliseconds = 0.0;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		PROFILE_ZONE("Frame");
+
+		const std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+		RenderFrame(g_ViewManager->UpdateView());
+		{
+			PROFILE_ZONE("glFinish");
+			glFinish();
+		}
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - frameStart).count();
+		totalMilliseconds += milliseconds;
+		minMilliseconds = (0 == frame) ? milliseconds : std::min(minMilliseconds, milliseconds);
+		maxMilliseconds = (0 == frame) ? milliseconds : std::max(maxMilliseconds, milliseconds);
+	}
+
+	std::cout << "INFO: Rendered " << frameCount << " frames at " << width << "x" << height
+		<< " - mean " << (totalMilliseconds / frameCount) << " ms, min " << minMilliseconds
+		<< " ms, max " << maxMilliseconds << " ms" << std::endl;
+
+	const bool bWritten = headlessContext.WriteImage(imageFilename);
+	if (bWritten == false)
+	{
+		std::cerr << "Could not write the image " << imageFilename << std::endl;
+	}
+
+	DestroyManagers();
+	headlessContext.Destroy();
+
+	return(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  RunBenchmark()
+ *
+ *  This function is used for replaying a camera path and
+ *  recording the cost of every frame.  The warm-up frames
+ *  play the whole path first, so every texture level, shape
+ *  level and buffer the path needs is already in place,
+ *  and then the measured frames play it again.  The path
+ *  is stretched over the frame counts, so its keys can be
+ *  in any seconds.  The clock moves by a fixed step, and in
+ *  a window the buffer swaps do not wait for the display.
+ *  A width and height of zero use the window.
+ ***********************************************************/
+int RunBenchmark(const char* pathFilename, int warmUpFrames, int frameCount, const char* resultsFilename, int width, int height)
+{
+	if ((warmUpFrames < 0) || (frameCount <= 0) || (width < 0) || (height < 0))
+	{
+		std::cerr << "usage: --benchmark <camera path> <warm-up frames> <frames> <results.json> [<width> <height>]" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	CameraPath cameraPath;
+	if (cameraPath.Load(pathFilename) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	const bool bOffscreen = (width > 0) && (height > 0);
+	HeadlessContext headlessContext;
+	if (bOffscreen)
+	{
+		if (CreateHeadlessRenderer(headlessContext, width, height) == false)
+		{
+			return(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		if (CreateWindowRenderer() == false)
+		{
+			return(EXIT_FAILURE);
+		}
+		glfwSwapInterval(0);
+		glfwGetFramebufferSize(g_Window, &width, &height);
+		g_ViewManager->SetFixedFrameTime(g_FixedFrameTime);
+	}
+
+	// the frames must not depend on how fast the images decode
+	g_SceneManager->FinishTextureLoading();
+
+	FrameBenchmark frameBenchmark;
+	frameBenchmark.CreateQueries();
+	frameBenchmark.SetWarmUpFrames(warmUpFrames);
+
+	const int totalFrames = warmUpFrames + frameCount;
+	for (int frame = 0; frame < totalFrames; frame++)
+	{
+		if ((false == bOffscreen) && glfwWindowShouldClose(g_Window))
+		{
+			break;
+		}
+
+		PROFILE_ZONE("Frame");
+
+		// place the camera where the path is at this frame
+		const bool bWarmUp = (frame < warmUpFrames);
+		const int pathFrame = bWarmUp ? frame : (frame - warmUpFrames);
+		const int pathFrameCount = bWarmUp ? warmUpFrames : frameCount;
+		float pathTime = 0.0f;
+		if (pathFrameCount > 1)
+		{
+			pathTime = cameraPath.GetDuration() * (float)pathFrame / (float)(pathFrameCount - 1);
+		}
+		const CameraPath::CAMERA_KEY pose = cameraPath.Sample(pathTime);
+		g_ViewManager->SetCameraPose(pose.position, pose.front, pose.zoom, pose.bOrthographic);
+
+		frameBenchmark.BeginFrame();
+		RenderFrame(g_ViewManager->UpdateView());
+		const GLStateCache::STATE_STATS stateStats = g_StateCache->GetFrameStats();
+		const StreamRing::RING_STATS ringStats = g_StreamRing->GetFrameStats();
+		frameBenchmark.EndFrameSubmit(g_SceneManager->GetFrameDrawCalls(), stateStats.callsIssued, stateStats.callsElided, ringStats.stallMilliseconds);
+
+		if (false == bOffscreen)
+		{
+			PROFILE_ZONE("glfwSwapBuffers");
+			glfwSwapBuffers(g_Window);
+			glfwPollEvents();
+		}
+	}
+	frameBenchmark.Finish();
+
+	const FrameBenchmark::SUMMARY frameTime = frameBenchmark.Summarize(FrameBenchmark::METRIC_FRAME_TIME);
+	const FrameBenchmark::SUMMARY gpuTime = frameBenchmark.Summarize(FrameBenchmark::METRIC_GPU_TIME);
+	const FrameBenchmark::SUMMARY fenceStallTime = frameBenchmark.Summarize(FrameBenchmark::METRIC_FENCE_STALL_TIME);
+	std::cout << "INFO: Benchmarked " << std::max((int)frameBenchmark.GetSamples().size() - warmUpFrames, 0)
+		<< " frames at " << width << "x" << height << " - frame mean " << frameTime.mean
+		<< " ms, p95 " << frameTime.p95 << " ms, p99 " << frameTime.p99
+		<< " ms, GPU mean " << gpuTime.mean << " ms, fence stall max " << fenceStallTime.max
+		<< " ms" << std::endl;
+
+	const bool bWritten = frameBenchmark.WriteResults(resultsFilename, pathFilename, width, height);
+
+	frameBenchmark.Destroy();
+	DestroyManagers();
+	headlessContext.Destroy();
+
+	return(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  CreateWindowRenderer()
+ *
+ *  This function is used for opening the display window and
+ *  preparing the renderer and the 3D scene in it.
+ ***********************************************************/
+bool CreateWindowRenderer()
 {
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
-		return(EXIT_FAILURE);
+		return(false);
 	}
 
-	// try to create a new shader manager object
-	g_ShaderManager = new ShaderManager();
-	// try to create a new view manager object
-	g_ViewManager = new ViewManager(
-		g_ShaderManager);
+	// create the shader, uniform cache and view manager objects
+	CreateManagers();
 
 	// try to create the main display window
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
@@ -72,45 +896,164 @@ int main(int argc, char* argv[])
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
 	{
-		return(EXIT_FAILURE);
+		return(false);
+	}
+
+	// load the shaders and prepare the 3D scene
+	PrepareRenderer();
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateHeadlessRenderer()
+ *
+ *  This function is used for creating a headless context
+ *  with an offscreen framebuffer of the passed in size, and
+ *  preparing the renderer and the 3D scene in it.  The clock
+ *  moves by a fixed step every frame.
+ ***********************************************************/
+bool CreateHeadlessRenderer(HeadlessContext& headlessContext, int width, int height)
+{
+	g_bHeadless = true;
+
+	if (headlessContext.CreateContext() == false)
+	{
+		return(false);
+	}
+
+	CreateManagers();
+
+	if ((InitializeGLEW() == false) ||
+		(headlessContext.CreateFramebuffer(width, height) == false))
+	{
+		DestroyManagers();
+		return(false);
 	}
 
+	g_ViewManager->CreateOffscreenView(width, height);
+	g_ViewManager->SetFixedFrameTime(g_FixedFrameTime);
+	PrepareRenderer();
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateManagers()
+ *
+ *  This function is used for creating the shader, uniform
+ *  cache, state cache, stream ring and view manager objects.
+ ***********************************************************/
+void CreateManagers()
+{
+	// try to create a new shader manager object
+	g_ShaderManager = new ShaderManager();
+	// try to create a new uniform cache object
+	g_UniformCache = new UniformCache();
+	// try to create a new state cache object
+	g_StateCache = new GLStateCache();
+	// try to create a new stream ring object
+	g_StreamRing = new StreamRing(g_StateCache);
+	// try to create a new view manager object
+	g_ViewManager = new ViewManager(
+		g_ShaderManager,
+		g_UniformCache,
+		g_StateCache,
+		g_StreamRing);
+}
+
+/***********************************************************
+ *  PrepareRenderer()
+ *
+ *  This function is used for loading the shaders and
+ *  preparing the 3D scene, once the context is current.
+ ***********************************************************/
+void PrepareRenderer()
+{
+	PROFILE_ZONE("PrepareRenderer");
+
 	// load the shader code from the external GLSL files
 	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+		"shaders/vertexShader.glsl",
+		"shaders/fragmentShader.glsl");
 	g_ShaderManager->use();
 
+	// look up the uniform locations once for the linked program
+	GLint programID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	g_UniformCache->ResolveLocations(programID);
+	// map the ring the data of each frame is written into -
+	// without buffer storage the data is uploaded instead
+	if (g_StreamRing->Create(g_StreamFrameBytes) == false)
+	{
+		std::cout << "INFO: Persistent buffer mapping is not available, the frame data is uploaded" << std::endl;
+	}
+	// create the uniform buffers for the per-frame camera block
+	g_ViewManager->CreateCameraBuffers();
+
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_UniformCache, g_StateCache, g_StreamRing);
+	// a change to the scene wakes the render thread of the on
+	// demand mode, which otherwise sleeps while the camera
+	// stays still
+	g_SceneManager->SetSceneChangeCallback(WakeRenderThread);
 	g_SceneManager->PrepareScene();
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
-	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+	// the shader and the shapes were set up with binds made
+	// outside of the cache, so it cannot trust what it knows
+	g_StateCache->Invalidate();
+	g_StateCache->UseProgram(programID);
+}
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+/***********************************************************
+ *  RenderFrame()
+ *
+ *  This function is used for drawing one frame of the 3D
+ *  scene into the bound framebuffer, seen from the passed
+ *  in camera state.
+ ***********************************************************/
+void RenderFrame(const ViewManager::VIEW_SNAPSHOT& snapshot)
+{
+	PROFILE_ZONE("RenderFrame");
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+	// start counting the uniform uploads and state changes
+	// for this frame
+	g_UniformCache->BeginFrame();
+	g_StateCache->BeginFrame();
+	// and move to the stream ring region the GPU is done with
+	g_StreamRing->BeginFrame();
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+	// Enable z-depth
+	g_StateCache->Enable(GL_DEPTH_TEST);
 
+	// Clear the frame and z buffers
+	g_StateCache->SetClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// convert from 3D object space to 2D view
+	g_ViewManager->PrepareSceneView(snapshot);
 
-		// query the latest GLFW events
-		glfwPollEvents();
-	}
+	// refresh the 3D scene, sorting the draws by their
+	// distance from the current camera position
+	g_SceneManager->SetViewPosition(g_ViewManager->GetViewPosition());
+	// and asking for the textures at their screen size
+	g_SceneManager->SetViewProjectionScale(g_ViewManager->GetProjectionScale(), g_ViewManager->IsPerspective());
+	// and leaving out the objects outside of the view
+	g_SceneManager->SetViewProjection(g_ViewManager->GetViewProjection());
+	g_SceneManager->RenderScene();
 
-	// clear the allocated manager objects from memory
+	// the region is written again once these draws are done
+	g_StreamRing->EndFrame();
+}
+
+/***********************************************************
+ *  DestroyManagers()
+ *
+ *  This function is used for clearing the allocated manager
+ *  objects from memory.
+ ***********************************************************/
+void DestroyManagers()
+{
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -121,14 +1064,45 @@ int main(int argc, char* argv[])
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_UniformCache)
+	{
+		delete g_UniformCache;
+		g_UniformCache = NULL;
+	}
+	if (NULL != g_StreamRing)
+	{
+		delete g_StreamRing;
+		g_StreamRing = NULL;
+	}
+	if (NULL != g_StateCache)
+	{
+		delete g_StateCache;
+		g_StateCache = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+/***********************************************************
+ *  WriteProfileTrace()
+ *
+ *  This function is used for writing the recorded profiling
+ *  zones to the Chrome trace file when the application
+ *  exits.  The trace opens in Perfetto or chrome://tracing.
+ ***********************************************************/
+void WriteProfileTrace()
+{
+	if (Profiler::WriteChromeTrace(g_TraceFilename))
+	{
+		std::cout << "INFO: Wrote the profiling zones to " << g_TraceFilename << std::endl;
+	}
+	else
+	{
+		std::cerr << "Could not write the profiling zones to " << g_TraceFilename << std::endl;
+	}
 }
 
 /***********************************************************
@@ -171,6 +1145,15 @@ bool InitializeGLEW()
 
 	// try to initialize the GLEW library
 	GLEWInitResult = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// a headless context has no GLX display, which GLEW only
+	// needs for the GLX extensions - the OpenGL functions are
+	// loaded before it finds that out
+	if (g_bHeadless && (GLEW_ERROR_NO_GLX_DISPLAY == GLEWInitResult))
+	{
+		GLEWInitResult = GLEW_OK;
+	}
+#endif
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
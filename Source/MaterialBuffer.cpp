@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialbuffer.cpp
+// ============
+// table of the object materials in a std140 uniform buffer object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MaterialBuffer.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_MaterialBlockName = "MaterialBlock";
+}
+
+/***********************************************************
+ *  MaterialBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MaterialBuffer::MaterialBuffer(GLStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	// value initialization zeroes every material and the padding
+	m_materialBlock = MATERIAL_BLOCK();
+	m_bufferID = 0;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  ~MaterialBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MaterialBuffer::~MaterialBuffer()
+{
+	DestroyMaterialBuffer();
+}
+
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method is used for creating the uniform buffer that
+ *  holds the material block and connecting it to the block
+ *  declared in the passed in shader program.
+ ***********************************************************/
+bool MaterialBuffer::CreateMaterialBuffer(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, g_MaterialBlockName);
+	if (GL_INVALID_INDEX == blockIndex)
+	{
+		std::cout << "Uniform block not found in shader program:" << g_MaterialBlockName << std::endl;
+		return false;
+	}
+
+	// catch a MAX_MATERIALS mismatch between C++ and GLSL
+	GLint blockSize = 0;
+	glGetActiveUniformBlockiv(programID, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+	if (blockSize != (GLint)sizeof(MATERIAL_BLOCK))
+	{
+		std::cout << "Material block size mismatch - shader:" << blockSize << ", application:" << sizeof(MATERIAL_BLOCK) << std::endl;
+		return false;
+	}
+
+	glUniformBlockBinding(programID, blockIndex, MATERIAL_BLOCK_BINDING);
+
+	glGenBuffers(1, &m_bufferID);
+	m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MATERIAL_BLOCK), &m_materialBlock, GL_STATIC_DRAW);
+	m_pStateCache->BindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_bufferID);
+
+	// the buffer was just filled with the current table
+	m_bDirty = false;
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyMaterialBuffer()
+ *
+ *  This method is used for freeing the uniform buffer.
+ ***********************************************************/
+void MaterialBuffer::DestroyMaterialBuffer()
+{
+	if (0 != m_bufferID)
+	{
+		m_pStateCache->DeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+}
+
+/***********************************************************
+ *  SetMaterial()
+ *
+ *  This method is used for setting one entry of the table.
+ ***********************************************************/
+void MaterialBuffer::SetMaterial(
+	int index,
+	glm::vec3 diffuseColor,
+	glm::vec3 specularColor,
+	float shininess)
+{
+	if ((index < 0) || (index >= MAX_MATERIALS))
+	{
+		std::cout << "Material index is outside of the material block:" << index << std::endl;
+		return;
+	}
+
+	m_materialBlock.materials[index].diffuseColor = diffuseColor;
+	m_materialBlock.materials[index].specularColor = specularColor;
+	m_materialBlock.materials[index].shininess = shininess;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  UploadMaterials()
+ *
+ *  This method is used for sending the table to the uniform
+ *  buffer.  The materials rarely change after the scene is
+ *  prepared, so the whole table is sent when any changed.
+ ***********************************************************/
+void MaterialBuffer::UploadMaterials()
+{
+	if ((0 == m_bufferID) || (false == m_bDirty))
+	{
+		return;
+	}
+
+	m_pStateCache->BindBuffer(GL_UNIFORM_BUFFER, m_bufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MATERIAL_BLOCK), &m_materialBlock);
+
+	m_bDirty = false;
+}
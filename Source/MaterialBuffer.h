@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// materialbuffer.h
+// ============
+// table of the object materials in a std140 uniform buffer object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/***********************************************************
+ *  MaterialBuffer
+ *
+ *  This class keeps every defined object material in the
+ *  "MaterialBlock" uniform block, so that draws which pick
+ *  their material per instance can index the table instead
+ *  of having the material uniforms set before each draw.
+ ***********************************************************/
+class MaterialBuffer
+{
+public:
+	// constructor
+	MaterialBuffer(GLStateCache* pStateCache);
+	// destructor
+	~MaterialBuffer();
+
+	// highest number of materials in the uniform block -
+	// must match MAX_MATERIALS in fragmentShader.glsl
+	static const int MAX_MATERIALS = 64;
+	// uniform buffer binding point used for the material block
+	static const GLuint MATERIAL_BLOCK_BINDING = 2;
+
+	// std140 layout of one material - the shininess fills the
+	// slot after the diffuse color
+	struct GPU_MATERIAL
+	{
+		glm::vec3 diffuseColor;
+		float shininess;
+		glm::vec3 specularColor;
+		float pad0;
+	};
+
+	struct MATERIAL_BLOCK
+	{
+		GPU_MATERIAL materials[MAX_MATERIALS];
+	};
+
+	// create the uniform buffer and attach it to the program
+	bool CreateMaterialBuffer(GLuint programID);
+	// free the uniform buffer
+	void DestroyMaterialBuffer();
+
+	// set the material at the passed in index
+	void SetMaterial(
+		int index,
+		glm::vec3 diffuseColor,
+		glm::vec3 specularColor,
+		float shininess);
+
+	// send the material table to the GPU when it has changed
+	void UploadMaterials();
+
+private:
+	// CPU copy of the uniform block
+	MATERIAL_BLOCK m_materialBlock;
+	// uniform buffer object holding the material block
+	GLuint m_bufferID;
+	// cache the buffer binds go through
+	GLStateCache* m_pStateCache;
+	// set when the table changed since the last upload
+	bool m_bDirty;
+};
+
+// the C++ layout must match the std140 layout of the shader block
+static_assert(sizeof(MaterialBuffer::GPU_MATERIAL) == 32, "GPU_MATERIAL does not match std140");
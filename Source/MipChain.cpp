@@ -0,0 +1,395 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.cpp
+// ============
+// build the mipmap levels of a texture layer on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MIPCHAIN_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIPCHAIN_NEON
+#include <arm_neon.h>
+#endif
+
+const float MipChain::DEFAULT_ALPHA_REFERENCE = 0.5f;
+
+// declaration of global variables
+namespace
+{
+	// entries of the linear to sRGB table - enough that
+	// neighboring entries are less than one sRGB step apart
+	const int g_LinearTableSize = 4096;
+	// steps of the search for the alpha scale of a level
+	const int g_CoverageSearchSteps = 12;
+
+	// four channels of a pixel, or one channel of four pixels,
+	// in linear color space
+#if defined(MIPCHAIN_SSE2)
+	typedef __m128 VECTOR4;
+
+	inline VECTOR4 Load4(const float* p) { return(_mm_loadu_ps(p)); }
+	inline void Store4(float* p, VECTOR4 v) { _mm_storeu_ps(p, v); }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { return(_mm_add_ps(a, b)); }
+	inline VECTOR4 Scale4(VECTOR4 v, float s) { return(_mm_mul_ps(v, _mm_set1_ps(s))); }
+	inline VECTOR4 Clamp4(VECTOR4 v) { return(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f))); }
+	inline void Round4(VECTOR4 v, int32_t* p) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)))); }
+	inline VECTOR4 AddPairs4(VECTOR4 a, VECTOR4 b) { return(_mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)))); }
+	inline void Transpose4(VECTOR4& a, VECTOR4& b, VECTOR4& c, VECTOR4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#elif defined(MIPCHAIN_NEON)
+	typedef float32x4_t VECTOR4;
+
+	inline VECTOR4 Load4(const float* p) { return(vld1q_f32(p)); }
+	inline void Store4(float* p, VECTOR4 v) { vst1q_f32(p, v); }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { return(vaddq_f32(a, b)); }
+	inline VECTOR4 Scale4(VECTOR4 v, float s) { return(vmulq_n_f32(v, s)); }
+	inline VECTOR4 Clamp4(VECTOR4 v) { return(vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f))); }
+	inline void Round4(VECTOR4 v, int32_t* p) { vst1q_s32(p, vcvtq_s32_f32(vaddq_f32(v, vdupq_n_f32(0.5f)))); }
+	inline VECTOR4 AddPairs4(VECTOR4 a, VECTOR4 b) { return(vcombine_f32(vpadd_f32(vget_low_f32(a), vget_high_f32(a)), vpadd_f32(vget_low_f32(b), vget_high_f32(b)))); }
+	inline void Transpose4(VECTOR4& a, VECTOR4& b, VECTOR4& c, VECTOR4& d)
+	{
+		const float32x4x2_t ab = vtrnq_f32(a, b);
+		const float32x4x2_t cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+#else
+	struct VECTOR4
+	{
+		float v[4];
+	};
+
+	inline VECTOR4 Load4(const float* p) { VECTOR4 o = { { p[0], p[1], p[2], p[3] } }; return(o); }
+	inline void Store4(float* p, VECTOR4 v) { for (int i = 0; i < 4; i++) { p[i] = v.v[i]; } }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { for (int i = 0; i < 4; i++) { a.v[i] += b.v[i]; } return(a); }
+	inline VECTOR4 Scale4(VECTOR4 v, float s) { for (int i = 0; i < 4; i++) { v.v[i] *= s; } return(v); }
+	inline VECTOR4 Clamp4(VECTOR4 v) { for (int i = 0; i < 4; i++) { v.v[i] = std::min(std::max(v.v[i], 0.0f), 1.0f); } return(v); }
+	inline void Round4(VECTOR4 v, int32_t* p) { for (int i = 0; i < 4; i++) { p[i] = (int32_t)(v.v[i] + 0.5f); } }
+	inline VECTOR4 AddPairs4(VECTOR4 a, VECTOR4 b) { VECTOR4 o = { { a.v[0] + a.v[1], a.v[2] + a.v[3], b.v[0] + b.v[1], b.v[2] + b.v[3] } }; return(o); }
+	inline void Transpose4(VECTOR4& a, VECTOR4& b, VECTOR4& c, VECTOR4& d)
+	{
+		VECTOR4* rows[4] = { &a, &b, &c, &d };
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = i + 1; j < 4; j++)
+			{
+				std::swap(rows[i]->v[j], rows[j]->v[i]);
+			}
+		}
+	}
+#endif
+
+	// color space conversion tables
+	struct COLOR_TABLES
+	{
+		float toLinear[256];
+		unsigned char toSRGB[g_LinearTableSize];
+	};
+
+	/***********************************************************
+	 *  GetColorTables()
+	 *
+	 *  This function is used for getting the sRGB conversion
+	 *  tables, which are filled on first use.
+	 ***********************************************************/
+	const COLOR_TABLES& GetColorTables()
+	{
+		struct TABLES_BUILDER
+		{
+			COLOR_TABLES tables;
+
+			TABLES_BUILDER()
+			{
+				for (int i = 0; i < 256; i++)
+				{
+					const float c = (float)i / 255.0f;
+					tables.toLinear[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				for (int i = 0; i < g_LinearTableSize; i++)
+				{
+					const float l = (float)i / (float)(g_LinearTableSize - 1);
+					const float c = (l <= 0.0031308f) ? (l * 12.92f) : (1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f);
+					tables.toSRGB[i] = (unsigned char)std::min(255.0f, c * 255.0f + 0.5f);
+				}
+			}
+		};
+		// built once, even when several workers get here at once
+		static const TABLES_BUILDER builder;
+
+		return(builder.tables);
+	}
+
+	/***********************************************************
+	 *  LinearizeRow()
+	 *
+	 *  This function is used for converting a row of 8 bit
+	 *  pixels into linear color space, with an opaque alpha for
+	 *  RGB, and splitting it into one plane per channel, so
+	 *  the averages can work on four pixels at a time.
+	 ***********************************************************/
+	void LinearizeRow(const unsigned char* pRow, int width, int channels, const float* toLinear, float* pPlanes)
+	{
+		float* pRed = pPlanes;
+		float* pGreen = pPlanes + width;
+		float* pBlue = pPlanes + width * 2;
+		float* pAlpha = pPlanes + width * 3;
+
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* p = pRow + (size_t)x * channels;
+			pRed[x] = toLinear[p[0]];
+			pGreen[x] = toLinear[p[1]];
+			pBlue[x] = toLinear[p[2]];
+			pAlpha[x] = (channels == 4) ? ((float)p[3] * (1.0f / 255.0f)) : 1.0f;
+		}
+	}
+
+	/***********************************************************
+	 *  HalvePixels()
+	 *
+	 *  This function is used for averaging each 2x2 square of
+	 *  an 8 bit image into a linear RGBA level of half size.
+	 *  The two source rows of each output row are made linear
+	 *  once, and four output pixels are then averaged per step,
+	 *  one channel per vector, and turned back into RGBA.
+	 ***********************************************************/
+	void HalvePixels(const unsigned char* pSource, int sourceSize, int channels, float* pOut)
+	{
+		const float* toLinear = GetColorTables().toLinear;
+		const int size = std::max(1, sourceSize / 2);
+
+		// the channel planes of the two source rows
+		std::vector<float> planes((size_t)sourceSize * 8);
+		float* pPlanes0 = planes.data();
+		float* pPlanes1 = planes.data() + (size_t)sourceSize * 4;
+
+		for (int y = 0; y < size; y++)
+		{
+			const unsigned char* pRow0 = pSource + (size_t)std::min(y * 2, sourceSize - 1) * sourceSize * channels;
+			const unsigned char* pRow1 = pSource + (size_t)std::min(y * 2 + 1, sourceSize - 1) * sourceSize * channels;
+			LinearizeRow(pRow0, sourceSize, channels, toLinear, pPlanes0);
+			LinearizeRow(pRow1, sourceSize, channels, toLinear, pPlanes1);
+
+			float* pOutRow = pOut + (size_t)y * size * 4;
+			int x = 0;
+			for (; (x + 4 <= size) && (x * 2 + 8 <= sourceSize); x += 4)
+			{
+				VECTOR4 channel[4];
+				for (int c = 0; c < 4; c++)
+				{
+					const float* p0 = pPlanes0 + (size_t)c * sourceSize + x * 2;
+					const float* p1 = pPlanes1 + (size_t)c * sourceSize + x * 2;
+					const VECTOR4 left = Add4(Load4(p0), Load4(p1));
+					const VECTOR4 right = Add4(Load4(p0 + 4), Load4(p1 + 4));
+					channel[c] = Scale4(AddPairs4(left, right), 0.25f);
+				}
+
+				Transpose4(channel[0], channel[1], channel[2], channel[3]);
+				for (int i = 0; i < 4; i++)
+				{
+					Store4(pOutRow + (size_t)(x + i) * 4, channel[i]);
+				}
+			}
+
+			// rows narrower than four output pixels
+			for (; x < size; x++)
+			{
+				const int x0 = std::min(x * 2, sourceSize - 1);
+				const int x1 = std::min(x * 2 + 1, sourceSize - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					const float* p0 = pPlanes0 + (size_t)c * sourceSize;
+					const float* p1 = pPlanes1 + (size_t)c * sourceSize;
+					pOutRow[x * 4 + c] = (p0[x0] + p0[x1] + p1[x0] + p1[x1]) * 0.25f;
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  HalveLinear()
+	 *
+	 *  This function is used for averaging each 2x2 square of
+	 *  a linear RGBA level into the level of half its size.
+	 ***********************************************************/
+	void HalveLinear(const float* pSource, int sourceSize, float* pOut)
+	{
+		const int size = std::max(1, sourceSize / 2);
+
+		for (int y = 0; y < size; y++)
+		{
+			const float* pRow0 = pSource + (size_t)std::min(y * 2, sourceSize - 1) * sourceSize * 4;
+			const float* pRow1 = pSource + (size_t)std::min(y * 2 + 1, sourceSize - 1) * sourceSize * 4;
+			for (int x = 0; x < size; x++)
+			{
+				const size_t x0 = (size_t)std::min(x * 2, sourceSize - 1) * 4;
+				const size_t x1 = (size_t)std::min(x * 2 + 1, sourceSize - 1) * 4;
+
+				VECTOR4 sum = Add4(Load4(pRow0 + x0), Load4(pRow0 + x1));
+				sum = Add4(sum, Add4(Load4(pRow1 + x0), Load4(pRow1 + x1)));
+				Store4(pOut + ((size_t)y * size + x) * 4, Scale4(sum, 0.25f));
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  GetLinearCoverage()
+	 *
+	 *  This function is used for getting the part of a linear
+	 *  RGBA level whose alpha, times the passed in scale, is
+	 *  above the cutoff.
+	 ***********************************************************/
+	float GetLinearCoverage(const float* pLevel, int size, float alphaScale, float alphaReference)
+	{
+		const size_t pixelCount = (size_t)size * size;
+		size_t covered = 0;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			covered += (pLevel[i * 4 + 3] * alphaScale > alphaReference) ? 1 : 0;
+		}
+		return((float)covered / (float)pixelCount);
+	}
+
+	/***********************************************************
+	 *  FindAlphaScale()
+	 *
+	 *  This function is used for searching the alpha scale that
+	 *  gives a linear RGBA level the passed in coverage.
+	 ***********************************************************/
+	float FindAlphaScale(const float* pLevel, int size, float coverage, float alphaReference)
+	{
+		float low = 0.0f;
+		float high = 4.0f;
+		for (int step = 0; step < g_CoverageSearchSteps; step++)
+		{
+			const float middle = (low + high) * 0.5f;
+			if (GetLinearCoverage(pLevel, size, middle, alphaReference) < coverage)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		return((low + high) * 0.5f);
+	}
+
+	/***********************************************************
+	 *  StorePixels()
+	 *
+	 *  This function is used for converting a linear RGBA level
+	 *  back to 8 bit sRGB pixels with the channels of the image.
+	 ***********************************************************/
+	void StorePixels(const float* pLevel, int size, int channels, float alphaScale, unsigned char* pOut)
+	{
+		const unsigned char* toSRGB = GetColorTables().toSRGB;
+		const size_t pixelCount = (size_t)size * size;
+		int32_t indices[4];
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			const float* pPixel = pLevel + i * 4;
+			Round4(Scale4(Clamp4(Load4(pPixel)), (float)(g_LinearTableSize - 1)), indices);
+
+			unsigned char* pPixelOut = pOut + i * channels;
+			pPixelOut[0] = toSRGB[indices[0]];
+			pPixelOut[1] = toSRGB[indices[1]];
+			pPixelOut[2] = toSRGB[indices[2]];
+			if (channels == 4)
+			{
+				const float alpha = std::min(std::max(pPixel[3] * alphaScale, 0.0f), 1.0f);
+				pPixelOut[3] = (unsigned char)(alpha * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildLevels()
+ *
+ *  This method is used for building the mipmap levels below
+ *  an 8 bit sRGB image.  The levels are averaged from each
+ *  other in linear RGBA, so the rounding to 8 bits happens
+ *  once per level instead of adding up down the chain.
+ ***********************************************************/
+void MipChain::BuildLevels(
+	const unsigned char* pPixels,
+	int size,
+	int channels,
+	bool bKeepAlphaCoverage,
+	std::vector<MIP_LEVEL>& levels)
+{
+	levels.clear();
+	if ((NULL == pPixels) || (size <= 1))
+	{
+		return;
+	}
+
+	const bool bCoverage = bKeepAlphaCoverage && (channels == 4);
+	const float coverage = bCoverage ? GetAlphaCoverage(pPixels, size, DEFAULT_ALPHA_REFERENCE) : 0.0f;
+
+	// linear values of the level above and of the new level
+	std::vector<float> sourceLevel;
+	std::vector<float> level;
+
+	int levelSize = size;
+	while (levelSize > 1)
+	{
+		const int nextSize = levelSize / 2;
+		level.resize((size_t)nextSize * nextSize * 4);
+		if (sourceLevel.empty())
+		{
+			HalvePixels(pPixels, levelSize, channels, level.data());
+		}
+		else
+		{
+			HalveLinear(sourceLevel.data(), levelSize, level.data());
+		}
+
+		float alphaScale = 1.0f;
+		if (bCoverage)
+		{
+			alphaScale = FindAlphaScale(level.data(), nextSize, coverage, DEFAULT_ALPHA_REFERENCE);
+		}
+
+		MIP_LEVEL mipLevel;
+		mipLevel.size = nextSize;
+		levels.push_back(mipLevel);
+		levels.back().pixels.resize((size_t)nextSize * nextSize * channels);
+		StorePixels(level.data(), nextSize, channels, alphaScale, levels.back().pixels.data());
+
+		// the next level averages the unscaled alpha
+		sourceLevel.swap(level);
+		levelSize = nextSize;
+	}
+}
+
+/***********************************************************
+ *  GetAlphaCoverage()
+ *
+ *  This method is used for getting the part of an 8 bit RGBA
+ *  image whose alpha is above the passed in cutoff.
+ ***********************************************************/
+float MipChain::GetAlphaCoverage(const unsigned char* pPixels, int size, float alphaReference)
+{
+	const size_t pixelCount = (size_t)size * size;
+	const float reference = alphaReference * 255.0f;
+	size_t covered = 0;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		covered += ((float)pPixels[i * 4 + 3] > reference) ? 1 : 0;
+	}
+	return((float)covered / (float)pixelCount);
+}
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.h
+// ============
+// build the mipmap levels of a texture layer on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+/***********************************************************
+ *  MipChain
+ *
+ *  This class builds every mipmap level below a square power
+ *  of two image, down to 1x1, for uploading as they are or
+ *  for compressing into a texture cache.
+ *
+ *  The images hold sRGB colors, so each 2x2 average is taken
+ *  in linear color space and converted back - averaging the
+ *  sRGB values directly darkens every level.  Alpha is not
+ *  gamma encoded and is averaged as it is, or, for images
+ *  whose alpha is compared against a cutoff, scaled so that
+ *  each level covers as many pixels as the full image.
+ *
+ *  The averages are computed with SSE2 or NEON where the
+ *  compiler targets them, and with plain C++ otherwise.  The
+ *  first level works on four pixels at a time, one channel
+ *  per vector, from rows made linear as a whole, and the
+ *  levels below it, which are linear already, on the four
+ *  channels of a pixel at a time.  The class makes no
+ *  OpenGL calls, so it can be used on worker threads.
+ ***********************************************************/
+class MipChain
+{
+public:
+	struct MIP_LEVEL
+	{
+		int size;
+		// size x size pixels with the channels of the image
+		std::vector<unsigned char> pixels;
+	};
+
+	// alpha cutoff used for the coverage of a level
+	static const float DEFAULT_ALPHA_REFERENCE;
+
+	// build levels 1 and down of an image - levels[0] is the
+	// half size level, and the last one is 1x1
+	static void BuildLevels(
+		const unsigned char* pPixels,
+		int size,
+		int channels,
+		bool bKeepAlphaCoverage,
+		std::vector<MIP_LEVEL>& levels);
+
+	// get the part of the pixels whose alpha is above the cutoff
+	static float GetAlphaCoverage(const unsigned char* pPixels, int size, float alphaReference);
+};
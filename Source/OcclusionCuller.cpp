@@ -0,0 +1,637 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ============
+// hide objects behind large occluders with a low resolution CPU depth buffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSIONCULLER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define OCCLUSIONCULLER_NEON
+#include <arm_neon.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// bands of the depth buffer
+	const int g_BandCount = OcclusionCuller::BUFFER_HEIGHT / OcclusionCuller::BAND_HEIGHT;
+	// smallest clip space w of a vertex in front of the camera
+	const float g_MinClipW = 1.0e-5f;
+	// pixels the screen rectangle of a tested object is grown
+	// by on each side, so the rounding of its corners can never
+	// move it off a pixel it touches
+	const float g_ObjectRectMargin = 0.5f;
+
+	// four pixels of a depth buffer row, and the pixels of
+	// them that pass a test
+#if defined(OCCLUSIONCULLER_SSE2)
+	typedef __m128 VECTOR4;
+	typedef __m128 MASK4;
+
+	inline VECTOR4 Set4(float a, float b, float c, float d) { return(_mm_set_ps(d, c, b, a)); }
+	inline VECTOR4 Splat4(float s) { return(_mm_set1_ps(s)); }
+	inline VECTOR4 Load4(const float* p) { return(_mm_loadu_ps(p)); }
+	inline void Store4(float* p, VECTOR4 v) { _mm_storeu_ps(p, v); }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { return(_mm_add_ps(a, b)); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { return(_mm_add_ps(_mm_mul_ps(a, b), c)); }
+	inline VECTOR4 Min4(VECTOR4 a, VECTOR4 b) { return(_mm_min_ps(a, b)); }
+	inline MASK4 GreaterEqualMask4(VECTOR4 a, VECTOR4 b) { return(_mm_cmpge_ps(a, b)); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(_mm_and_ps(a, b)); }
+	inline VECTOR4 Select4(MASK4 m, VECTOR4 a, VECTOR4 b) { return(_mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))); }
+	inline bool AnyMask4(MASK4 m) { return(0 != _mm_movemask_ps(m)); }
+#elif defined(OCCLUSIONCULLER_NEON)
+	typedef float32x4_t VECTOR4;
+	typedef uint32x4_t MASK4;
+
+	inline VECTOR4 Set4(float a, float b, float c, float d) { const float v[4] = { a, b, c, d }; return(vld1q_f32(v)); }
+	inline VECTOR4 Splat4(float s) { return(vdupq_n_f32(s)); }
+	inline VECTOR4 Load4(const float* p) { return(vld1q_f32(p)); }
+	inline void Store4(float* p, VECTOR4 v) { vst1q_f32(p, v); }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { return(vaddq_f32(a, b)); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { return(vmlaq_f32(c, a, b)); }
+	inline VECTOR4 Min4(VECTOR4 a, VECTOR4 b) { return(vminq_f32(a, b)); }
+	inline MASK4 GreaterEqualMask4(VECTOR4 a, VECTOR4 b) { return(vcgeq_f32(a, b)); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(vandq_u32(a, b)); }
+	inline VECTOR4 Select4(MASK4 m, VECTOR4 a, VECTOR4 b) { return(vbslq_f32(m, a, b)); }
+	inline bool AnyMask4(MASK4 m) { return(0 != (vgetq_lane_u32(m, 0) | vgetq_lane_u32(m, 1) | vgetq_lane_u32(m, 2) | vgetq_lane_u32(m, 3))); }
+#else
+	struct VECTOR4
+	{
+		float v[4];
+	};
+	typedef int MASK4;
+
+	inline VECTOR4 Set4(float a, float b, float c, float d) { VECTOR4 o = { { a, b, c, d } }; return(o); }
+	inline VECTOR4 Splat4(float s) { VECTOR4 o = { { s, s, s, s } }; return(o); }
+	inline VECTOR4 Load4(const float* p) { VECTOR4 o = { { p[0], p[1], p[2], p[3] } }; return(o); }
+	inline void Store4(float* p, VECTOR4 v) { for (int i = 0; i < 4; i++) { p[i] = v.v[i]; } }
+	inline VECTOR4 Add4(VECTOR4 a, VECTOR4 b) { for (int i = 0; i < 4; i++) { a.v[i] += b.v[i]; } return(a); }
+	inline VECTOR4 MultiplyAdd4(VECTOR4 a, VECTOR4 b, VECTOR4 c) { for (int i = 0; i < 4; i++) { c.v[i] += a.v[i] * b.v[i]; } return(c); }
+	inline VECTOR4 Min4(VECTOR4 a, VECTOR4 b) { for (int i = 0; i < 4; i++) { a.v[i] = std::min(a.v[i], b.v[i]); } return(a); }
+	inline MASK4 GreaterEqualMask4(VECTOR4 a, VECTOR4 b) { MASK4 m = 0; for (int i = 0; i < 4; i++) { m |= (a.v[i] >= b.v[i]) ? (1 << i) : 0; } return(m); }
+	inline MASK4 AndMask4(MASK4 a, MASK4 b) { return(a & b); }
+	inline VECTOR4 Select4(MASK4 m, VECTOR4 a, VECTOR4 b) { for (int i = 0; i < 4; i++) { b.v[i] = (m & (1 << i)) ? a.v[i] : b.v[i]; } return(b); }
+	inline bool AnyMask4(MASK4 m) { return(0 != m); }
+#endif
+
+	// faces of the unit box as their normal and the two axes
+	// spanning them, with the axes turning counterclockwise
+	// seen from outside - unlike the top and bottom faces of
+	// the ShapeGeometry box, which are drawn without culling
+	const float g_BoxFaces[6][3][3] =
+	{
+		{ { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } }
+	};
+
+	// a vertex in depth buffer pixels, with its depth
+	struct SCREEN_VERTEX
+	{
+		float x;
+		float y;
+		float depth;
+	};
+
+	/***********************************************************
+	 *  GetSeconds()
+	 *
+	 *  This function is used for getting a steady time stamp.
+	 ***********************************************************/
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  ProjectVertex()
+	 *
+	 *  This function is used for moving a clip space position
+	 *  into depth buffer pixels, with y pointing up as in the
+	 *  clip space, and the depth from 0 at the near plane to 1
+	 *  at the far plane.  Returns false for a position that is
+	 *  in front of the near plane.
+	 ***********************************************************/
+	bool ProjectVertex(const glm::vec4& clip, SCREEN_VERTEX& vertex)
+	{
+		if ((clip.w < g_MinClipW) || (clip.z < -clip.w))
+		{
+			return(false);
+		}
+
+		const float inverseW = 1.0f / clip.w;
+		vertex.x = (clip.x * inverseW * 0.5f + 0.5f) * (float)OcclusionCuller::BUFFER_WIDTH;
+		vertex.y = (clip.y * inverseW * 0.5f + 0.5f) * (float)OcclusionCuller::BUFFER_HEIGHT;
+		vertex.depth = clip.z * inverseW * 0.5f + 0.5f;
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller()
+{
+	m_viewProjection = glm::mat4(1.0f);
+	m_depthBuffer.resize(BUFFER_WIDTH * BUFFER_HEIGHT, 1.0f);
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+	m_startSeconds = 0.0;
+	m_workSerial = 0;
+	m_bQuit = false;
+	m_nextBand = g_BandCount;
+	m_finishedBands = g_BandCount;
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	Finish();
+
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_bQuit = true;
+	}
+	m_workCondition.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for setting the number of objects,
+ *  which are all visible until a frame hides them.
+ ***********************************************************/
+void OcclusionCuller::Resize(int objectCount)
+{
+	Finish();
+	m_occludedFlags.assign(std::max(0, objectCount), 0);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame - every object
+ *  is visible again until the frame is finished.
+ ***********************************************************/
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	Finish();
+
+	m_viewProjection = viewProjection;
+	m_triangles.clear();
+	m_objectRects.clear();
+	std::fill(m_occludedFlags.begin(), m_occludedFlags.end(), 0);
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+}
+
+/***********************************************************
+ *  AddBoxOccluder()
+ *
+ *  This method is used for adding the triangles of a box
+ *  occluder that face the camera.  A world matrix that
+ *  mirrors the box turns its faces inside out, so the facing
+ *  test is flipped for it.  Triangles that cross the near
+ *  plane are left out.
+ ***********************************************************/
+bool OcclusionCuller::AddBoxOccluder(const glm::mat4& worldMatrix)
+{
+	if ((int)m_lastStats.occluderCount >= MAX_OCCLUDERS)
+	{
+		return false;
+	}
+
+	const glm::mat4 modelViewProjection = m_viewProjection * worldMatrix;
+	const float windingSign = (glm::dot(glm::cross(glm::vec3(worldMatrix[0]), glm::vec3(worldMatrix[1])), glm::vec3(worldMatrix[2])) < 0.0f) ? -1.0f : 1.0f;
+
+	for (int face = 0; face < 6; face++)
+	{
+		const glm::vec3 normal(g_BoxFaces[face][0][0], g_BoxFaces[face][0][1], g_BoxFaces[face][0][2]);
+		const glm::vec3 uAxis(g_BoxFaces[face][1][0], g_BoxFaces[face][1][1], g_BoxFaces[face][1][2]);
+		const glm::vec3 vAxis(g_BoxFaces[face][2][0], g_BoxFaces[face][2][1], g_BoxFaces[face][2][2]);
+		const glm::vec3 center = normal * 0.5f;
+		const glm::vec3 corners[4] =
+		{
+			center - uAxis * 0.5f - vAxis * 0.5f,
+			center + uAxis * 0.5f - vAxis * 0.5f,
+			center + uAxis * 0.5f + vAxis * 0.5f,
+			center - uAxis * 0.5f + vAxis * 0.5f
+		};
+
+		SCREEN_VERTEX vertices[4];
+		bool bProjected[4];
+		for (int i = 0; i < 4; i++)
+		{
+			bProjected[i] = ProjectVertex(modelViewProjection * glm::vec4(corners[i], 1.0f), vertices[i]);
+		}
+
+		const int quad[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+		for (int half = 0; half < 2; half++)
+		{
+			const int i0 = quad[half][0];
+			int i1 = quad[half][1];
+			int i2 = quad[half][2];
+			if (!bProjected[i0] || !bProjected[i1] || !bProjected[i2])
+			{
+				continue;
+			}
+
+			float area =
+				(vertices[i1].x - vertices[i0].x) * (vertices[i2].y - vertices[i0].y) -
+				(vertices[i2].x - vertices[i0].x) * (vertices[i1].y - vertices[i0].y);
+			if (area * windingSign <= 0.0f)
+			{
+				continue;
+			}
+			if (area < 0.0f)
+			{
+				std::swap(i1, i2);
+				area = -area;
+			}
+
+			const SCREEN_VERTEX& v0 = vertices[i0];
+			const SCREEN_VERTEX& v1 = vertices[i1];
+			const SCREEN_VERTEX& v2 = vertices[i2];
+
+			// pixels whose centers can be inside the triangle
+			OCCLUDER_TRIANGLE triangle;
+			triangle.minX = std::max(0, (int)std::ceil(std::min(v0.x, std::min(v1.x, v2.x)) - 0.5f));
+			triangle.maxX = std::min(BUFFER_WIDTH - 1, (int)std::floor(std::max(v0.x, std::max(v1.x, v2.x)) - 0.5f));
+			triangle.minY = std::max(0, (int)std::ceil(std::min(v0.y, std::min(v1.y, v2.y)) - 0.5f));
+			triangle.maxY = std::min(BUFFER_HEIGHT - 1, (int)std::floor(std::max(v0.y, std::max(v1.y, v2.y)) - 0.5f));
+			if ((triangle.minX > triangle.maxX) || (triangle.minY > triangle.maxY))
+			{
+				continue;
+			}
+
+			// the edges are moved inward by half a pixel along both
+			// axes, so the test at a pixel center only passes when
+			// the whole pixel is inside the triangle
+			const SCREEN_VERTEX* edgeStart[3] = { &v0, &v1, &v2 };
+			const SCREEN_VERTEX* edgeEnd[3] = { &v1, &v2, &v0 };
+			for (int edge = 0; edge < 3; edge++)
+			{
+				triangle.edgeA[edge] = edgeStart[edge]->y - edgeEnd[edge]->y;
+				triangle.edgeB[edge] = edgeEnd[edge]->x - edgeStart[edge]->x;
+				triangle.edgeC[edge] = edgeStart[edge]->x * edgeEnd[edge]->y - edgeEnd[edge]->x * edgeStart[edge]->y -
+					0.5f * (std::fabs(triangle.edgeA[edge]) + std::fabs(triangle.edgeB[edge]));
+			}
+
+			// and the depth written is the farthest of the pixel
+			// rather than the one at its center
+			triangle.depthA = ((v1.depth - v0.depth) * (v2.y - v0.y) - (v2.depth - v0.depth) * (v1.y - v0.y)) / area;
+			triangle.depthB = ((v2.depth - v0.depth) * (v1.x - v0.x) - (v1.depth - v0.depth) * (v2.x - v0.x)) / area;
+			triangle.depthC = v0.depth - triangle.depthA * v0.x - triangle.depthB * v0.y +
+				0.5f * (std::fabs(triangle.depthA) + std::fabs(triangle.depthB));
+
+			m_triangles.push_back(triangle);
+			m_lastStats.triangleCount++;
+		}
+	}
+
+	m_lastStats.occluderCount++;
+	return true;
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding an object to test, from
+ *  the screen rectangle and nearest depth of the corners of
+ *  its world box.  The rectangle is grown outward to every
+ *  pixel it touches, and a little past them.  An object
+ *  crossing the near plane, or covering no pixel, cannot be
+ *  tested and stays visible.
+ ***********************************************************/
+void OcclusionCuller::AddObject(int object, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	if ((object < 0) || (object >= (int)m_occludedFlags.size()))
+	{
+		return;
+	}
+
+	float minX = (float)BUFFER_WIDTH;
+	float maxX = 0.0f;
+	float minY = (float)BUFFER_HEIGHT;
+	float maxY = 0.0f;
+	float minDepth = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 position(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+
+		SCREEN_VERTEX vertex;
+		if (false == ProjectVertex(m_viewProjection * glm::vec4(position, 1.0f), vertex))
+		{
+			return;
+		}
+		minX = std::min(minX, vertex.x);
+		maxX = std::max(maxX, vertex.x);
+		minY = std::min(minY, vertex.y);
+		maxY = std::max(maxY, vertex.y);
+		minDepth = std::min(minDepth, vertex.depth);
+	}
+
+	OBJECT_RECT rect;
+	rect.object = object;
+	rect.minX = std::max(0, (int)std::floor(minX - g_ObjectRectMargin));
+	rect.maxX = std::min(BUFFER_WIDTH - 1, (int)std::floor(maxX + g_ObjectRectMargin));
+	rect.minY = std::max(0, (int)std::floor(minY - g_ObjectRectMargin));
+	rect.maxY = std::min(BUFFER_HEIGHT - 1, (int)std::floor(maxY + g_ObjectRectMargin));
+	rect.minDepth = std::max(0.0f, minDepth);
+	if ((rect.minX > rect.maxX) || (rect.minY > rect.maxY))
+	{
+		return;
+	}
+
+	m_objectRects.push_back(rect);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for handing the bands of the frame to
+ *  the worker threads.  The workers are created on the first
+ *  frame - one less than the hardware threads, since the
+ *  caller helps in Finish(), and no more than the bands.
+ ***********************************************************/
+void OcclusionCuller::Start()
+{
+	m_startSeconds = GetSeconds();
+	if (m_triangles.empty() || m_objectRects.empty())
+	{
+		return;
+	}
+
+	if (m_workers.empty())
+	{
+		int workerCount = (int)std::thread::hardware_concurrency() - 1;
+		workerCount = std::max(0, std::min(workerCount, g_BandCount - 1));
+		for (int i = 0; i < workerCount; i++)
+		{
+			m_workers.push_back(std::thread(&OcclusionCuller::WorkerLoop, this));
+		}
+	}
+
+	m_bandVisible.assign(g_BandCount * m_objectRects.size(), 0);
+	m_finishedBands = 0;
+	m_nextBand = 0;
+	m_bRunning = true;
+
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_workSerial++;
+	}
+	m_workCondition.notify_all();
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for processing the bands no worker
+ *  has claimed yet, waiting for the others, and marking the
+ *  objects no band found a visible pixel of as hidden.
+ ***********************************************************/
+void OcclusionCuller::Finish()
+{
+	PROFILE_ZONE("OcclusionCuller::Finish");
+
+	if (false == m_bRunning)
+	{
+		return;
+	}
+
+	ProcessBands();
+	{
+		std::unique_lock<std::mutex> lock(m_finishedMutex);
+		while (m_finishedBands < g_BandCount)
+		{
+			m_finishedCondition.wait(lock);
+		}
+	}
+	m_bRunning = false;
+
+	const size_t rectCount = m_objectRects.size();
+	for (size_t i = 0; i < rectCount; i++)
+	{
+		const OBJECT_RECT& rect = m_objectRects[i];
+		bool bVisible = false;
+		for (int band = rect.minY / BAND_HEIGHT; (band <= rect.maxY / BAND_HEIGHT) && !bVisible; band++)
+		{
+			bVisible = (0 != m_bandVisible[band * rectCount + i]);
+		}
+
+		m_occludedFlags[rect.object] = bVisible ? 0 : 1;
+		if (false == bVisible)
+		{
+			m_lastStats.occludedCount++;
+		}
+	}
+
+	m_lastStats.testedCount = (unsigned int)rectCount;
+	m_lastStats.threadCount = (int)m_workers.size() + 1;
+	m_lastStats.cullMilliseconds = (GetSeconds() - m_startSeconds) * 1000.0;
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is used for waiting for each new frame and
+ *  working on its bands, until the culler is destroyed.
+ ***********************************************************/
+void OcclusionCuller::WorkerLoop()
+{
+	Profiler::SetThreadName("Occlusion worker");
+
+	unsigned int seenSerial = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_workMutex);
+			while ((false == m_bQuit) && (m_workSerial == seenSerial))
+			{
+				m_workCondition.wait(lock);
+			}
+			if (m_bQuit)
+			{
+				return;
+			}
+			seenSerial = m_workSerial;
+		}
+
+		ProcessBands();
+	}
+}
+
+/***********************************************************
+ *  ProcessBands()
+ *
+ *  This method is used for claiming bands until every band
+ *  of the frame is claimed.  Each band is rasterized and
+ *  tested by the thread that claimed it, and the thread that
+ *  finishes the last band wakes up Finish().
+ ***********************************************************/
+void OcclusionCuller::ProcessBands()
+{
+	PROFILE_ZONE("OcclusionCuller::ProcessBands");
+
+	while (true)
+	{
+		const int band = m_nextBand++;
+		if (band >= g_BandCount)
+		{
+			return;
+		}
+
+		RasterizeBand(band);
+		TestBand(band);
+
+		if (g_BandCount == ++m_finishedBands)
+		{
+			std::lock_guard<std::mutex> lock(m_finishedMutex);
+			m_finishedCondition.notify_all();
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterizeBand()
+ *
+ *  This method is used for clearing the rows of one band to
+ *  the far depth and filling the occluder triangles into
+ *  them, keeping the nearest depth of each pixel.  The edges
+ *  and depth planes were moved when the triangles were set
+ *  up, so a pixel is only covered when all of it is inside
+ *  the triangle, and gets the farthest depth of the triangle
+ *  over it - a partly covered pixel never hides anything.
+ ***********************************************************/
+void OcclusionCuller::RasterizeBand(int band)
+{
+	const int bandTop = band * BAND_HEIGHT;
+	const int bandBottom = bandTop + BAND_HEIGHT - 1;
+	float* pBand = &m_depthBuffer[bandTop * BUFFER_WIDTH];
+	std::fill(pBand, pBand + BAND_HEIGHT * BUFFER_WIDTH, 1.0f);
+
+	const VECTOR4 laneOffsets = Set4(0.5f, 1.5f, 2.5f, 3.5f);
+	const VECTOR4 zero = Splat4(0.0f);
+
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		const OCCLUDER_TRIANGLE& triangle = m_triangles[i];
+		const int minY = std::max(triangle.minY, bandTop);
+		const int maxY = std::min(triangle.maxY, bandBottom);
+		if (minY > maxY)
+		{
+			continue;
+		}
+
+		const VECTOR4 edgeA0 = Splat4(triangle.edgeA[0]);
+		const VECTOR4 edgeA1 = Splat4(triangle.edgeA[1]);
+		const VECTOR4 edgeA2 = Splat4(triangle.edgeA[2]);
+		const VECTOR4 depthA = Splat4(triangle.depthA);
+		const int startX = triangle.minX & ~3;
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			const float centerY = (float)y + 0.5f;
+			const VECTOR4 rowEdge0 = Splat4(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+			const VECTOR4 rowEdge1 = Splat4(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+			const VECTOR4 rowEdge2 = Splat4(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+			const VECTOR4 rowDepth = Splat4(triangle.depthB * centerY + triangle.depthC);
+			float* pRow = &m_depthBuffer[y * BUFFER_WIDTH];
+
+			for (int x = startX; x <= triangle.maxX; x += 4)
+			{
+				const VECTOR4 centerX = Add4(Splat4((float)x), laneOffsets);
+
+				MASK4 inside = GreaterEqualMask4(MultiplyAdd4(edgeA0, centerX, rowEdge0), zero);
+				inside = AndMask4(inside, GreaterEqualMask4(MultiplyAdd4(edgeA1, centerX, rowEdge1), zero));
+				inside = AndMask4(inside, GreaterEqualMask4(MultiplyAdd4(edgeA2, centerX, rowEdge2), zero));
+				if (false == AnyMask4(inside))
+				{
+					continue;
+				}
+
+				const VECTOR4 depth = MultiplyAdd4(depthA, centerX, rowDepth);
+				const VECTOR4 stored = Load4(pRow + x);
+				Store4(pRow + x, Select4(inside, Min4(stored, depth), stored));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TestBand()
+ *
+ *  This method is used for looking for a visible pixel of
+ *  each object rectangle over one band - a pixel where the
+ *  occluders are not nearer than the nearest point of the
+ *  object.  The search of a rectangle stops at the first
+ *  visible pixel.
+ ***********************************************************/
+void OcclusionCuller::TestBand(int band)
+{
+	const int bandTop = band * BAND_HEIGHT;
+	const int bandBottom = bandTop + BAND_HEIGHT - 1;
+	const size_t rectCount = m_objectRects.size();
+	uint8_t* pVisible = &m_bandVisible[band * rectCount];
+
+	const VECTOR4 laneOffsets = Set4(0.0f, 1.0f, 2.0f, 3.0f);
+
+	for (size_t i = 0; i < rectCount; i++)
+	{
+		const OBJECT_RECT& rect = m_objectRects[i];
+		const int minY = std::max(rect.minY, bandTop);
+		const int maxY = std::min(rect.maxY, bandBottom);
+		if (minY > maxY)
+		{
+			continue;
+		}
+
+		const VECTOR4 objectDepth = Splat4(rect.minDepth);
+		const VECTOR4 rectMinX = Splat4((float)rect.minX);
+		const VECTOR4 rectMaxX = Splat4((float)rect.maxX);
+		const int startX = rect.minX & ~3;
+
+		bool bVisible = false;
+		for (int y = minY; (y <= maxY) && !bVisible; y++)
+		{
+			const float* pRow = &m_depthBuffer[y * BUFFER_WIDTH];
+			for (int x = startX; (x <= rect.maxX) && !bVisible; x += 4)
+			{
+				const VECTOR4 pixelX = Add4(Splat4((float)x), laneOffsets);
+				MASK4 visible = GreaterEqualMask4(Load4(pRow + x), objectDepth);
+				visible = AndMask4(visible, GreaterEqualMask4(pixelX, rectMinX));
+				visible = AndMask4(visible, GreaterEqualMask4(rectMaxX, pixelX));
+				bVisible = AnyMask4(visible);
+			}
+		}
+		pVisible[i] = bVisible ? 1 : 0;
+	}
+}
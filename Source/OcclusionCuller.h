@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// ============
+// hide objects behind large occluders with a low resolution CPU depth buffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class finds the objects that are hidden behind a few
+ *  large occluders.  Each frame, the triangles of the chosen
+ *  occluder boxes are rasterized into a small depth buffer
+ *  on the CPU, and the screen rectangle and nearest depth of
+ *  every other object's world box are tested against it - an
+ *  object whose rectangle is behind the occluders in every
+ *  pixel cannot be seen.
+ *
+ *  The depth buffer is split into bands of BAND_HEIGHT rows.
+ *  A band is rasterized and then has the objects over it
+ *  tested by one thread, so the bands need no locking, and
+ *  an object is hidden when no band found a visible pixel of
+ *  it.  The rasterizer and the tests cover four pixels at a
+ *  time with SSE2 or NEON where the compiler targets them,
+ *  and with plain C++ otherwise.
+ *
+ *  Start() hands the bands to a pool of worker threads and
+ *  returns, so the caller can go on with other work - such
+ *  as the texture uploads - while they run, and Finish()
+ *  helps with the remaining bands and waits for the rest.
+ *
+ *  The test is conservative: an occluder only covers the
+ *  pixels that are wholly inside it, at its farthest depth
+ *  over each of them, and the rectangle of a tested object
+ *  is grown out to every pixel it touches, so an object seen
+ *  through a gap narrower than a buffer pixel stays visible.
+ *  Objects that cross the near plane are always visible, and
+ *  occluder triangles that cross it are left out.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// constructor
+	OcclusionCuller();
+	// destructor
+	~OcclusionCuller();
+
+	// size of the depth buffer - the width is a multiple of
+	// four, and the height a multiple of the band height
+	static const int BUFFER_WIDTH = 256;
+	static const int BUFFER_HEIGHT = 192;
+	static const int BAND_HEIGHT = 16;
+	// most occluders rasterized in one frame
+	static const int MAX_OCCLUDERS = 16;
+
+	struct OCCLUSION_STATS
+	{
+		// occluders and their front facing triangles that were
+		// rasterized
+		unsigned int occluderCount;
+		unsigned int triangleCount;
+		// objects tested against the depth buffer, and how many
+		// of them were hidden
+		unsigned int testedCount;
+		unsigned int occludedCount;
+		// threads that shared the bands, counting the caller
+		int threadCount;
+		// time from Start() until Finish() returned
+		double cullMilliseconds;
+	};
+
+	// set the number of objects, which are all visible
+	void Resize(int objectCount);
+
+	// start a frame with the view projection it is seen with
+	void BeginFrame(const glm::mat4& viewProjection);
+	// add a box occluder - the unit box around the origin
+	// moved by the passed in world matrix
+	bool AddBoxOccluder(const glm::mat4& worldMatrix);
+	// add an object to test, with its world box
+	void AddObject(int object, glm::vec3 boundsMin, glm::vec3 boundsMax);
+	// start rasterizing and testing on the worker threads
+	void Start();
+	// finish the frame and wait until every object is tested
+	void Finish();
+
+	// get whether an object was hidden in the last frame
+	bool IsOccluded(int object) const { return(0 != m_occludedFlags[object]); }
+	// get the occluder and hidden object counts of the last frame
+	OCCLUSION_STATS GetLastStats() const { return(m_lastStats); }
+
+private:
+	// one occluder triangle in depth buffer pixels, with the
+	// edge and depth planes used to fill it
+	struct OCCLUDER_TRIANGLE
+	{
+		// pixel rows and columns the triangle covers
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+		// edge functions, a * x + b * y + c, not negative inside
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		// depth from 0 (near) to 1 (far) as a * x + b * y + c
+		float depthA;
+		float depthB;
+		float depthC;
+	};
+
+	// screen rectangle and nearest depth of a tested object
+	struct OBJECT_RECT
+	{
+		int object;
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+		float minDepth;
+	};
+
+	glm::mat4 m_viewProjection;
+	std::vector<OCCLUDER_TRIANGLE> m_triangles;
+	std::vector<OBJECT_RECT> m_objectRects;
+	// depth buffer, BUFFER_WIDTH floats per row
+	std::vector<float> m_depthBuffer;
+	// for each band, one flag per object rectangle set when
+	// the band found a visible pixel of it
+	std::vector<uint8_t> m_bandVisible;
+	// result of the last frame for each object
+	std::vector<uint8_t> m_occludedFlags;
+	OCCLUSION_STATS m_lastStats;
+	double m_startSeconds;
+
+	// worker threads, which wait for a new frame serial
+	std::vector<std::thread> m_workers;
+	std::mutex m_workMutex;
+	std::condition_variable m_workCondition;
+	unsigned int m_workSerial;
+	bool m_bQuit;
+	// next band to claim and bands finished in this frame
+	std::atomic<int> m_nextBand;
+	std::atomic<int> m_finishedBands;
+	std::mutex m_finishedMutex;
+	std::condition_variable m_finishedCondition;
+	// set between Start() and Finish()
+	bool m_bRunning;
+
+	// wait for frames and work on their bands - run by each worker
+	void WorkerLoop();
+	// claim and process bands until none are left
+	void ProcessBands();
+	// fill the occluder triangles into one band
+	void RasterizeBand(int band);
+	// test the object rectangles over one band
+	void TestBand(int band);
+};
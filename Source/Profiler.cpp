@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.cpp
+// ============
+// scoped CPU timing zones, exported as a Chrome trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Profiler.h"
+
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::s_bRecording(false);
+thread_local Profiler::THREAD_BUFFER* Profiler::s_pThreadBuffer = NULL;
+thread_local const char* Profiler::s_pThreadName = NULL;
+
+// declaration of global variables
+namespace
+{
+	// rings of every thread that recorded a zone - they live
+	// until the program exits, since their threads may still
+	// be writing to them
+	std::mutex g_BufferMutex;
+	std::vector<Profiler::THREAD_BUFFER*> g_ThreadBuffers;
+
+	// timestamp and clock time recording started at, which
+	// the ticks are converted to time from
+	uint64_t g_StartTicks = 0;
+	std::chrono::steady_clock::time_point g_StartTime;
+	bool g_bStarted = false;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting to record zones.  The
+ *  zones recorded before are left out of the next trace.
+ ***********************************************************/
+void Profiler::Start()
+{
+	std::lock_guard<std::mutex> lock(g_BufferMutex);
+	g_StartTime = std::chrono::steady_clock::now();
+	g_StartTicks = GetTimestamp();
+	g_bStarted = true;
+	s_bRecording.store(true, std::memory_order_relaxed);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for stopping the recording.  Zones
+ *  that are open carry on and are not recorded.
+ ***********************************************************/
+void Profiler::Stop()
+{
+	s_bRecording.store(false, std::memory_order_relaxed);
+}
+
+/***********************************************************
+ *  SetThreadName()
+ *
+ *  This method is used for naming the calling thread in the
+ *  trace.  Threads without a name show up by their number.
+ ***********************************************************/
+void Profiler::SetThreadName(const char* name)
+{
+	s_pThreadName = name;
+	if (NULL != s_pThreadBuffer)
+	{
+		std::lock_guard<std::mutex> lock(g_BufferMutex);
+		s_pThreadBuffer->threadName = name;
+	}
+}
+
+/***********************************************************
+ *  CreateThreadBuffer()
+ *
+ *  This method is used for creating the ring of the calling
+ *  thread on its first zone and adding it to the rings the
+ *  trace is written from.
+ ***********************************************************/
+Profiler::THREAD_BUFFER* Profiler::CreateThreadBuffer()
+{
+	THREAD_BUFFER* pBuffer = new THREAD_BUFFER;
+	pBuffer->writeCount.store(0, std::memory_order_relaxed);
+	pBuffer->threadName = s_pThreadName;
+
+	std::lock_guard<std::mutex> lock(g_BufferMutex);
+	pBuffer->threadIndex = (int)g_ThreadBuffers.size() + 1;
+	g_ThreadBuffers.push_back(pBuffer);
+	s_pThreadBuffer = pBuffer;
+
+	return(pBuffer);
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  This method is used for stopping the recording and
+ *  writing the zones recorded since Start() as complete
+ *  events of the Chrome Trace Event format, with a name
+ *  event for each thread.  The ticks are converted to
+ *  microseconds with the rate measured against the steady
+ *  clock over the recording.
+ *
+ *  The threads should be idle while the trace is written -
+ *  a zone that ends meanwhile may overwrite one being read.
+ ***********************************************************/
+bool Profiler::WriteChromeTrace(const char* filename)
+{
+	Stop();
+
+	std::lock_guard<std::mutex> lock(g_BufferMutex);
+	if (false == g_bStarted)
+	{
+		return false;
+	}
+
+	const uint64_t endTicks = GetTimestamp();
+	const double elapsedMicroseconds = std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - g_StartTime).count();
+	if ((endTicks <= g_StartTicks) || (elapsedMicroseconds <= 0.0))
+	{
+		return false;
+	}
+	const double microsecondsPerTick = elapsedMicroseconds / (double)(endTicks - g_StartTicks);
+
+	FILE* file = fopen(filename, "w");
+	if (NULL == file)
+	{
+		std::cout << "Could not write the trace:" << filename << std::endl;
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool bFirstEvent = true;
+	for (size_t i = 0; i < g_ThreadBuffers.size(); i++)
+	{
+		const THREAD_BUFFER* pBuffer = g_ThreadBuffers[i];
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+			bFirstEvent ? "" : ",\n", pBuffer->threadIndex);
+		if (NULL != pBuffer->threadName)
+		{
+			fprintf(file, "%s", pBuffer->threadName);
+		}
+		else
+		{
+			fprintf(file, "Thread %d", pBuffer->threadIndex);
+		}
+		fprintf(file, "\"}}");
+		bFirstEvent = false;
+
+		// only the newest zones are still in the ring
+		const uint64_t writeCount = pBuffer->writeCount.load(std::memory_order_acquire);
+		const uint64_t firstEvent = (writeCount > RING_SIZE) ? (writeCount - RING_SIZE) : 0;
+		for (uint64_t e = firstEvent; e < writeCount; e++)
+		{
+			const ZONE_EVENT& event = pBuffer->events[e & (RING_SIZE - 1)];
+			if ((event.start < g_StartTicks) || (event.end < event.start))
+			{
+				continue;
+			}
+
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, pBuffer->threadIndex,
+				(double)(event.start - g_StartTicks) * microsecondsPerTick,
+				(double)(event.end - event.start) * microsecondsPerTick);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	const bool bWritten = (0 == ferror(file));
+	fclose(file);
+
+	return(bWritten);
+}
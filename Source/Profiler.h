@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.h
+// ============
+// scoped CPU timing zones, exported as a Chrome trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// the zones are compiled in unless PROFILER_DISABLED is defined
+#if !defined(PROFILER_DISABLED)
+#define PROFILER_ENABLED
+#endif
+
+// the x86 time stamp counter is read in a few cycles, where
+// the steady clock can cost a system call on some platforms
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILER_RDTSC
+#endif
+
+/***********************************************************
+ *  Profiler
+ *
+ *  This class collects timed zones from every thread while
+ *  recording is on, and writes them out in the Chrome Trace
+ *  Event format, which Perfetto and chrome://tracing open.
+ *
+ *  Each thread writes its zones into a ring buffer of its
+ *  own, so recording takes no lock and a long run only
+ *  keeps the latest zones of each thread.  The timestamps
+ *  are raw time stamp counter ticks on x86, converted to
+ *  time when the trace is written, and steady clock
+ *  nanoseconds elsewhere.
+ *
+ *  The zones are placed with PROFILE_ZONE(), which compiles
+ *  to nothing when PROFILER_DISABLED is defined.
+ ***********************************************************/
+class Profiler
+{
+public:
+	// zones kept per thread, a power of two
+	static const uint32_t RING_SIZE = 1 << 14;
+
+	// one finished zone, in timestamp ticks
+	struct ZONE_EVENT
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// ring buffer of the zones of one thread
+	struct THREAD_BUFFER
+	{
+		ZONE_EVENT events[RING_SIZE];
+		// zones written since the buffer was created
+		std::atomic<uint64_t> writeCount;
+		const char* threadName;
+		int threadIndex;
+	};
+
+	// start recording zones on every thread
+	static void Start();
+	// stop recording zones
+	static void Stop();
+	// get whether zones are being recorded
+	static bool IsRecording() { return(s_bRecording.load(std::memory_order_relaxed)); }
+
+	// name the calling thread in the trace - the name has to
+	// stay valid for the rest of the run
+	static void SetThreadName(const char* name);
+
+	// stop recording and write the recorded zones of every
+	// thread to a Chrome trace JSON file
+	static bool WriteChromeTrace(const char* filename);
+
+	// get the current timestamp in ticks
+	static uint64_t GetTimestamp()
+	{
+#if defined(PROFILER_RDTSC)
+		return(__rdtsc());
+#else
+		return((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	// add a finished zone to the ring of the calling thread
+	static void RecordZone(const char* name, uint64_t start, uint64_t end)
+	{
+		THREAD_BUFFER* pBuffer = s_pThreadBuffer;
+		if (NULL == pBuffer)
+		{
+			pBuffer = CreateThreadBuffer();
+		}
+
+		const uint64_t index = pBuffer->writeCount.load(std::memory_order_relaxed);
+		ZONE_EVENT& event = pBuffer->events[index & (RING_SIZE - 1)];
+		event.name = name;
+		event.start = start;
+		event.end = end;
+		pBuffer->writeCount.store(index + 1, std::memory_order_release);
+	}
+
+private:
+	static std::atomic<bool> s_bRecording;
+	// ring of the calling thread, created on its first zone
+	static thread_local THREAD_BUFFER* s_pThreadBuffer;
+	static thread_local const char* s_pThreadName;
+
+	// create and register the ring of the calling thread
+	static THREAD_BUFFER* CreateThreadBuffer();
+};
+
+/***********************************************************
+ *  ProfileZone
+ *
+ *  This class times the scope it is declared in, from its
+ *  constructor to its destructor, when recording is on.
+ *  The name has to be a string literal or otherwise stay
+ *  valid until the trace is written.
+ ***********************************************************/
+class ProfileZone
+{
+public:
+	// constructor
+	explicit ProfileZone(const char* name)
+	{
+		m_name = name;
+		m_start = Profiler::IsRecording() ? Profiler::GetTimestamp() : 0;
+	}
+	// destructor
+	~ProfileZone()
+	{
+		if (0 != m_start)
+		{
+			Profiler::RecordZone(m_name, m_start, Profiler::GetTimestamp());
+		}
+	}
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#if defined(PROFILER_ENABLED)
+// time the rest of the enclosing scope as a named zone
+#define PROFILE_ZONE(name) ProfileZone PROFILER_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// sort the draws of a frame by packed state keys to minimise state changes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+#include "Profiler.h"
+
+#include <cstring>
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	memset(&m_lastSortStats, 0, sizeof(m_lastSortStats));
+}
+
+/***********************************************************
+ *  ~RenderQueue()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderQueue::~RenderQueue()
+{
+}
+
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  This method is used for packing the render state of a
+ *  draw into a sort key.  Values that do not fit into their
+ *  field are clamped to the highest value of the field.
+ ***********************************************************/
+uint64_t RenderQueue::MakeSortKey(
+	uint32_t pass,
+	BLEND_MODE blendMode,
+	uint32_t material,
+	uint32_t texture,
+	uint32_t mesh,
+	float depth)
+{
+	// quantize the depth into the 24 bits of its field
+	if (depth < 0.0f)
+	{
+		depth = 0.0f;
+	}
+	if (depth > 1.0f)
+	{
+		depth = 1.0f;
+	}
+	uint64_t depthBits = (uint64_t)(depth * (float)MAX_DEPTH);
+
+	uint64_t key = 0;
+	key |= (uint64_t)((pass < MAX_PASS) ? pass : MAX_PASS) << 60;
+	key |= (uint64_t)(blendMode & 0x3) << 58;
+
+	if (BLEND_OPAQUE == blendMode)
+	{
+		key |= (uint64_t)((material < MAX_MATERIAL) ? material : MAX_MATERIAL) << 46;
+		key |= (uint64_t)((texture < MAX_TEXTURE) ? texture : MAX_TEXTURE) << 34;
+		key |= (uint64_t)((mesh < MAX_MESH) ? mesh : MAX_MESH) << 26;
+		key |= depthBits << 2;
+	}
+	else
+	{
+		// back to front - the farthest draw gets the lowest key
+		key |= (MAX_DEPTH - depthBits) << 34;
+		key |= (uint64_t)((mesh < MAX_MESH) ? mesh : MAX_MESH) << 26;
+	}
+
+	return(key);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all the queued draws,
+ *  keeping the memory for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_commands.clear();
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a draw.
+ ***********************************************************/
+void RenderQueue::Submit(uint64_t key, uint32_t payload)
+{
+	RENDER_COMMAND command;
+	command.key = key;
+	command.payload = payload;
+	m_commands.push_back(command);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for sorting the queued draws with a
+ *  least significant digit radix sort, one byte of the key
+ *  per pass.  The sort is stable, so draws with equal keys
+ *  keep their submitted order, and a pass is skipped when
+ *  all the keys have the same value in its byte - for the
+ *  mostly empty high bits of a small scene that skips most
+ *  of the passes.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	PROFILE_ZONE("RenderQueue::Sort");
+
+	m_lastSortStats.drawCount = (unsigned int)m_commands.size();
+	m_lastSortStats.stateChangesSubmitted = CountStateChanges();
+
+	const size_t commandCount = m_commands.size();
+	if (commandCount > 1)
+	{
+		m_sortBuffer.resize(commandCount);
+
+		RENDER_COMMAND* pSource = m_commands.data();
+		RENDER_COMMAND* pDestination = m_sortBuffer.data();
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t offsets[256];
+			memset(offsets, 0, sizeof(offsets));
+			for (size_t i = 0; i < commandCount; i++)
+			{
+				offsets[(pSource[i].key >> shift) & 0xFF]++;
+			}
+
+			// every key has the same byte, so the order stays
+			if (offsets[(pSource[0].key >> shift) & 0xFF] == commandCount)
+			{
+				continue;
+			}
+
+			size_t total = 0;
+			for (int digit = 0; digit < 256; digit++)
+			{
+				size_t count = offsets[digit];
+				offsets[digit] = total;
+				total += count;
+			}
+
+			for (size_t i = 0; i < commandCount; i++)
+			{
+				pDestination[offsets[(pSource[i].key >> shift) & 0xFF]++] = pSource[i];
+			}
+
+			RENDER_COMMAND* pSwap = pSource;
+			pSource = pDestination;
+			pDestination = pSwap;
+		}
+
+		// an odd number of passes leaves the result in the scratch buffer
+		if (pSource != m_commands.data())
+		{
+			m_commands.swap(m_sortBuffer);
+		}
+	}
+
+	m_lastSortStats.stateChangesSorted = CountStateChanges();
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting the pass, blend mode,
+ *  material, texture and mesh changes that drawing the queue
+ *  in its current order would need.  The first draw counts
+ *  as one change for each of the states it sets.  Blended
+ *  keys do not hold the material and texture, so a blended
+ *  draw is always counted as changing both.
+ ***********************************************************/
+unsigned int RenderQueue::CountStateChanges() const
+{
+	unsigned int stateChanges = 0;
+
+	for (size_t i = 0; i < m_commands.size(); i++)
+	{
+		const uint64_t key = m_commands[i].key;
+		if (i == 0)
+		{
+			stateChanges += 5;
+			continue;
+		}
+
+		const uint64_t previousKey = m_commands[i - 1].key;
+		stateChanges += (GetPass(key) != GetPass(previousKey)) ? 1 : 0;
+		stateChanges += (GetBlendMode(key) != GetBlendMode(previousKey)) ? 1 : 0;
+		if ((BLEND_OPAQUE != GetBlendMode(key)) || (BLEND_OPAQUE != GetBlendMode(previousKey)))
+		{
+			stateChanges += 2;
+		}
+		else
+		{
+			stateChanges += (GetMaterial(key) != GetMaterial(previousKey)) ? 1 : 0;
+			stateChanges += (GetTexture(key) != GetTexture(previousKey)) ? 1 : 0;
+		}
+		stateChanges += (GetMesh(key) != GetMesh(previousKey)) ? 1 : 0;
+	}
+
+	return(stateChanges);
+}
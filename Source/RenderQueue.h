@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// sort the draws of a frame by packed state keys to minimise state changes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class collects the draws of a frame as a 64 bit
+ *  sort key plus a payload.  The key packs the render state
+ *  of the draw with the most expensive state in the highest
+ *  bits, so after the radix sort in Sort() the draws that
+ *  share a state are next to each other and the state only
+ *  has to be changed when the key changes.
+ *
+ *  Key layout, from the highest bit down:
+ *
+ *    63..60  pass
+ *    59..58  blend mode
+ *    57..46  material    - opaque draws
+ *    45..34  texture
+ *    33..26  mesh
+ *    25..2   depth, front to back
+ *
+ *  Blended draws have to be drawn back to front instead, so
+ *  for them the inverted depth takes the place of material,
+ *  texture and mesh.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// constructor
+	RenderQueue();
+	// destructor
+	~RenderQueue();
+
+	enum BLEND_MODE
+	{
+		BLEND_OPAQUE = 0,
+		BLEND_ALPHA
+	};
+
+	// highest values of the packed key fields
+	static const uint32_t MAX_PASS = 0xF;
+	static const uint32_t MAX_MATERIAL = 0xFFF;
+	static const uint32_t MAX_TEXTURE = 0xFFF;
+	static const uint32_t MAX_MESH = 0xFF;
+	static const uint32_t MAX_DEPTH = 0xFFFFFF;
+
+	// one queued draw
+	struct RENDER_COMMAND
+	{
+		uint64_t key;
+		uint32_t payload;
+	};
+
+	struct RENDER_QUEUE_STATS
+	{
+		unsigned int drawCount;
+		unsigned int stateChangesSubmitted;
+		unsigned int stateChangesSorted;
+	};
+
+	// pack the render state of a draw into a sort key - the
+	// depth is a value from 0 (near) to 1 (far)
+	static uint64_t MakeSortKey(
+		uint32_t pass,
+		BLEND_MODE blendMode,
+		uint32_t material,
+		uint32_t texture,
+		uint32_t mesh,
+		float depth);
+	// unpack the fields of a sort key
+	static uint32_t GetPass(uint64_t key) { return((uint32_t)(key >> 60) & MAX_PASS); }
+	static BLEND_MODE GetBlendMode(uint64_t key) { return((BLEND_MODE)((key >> 58) & 0x3)); }
+	static uint32_t GetMaterial(uint64_t key) { return((uint32_t)(key >> 46) & MAX_MATERIAL); }
+	static uint32_t GetTexture(uint64_t key) { return((uint32_t)(key >> 34) & MAX_TEXTURE); }
+	static uint32_t GetMesh(uint64_t key) { return((uint32_t)(key >> 26) & MAX_MESH); }
+
+	// remove all the queued draws
+	void Clear();
+	// queue a draw
+	void Submit(uint64_t key, uint32_t payload);
+	// sort the queued draws by their keys
+	void Sort();
+
+	// get the queued draws, in sorted order after Sort()
+	int GetCommandCount() const { return((int)m_commands.size()); }
+	const RENDER_COMMAND& GetCommand(int index) const { return(m_commands[index]); }
+
+	// get the draw and state change counts of the last sort
+	RENDER_QUEUE_STATS GetLastSortStats() const { return(m_lastSortStats); }
+
+private:
+	// queued draws
+	std::vector<RENDER_COMMAND> m_commands;
+	// scratch buffer used by the radix sort
+	std::vector<RENDER_COMMAND> m_sortBuffer;
+	// counts of the last sort
+	RENDER_QUEUE_STATS m_lastSortStats;
+
+	// count the state changes needed to draw the queue in order
+	unsigned int CountStateChanges() const;
+};
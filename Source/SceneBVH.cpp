@@ -0,0 +1,995 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// bounding volume hierarchy for spatial queries over the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+#include "Profiler.h"
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+const float SceneBVH::REBUILD_COST_RATIO = 1.5f;
+
+// declaration of global variables
+namespace
+{
+	// bins the object centers are sorted into along each axis
+	// when looking for the cheapest split
+	const int g_BinCount = 12;
+	// relative costs of visiting an inner node, which tests the
+	// boxes of both its children, and of testing the box of
+	// one object in a leaf
+	const float g_TraversalCost = 2.0f;
+	const float g_IntersectCost = 1.0f;
+	// nodes a query keeps waiting on its own stack - more than
+	// any tree that is not degenerate needs
+	const int g_StackSize = 64;
+	// smallest ray direction component that is inverted - a
+	// smaller one gets a large but finite inverse instead of an
+	// infinity, which the slab test would turn into NaN
+	const float g_MinDirection = 1e-20f;
+	const float g_MaxInverseDirection = 1e20f;
+	// bytes of a cache line, which the node array starts on
+	const size_t g_CacheLineBytes = 64;
+
+	/***********************************************************
+	 *  TraversalStack
+	 *
+	 *  This class holds the nodes a query still has to visit.
+	 *  They are kept in a fixed array on the stack of the
+	 *  caller, so a query makes no heap allocation, and only a
+	 *  tree deeper than the array spills the rest into a vector
+	 *  instead of dropping nodes.
+	 ***********************************************************/
+	template <typename ENTRY>
+	class TraversalStack
+	{
+	public:
+		TraversalStack() : m_size(0) {}
+
+		bool IsEmpty() const { return(0 == m_size); }
+
+		void Push(const ENTRY& entry)
+		{
+			if (m_size < g_StackSize)
+			{
+				m_entries[m_size] = entry;
+			}
+			else
+			{
+				m_overflow.push_back(entry);
+			}
+			m_size++;
+		}
+
+		ENTRY Pop()
+		{
+			m_size--;
+			if (m_size < g_StackSize)
+			{
+				return(m_entries[m_size]);
+			}
+			const ENTRY entry = m_overflow.back();
+			m_overflow.pop_back();
+			return(entry);
+		}
+
+	private:
+		ENTRY m_entries[g_StackSize];
+		std::vector<ENTRY> m_overflow;
+		int m_size;
+	};
+
+	/***********************************************************
+	 *  GetSeconds()
+	 *
+	 *  This function is used for getting a steady time stamp.
+	 ***********************************************************/
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  GetHalfArea()
+	 *
+	 *  This function is used for getting half the surface area
+	 *  of a box, which is all the cost comparisons need.
+	 ***********************************************************/
+	float GetHalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		const glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return(size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	/***********************************************************
+	 *  GetInverseDirection()
+	 *
+	 *  This function is used for getting the inverse of a ray
+	 *  direction for the slab test.  An axis the ray does not
+	 *  move along keeps the sign of its component, so the slabs
+	 *  of that axis either hold the origin or are never reached.
+	 ***********************************************************/
+	glm::vec3 GetInverseDirection(const glm::vec3& direction)
+	{
+		glm::vec3 inverseDirection;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (std::fabs(direction[axis]) > g_MinDirection)
+			{
+				inverseDirection[axis] = 1.0f / direction[axis];
+			}
+			else
+			{
+				inverseDirection[axis] = std::copysign(g_MaxInverseDirection, direction[axis]);
+			}
+		}
+		return(inverseDirection);
+	}
+
+	/***********************************************************
+	 *  GetRayBoxDistance()
+	 *
+	 *  This function is used for getting the distance along a
+	 *  ray at which it enters a box, with the slab test, or
+	 *  FLT_MAX when it misses the box before maxDistance.  A
+	 *  ray starting inside the box enters it at zero.
+	 ***********************************************************/
+	float GetRayBoxDistance(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax,
+		float maxDistance)
+	{
+		const glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+		const glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min(t0, t1);
+		const glm::vec3 tFar = glm::max(t0, t1);
+
+		const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		if (enter > exit)
+		{
+			return(FLT_MAX);
+		}
+		return(enter);
+	}
+
+	/***********************************************************
+	 *  BoxesOverlap()
+	 *
+	 *  This function is used for checking whether two boxes
+	 *  overlap or touch.
+	 ***********************************************************/
+	bool BoxesOverlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		return((minA.x <= maxB.x) && (maxA.x >= minB.x) &&
+			(minA.y <= maxB.y) && (maxA.y >= minB.y) &&
+			(minA.z <= maxB.z) && (maxA.z >= minB.z));
+	}
+
+	/***********************************************************
+	 *  SphereOverlapsBox()
+	 *
+	 *  This function is used for checking whether a sphere
+	 *  reaches into a box, from the distance between its
+	 *  center and the closest point of the box.
+	 ***********************************************************/
+	bool SphereOverlapsBox(const glm::vec3& center, float radiusSquared, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		const glm::vec3 offset = center - glm::clamp(center, boundsMin, boundsMax);
+		return(glm::dot(offset, offset) <= radiusSquared);
+	}
+
+	/***********************************************************
+	 *  ClassifyBox()
+	 *
+	 *  This function is used for testing a box against the
+	 *  frustum planes whose bits are set in the plane mask.
+	 *  Returns -1 when the box is outside of one of them, and
+	 *  otherwise the mask of the planes the box still crosses
+	 *  - the planes it is fully inside of need no test for the
+	 *  boxes within it.
+	 ***********************************************************/
+	int ClassifyBox(const glm::vec4* planes, int planeMask, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		const glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+		for (int plane = 0; plane < FrustumCuller::PLANE_COUNT; plane++)
+		{
+			if (0 == (planeMask & (1 << plane)))
+			{
+				continue;
+			}
+
+			const glm::vec3 normal(planes[plane]);
+			const float distance = glm::dot(normal, center) + planes[plane].w;
+			const float reach = glm::dot(glm::abs(normal), extent);
+			if (distance + reach < 0.0f)
+			{
+				return(-1);
+			}
+			if (distance - reach >= 0.0f)
+			{
+				planeMask &= ~(1 << plane);
+			}
+		}
+		return(planeMask);
+	}
+
+	// orders objects by their center along one axis
+	struct CENTER_LESS
+	{
+		const glm::vec3* pMin;
+		const glm::vec3* pMax;
+		int axis;
+
+		bool operator()(int a, int b) const
+		{
+			return((pMin[a][axis] + pMax[a][axis]) < (pMin[b][axis] + pMax[b][axis]));
+		}
+	};
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+	m_objectCount = 0;
+	m_pNodes = NULL;
+	m_nodeCount = 0;
+	m_bNeedsBuild = false;
+	m_costSum = 0.0;
+	m_buildCost = 0.0f;
+	m_depth = 0;
+	m_leafCount = 0;
+	m_refitCount = 0;
+	m_rebuildCount = 0;
+	m_buildMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~SceneBVH()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneBVH::~SceneBVH()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all the objects and the
+ *  tree.
+ ***********************************************************/
+void SceneBVH::Clear()
+{
+	m_objectCount = 0;
+	m_objectMin.clear();
+	m_objectMax.clear();
+	m_objectValid.clear();
+	m_objectLeaf.clear();
+	m_leafObjects.clear();
+	m_nodeMemory.clear();
+	m_pNodes = NULL;
+	m_nodeCount = 0;
+	m_nodeParents.clear();
+	m_movedObjects.clear();
+	m_movedFlags.clear();
+	m_bNeedsBuild = false;
+	m_costSum = 0.0;
+	m_buildCost = 0.0f;
+	m_depth = 0;
+	m_leafCount = 0;
+	m_refitCount = 0;
+	m_rebuildCount = 0;
+	m_buildMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for setting the number of objects.
+ *  Removed objects leave the tree on the next update.
+ ***********************************************************/
+void SceneBVH::Resize(int objectCount)
+{
+	if (objectCount < 0)
+	{
+		objectCount = 0;
+	}
+	if (objectCount < m_objectCount)
+	{
+		m_bNeedsBuild = true;
+		m_movedObjects.clear();
+		m_movedFlags.assign(objectCount, 0);
+	}
+
+	m_objectCount = objectCount;
+	m_objectMin.resize(objectCount, glm::vec3(0.0f));
+	m_objectMax.resize(objectCount, glm::vec3(0.0f));
+	m_objectValid.resize(objectCount, 0);
+	m_objectLeaf.resize(objectCount, -1);
+	m_movedFlags.resize(objectCount, 0);
+}
+
+/***********************************************************
+ *  SetObjectBounds()
+ *
+ *  This method is used for setting the world box of an
+ *  object.  An object that had no box yet makes the next
+ *  update rebuild the tree, and one that had is refitted.
+ ***********************************************************/
+void SceneBVH::SetObjectBounds(int object, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	if ((object < 0) || (object >= m_objectCount))
+	{
+		return;
+	}
+
+	if (0 == m_objectValid[object])
+	{
+		m_objectValid[object] = 1;
+		m_bNeedsBuild = true;
+	}
+	m_objectMin[object] = boundsMin;
+	m_objectMax[object] = boundsMax;
+
+	if (0 == m_movedFlags[object])
+	{
+		m_movedFlags[object] = 1;
+		m_movedObjects.push_back(object);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for bringing the tree up to date with
+ *  the boxes set since the last update.  The tree is built
+ *  when objects were added or removed, and refitted when
+ *  objects only moved - then rebuilt if the refit made it
+ *  too loose.
+ ***********************************************************/
+void SceneBVH::Update()
+{
+	PROFILE_ZONE("SceneBVH::Update");
+
+	if (m_bNeedsBuild)
+	{
+		Build();
+		m_rebuildCount++;
+	}
+	else if (false == m_movedObjects.empty())
+	{
+		Refit();
+		m_refitCount++;
+
+		if (GetNormalizedCost() > m_buildCost * REBUILD_COST_RATIO)
+		{
+			Build();
+			m_rebuildCount++;
+		}
+	}
+
+	for (size_t i = 0; i < m_movedObjects.size(); i++)
+	{
+		m_movedFlags[m_movedObjects[i]] = 0;
+	}
+	m_movedObjects.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree over all the
+ *  objects with a box.  A tree over n objects has at most
+ *  2n - 1 nodes, plus the unused node 1, so the node array
+ *  is allocated once at that size.
+ ***********************************************************/
+void SceneBVH::Build()
+{
+	const double startSeconds = GetSeconds();
+
+	m_leafObjects.clear();
+	for (int object = 0; object < m_objectCount; object++)
+	{
+		m_objectLeaf[object] = -1;
+		if (0 != m_objectValid[object])
+		{
+			m_leafObjects.push_back(object);
+		}
+	}
+
+	const int leafObjectCount = (int)m_leafObjects.size();
+	const int maxNodes = 2 * leafObjectCount + 1;
+
+	m_nodeMemory.resize(maxNodes * sizeof(BVH_NODE) + g_CacheLineBytes);
+	const uintptr_t address = (uintptr_t)&m_nodeMemory[0];
+	m_pNodes = (BVH_NODE*)((address + g_CacheLineBytes - 1) & ~(uintptr_t)(g_CacheLineBytes - 1));
+	m_nodeParents.assign(maxNodes, -1);
+	m_nodeCount = 0;
+	m_costSum = 0.0;
+	m_buildCost = 0.0f;
+	m_depth = 0;
+	m_leafCount = 0;
+
+	if (leafObjectCount > 0)
+	{
+		BVH_NODE root;
+		root.boundsMin = glm::vec3(0.0f);
+		root.boundsMax = glm::vec3(0.0f);
+		root.leftFirst = 0;
+		root.count = 0;
+		// node 1 stays empty
+		m_pNodes[1] = root;
+		root.count = leafObjectCount;
+		m_pNodes[0] = root;
+		m_nodeCount = 2;
+		Subdivide(0, 0);
+
+		for (int node = 0; node < m_nodeCount; node++)
+		{
+			if (1 != node)
+			{
+				m_costSum += GetNodeCost(m_pNodes[node]);
+			}
+		}
+		m_buildCost = GetNormalizedCost();
+	}
+
+	m_bNeedsBuild = false;
+	m_buildMilliseconds = (GetSeconds() - startSeconds) * 1000.0;
+}
+
+/***********************************************************
+ *  Subdivide()
+ *
+ *  This method is used for splitting a node in two.  The
+ *  object centers are sorted into bins along each axis, and
+ *  the split between two bins with the lowest surface area
+ *  cost wins, unless keeping the node as a leaf is cheaper.
+ *  Nodes too large for a leaf whose objects cannot be split
+ *  by cost, and nodes at MAX_DEPTH, are split at their
+ *  middle object along their longest axis instead.
+ ***********************************************************/
+void SceneBVH::Subdivide(int node, int depth)
+{
+	BVH_NODE& current = m_pNodes[node];
+	ComputeNodeBounds(node, current.boundsMin, current.boundsMax);
+	m_depth = std::max(m_depth, depth);
+
+	const int first = current.leftFirst;
+	const int count = current.count;
+
+	// box of the object centers, doubled like the bin keys
+	glm::vec3 centerMin(FLT_MAX);
+	glm::vec3 centerMax(-FLT_MAX);
+	for (int i = first; i < first + count; i++)
+	{
+		const int object = m_leafObjects[i];
+		const glm::vec3 center = m_objectMin[object] + m_objectMax[object];
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	if ((count > 1) && (depth < MAX_DEPTH))
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float range = centerMax[axis] - centerMin[axis];
+			if (range <= 0.0f)
+			{
+				continue;
+			}
+
+			int binCounts[g_BinCount] = { 0 };
+			glm::vec3 binMin[g_BinCount];
+			glm::vec3 binMax[g_BinCount];
+			for (int bin = 0; bin < g_BinCount; bin++)
+			{
+				binMin[bin] = glm::vec3(FLT_MAX);
+				binMax[bin] = glm::vec3(-FLT_MAX);
+			}
+
+			const float binScale = (float)g_BinCount / range;
+			for (int i = first; i < first + count; i++)
+			{
+				const int object = m_leafObjects[i];
+				const float center = m_objectMin[object][axis] + m_objectMax[object][axis];
+				const int bin = std::min((int)((center - centerMin[axis]) * binScale), g_BinCount - 1);
+				binCounts[bin]++;
+				binMin[bin] = glm::min(binMin[bin], m_objectMin[object]);
+				binMax[bin] = glm::max(binMax[bin], m_objectMax[object]);
+			}
+
+			// sweep from the right to get the cost of each right side
+			float rightArea[g_BinCount];
+			int rightCount[g_BinCount];
+			glm::vec3 sweepMin(FLT_MAX);
+			glm::vec3 sweepMax(-FLT_MAX);
+			int sweepCount = 0;
+			for (int bin = g_BinCount - 1; bin > 0; bin--)
+			{
+				sweepMin = glm::min(sweepMin, binMin[bin]);
+				sweepMax = glm::max(sweepMax, binMax[bin]);
+				sweepCount += binCounts[bin];
+				rightArea[bin] = (sweepCount > 0) ? GetHalfArea(sweepMin, sweepMax) : 0.0f;
+				rightCount[bin] = sweepCount;
+			}
+
+			// and from the left, splitting before each bin
+			sweepMin = glm::vec3(FLT_MAX);
+			sweepMax = glm::vec3(-FLT_MAX);
+			sweepCount = 0;
+			for (int split = 1; split < g_BinCount; split++)
+			{
+				sweepMin = glm::min(sweepMin, binMin[split - 1]);
+				sweepMax = glm::max(sweepMax, binMax[split - 1]);
+				sweepCount += binCounts[split - 1];
+				if ((0 == sweepCount) || (0 == rightCount[split]))
+				{
+					continue;
+				}
+
+				const float cost =
+					GetHalfArea(sweepMin, sweepMax) * (float)sweepCount +
+					rightArea[split] * (float)rightCount[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+	}
+
+	const float nodeArea = GetHalfArea(current.boundsMin, current.boundsMax);
+	const float leafCost = g_IntersectCost * nodeArea * (float)count;
+	const float splitCost = g_TraversalCost * nodeArea + g_IntersectCost * bestCost;
+	if ((count <= 1) || ((count <= MAX_LEAF_OBJECTS) && ((bestAxis < 0) || (splitCost >= leafCost))))
+	{
+		for (int i = first; i < first + count; i++)
+		{
+			m_objectLeaf[m_leafObjects[i]] = node;
+		}
+		m_leafCount++;
+		return;
+	}
+
+	int middle = first;
+	if (bestAxis >= 0)
+	{
+		// move the objects left of the split to the front
+		const float binScale = (float)g_BinCount / (centerMax[bestAxis] - centerMin[bestAxis]);
+		int end = first + count - 1;
+		middle = first;
+		while (middle <= end)
+		{
+			const int object = m_leafObjects[middle];
+			const float center = m_objectMin[object][bestAxis] + m_objectMax[object][bestAxis];
+			const int bin = std::min((int)((center - centerMin[bestAxis]) * binScale), g_BinCount - 1);
+			if (bin < bestSplit)
+			{
+				middle++;
+			}
+			else
+			{
+				std::swap(m_leafObjects[middle], m_leafObjects[end]);
+				end--;
+			}
+		}
+	}
+	if ((middle == first) || (middle == first + count))
+	{
+		// no split by cost - halve the objects along the
+		// longest axis of their centers
+		const glm::vec3 centerRange = centerMax - centerMin;
+		CENTER_LESS less;
+		less.pMin = &m_objectMin[0];
+		less.pMax = &m_objectMax[0];
+		less.axis = (centerRange.x >= centerRange.y) ?
+			((centerRange.x >= centerRange.z) ? 0 : 2) :
+			((centerRange.y >= centerRange.z) ? 1 : 2);
+
+		middle = first + count / 2;
+		std::nth_element(
+			m_leafObjects.begin() + first,
+			m_leafObjects.begin() + middle,
+			m_leafObjects.begin() + first + count,
+			less);
+	}
+
+	// the two children go next to each other, in one cache line
+	const int left = m_nodeCount;
+	m_nodeCount += 2;
+
+	m_pNodes[left].leftFirst = first;
+	m_pNodes[left].count = middle - first;
+	m_pNodes[left + 1].leftFirst = middle;
+	m_pNodes[left + 1].count = first + count - middle;
+	m_nodeParents[left] = node;
+	m_nodeParents[left + 1] = node;
+
+	current.leftFirst = left;
+	current.count = 0;
+
+	Subdivide(left, depth + 1);
+	Subdivide(left + 1, depth + 1);
+}
+
+/***********************************************************
+ *  ComputeNodeBounds()
+ *
+ *  This method is used for getting the box around the two
+ *  children of an inner node, or around the objects of a
+ *  leaf.
+ ***********************************************************/
+void SceneBVH::ComputeNodeBounds(int node, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	const BVH_NODE& current = m_pNodes[node];
+	if (0 == current.count)
+	{
+		const BVH_NODE& left = m_pNodes[current.leftFirst];
+		const BVH_NODE& right = m_pNodes[current.leftFirst + 1];
+		boundsMin = glm::min(left.boundsMin, right.boundsMin);
+		boundsMax = glm::max(left.boundsMax, right.boundsMax);
+		return;
+	}
+
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (int i = current.leftFirst; i < current.leftFirst + current.count; i++)
+	{
+		const int object = m_leafObjects[i];
+		boundsMin = glm::min(boundsMin, m_objectMin[object]);
+		boundsMax = glm::max(boundsMax, m_objectMax[object]);
+	}
+}
+
+/***********************************************************
+ *  GetNodeCost()
+ *
+ *  This method is used for getting the surface area cost a
+ *  node adds to the tree - the chance of a query reaching
+ *  it, which grows with its area, times the cost of visiting
+ *  it or of testing its objects.
+ ***********************************************************/
+double SceneBVH::GetNodeCost(const BVH_NODE& node) const
+{
+	const double area = GetHalfArea(node.boundsMin, node.boundsMax);
+	if (0 == node.count)
+	{
+		return(area * g_TraversalCost);
+	}
+	return(area * g_IntersectCost * node.count);
+}
+
+/***********************************************************
+ *  GetNormalizedCost()
+ *
+ *  This method is used for getting the cost of the tree
+ *  relative to the area of its root, which is the expected
+ *  cost of a query that reaches the root.
+ ***********************************************************/
+float SceneBVH::GetNormalizedCost() const
+{
+	if (0 == m_nodeCount)
+	{
+		return(0.0f);
+	}
+
+	const float rootArea = GetHalfArea(m_pNodes[0].boundsMin, m_pNodes[0].boundsMax);
+	if (rootArea <= 0.0f)
+	{
+		return(0.0f);
+	}
+	return((float)(m_costSum / rootArea));
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for recomputing the boxes above each
+ *  moved object, from its leaf up to the root.  A walk stops
+ *  at the first box that comes out the same, since nothing
+ *  above it can change either, and the tree cost is changed
+ *  by the difference of each recomputed node.
+ ***********************************************************/
+void SceneBVH::Refit()
+{
+	for (size_t i = 0; i < m_movedObjects.size(); i++)
+	{
+		int node = m_objectLeaf[m_movedObjects[i]];
+		while (node >= 0)
+		{
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			ComputeNodeBounds(node, boundsMin, boundsMax);
+
+			BVH_NODE& current = m_pNodes[node];
+			if ((boundsMin == current.boundsMin) && (boundsMax == current.boundsMax))
+			{
+				break;
+			}
+
+			m_costSum -= GetNodeCost(current);
+			current.boundsMin = boundsMin;
+			current.boundsMax = boundsMax;
+			m_costSum += GetNodeCost(current);
+
+			node = m_nodeParents[node];
+		}
+	}
+}
+
+/***********************************************************
+ *  FindFirstHit()
+ *
+ *  This method is used for finding the object whose box a
+ *  ray enters first.  Of the two children of a node, the one
+ *  the ray enters first is visited first, and nodes entered
+ *  beyond the closest hit so far are skipped.  The direction
+ *  does not need to be normalized - the distances are in
+ *  units of its length.
+ ***********************************************************/
+int SceneBVH::FindFirstHit(glm::vec3 origin, glm::vec3 direction, float maxDistance, float& hitDistance) const
+{
+	hitDistance = maxDistance;
+	if (0 == m_nodeCount)
+	{
+		return(-1);
+	}
+
+	const glm::vec3 inverseDirection = GetInverseDirection(direction);
+	int hitObject = -1;
+
+	// node and the distance the ray enters it at
+	TraversalStack<std::pair<int, float>> stack;
+
+	const float rootDistance = GetRayBoxDistance(origin, inverseDirection, m_pNodes[0].boundsMin, m_pNodes[0].boundsMax, hitDistance);
+	if (rootDistance < FLT_MAX)
+	{
+		stack.Push(std::make_pair(0, rootDistance));
+	}
+
+	while (!stack.IsEmpty())
+	{
+		const std::pair<int, float> entry = stack.Pop();
+		if (entry.second > hitDistance)
+		{
+			continue;
+		}
+
+		const BVH_NODE& node = m_pNodes[entry.first];
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const int object = m_leafObjects[i];
+				const float distance = GetRayBoxDistance(origin, inverseDirection, m_objectMin[object], m_objectMax[object], hitDistance);
+				if ((distance < FLT_MAX) && ((distance < hitDistance) || (hitObject < 0)))
+				{
+					hitDistance = distance;
+					hitObject = object;
+				}
+			}
+			continue;
+		}
+
+		const int left = node.leftFirst;
+		float leftDistance = GetRayBoxDistance(origin, inverseDirection, m_pNodes[left].boundsMin, m_pNodes[left].boundsMax, hitDistance);
+		float rightDistance = GetRayBoxDistance(origin, inverseDirection, m_pNodes[left + 1].boundsMin, m_pNodes[left + 1].boundsMax, hitDistance);
+
+		// push the farther child first, so the nearer is next
+		int nearChild = left;
+		int farChild = left + 1;
+		if (rightDistance < leftDistance)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(leftDistance, rightDistance);
+		}
+		if (rightDistance < FLT_MAX)
+		{
+			stack.Push(std::make_pair(farChild, rightDistance));
+		}
+		if (leftDistance < FLT_MAX)
+		{
+			stack.Push(std::make_pair(nearChild, leftDistance));
+		}
+	}
+
+	return(hitObject);
+}
+
+/***********************************************************
+ *  FindInBox()
+ *
+ *  This method is used for finding the objects whose box
+ *  overlaps the passed in box.
+ ***********************************************************/
+int SceneBVH::FindInBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<int>& objects) const
+{
+	objects.clear();
+	if (0 == m_nodeCount)
+	{
+		return(0);
+	}
+
+	TraversalStack<int> stack;
+	stack.Push(0);
+
+	while (!stack.IsEmpty())
+	{
+		const BVH_NODE& node = m_pNodes[stack.Pop()];
+		if (false == BoxesOverlap(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const int object = m_leafObjects[i];
+				if (BoxesOverlap(m_objectMin[object], m_objectMax[object], boundsMin, boundsMax))
+				{
+					objects.push_back(object);
+				}
+			}
+		}
+		else
+		{
+			stack.Push(node.leftFirst + 1);
+			stack.Push(node.leftFirst);
+		}
+	}
+
+	return((int)objects.size());
+}
+
+/***********************************************************
+ *  FindInSphere()
+ *
+ *  This method is used for finding the objects whose box
+ *  reaches into a sphere, such as the range of a light.
+ ***********************************************************/
+int SceneBVH::FindInSphere(glm::vec3 center, float radius, std::vector<int>& objects) const
+{
+	objects.clear();
+	if ((0 == m_nodeCount) || (radius < 0.0f))
+	{
+		return(0);
+	}
+
+	const float radiusSquared = radius * radius;
+	TraversalStack<int> stack;
+	stack.Push(0);
+
+	while (!stack.IsEmpty())
+	{
+		const BVH_NODE& node = m_pNodes[stack.Pop()];
+		if (false == SphereOverlapsBox(center, radiusSquared, node.boundsMin, node.boundsMax))
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const int object = m_leafObjects[i];
+				if (SphereOverlapsBox(center, radiusSquared, m_objectMin[object], m_objectMax[object]))
+				{
+					objects.push_back(object);
+				}
+			}
+		}
+		else
+		{
+			stack.Push(node.leftFirst + 1);
+			stack.Push(node.leftFirst);
+		}
+	}
+
+	return((int)objects.size());
+}
+
+/***********************************************************
+ *  FindInFrustum()
+ *
+ *  This method is used for finding the objects whose box is
+ *  inside the frustum of a view projection, with the same
+ *  conservative test as FrustumCuller.  Each node carries
+ *  the planes its parent still crosses, so below a node that
+ *  is fully inside the frustum no plane is tested at all.
+ ***********************************************************/
+int SceneBVH::FindInFrustum(const glm::mat4& viewProjection, std::vector<int>& objects) const
+{
+	objects.clear();
+	if (0 == m_nodeCount)
+	{
+		return(0);
+	}
+
+	glm::vec4 planes[FrustumCuller::PLANE_COUNT];
+	FrustumCuller::GetFrustumPlanes(viewProjection, planes);
+
+	// node and the planes its parent still crosses
+	TraversalStack<std::pair<int, int>> stack;
+	stack.Push(std::make_pair(0, (1 << FrustumCuller::PLANE_COUNT) - 1));
+
+	while (!stack.IsEmpty())
+	{
+		const std::pair<int, int> entry = stack.Pop();
+		const BVH_NODE& node = m_pNodes[entry.first];
+		int planeMask = entry.second;
+		if (0 != planeMask)
+		{
+			planeMask = ClassifyBox(planes, planeMask, node.boundsMin, node.boundsMax);
+			if (planeMask < 0)
+			{
+				continue;
+			}
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const int object = m_leafObjects[i];
+				if ((0 == planeMask) ||
+					(ClassifyBox(planes, planeMask, m_objectMin[object], m_objectMax[object]) >= 0))
+				{
+					objects.push_back(object);
+				}
+			}
+		}
+		else
+		{
+			stack.Push(std::make_pair(node.leftFirst + 1, planeMask));
+			stack.Push(std::make_pair(node.leftFirst, planeMask));
+		}
+	}
+
+	return((int)objects.size());
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the size and quality of
+ *  the tree and how often it was refitted and rebuilt.
+ ***********************************************************/
+SceneBVH::BVH_STATS SceneBVH::GetStats() const
+{
+	BVH_STATS stats;
+	stats.objectCount = (int)m_leafObjects.size();
+	stats.nodeCount = (m_nodeCount > 1) ? m_nodeCount - 1 : m_nodeCount;
+	stats.leafCount = m_leafCount;
+	stats.depth = m_depth;
+	stats.buildCost = m_buildCost;
+	stats.currentCost = GetNormalizedCost();
+	stats.refitCount = m_refitCount;
+	stats.rebuildCount = m_rebuildCount;
+	stats.buildMilliseconds = m_buildMilliseconds;
+
+	return(stats);
+}
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// bounding volume hierarchy for spatial queries over the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class builds a bounding volume hierarchy over the
+ *  world boxes of the scene objects, so that the objects hit
+ *  by a ray, inside a sphere or box, or inside a view
+ *  frustum are found by visiting the few nodes that touch
+ *  the query instead of testing every object.
+ *
+ *  The tree is built top down with the surface area
+ *  heuristic over binned object centers.  Its nodes are 32
+ *  bytes in one flat array aligned to 64 bytes, with node 1
+ *  left unused so that the two children of every node share
+ *  one cache line.
+ *
+ *  When objects move, Update() refits the tree - the boxes
+ *  of the leaves holding the moved objects and of their
+ *  parents are recomputed, stopping at the first box that
+ *  did not change.  Refitting keeps the tree correct but
+ *  lets it grow loose, so the surface area cost of the tree
+ *  is kept up to date during the refit, and the tree is
+ *  rebuilt once that cost grows past REBUILD_COST_RATIO
+ *  times the cost it had when it was built.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+	// destructor
+	~SceneBVH();
+
+	// most objects in a leaf, unless they cannot be split
+	static const int MAX_LEAF_OBJECTS = 4;
+	// deepest level of the tree - nodes below it are split
+	// at their middle object instead of by cost
+	static const int MAX_DEPTH = 48;
+	// growth of the tree cost that triggers a rebuild
+	static const float REBUILD_COST_RATIO;
+
+	struct BVH_STATS
+	{
+		int objectCount;
+		int nodeCount;
+		int leafCount;
+		int depth;
+		// surface area cost of the tree when it was built and
+		// after the last refit
+		float buildCost;
+		float currentCost;
+		// updates that refit or rebuilt the tree
+		int refitCount;
+		int rebuildCount;
+		double buildMilliseconds;
+	};
+
+	// remove all the objects and the tree
+	void Clear();
+	// set the number of objects - new objects have no box and
+	// are left out of the tree
+	void Resize(int objectCount);
+	// set the world box of an object
+	void SetObjectBounds(int object, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+	// build, refit or rebuild the tree for the boxes set
+	// since the last update
+	void Update();
+	// build the tree over all the objects with a box
+	void Build();
+
+	// find the object whose box the ray enters first, within
+	// the passed in distance - returns -1 when none is hit
+	int FindFirstHit(glm::vec3 origin, glm::vec3 direction, float maxDistance, float& hitDistance) const;
+	// find the objects whose box overlaps a box, a sphere, or
+	// the frustum of a view projection - returns their number
+	int FindInBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<int>& objects) const;
+	int FindInSphere(glm::vec3 center, float radius, std::vector<int>& objects) const;
+	int FindInFrustum(const glm::mat4& viewProjection, std::vector<int>& objects) const;
+
+	// get the size, quality and update counts of the tree
+	BVH_STATS GetStats() const;
+
+private:
+	// one node of the tree - a leaf holds count objects from
+	// leftFirst in m_leafObjects, and an inner node has a
+	// count of zero and its children at leftFirst and
+	// leftFirst + 1
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		int32_t leftFirst;
+		glm::vec3 boundsMax;
+		int32_t count;
+	};
+
+	int m_objectCount;
+	// world boxes of the objects
+	std::vector<glm::vec3> m_objectMin;
+	std::vector<glm::vec3> m_objectMax;
+	std::vector<uint8_t> m_objectValid;
+	// leaf holding each object, -1 when it is not in the tree
+	std::vector<int> m_objectLeaf;
+	// objects of the leaves, in leaf order
+	std::vector<int> m_leafObjects;
+
+	// memory of the node array, and the node array inside it
+	// starting on a cache line
+	std::vector<unsigned char> m_nodeMemory;
+	BVH_NODE* m_pNodes;
+	int m_nodeCount;
+	// parent of each node, -1 for the root
+	std::vector<int> m_nodeParents;
+
+	// objects moved since the last update
+	std::vector<int> m_movedObjects;
+	std::vector<uint8_t> m_movedFlags;
+	// set when objects were added or removed since the build
+	bool m_bNeedsBuild;
+
+	// unnormalized cost of the tree, kept up to date by the
+	// refit, and the normalized cost after the build
+	double m_costSum;
+	float m_buildCost;
+	int m_depth;
+	int m_leafCount;
+	int m_refitCount;
+	int m_rebuildCount;
+	double m_buildMilliseconds;
+
+	// split a node by cost, or make it a leaf
+	void Subdivide(int node, int depth);
+	// get the box of a node from its children or objects
+	void ComputeNodeBounds(int node, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	// get the cost one node adds to the tree
+	double GetNodeCost(const BVH_NODE& node) const;
+	// get the cost of the tree relative to its root box
+	float GetNormalizedCost() const;
+	// recompute the boxes above the moved objects
+	void Refit();
+};
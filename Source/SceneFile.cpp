@@ -0,0 +1,631 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// memory mapped binary scene files and the text to binary scene converter
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// names of the basic shapes in the text scene format,
+	// in the same order as the MESH_ID values
+	const char* g_MeshNames[SceneFile::MESH_COUNT] =
+	{
+		"box",
+		"plane",
+		"cylinder",
+		"cylinder_notop",
+		"cone",
+		"sphere",
+		"halfsphere",
+		"pyramid4",
+		"taperedcylinder"
+	};
+
+	// round a file offset up to the next 16 byte boundary
+	uint32_t AlignOffset(size_t offset)
+	{
+		return((uint32_t)((offset + 15) & ~(size_t)15));
+	}
+
+	// find a tag in a tag table, adding it when it is new
+	int16_t FindOrAddTag(std::vector<std::string>& tags, const std::string& tag)
+	{
+		for (size_t i = 0; i < tags.size(); i++)
+		{
+			if (tags[i].compare(tag) == 0)
+			{
+				return((int16_t)i);
+			}
+		}
+		tags.push_back(tag);
+		return((int16_t)(tags.size() - 1));
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+	m_pHeader = NULL;
+	memset(&m_drawList, 0, sizeof(m_drawList));
+}
+
+/***********************************************************
+ *  ~SceneFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  ConvertTextScene()
+ *
+ *  This method is used for converting a scene from the text
+ *  form into the binary form.  The text form keeps the same
+ *  shader state as the scene manager did - the texture or
+ *  color, material and UV scale commands stay in effect for
+ *  all the following draw commands:
+ *
+ *    texture <tag>         draw with the tagged texture
+ *    color <r> <g> <b> <a> draw with a solid color
+ *    material <tag>        use the tagged object material
+ *    uvscale <u> <v>       set the texture UV scale
+ *    draw <mesh> <scale x y z> <rotation x y z> <position x y z>
+ *    group <tag> <scale x y z> <rotation x y z> <position x y z>
+ *    end                   close the innermost group
+ *
+ *  The transforms of the draw and group commands between a
+ *  group and its end are relative to that group, so the
+ *  whole group can be moved as one unit.  Everything after
+ *  a '#' is a comment.
+ ***********************************************************/
+bool SceneFile::ConvertTextScene(const char* textFilename, const char* binaryFilename)
+{
+	std::ifstream textFile(textFilename);
+	if (!textFile)
+	{
+		std::cout << "Could not open text scene:" << textFilename << std::endl;
+		return false;
+	}
+
+	// the current shader state of the text scene
+	int16_t currentTexture = -1;
+	int16_t currentMaterial = -1;
+	float currentUVScale[2] = { 1.0f, 1.0f };
+	float currentColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	std::vector<std::string> textureTags;
+	std::vector<std::string> materialTags;
+	std::vector<std::string> groupTags;
+	std::vector<int32_t> groupNodes;
+	// objects of the groups that are still open
+	std::vector<int32_t> openGroups;
+	std::vector<float> scales;
+	std::vector<float> rotations;
+	std::vector<float> positions;
+	std::vector<float> uvScales;
+	std::vector<float> colors;
+	std::vector<uint8_t> meshes;
+	std::vector<int16_t> textures;
+	std::vector<int16_t> materials;
+	std::vector<int32_t> parents;
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(textFile, line))
+	{
+		lineNumber++;
+
+		// strip comments and skip empty lines
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string command;
+		if (!(tokens >> command))
+		{
+			continue;
+		}
+
+		bool bValid = true;
+		if (command == "texture")
+		{
+			std::string tag;
+			bValid = (tokens >> tag) && (tag.length() < TAG_LENGTH);
+			if (bValid)
+			{
+				currentTexture = FindOrAddTag(textureTags, tag);
+			}
+		}
+		else if (command == "color")
+		{
+			bValid = (tokens >> currentColor[0] >> currentColor[1] >> currentColor[2] >> currentColor[3]) ? true : false;
+			currentTexture = -1;
+		}
+		else if (command == "material")
+		{
+			std::string tag;
+			bValid = (tokens >> tag) && (tag.length() < TAG_LENGTH);
+			if (bValid)
+			{
+				currentMaterial = FindOrAddTag(materialTags, tag);
+			}
+		}
+		else if (command == "uvscale")
+		{
+			bValid = (tokens >> currentUVScale[0] >> currentUVScale[1]) ? true : false;
+		}
+		else if ((command == "draw") || (command == "group"))
+		{
+			std::string name;
+			float values[9];
+
+			bValid = (tokens >> name) ? true : false;
+			for (int i = 0; (i < 9) && bValid; i++)
+			{
+				bValid = (tokens >> values[i]) ? true : false;
+			}
+
+			int meshID = -1;
+			if (command == "group")
+			{
+				// group tags must be unique to be found by name
+				size_t groupCount = groupTags.size();
+				if (bValid && (name.length() < TAG_LENGTH) &&
+					(FindOrAddTag(groupTags, name) == (int16_t)groupCount))
+				{
+					meshID = MESH_GROUP;
+					groupNodes.push_back((int32_t)meshes.size());
+				}
+			}
+			for (int i = 0; (i < MESH_COUNT) && bValid && (command == "draw"); i++)
+			{
+				if (name.compare(g_MeshNames[i]) == 0)
+				{
+					meshID = i;
+				}
+			}
+			if (meshID < 0)
+			{
+				bValid = false;
+			}
+
+			if (bValid)
+			{
+				parents.push_back(openGroups.empty() ? -1 : openGroups.back());
+				if (meshID == MESH_GROUP)
+				{
+					openGroups.push_back((int32_t)meshes.size());
+				}
+
+				scales.insert(scales.end(), values, values + 3);
+				rotations.insert(rotations.end(), values + 3, values + 6);
+				positions.insert(positions.end(), values + 6, values + 9);
+				uvScales.insert(uvScales.end(), currentUVScale, currentUVScale + 2);
+				colors.insert(colors.end(), currentColor, currentColor + 4);
+				meshes.push_back((uint8_t)meshID);
+				textures.push_back(currentTexture);
+				materials.push_back(currentMaterial);
+			}
+		}
+		else if (command == "end")
+		{
+			bValid = !openGroups.empty();
+			if (bValid)
+			{
+				openGroups.pop_back();
+			}
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			std::cout << textFilename << "(" << lineNumber << "): invalid scene command:" << line << std::endl;
+			return false;
+		}
+	}
+
+	if (!openGroups.empty())
+	{
+		std::cout << textFilename << ": a group is missing its end command" << std::endl;
+		return false;
+	}
+
+	// lay out the tag tables and arrays one after the other
+	SCENE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SCENE_MAGIC;
+	header.version = SCENE_VERSION;
+	header.objectCount = (uint32_t)meshes.size();
+	header.textureCount = (uint32_t)textureTags.size();
+	header.materialCount = (uint32_t)materialTags.size();
+	header.groupCount = (uint32_t)groupTags.size();
+
+	size_t objectCount = meshes.size();
+	header.textureTagOffset = AlignOffset(sizeof(SCENE_HEADER));
+	header.materialTagOffset = AlignOffset(header.textureTagOffset + textureTags.size() * TAG_LENGTH);
+	header.groupTagOffset = AlignOffset(header.materialTagOffset + materialTags.size() * TAG_LENGTH);
+	header.groupNodeOffset = AlignOffset(header.groupTagOffset + groupTags.size() * TAG_LENGTH);
+	header.scaleOffset = AlignOffset(header.groupNodeOffset + groupNodes.size() * sizeof(int32_t));
+	header.rotationOffset = AlignOffset(header.scaleOffset + objectCount * 3 * sizeof(float));
+	header.positionOffset = AlignOffset(header.rotationOffset + objectCount * 3 * sizeof(float));
+	header.uvScaleOffset = AlignOffset(header.positionOffset + objectCount * 3 * sizeof(float));
+	header.colorOffset = AlignOffset(header.uvScaleOffset + objectCount * 2 * sizeof(float));
+	header.meshOffset = AlignOffset(header.colorOffset + objectCount * 4 * sizeof(float));
+	header.textureOffset = AlignOffset(header.meshOffset + objectCount * sizeof(uint8_t));
+	header.materialOffset = AlignOffset(header.textureOffset + objectCount * sizeof(int16_t));
+	header.parentOffset = AlignOffset(header.materialOffset + objectCount * sizeof(int16_t));
+	header.fileSize = AlignOffset(header.parentOffset + objectCount * sizeof(int32_t));
+
+	std::vector<unsigned char> fileData(header.fileSize, 0);
+	unsigned char* pData = fileData.data();
+
+	memcpy(pData, &header, sizeof(header));
+	for (size_t i = 0; i < textureTags.size(); i++)
+	{
+		memcpy(pData + header.textureTagOffset + i * TAG_LENGTH, textureTags[i].c_str(), textureTags[i].length());
+	}
+	for (size_t i = 0; i < materialTags.size(); i++)
+	{
+		memcpy(pData + header.materialTagOffset + i * TAG_LENGTH, materialTags[i].c_str(), materialTags[i].length());
+	}
+	for (size_t i = 0; i < groupTags.size(); i++)
+	{
+		memcpy(pData + header.groupTagOffset + i * TAG_LENGTH, groupTags[i].c_str(), groupTags[i].length());
+	}
+	if (!groupNodes.empty())
+	{
+		memcpy(pData + header.groupNodeOffset, groupNodes.data(), groupNodes.size() * sizeof(int32_t));
+	}
+	if (objectCount > 0)
+	{
+		memcpy(pData + header.scaleOffset, scales.data(), scales.size() * sizeof(float));
+		memcpy(pData + header.rotationOffset, rotations.data(), rotations.size() * sizeof(float));
+		memcpy(pData + header.positionOffset, positions.data(), positions.size() * sizeof(float));
+		memcpy(pData + header.uvScaleOffset, uvScales.data(), uvScales.size() * sizeof(float));
+		memcpy(pData + header.colorOffset, colors.data(), colors.size() * sizeof(float));
+		memcpy(pData + header.meshOffset, meshes.data(), meshes.size() * sizeof(uint8_t));
+		memcpy(pData + header.textureOffset, textures.data(), textures.size() * sizeof(int16_t));
+		memcpy(pData + header.materialOffset, materials.data(), materials.size() * sizeof(int16_t));
+		memcpy(pData + header.parentOffset, parents.data(), parents.size() * sizeof(int32_t));
+	}
+
+	// the file is written beside the old one and renamed over
+	// it, so a failed write never leaves a torn binary scene
+	const std::string temporaryFilename = std::string(binaryFilename) + ".tmp";
+	bool bWritten = false;
+	{
+		std::ofstream binaryFile(temporaryFilename, std::ios::binary | std::ios::trunc);
+		if (!binaryFile)
+		{
+			std::cout << "Could not create binary scene:" << temporaryFilename << std::endl;
+			return false;
+		}
+		binaryFile.write((const char*)pData, fileData.size());
+		bWritten = !binaryFile.fail();
+	}
+	if (bWritten)
+	{
+		// rename does not replace an existing file everywhere
+		std::remove(binaryFilename);
+		bWritten = (0 == std::rename(temporaryFilename.c_str(), binaryFilename));
+	}
+	if (!bWritten)
+	{
+		std::remove(temporaryFilename.c_str());
+		std::cout << "Could not write binary scene:" << binaryFilename << std::endl;
+		return false;
+	}
+
+	std::cout << "Converted scene:" << textFilename << " to " << binaryFilename << ", objects:" << objectCount << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a binary scene file into
+ *  memory and pointing the draw list at its arrays.
+ ***********************************************************/
+bool SceneFile::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == fileHandle)
+	{
+		std::cout << "Could not open binary scene:" << filename << std::endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == mappingHandle)
+	{
+		CloseHandle(fileHandle);
+		std::cout << "Could not map binary scene:" << filename << std::endl;
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_mappingHandle = mappingHandle;
+	m_mappingSize = (size_t)fileSize.QuadPart;
+	m_pMapping = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fileDescriptor = open(filename, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		std::cout << "Could not open binary scene:" << filename << std::endl;
+		return false;
+	}
+	struct stat fileInfo;
+	fstat(fileDescriptor, &fileInfo);
+	m_mappingSize = (size_t)fileInfo.st_size;
+
+	void* pMapping = MAP_FAILED;
+	if (m_mappingSize > 0)
+	{
+		pMapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(fileDescriptor);
+	m_pMapping = (MAP_FAILED == pMapping) ? NULL : (const unsigned char*)pMapping;
+#endif
+
+	if (NULL == m_pMapping)
+	{
+		std::cout << "Could not map binary scene:" << filename << std::endl;
+		Close();
+		return false;
+	}
+
+	m_pHeader = (const SCENE_HEADER*)m_pMapping;
+	if (!ValidateHeader())
+	{
+		std::cout << "Invalid binary scene:" << filename << std::endl;
+		Close();
+		return false;
+	}
+
+	m_drawList.count = m_pHeader->objectCount;
+	m_drawList.scale = (const float*)(m_pMapping + m_pHeader->scaleOffset);
+	m_drawList.rotation = (const float*)(m_pMapping + m_pHeader->rotationOffset);
+	m_drawList.position = (const float*)(m_pMapping + m_pHeader->positionOffset);
+	m_drawList.uvScale = (const float*)(m_pMapping + m_pHeader->uvScaleOffset);
+	m_drawList.color = (const float*)(m_pMapping + m_pHeader->colorOffset);
+	m_drawList.mesh = (const uint8_t*)(m_pMapping + m_pHeader->meshOffset);
+	m_drawList.texture = (const int16_t*)(m_pMapping + m_pHeader->textureOffset);
+	m_drawList.material = (const int16_t*)(m_pMapping + m_pHeader->materialOffset);
+	m_drawList.parent = (const int32_t*)(m_pMapping + m_pHeader->parentOffset);
+
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the opened scene file.
+ ***********************************************************/
+void SceneFile::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pMapping)
+	{
+		UnmapViewOfFile(m_pMapping);
+	}
+	if (NULL != m_mappingHandle)
+	{
+		CloseHandle((HANDLE)m_mappingHandle);
+	}
+	if (NULL != m_fileHandle)
+	{
+		CloseHandle((HANDLE)m_fileHandle);
+	}
+#else
+	if (NULL != m_pMapping)
+	{
+		munmap((void*)m_pMapping, m_mappingSize);
+	}
+#endif
+
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+	m_pHeader = NULL;
+	memset(&m_drawList, 0, sizeof(m_drawList));
+}
+
+/***********************************************************
+ *  ValidateHeader()
+ *
+ *  This method is used for checking that the header of the
+ *  mapped file is a known version and that every array it
+ *  describes lies inside of the file.  The per-object values
+ *  are range checked when they are used instead, so opening
+ *  a scene never has to touch all of its pages.
+ ***********************************************************/
+bool SceneFile::ValidateHeader() const
+{
+	if (m_mappingSize < sizeof(SCENE_HEADER))
+	{
+		return false;
+	}
+	if ((m_pHeader->magic != SCENE_MAGIC) ||
+		(m_pHeader->version != SCENE_VERSION) ||
+		(m_pHeader->fileSize > m_mappingSize))
+	{
+		return false;
+	}
+
+	const uint64_t objectCount = m_pHeader->objectCount;
+	const struct
+	{
+		uint32_t offset;
+		uint64_t size;
+	} arrays[] =
+	{
+		{ m_pHeader->textureTagOffset, (uint64_t)m_pHeader->textureCount * TAG_LENGTH },
+		{ m_pHeader->materialTagOffset, (uint64_t)m_pHeader->materialCount * TAG_LENGTH },
+		{ m_pHeader->groupTagOffset, (uint64_t)m_pHeader->groupCount * TAG_LENGTH },
+		{ m_pHeader->groupNodeOffset, (uint64_t)m_pHeader->groupCount * sizeof(int32_t) },
+		{ m_pHeader->scaleOffset, objectCount * 3 * sizeof(float) },
+		{ m_pHeader->rotationOffset, objectCount * 3 * sizeof(float) },
+		{ m_pHeader->positionOffset, objectCount * 3 * sizeof(float) },
+		{ m_pHeader->uvScaleOffset, objectCount * 2 * sizeof(float) },
+		{ m_pHeader->colorOffset, objectCount * 4 * sizeof(float) },
+		{ m_pHeader->meshOffset, objectCount * sizeof(uint8_t) },
+		{ m_pHeader->textureOffset, objectCount * sizeof(int16_t) },
+		{ m_pHeader->materialOffset, objectCount * sizeof(int16_t) },
+		{ m_pHeader->parentOffset, objectCount * sizeof(int32_t) }
+	};
+
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+	{
+		if (((arrays[i].offset & 15) != 0) ||
+			((uint64_t)arrays[i].offset + arrays[i].size > m_pHeader->fileSize))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  GetTag()
+ *
+ *  This method is used for reading a tag out of one of the
+ *  tag tables.  The tables were checked to lie inside of the
+ *  mapping when the file was opened, and a tag that fills
+ *  its whole slot without a terminating NUL is returned as
+ *  an empty tag, so it is never read past its slot.
+ ***********************************************************/
+const char* SceneFile::GetTag(uint32_t tableOffset, int index) const
+{
+	const char* tag = (const char*)(m_pMapping + tableOffset + (size_t)index * TAG_LENGTH);
+	if (NULL == memchr(tag, '\0', TAG_LENGTH))
+	{
+		return("");
+	}
+	return(tag);
+}
+
+/***********************************************************
+ *  GetTextureCount() / GetTextureTag()
+ *
+ *  These methods are used for reading the table of texture
+ *  tags that the per-object texture indices refer to.
+ ***********************************************************/
+int SceneFile::GetTextureCount() const
+{
+	return((NULL != m_pHeader) ? (int)m_pHeader->textureCount : 0);
+}
+
+const char* SceneFile::GetTextureTag(int index) const
+{
+	if ((index < 0) || (index >= GetTextureCount()))
+	{
+		return("");
+	}
+	return(GetTag(m_pHeader->textureTagOffset, index));
+}
+
+/***********************************************************
+ *  GetMaterialCount() / GetMaterialTag()
+ *
+ *  These methods are used for reading the table of material
+ *  tags that the per-object material indices refer to.
+ ***********************************************************/
+int SceneFile::GetMaterialCount() const
+{
+	return((NULL != m_pHeader) ? (int)m_pHeader->materialCount : 0);
+}
+
+const char* SceneFile::GetMaterialTag(int index) const
+{
+	if ((index < 0) || (index >= GetMaterialCount()))
+	{
+		return("");
+	}
+	return(GetTag(m_pHeader->materialTagOffset, index));
+}
+
+/***********************************************************
+ *  GetGroupCount() / GetGroupTag() / GetGroupNode()
+ *
+ *  These methods are used for finding the objects of the
+ *  named groups, so that a group can be moved as one unit.
+ *  A node index outside of the draw list is returned as -1.
+ ***********************************************************/
+int SceneFile::GetGroupCount() const
+{
+	return((NULL != m_pHeader) ? (int)m_pHeader->groupCount : 0);
+}
+
+const char* SceneFile::GetGroupTag(int index) const
+{
+	if ((index < 0) || (index >= GetGroupCount()))
+	{
+		return("");
+	}
+	return(GetTag(m_pHeader->groupTagOffset, index));
+}
+
+int SceneFile::GetGroupNode(int index) const
+{
+	if ((index < 0) || (index >= GetGroupCount()))
+	{
+		return(-1);
+	}
+
+	int32_t node = ((const int32_t*)(m_pMapping + m_pHeader->groupNodeOffset))[index];
+	if ((node < 0) || ((uint32_t)node >= m_pHeader->objectCount))
+	{
+		return(-1);
+	}
+	return(node);
+}
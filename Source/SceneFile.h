@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// memory mapped binary scene files and the text to binary scene converter
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class maps a binary scene file into memory and
+ *  exposes its flat arrays as a structure-of-arrays draw
+ *  list.  Nothing is parsed or copied when a scene is
+ *  opened - the arrays point straight into the mapping, so
+ *  the cost of loading a scene is the page-in of the parts
+ *  that are actually read.
+ *
+ *  Binary scenes are generated from the readable text form
+ *  by ConvertTextScene().
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+	// destructor
+	~SceneFile();
+
+	// identifiers of the basic shapes - stored in the file,
+	// so new shapes must only ever be added at the end
+	enum MESH_ID
+	{
+		MESH_BOX = 0,
+		MESH_PLANE,
+		MESH_CYLINDER,
+		MESH_CYLINDER_NO_TOP,
+		MESH_CONE,
+		MESH_SPHERE,
+		MESH_HALF_SPHERE,
+		MESH_PYRAMID4,
+		MESH_TAPERED_CYLINDER,
+		MESH_COUNT,
+		// a group node only carries a transform for its children
+		MESH_GROUP = 0xFF
+	};
+
+	// identifies a binary scene file and its layout version
+	static const uint32_t SCENE_MAGIC = 0x424E4353;	// "SCNB"
+	static const uint32_t SCENE_VERSION = 2;
+	// fixed length of the texture, material and group tag strings
+	static const int TAG_LENGTH = 32;
+
+	// header at the start of a binary scene file - all the
+	// offsets are in bytes from the start of the file and
+	// every array starts on a 16 byte boundary
+	struct SCENE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t objectCount;
+		uint32_t textureCount;
+		uint32_t materialCount;
+		uint32_t groupCount;
+		uint32_t textureTagOffset;		// char[TAG_LENGTH] per texture
+		uint32_t materialTagOffset;		// char[TAG_LENGTH] per material
+		uint32_t groupTagOffset;		// char[TAG_LENGTH] per group
+		uint32_t groupNodeOffset;		// int32_t object index per group
+		uint32_t scaleOffset;			// float[3] per object
+		uint32_t rotationOffset;		// float[3] per object, degrees
+		uint32_t positionOffset;		// float[3] per object
+		uint32_t uvScaleOffset;			// float[2] per object
+		uint32_t colorOffset;			// float[4] per object
+		uint32_t meshOffset;			// uint8_t per object
+		uint32_t textureOffset;			// int16_t per object, -1 for color
+		uint32_t materialOffset;		// int16_t per object, -1 for none
+		uint32_t parentOffset;			// int32_t per object, -1 for a root
+		uint32_t fileSize;
+	};
+
+	// structure-of-arrays view of the objects in the scene -
+	// transforms are relative to the parent object, and every
+	// parent comes before its children
+	struct DRAW_LIST
+	{
+		uint32_t count;
+		const float* scale;
+		const float* rotation;
+		const float* position;
+		const float* uvScale;
+		const float* color;
+		const uint8_t* mesh;
+		const int16_t* texture;
+		const int16_t* material;
+		const int32_t* parent;
+	};
+
+	// convert a text scene into a binary scene file
+	static bool ConvertTextScene(const char* textFilename, const char* binaryFilename);
+
+	// map a binary scene file into memory
+	bool Open(const char* filename);
+	// unmap the currently opened scene file
+	void Close();
+
+	// get the draw list of the opened scene
+	const DRAW_LIST& GetDrawList() const { return(m_drawList); }
+	// get the texture and material tags referenced by the scene
+	int GetTextureCount() const;
+	const char* GetTextureTag(int index) const;
+	int GetMaterialCount() const;
+	const char* GetMaterialTag(int index) const;
+	// get the named groups of the scene and their objects
+	int GetGroupCount() const;
+	const char* GetGroupTag(int index) const;
+	int GetGroupNode(int index) const;
+
+private:
+	// start and size of the mapped file
+	const unsigned char* m_pMapping;
+	size_t m_mappingSize;
+	// operating system handles of the mapping
+	void* m_fileHandle;
+	void* m_mappingHandle;
+	// header of the mapped file
+	const SCENE_HEADER* m_pHeader;
+	// arrays of the mapped file
+	DRAW_LIST m_drawList;
+
+	// check that the header describes a valid file
+	bool ValidateHeader() const;
+	// get a tag of a tag table, or an empty one when it is not
+	// terminated inside of its slot
+	const char* GetTag(uint32_t tableOffset, int index) const;
+};
@@ -8,22 +8,58 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
-
-#ifndef STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#endif
+#include "ShapeGeometry.h"
+#include "Profiler.h"
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <sys/stat.h>
+
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureLayerName = "textureLayer";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UVscaleName = "UVscale";
+	const char* g_MaterialDiffuseName = "material.diffuseColor";
+	const char* g_MaterialSpecularName = "material.specularColor";
+	const char* g_MaterialShininessName = "material.shininess";
+	const char* g_UseInstancingName = "bUseInstancing";
+
+	// distance from the camera that maps to the far end of the
+	// depth field of the render queue keys - the far plane
+	const float g_SortDepthRange = 100.0f;
+
+	// texture unit the texture arrays are bound to
+	const int g_TextureUnit = 0;
+	// closest distance used for the screen size of a draw, so
+	// that objects around the camera do not ask for more than
+	// the full size of their texture on every frame
+	const float g_MinTextureDistance = 0.1f;
+
+	// smallest size of an occluder over its distance from the
+	// camera - smaller boxes hide too little to be worth
+	// rasterizing
+	const float g_MinOccluderSize = 0.2f;
+
+	/***********************************************************
+	 *  IsLargerOccluder()
+	 *
+	 *  This function is used for ordering the occluder
+	 *  candidates from the largest on the screen down.
+	 ***********************************************************/
+	bool IsLargerOccluder(const SceneManager::OCCLUDER_CANDIDATE& a, const SceneManager::OCCLUDER_CANDIDATE& b)
+	{
+		return(a.score > b.score);
+	}
 }
 
 /***********************************************************
@@ -31,17 +67,51 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, UniformCache* pUniformCache, GLStateCache* pStateCache, StreamRing* pStreamRing)
 {
 	m_pShaderManager = pShaderManager;
+	m_pUniformCache = pUniformCache;
+	m_pStateCache = pStateCache;
 	m_basicMeshes = new ShapeMeshes();
-
-	for (int i = 0; i < 16; i++)
-	{
-		m_textureIDs[i].tag = "/0";
-		m_textureIDs[i].ID = -1;
-	}
-	m_loadedTextures = 0;
+	m_lightRig = new LightRig(pStateCache);
+
+	// register the per-draw uniforms so that their locations
+	// are only looked up once instead of on every draw
+	m_modelUniform = m_pUniformCache->Register<glm::mat4>(g_ModelName);
+	m_colorValueUniform = m_pUniformCache->Register<glm::vec4>(g_ColorValueName);
+	m_textureValueUniform = m_pUniformCache->Register<int>(g_TextureValueName);
+	m_textureLayerUniform = m_pUniformCache->Register<int>(g_TextureLayerName);
+	m_useTextureUniform = m_pUniformCache->Register<bool>(g_UseTextureName);
+	m_useLightingUniform = m_pUniformCache->Register<bool>(g_UseLightingName);
+	m_UVscaleUniform = m_pUniformCache->Register<glm::vec2>(g_UVscaleName);
+	m_materialDiffuseUniform = m_pUniformCache->Register<glm::vec3>(g_MaterialDiffuseName);
+	m_materialSpecularUniform = m_pUniformCache->Register<glm::vec3>(g_MaterialSpecularName);
+	m_materialShininessUniform = m_pUniformCache->Register<float>(g_MaterialShininessName);
+	m_useInstancingUniform = m_pUniformCache->Register<bool>(g_UseInstancingName);
+
+	m_pTextureManager = new TextureManager(pStateCache);
+	m_pSceneFile = NULL;
+	m_pTransformStore = new TransformStore();
+	m_pRenderQueue = new RenderQueue();
+	m_pFrustumCuller = new FrustumCuller();
+	m_pSceneBVH = new SceneBVH();
+	m_pOcclusionCuller = new OcclusionCuller();
+	m_pLodSelector = new LodSelector();
+	m_pInstancedMeshes = new InstancedMeshes(pStateCache, pStreamRing);
+	m_pMaterialBuffer = new MaterialBuffer(pStateCache);
+	m_bUseInstancing = true;
+	m_bInstancingAvailable = false;
+	m_frameDrawCalls = 0;
+	m_bSceneDirty = true;
+	m_pSceneChangeCallback = NULL;
+	m_drawnViewProjection = glm::mat4(0.0f);
+	m_viewPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_projectionScale = 0.0f;
+	m_bPerspectiveView = true;
+	m_viewProjection = glm::mat4(1.0f);
+	m_bViewProjectionValid = false;
+	m_bUseCulling = true;
+	m_bUseOcclusionCulling = true;
 }
 
 /***********************************************************
@@ -53,140 +123,94 @@ SceneManager::~SceneManager()
 {
 	// clear the allocated memory
 	m_pShaderManager = NULL;
+	m_pUniformCache = NULL;
+	m_pStateCache = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	delete m_lightRig;
+	m_lightRig = NULL;
+	delete m_pSceneFile;
+	m_pSceneFile = NULL;
+	delete m_pTransformStore;
+	m_pTransformStore = NULL;
+	delete m_pRenderQueue;
+	m_pRenderQueue = NULL;
+	delete m_pFrustumCuller;
+	m_pFrustumCuller = NULL;
+	delete m_pSceneBVH;
+	m_pSceneBVH = NULL;
+	delete m_pOcclusionCuller;
+	m_pOcclusionCuller = NULL;
+	delete m_pLodSelector;
+	m_pLodSelector = NULL;
+	delete m_pInstancedMeshes;
+	m_pInstancedMeshes = NULL;
+	delete m_pMaterialBuffer;
+	m_pMaterialBuffer = NULL;
 	// destroy the created OpenGL textures
 	DestroyGLTextures();
+	delete m_pTextureManager;
+	m_pTextureManager = NULL;
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for queueing textures from image files
+ *  and associating them with the passed in tag.  The images
+ *  are decoded and sent to OpenGL after BindGLTextures().
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-
-		return true;
-	}
-
-	std::cout << "Could not load image:" << filename << std::endl;
-
-	// Error loading the image
-	return false;
+	return(m_pTextureManager->LoadTexture(filename, tag));
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for packing the loaded textures into
+ *  OpenGL texture arrays.  The arrays share one texture unit
+ *  and are bound when a draw needs them, so any number of
+ *  textures can be loaded.  The images are decoded in the
+ *  background and reach their layers during the first frames.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (false == m_pTextureManager->CreateArrays())
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		std::cout << "Could not create the texture arrays" << std::endl;
 	}
+
+	m_pUniformCache->Set(m_textureValueUniform, g_TextureUnit);
 }
 
 /***********************************************************
  *  DestroyGLTextures()
  *
  *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  texture arrays.
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	m_pTextureManager->DestroyTextures();
 }
 
 /***********************************************************
  *  FindTextureID()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for getting the ID of the texture
+ *  array holding the previously loaded texture bitmap
+ *  associated with the passed in tag.
  ***********************************************************/
 int SceneManager::FindTextureID(std::string tag)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	const int texture = m_pTextureManager->FindTexture(tag);
+	if ((texture < 0) || (m_pTextureManager->GetTextureArray(texture) < 0))
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
 
-	return(textureID);
+	return((int)m_pTextureManager->GetArrayID(m_pTextureManager->GetTextureArray(texture)));
 }
 
 /***********************************************************
@@ -197,60 +221,7 @@ int SceneManager::FindTextureID(std::string tag)
  ***********************************************************/
 int SceneManager::FindTextureSlot(std::string tag)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
-	}
-
-	return(textureSlot);
-}
-
-/***********************************************************
- *  SetTransformations()
- *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
- ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
-{
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
-
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	return(m_pTextureManager->FindTexture(tag));
 }
 
 /***********************************************************
@@ -273,10 +244,10 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
+	if (NULL != m_pUniformCache)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		m_pUniformCache->Set(m_useTextureUniform, false);
+		m_pUniformCache->Set(m_colorValueUniform, currentColor);
 	}
 }
 
@@ -289,13 +260,29 @@ void SceneManager::SetShaderColor(
 void SceneManager::SetShaderTexture(
 	std::string textureTag)
 {
-	if (NULL != m_pShaderManager)
+	SetShaderTextureSlot(FindTextureSlot(textureTag));
+}
+
+/***********************************************************
+ *  SetShaderTextureSlot()
+ *
+ *  This method is used for setting the texture in the passed
+ *  in slot into the shader, binding its texture array and
+ *  selecting its layer.
+ ***********************************************************/
+void SceneManager::SetShaderTextureSlot(
+	int textureSlot)
+{
+	if (NULL != m_pUniformCache)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		m_pUniformCache->Set(m_useTextureUniform, true);
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		// an unknown tag keeps the previously set texture
+		if ((textureSlot >= 0) && (textureSlot < m_pTextureManager->GetTextureCount()))
+		{
+			m_pTextureManager->BindArray(m_pTextureManager->GetTextureArray(textureSlot), g_TextureUnit);
+			m_pUniformCache->Set(m_textureLayerUniform, m_pTextureManager->GetTextureLayer(textureSlot));
+		}
 	}
 }
 
@@ -307,9 +294,9 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
+	if (NULL != m_pUniformCache)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_pUniformCache->Set(m_UVscaleUniform, glm::vec2(u, v));
 	}
 }
 
@@ -348,6 +335,24 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 	return(true);
 }
 
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index of the defined
+ *  material associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(std::string tag)
+{
+	for (int index = 0; index < (int)m_objectMaterials.size(); index++)
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			return(index);
+		}
+	}
+
+	return(-1);
+}
 
 /***********************************************************
  *  SetShaderMaterial()
@@ -368,11 +373,231 @@ void SceneManager::SetShaderMaterial(
 		if (bReturn == true)
 		{
 			// pass the material properties into the shader
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			m_pUniformCache->Set(m_materialDiffuseUniform, material.diffuseColor);
+			m_pUniformCache->Set(m_materialSpecularUniform, material.specularColor);
+			m_pUniformCache->Set(m_materialShininessUniform, material.shininess);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetShaderMaterialIndex()
+ *
+ *  This method is used for passing the values of the defined
+ *  material at the passed in index into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterialIndex(
+	int materialIndex)
+{
+	if ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size()))
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[materialIndex];
+
+		m_pUniformCache->Set(m_materialDiffuseUniform, material.diffuseColor);
+		m_pUniformCache->Set(m_materialSpecularUniform, material.specularColor);
+		m_pUniformCache->Set(m_materialShininessUniform, material.shininess);
+	}
+}
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method is used for mapping the binary scene file
+ *  that is rendered every frame.  The binary file is first
+ *  regenerated from the text form when it is missing or
+ *  older than the text file, or was written by an older
+ *  version.  The texture and material tags of the scene are
+ *  resolved once here, so rendering only has to look up the
+ *  resolved values by index, and the object transforms are
+ *  copied into the transform store.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile(
+	const char* textFilename,
+	const char* binaryFilename)
+{
+	PROFILE_ZONE("SceneManager::LoadSceneFile");
+
+	struct stat textInfo;
+	struct stat binaryInfo;
+	bool bTextExists = (0 == stat(textFilename, &textInfo));
+	bool bBinaryExists = (0 == stat(binaryFilename, &binaryInfo));
+
+	if (bTextExists &&
+		((false == bBinaryExists) || (binaryInfo.st_mtime < textInfo.st_mtime)))
+	{
+		if (false == SceneFile::ConvertTextScene(textFilename, binaryFilename))
+		{
+			return false;
+		}
+	}
+
+	if (NULL == m_pSceneFile)
+	{
+		m_pSceneFile = new SceneFile();
+	}
+	if (false == m_pSceneFile->Open(binaryFilename))
+	{
+		if ((false == bTextExists) ||
+			(false == SceneFile::ConvertTextScene(textFilename, binaryFilename)) ||
+			(false == m_pSceneFile->Open(binaryFilename)))
+		{
+			// without a mapped file the scene is not drawn at all
+			delete m_pSceneFile;
+			m_pSceneFile = NULL;
+			return false;
+		}
+	}
+
+	m_sceneTextureSlots.resize(m_pSceneFile->GetTextureCount());
+	for (int i = 0; i < m_pSceneFile->GetTextureCount(); i++)
+	{
+		m_sceneTextureSlots[i] = FindTextureSlot(m_pSceneFile->GetTextureTag(i));
+		if (m_sceneTextureSlots[i] < 0)
+		{
+			std::cout << "Scene texture is not loaded:" << m_pSceneFile->GetTextureTag(i) << std::endl;
+		}
+	}
+
+	m_sceneMaterialIndices.resize(m_pSceneFile->GetMaterialCount());
+	for (int i = 0; i < m_pSceneFile->GetMaterialCount(); i++)
+	{
+		m_sceneMaterialIndices[i] = FindMaterialIndex(m_pSceneFile->GetMaterialTag(i));
+		if (m_sceneMaterialIndices[i] < 0)
+		{
+			std::cout << "Scene material is not defined:" << m_pSceneFile->GetMaterialTag(i) << std::endl;
+		}
+	}
+
+	const SceneFile::DRAW_LIST& drawList = m_pSceneFile->GetDrawList();
+	m_pTransformStore->Clear();
+	m_pTransformStore->Reserve(drawList.count);
+	for (uint32_t i = 0; i < drawList.count; i++)
+	{
+		const float* scale = drawList.scale + i * 3;
+		const float* rotation = drawList.rotation + i * 3;
+		const float* position = drawList.position + i * 3;
+
+		m_pTransformStore->AddNode(
+			drawList.parent[i],
+			glm::vec3(scale[0], scale[1], scale[2]),
+			glm::vec3(rotation[0], rotation[1], rotation[2]),
+			glm::vec3(position[0], position[1], position[2]));
+	}
+
+	// every shape gets the box around its mesh, which is moved
+	// into world space once its world matrix is built
+	m_pFrustumCuller->Clear();
+	m_pFrustumCuller->Resize(drawList.count);
+	m_pSceneBVH->Clear();
+	m_pSceneBVH->Resize(drawList.count);
+	m_pOcclusionCuller->Resize(drawList.count);
+	m_pLodSelector->Resize(drawList.count);
+	for (uint32_t i = 0; i < drawList.count; i++)
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		if (ShapeGeometry::GetMeshBounds(drawList.mesh[i], boundsMin, boundsMax))
+		{
+			m_pFrustumCuller->SetLocalBounds(i, boundsMin, boundsMax);
 		}
 	}
+
+	return true;
+}
+
+/***********************************************************
+ *  MarkSceneChanged()
+ *
+ *  This method is used for marking the scene as changed, so
+ *  the next frame is drawn even when the camera stays where
+ *  it is, and calling the scene change callback, which wakes
+ *  up a render thread that sleeps until something changes.
+ ***********************************************************/
+void SceneManager::MarkSceneChanged()
+{
+	m_bSceneDirty = true;
+	if (NULL != m_pSceneChangeCallback)
+	{
+		m_pSceneChangeCallback();
+	}
+}
+
+/***********************************************************
+ *  SetSceneGroupTransform()
+ *
+ *  This method is used for changing the transform of one of
+ *  the named groups of the scene file.  Only the matrices of
+ *  the group and its children are rebuilt on the next frame.
+ ***********************************************************/
+bool SceneManager::SetSceneGroupTransform(
+	std::string groupTag,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	if (NULL == m_pSceneFile)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < m_pSceneFile->GetGroupCount(); i++)
+	{
+		if (groupTag.compare(m_pSceneFile->GetGroupTag(i)) == 0)
+		{
+			m_pTransformStore->SetLocalTransform(
+				m_pSceneFile->GetGroupNode(i),
+				scaleXYZ,
+				rotationDegreesXYZ,
+				positionXYZ);
+			MarkSceneChanged();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/***********************************************************
+ *  DrawSceneMesh()
+ *
+ *  This method is used for drawing the basic shape with the
+ *  passed in scene file mesh ID.
+ ***********************************************************/
+void SceneManager::DrawSceneMesh(
+	int meshID)
+{
+	switch (meshID)
+	{
+	case SceneFile::MESH_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case SceneFile::MESH_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case SceneFile::MESH_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh();
+		break;
+	case SceneFile::MESH_CYLINDER_NO_TOP:
+		m_basicMeshes->DrawCylinderMesh(false, true, true);
+		break;
+	case SceneFile::MESH_CONE:
+		m_basicMeshes->DrawConeMesh();
+		break;
+	case SceneFile::MESH_SPHERE:
+		m_basicMeshes->DrawSphereMesh();
+		break;
+	case SceneFile::MESH_HALF_SPHERE:
+		m_basicMeshes->DrawHalfSphereMesh();
+		break;
+	case SceneFile::MESH_PYRAMID4:
+		m_basicMeshes->DrawPyramid4Mesh();
+		break;
+	case SceneFile::MESH_TAPERED_CYLINDER:
+		m_basicMeshes->DrawTaperedCylinderMesh();
+		break;
+	default:
+		break;
+	}
 }
 
 
@@ -388,6 +613,8 @@ void SceneManager::SetShaderMaterial(
 
 void SceneManager::LoadSceneTextures() {
 
+	PROFILE_ZONE("SceneManager::LoadSceneTextures");
+
 	bool bReturn = false;
 
 
@@ -460,6 +687,8 @@ void SceneManager::LoadSceneTextures() {
  ***********************************************************/
 void SceneManager::DefineObjectMaterials()
 {
+	PROFILE_ZONE("SceneManager::DefineObjectMaterials");
+
 	OBJECT_MATERIAL goldMaterial;
 	goldMaterial.diffuseColor = glm::vec3(0.8f, 0.8f, 0.0f); // Increase diffuse color
 	goldMaterial.specularColor = glm::vec3(1.0f, 1.0f, 0.8f); // Increase specular color
@@ -511,61 +740,71 @@ void SceneManager::DefineObjectMaterials()
 
 void SceneManager::SetupSceneLights()
 {
+	PROFILE_ZONE("SceneManager::SetupSceneLights");
+
 	// this line of code is NEEDED for telling the shaders to render 
 	// the 3D scene with custom lighting - to use the default rendered 
 	// lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_pUniformCache->Set(m_useLightingUniform, true);
+
+	// the light values are kept in a uniform buffer so that
+	// changing a light later only uploads the changed bytes
+	m_lightRig->CreateLightBuffer(m_pUniformCache->GetProgramID());
 
 	// directional light to emulate sunlight coming into scene
-	m_pShaderManager->setVec3Value("directionalLight.direction", -0.05f, -0.3f, -0.1f);
-	m_pShaderManager->setVec3Value("directionalLight.ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", 0.6f, 0.6f, 0.6f);
-	m_pShaderManager->setVec3Value("directionalLight.specular", 0.0f, 0.0f, 0.0f);
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+	m_lightRig->SetDirectionalLight(
+		glm::vec3(-0.05f, -0.3f, -0.1f),	// direction
+		glm::vec3(0.05f, 0.05f, 0.05f),		// ambient
+		glm::vec3(0.6f, 0.6f, 0.6f),		// diffuse
+		glm::vec3(0.0f, 0.0f, 0.0f),		// specular
+		true);
 
 	// point light 1
-	m_pShaderManager->setVec3Value("pointLights[0].position", -4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	m_lightRig->AddPointLight(
+		glm::vec3(-4.0f, 8.0f, 0.0f),		// position
+		glm::vec3(0.05f, 0.05f, 0.05f),		// ambient
+		glm::vec3(0.3f, 0.3f, 0.3f),		// diffuse
+		glm::vec3(0.1f, 0.1f, 0.1f),		// specular
+		true);
 	// point light 2
-	m_pShaderManager->setVec3Value("pointLights[1].position", 4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	m_lightRig->AddPointLight(
+		glm::vec3(4.0f, 8.0f, 0.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.3f, 0.3f, 0.3f),
+		glm::vec3(0.1f, 0.1f, 0.1f),
+		true);
 	// point light 3
-	m_pShaderManager->setVec3Value("pointLights[2].position", 3.8f, 5.5f, 4.0f);
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("pointLights[2].specular", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
-	
-
-
-	// point light 5
+	m_lightRig->AddPointLight(
+		glm::vec3(3.8f, 5.5f, 4.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.2f, 0.2f, 0.2f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		true);
 
 	//used to illuminate the backdrop
-	m_pShaderManager->setVec3Value("pointLights[4].position", -3.2f, 6.0f, -4.0f);
-	m_pShaderManager->setVec3Value("pointLights[4].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[4].diffuse", 0.9f, 0.9f, 0.9f);
-	m_pShaderManager->setVec3Value("pointLights[4].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[4].bActive", true);
-
+	m_lightRig->AddPointLight(
+		glm::vec3(-3.2f, 6.0f, -4.0f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.9f, 0.9f, 0.9f),
+		glm::vec3(0.1f, 0.1f, 0.1f),
+		true);
 
 	// Spotlight to cover all objects
-	m_pShaderManager->setVec3Value("spotLight.position", 0.0f, 10.0f, 0.0f); // Position above the center of the scene
-	m_pShaderManager->setVec3Value("spotLight.direction", 0.0f, -1.0f, 0.0f); // Pointing downwards
-	m_pShaderManager->setVec3Value("spotLight.ambient", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setVec3Value("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setVec3Value("spotLight.specular", 0.7f, 0.7f, 0.7f);
-	m_pShaderManager->setFloatValue("spotLight.constant", 1.0f);
-	m_pShaderManager->setFloatValue("spotLight.linear", 0.09f);
-	m_pShaderManager->setFloatValue("spotLight.quadratic", 0.032f);
-	m_pShaderManager->setFloatValue("spotLight.cutOff", glm::cos(glm::radians(45.0f))); // Wide cutoff angle
-	m_pShaderManager->setFloatValue("spotLight.outerCutOff", glm::cos(glm::radians(50.0f))); // Wide outer cutoff angle
-	m_pShaderManager->setBoolValue("spotLight.bActive", true);
+	m_lightRig->SetSpotLight(
+		glm::vec3(0.0f, 10.0f, 0.0f),		// position above the center of the scene
+		glm::vec3(0.0f, -1.0f, 0.0f),		// pointing downwards
+		glm::vec3(0.8f, 0.8f, 0.8f),		// ambient
+		glm::vec3(1.0f, 1.0f, 1.0f),		// diffuse
+		glm::vec3(0.7f, 0.7f, 0.7f),		// specular
+		1.0f,								// constant
+		0.09f,								// linear
+		0.032f,								// quadratic
+		45.0f,								// wide cutoff angle
+		50.0f,								// wide outer cutoff angle
+		true);
+
+	// send the whole light block once
+	m_lightRig->UploadDirtyRange();
 }
 
 
@@ -580,6 +819,8 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {	
+	PROFILE_ZONE("SceneManager::PrepareScene");
+
 	//loads the textures from textures folder for scene
 	LoadSceneTextures();
 
@@ -603,8 +844,28 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadPyramid4Mesh();
 	m_basicMeshes->LoadConeMesh();
 	m_basicMeshes->LoadTaperedCylinderMesh();
-	
 
+	// the instanced draws use their own copy of the shapes and
+	// read the materials from the material block
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
+	{
+		m_pMaterialBuffer->SetMaterial(
+			i,
+			m_objectMaterials[i].diffuseColor,
+			m_objectMaterials[i].specularColor,
+			m_objectMaterials[i].shininess);
+	}
+	m_bInstancingAvailable =
+		m_pMaterialBuffer->CreateMaterialBuffer(m_pUniformCache->GetProgramID()) &&
+		m_pInstancedMeshes->CreateMeshes();
+
+	// load the objects of the scene - the texture and material
+	// tags are resolved here, so it must come after both
+	bool bReturn = LoadSceneFile("scenes/desk.scene", "scenes/desk.bscene");
+	if (false == bReturn)
+	{
+		std::cout << "Could not load scene file:" << "scenes/desk.bscene" << std::endl;
+	}
 }
 
 /***********************************************************
@@ -615,1030 +876,526 @@ void SceneManager::PrepareScene()
  ***********************************************************/
 void SceneManager::RenderScene()
 {
+	PROFILE_ZONE("SceneManager::RenderScene");
 
-	//This will render the objects for each section of the scene
-	RenderWaterBottle();
-	RenderBackDrop();
-	RenderPhoneHolder();
-	RenderDesk();
-	RenderBook();
-	RenderMonitors();
-	RenderMouse();
-	RenderKeyBoard();
-}
-
-void SceneManager::RenderBackDrop() {
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Set needed transformations before drawing the basic mesh
-	scaleXYZ = glm::vec3(50.0f, 50.0f, 50.0f);
-	XrotationDegrees = 90.0f;
-	positionXYZ = glm::vec3(0.0f, 0.0f, -10.0f);
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderTexture("backdrop");
-	SetTextureUVScale(1.0, 1.0);
-
-	m_basicMeshes->DrawPlaneMesh();
-}
-
-void SceneManager::RenderDesk() {
-	/*********************************************************
-	* This section will create a 3D plane for the 3D scene
-	* This will be a desk consisting of a desk using box meshes to create the 3D shape
-	**********************************************************/
-
-	//This part will be the top of the desk that the objects will be on top off
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(40.0f, 1.0f, 20.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, -0.5f, 0.0f);
+	m_frameDrawCalls = 0;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(1, 1, 1, 1);
-
-	SetShaderTexture("knife");
-	SetTextureUVScale(1.0, 1.0);
-
-	//setting object shader
-	SetShaderMaterial("wooden");
-
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	// set the color for the next draw command
-
-
-
-
-
-	//this section will be two box meshes will be used to create the bottom part of the desk
-	//based on how the desk is made
-
-
-	//left side box mesh
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(8.0f, 12.0f, 10.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-15.0f, -6.5f, 0.0f);
+	if (NULL != m_pSceneFile)
+	{
+		// rebuild the world matrices of the objects that moved -
+		// a static scene does no matrix math here at all
+		m_pTransformStore->UpdateWorldMatrices();
+		// and move their boxes, refitting the hierarchy over them
+		for (int i = 0; i < m_pTransformStore->GetLastUpdateCount(); i++)
+		{
+			const int node = m_pTransformStore->GetLastUpdatedNode(i);
+			m_pFrustumCuller->SetWorldMatrix(node, m_pTransformStore->GetWorldMatrix(node));
+
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			if (m_pFrustumCuller->GetWorldBounds(node, boundsMin, boundsMax))
+			{
+				m_pSceneBVH->SetObjectBounds(node, boundsMin, boundsMax);
+			}
+		}
+		m_pSceneBVH->Update();
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		// find the objects inside the view before any of them is
+		// queued, so the ones outside of it set no state at all
+		if (m_bUseCulling && m_bViewProjectionValid)
+		{
+			m_pFrustumCuller->Cull(m_viewProjection);
+		}
+		else
+		{
+			m_pFrustumCuller->SetAllVisible();
+		}
 
-	SetShaderColor(1, 1, 1, 1);
+		// the occlusion tests run on the worker threads while
+		// the lights and textures below are sent to the GPU - it
+		// cannot start any earlier, since it needs the view of
+		// this frame and the culled, moved boxes above
+		StartOcclusionCulling();
+	}
 
-	SetShaderTexture("wood");
-	SetTextureUVScale(1.0, 1.0);
+	// send any light changes made since the last frame
+	m_lightRig->UploadDirtyRange();
+	// move the textures decoded since the last frame into
+	// their layers - until then they draw as placeholders
+	m_pTextureManager->UpdateUploads();
+	// page texture levels in and out for the screen sizes the
+	// draws of the last frame asked for
+	const TextureManager::RESIDENCY_STATS residencyBefore = m_pTextureManager->GetResidencyStats();
+	m_pTextureManager->UpdateResidency();
+	const TextureManager::RESIDENCY_STATS residencyAfter = m_pTextureManager->GetResidencyStats();
+
+	// the next frame from the same camera can still look
+	// different while images are arriving, after levels were
+	// paged, or after the view moved, since the texture sizes
+	// this frame asks for are only paged in on the next one -
+	// a change made before is kept, and the flag is only
+	// cleared once the frame was presented
+	const bool bViewMoved = (m_viewProjection != m_drawnViewProjection);
+	m_drawnViewProjection = m_viewProjection;
+	if (m_pTextureManager->HasPendingUploads() ||
+		bViewMoved ||
+		(residencyAfter.pageIns != residencyBefore.pageIns) ||
+		(residencyAfter.evictions != residencyBefore.evictions))
+	{
+		m_bSceneDirty = true;
+	}
 
-	//setting object shader
-	SetShaderMaterial("wooden");
+	if (NULL == m_pSceneFile)
+	{
+		return;
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	// set the color for the next draw command
+	m_pOcclusionCuller->Finish();
 
+	// the instanced draws read the material of every instance
+	// from the material block, so for them the material is
+	// not a state change and is left out of the keys, as is
+	// the texture layer
+	const bool bInstanced = m_bUseInstancing && m_bInstancingAvailable;
 
+	// queue every object of the mapped scene with a key made
+	// from its render state
+	const SceneFile::DRAW_LIST& drawList = m_pSceneFile->GetDrawList();
 
-	//right side box mesh
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(8.0f, 12.0f, 10.0f);
+	m_pRenderQueue->Clear();
+	m_pLodSelector->BeginFrame();
+	for (uint32_t i = 0; i < drawList.count; i++)
+	{
+		// group objects only carry the transform of their children
+		if (SceneFile::MESH_GROUP == drawList.mesh[i])
+		{
+			continue;
+		}
+		if ((false == m_pFrustumCuller->IsVisible(i)) || m_pOcclusionCuller->IsOccluded(i))
+		{
+			continue;
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		const uint32_t textureField = GetSceneTextureField(i);
+		const uint32_t materialField = bInstanced ? 0 : GetSceneMaterialField(i);
+		// the instanced draws take the layer from the instance,
+		// so only the texture array is a state change for them,
+		// and the objects of one array and shape share a command
+		const uint32_t textureKeyField = bInstanced ? (uint32_t)(GetSceneTextureArray(i) + 1) : textureField;
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(15.0f, -6.5f, 0.0f);
+		// solid colors with alpha need blending, drawn back to front
+		RenderQueue::BLEND_MODE blendMode = RenderQueue::BLEND_OPAQUE;
+		if ((0 == textureField) && (drawList.color[i * 4 + 3] < 1.0f))
+		{
+			blendMode = RenderQueue::BLEND_ALPHA;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		const glm::mat4& worldMatrix = m_pTransformStore->GetWorldMatrix(i);
+		const float distance = glm::length(glm::vec3(worldMatrix[3]) - m_viewPosition);
+		float depth = distance / g_SortDepthRange;
 
-	SetShaderColor(1, 1, 1, 1);
-	SetShaderTexture("wood");
-	SetTextureUVScale(1.0, 1.0);
+		if (0 != textureField)
+		{
+			RequestSceneTextureSize(i, textureField - 1, distance);
+		}
 
+		// only the instanced shapes are built at every level, and
+		// the level shares the mesh field of the key so the draws
+		// of a shape at one level end up next to each other
+		int level = 0;
+		if (bInstanced && LodSelector::HasLevels(drawList.mesh[i]))
+		{
+			level = SelectSceneMeshLevel(i, distance);
+		}
+		const uint32_t meshField = drawList.mesh[i] * LodSelector::LEVEL_COUNT + level;
 
-	// set the object material into the shader
-	SetShaderMaterial("wooden");
+		m_pRenderQueue->Submit(
+			RenderQueue::MakeSortKey(0, blendMode, materialField, textureKeyField, meshField, depth),
+			i);
+	}
+	m_pRenderQueue->Sort();
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	// set the color for the next draw command
+	m_pUniformCache->Set(m_useInstancingUniform, bInstanced);
+	if (bInstanced)
+	{
+		DrawQueueInstanced();
+		m_frameDrawCalls = m_pInstancedMeshes->GetFrameStats().drawCalls;
+	}
+	else
+	{
+		// one ShapeMeshes draw per queued object
+		DrawQueue();
+		m_frameDrawCalls = (unsigned int)m_pRenderQueue->GetCommandCount();
+	}
 }
 
-void SceneManager::RenderPhoneHolder() {
-	/****************************************************************
-	*   This part will start creating the phone holder for the 2D Image
-	*
-	*	This is where I will be using multiple shapes to create the object
-	*
-	*		*Shapes such as:
-	*			*Box mesh for the base, and connector between the body and the holder section (Where the phone goes)
-	*				*Two box meshes for the bottom of the holder section and for the body of the holder section
-	*
-	*			*Cylinder mesh for the body
-	*****************************************************************/
-
-
-	/****************************************************************
-	*	Section that will be working on the base of the object
-	*	I will be using the box mesh and flatten it on the y axis and elongate it a little bit on the x and z axis
-	*	I will then rotate it slightly at a -45 degree angle on the y axis to reference the photo proposed in the 2-3 milestone
-	****************************************************************/
-
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	//Size of the box mesh to replicate the phone holder
-	scaleXYZ = glm::vec3(2.0f, 0.2f, 2.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.0f, 0.0f, 1.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("silverBase");
-	SetTextureUVScale(1.0, 1.0);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	/*******************************************************************
-	*	This section will cover the body of the phone holder
-	*	Where I will be using a cylinder mesh that is standing up and being elongated
-	*	I will be stretching out the sides giving it an oval type shape that would match what it looks like on the reference photo
-	********************************************************************/
-
-	//Size of the cylinder for the body while also having an elongated height and oval shape
-	scaleXYZ = glm::vec3(0.15f, 3.0f, 0.1f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 0.0f, 0.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("metallicSilver");
-	SetTextureUVScale(1.0, 1.0);
-
-	// set object shader
-	SetShaderMaterial("glass");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-
-
-	/*******************************************************************
-	*	This section will cover the connecting part between the holder section on the phone holder
-	*	And the connecting part from the holder to the body
-	*
-	*
-	*	I will be using a box as the connector
-	*	Then a cylinder to start the top of the holder
-	*	A box to act as the body of the holder
-	*	Finally box meshes for the parts at the bottom that hold the phone in place
-	*
-	********************************************************************/
-
-	//Box Mesh that connects to the cylinder body
-	scaleXYZ = glm::vec3(0.2f, 0.2f, 0.2f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.4f, 2.8f, 0.6f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("silverBase");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("glass");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	/************************************************************
-	*	Section that will start the body of the holder section
-	*************************************************************/
-
-	//Cylinder Mesh that starts the top of the holder section
-	scaleXYZ = glm::vec3(0.1f, 1.5f, 0.1f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.78f, 2.8f, 0.1f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("body");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("glass");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-
-
-
-
-	//box mesh that acts as the body for the holder section
-	scaleXYZ = glm::vec3(1.5f, 0.05f, 2.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 60.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.95f, 2.0f, 0.99065f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("drywall");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("glass");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	/******************************************
-	*
-	*	Four box meshes that will act as the bottom of the holder section
-	*
-	*******************************************/
-
-
-	//box mesh that acts as the bottom of the body for the holder (left side)
-	scaleXYZ = glm::vec3(0.2f, 0.05f, 0.2f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = -20.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.12f, 1.23f, 1.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("grayHolder");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	//box mesh that acts as the bottom of the body for the holder (right side)
-	scaleXYZ = glm::vec3(0.2f, 0.05f, 0.2f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = -20.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.95f, 1.23f, 1.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("grayHolder");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
+/***********************************************************
+ *  StartOcclusionCulling()
+ *
+ *  This method is used for choosing the occluders of the
+ *  frame and handing the objects inside the view to the
+ *  occlusion culler.  The occluders are the opaque boxes
+ *  inside the view that are largest for their distance from
+ *  the camera - walls, desks and cabinets rather than the
+ *  small objects on them.  The occluders themselves are not
+ *  tested, since their own faces would hide them by a
+ *  rounding error.
+ ***********************************************************/
+void SceneManager::StartOcclusionCulling()
+{
+	PROFILE_ZONE("SceneManager::StartOcclusionCulling");
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	m_pOcclusionCuller->BeginFrame(m_viewProjection);
+	if ((false == m_bUseOcclusionCulling) || (false == m_bViewProjectionValid))
+	{
+		return;
+	}
 
-	//box mesh that acts as the bottom of the body for the holder (left side)
-	scaleXYZ = glm::vec3(0.2f, 0.05f, 0.2f);
+	const SceneFile::DRAW_LIST& drawList = m_pSceneFile->GetDrawList();
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = -125.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
+	m_occluderCandidates.clear();
+	for (uint32_t i = 0; i < drawList.count; i++)
+	{
+		if ((SceneFile::MESH_BOX != drawList.mesh[i]) || (false == m_pFrustumCuller->IsVisible(i)))
+		{
+			continue;
+		}
+		// blended boxes let the objects behind them show through
+		if ((0 == GetSceneTextureField(i)) && (drawList.color[i * 4 + 3] < 1.0f))
+		{
+			continue;
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.12f, 1.35f, 1.0f);
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		if (false == m_pFrustumCuller->GetWorldBounds(i, boundsMin, boundsMax))
+		{
+			continue;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		const float distance = glm::length((boundsMin + boundsMax) * 0.5f - m_viewPosition);
+		OCCLUDER_CANDIDATE candidate;
+		candidate.score = glm::length(boundsMax - boundsMin) / std::max(distance, g_MinTextureDistance);
+		candidate.object = (int)i;
+		if (candidate.score >= g_MinOccluderSize)
+		{
+			m_occluderCandidates.push_back(candidate);
+		}
+	}
 
-	//setting texture for the object
-	SetShaderTexture("grayHolder");
-	SetTextureUVScale(1.0, 1.0);
+	const size_t occluderCount = std::min(m_occluderCandidates.size(), (size_t)OcclusionCuller::MAX_OCCLUDERS);
+	if (0 == occluderCount)
+	{
+		return;
+	}
+	std::partial_sort(
+		m_occluderCandidates.begin(),
+		m_occluderCandidates.begin() + occluderCount,
+		m_occluderCandidates.end(),
+		IsLargerOccluder);
+	for (size_t i = 0; i < occluderCount; i++)
+	{
+		m_pOcclusionCuller->AddBoxOccluder(m_pTransformStore->GetWorldMatrix(m_occluderCandidates[i].object));
+	}
 
-	// setting object shader
-	SetShaderMaterial("plate");
+	m_occluderCandidates.resize(occluderCount);
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	for (uint32_t i = 0; i < drawList.count; i++)
+	{
+		if ((SceneFile::MESH_GROUP == drawList.mesh[i]) || (false == m_pFrustumCuller->IsVisible(i)))
+		{
+			continue;
+		}
 
+		bool bOccluder = false;
+		for (size_t j = 0; (j < occluderCount) && !bOccluder; j++)
+		{
+			bOccluder = ((int)i == m_occluderCandidates[j].object);
+		}
 
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		if ((false == bOccluder) && m_pFrustumCuller->GetWorldBounds(i, boundsMin, boundsMax))
+		{
+			m_pOcclusionCuller->AddObject(i, boundsMin, boundsMax);
+		}
+	}
 
-	//box mesh that acts as the bottom of the body for the holder (right side)
-	scaleXYZ = glm::vec3(0.2f, 0.05f, 0.2f);
+	m_pOcclusionCuller->Start();
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = -125.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  RequestSceneTextureSize()
+ *
+ *  This method is used for asking for the texture of a scene
+ *  file object at the screen size of one repeat of it.  The
+ *  size of the object is its largest scaled axis, which the
+ *  unit sized shapes span about once, and it is measured from
+ *  its nearest point to the camera.  Without a projection
+ *  scale from the view the full texture is asked for.
+ ***********************************************************/
+void SceneManager::RequestSceneTextureSize(uint32_t object, int textureSlot, float distance)
+{
+	const glm::mat4& worldMatrix = m_pTransformStore->GetWorldMatrix(object);
+	const float* uvScale = m_pSceneFile->GetDrawList().uvScale + object * 2;
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.93f, 1.35f, 1.8f);
+	float pixels = (float)TextureManager::MAX_LAYER_SIZE;
+	if (m_projectionScale > 0.0f)
+	{
+		const float objectSize = std::max(
+			glm::length(glm::vec3(worldMatrix[0])),
+			std::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		pixels = objectSize * m_projectionScale;
+		if (m_bPerspectiveView)
+		{
+			pixels /= std::max(distance - objectSize * 0.5f, g_MinTextureDistance);
+		}
+		// the texture repeats UV scale times across the object
+		pixels /= std::max(std::max(std::fabs(uvScale[0]), std::fabs(uvScale[1])), 0.01f);
+	}
 
-	//setting texture for the object
-	SetShaderTexture("grayHolder");
-	SetTextureUVScale(1.0, 1.0);
+	m_pTextureManager->RequestTextureSize(textureSlot, pixels);
+}
 
-	// setting object shader
-	SetShaderMaterial("plate");
+/***********************************************************
+ *  SelectSceneMeshLevel()
+ *
+ *  This method is used for picking the tessellation level of
+ *  a scene file object with a round shape.  The radius of the
+ *  object is its largest scaled axis, as the round shapes
+ *  have a radius of one, and it is measured on the screen at
+ *  its nearest point to the camera.  Without a projection
+ *  scale from the view the finest level is used.
+ ***********************************************************/
+int SceneManager::SelectSceneMeshLevel(uint32_t object, float distance)
+{
+	if (m_projectionScale <= 0.0f)
+	{
+		return(m_pLodSelector->SelectLevel(object, FLT_MAX));
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	const glm::mat4& worldMatrix = m_pTransformStore->GetWorldMatrix(object);
+	const float radius = std::max(
+		glm::length(glm::vec3(worldMatrix[0])),
+		std::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
 
+	float screenRadius = radius * m_projectionScale;
+	if (m_bPerspectiveView)
+	{
+		screenRadius /= std::max(distance - radius, g_MinTextureDistance);
+	}
 
+	return(m_pLodSelector->SelectLevel(object, screenRadius));
 }
 
-void SceneManager::RenderBook() {
-	/*********************************************************************
-	* This section will be covering the book that will be on the desk
-	*
-	* Will be using a box mesh to create the book
-	*
-	**********************************************************************/
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	scaleXYZ = glm::vec3(3.0f, 0.5f, 2.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 45.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.0f, 0.25f, 1.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//setting texture for the object
-	SetShaderTexture("book");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("book");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  GetSceneTextureField() / GetSceneMaterialField()
+ *
+ *  These methods are used for getting the texture slot and
+ *  material index of a scene file object, offset by one so
+ *  that zero stands for a solid color draw and for an object
+ *  without material.  The indices come straight from the
+ *  file, so they are range checked here.
+ ***********************************************************/
+uint32_t SceneManager::GetSceneTextureField(uint32_t object) const
+{
+	const int texture = m_pSceneFile->GetDrawList().texture[object];
+	if ((texture >= 0) && (texture < (int)m_sceneTextureSlots.size()) && (m_sceneTextureSlots[texture] >= 0))
+	{
+		return(m_sceneTextureSlots[texture] + 1);
+	}
+	return(0);
 }
 
-void SceneManager::RenderWaterBottle() {
-
-
-	/*********************************************************************
-	* This section will cover the water bottle
-	*
-	* I will be using a cylinder mesh to create the water bottle
-	* Then a pyramid mesh to create the top of the water bottle
-	* And finally a smaller cylinder mesh to create the cap of the water bottle
-	**********************************************************************/
-
-
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Cylinder Mesh that will act as the body of the water bottle
-	scaleXYZ = glm::vec3(1.0f, 2.5f, 1.0f);
-	positionXYZ = glm::vec3(-2.5f, 0.0f, 1.8f);
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderTexture("waterBottle");
-	SetTextureUVScale(1.0, 1.0);
-	SetShaderMaterial("glass");
-
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Pyramid Mesh that will act as the top of the water bottle
-	scaleXYZ = glm::vec3(1.0f, 1.4f, 1.0f);
-	positionXYZ = glm::vec3(-2.5f, 2.5f, 1.8f);
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderTexture("waterBottle");
-	SetTextureUVScale(1.0, 1.0);
-	SetShaderMaterial("glass");
-
-	m_basicMeshes->DrawConeMesh();
-
-	// Cylinder Mesh that will act as the cap of the water bottle
-	scaleXYZ = glm::vec3(0.3f, 0.5f, 0.3f);
-	positionXYZ = glm::vec3(-2.5f, 3.393f, 1.8f);
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderTexture("waterBottle");
-	SetTextureUVScale(1.0, 1.0);
-	SetShaderMaterial("glass");
-
-	m_basicMeshes->DrawCylinderMesh();
+uint32_t SceneManager::GetSceneMaterialField(uint32_t object) const
+{
+	const int material = m_pSceneFile->GetDrawList().material[object];
+	if ((material >= 0) && (material < (int)m_sceneMaterialIndices.size()) && (m_sceneMaterialIndices[material] >= 0))
+	{
+		return(m_sceneMaterialIndices[material] + 1);
+	}
+	return(0);
 }
 
-void SceneManager::RenderMonitors() {
-	/*********************************************************************
-	* This section will be covering the monitors that will be on the desk
-	*
-	* Will be using a box mesh to create the monitor
-	*
-	* One monitor on the left side of the objects
-	* One monitor on the right side of the objects
-	*
-	**********************************************************************/
-
-
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Monitor on the left side of the objects
-	// Dimensions for a 32-inch monitor scaled down to 40%
-	float monitorWidth = 27.9f * 0.4f;
-	float monitorHeight = 15.7f * 0.4f;
-	float monitorDepth = 2.0f * 0.4f;
-
-	// Scale for the monitor
-	scaleXYZ = glm::vec3(monitorWidth, monitorHeight, monitorDepth);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 6.0f, -4.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	// base of monitor on the left side of the objects
-
-	// Scale for the base
-	scaleXYZ = glm::vec3(4.0f, 0.2f, 4.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 0.2f, -4.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	// back handle of monitor on the left side of the objects
-
-	// Scale for the handle
-	scaleXYZ = glm::vec3(1.0f, 4.0f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-8.0f, 2.0f, -4.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	// Monitor on the right side of the objects
-	// Dimensions for a 32-inch monitor scaled down to 40%
-	monitorWidth = 27.9f * 0.4f;
-	monitorHeight = 15.7f * 0.4f;
-	monitorDepth = 2.0f * 0.4f;
-
-	// Scale for the monitor
-	scaleXYZ = glm::vec3(monitorWidth, monitorHeight, monitorDepth);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 6.0f, -4.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-	
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	// base of monitor on the right side of the objects
-
-	// Scale for the base
-	scaleXYZ = glm::vec3(4.0f, 0.2f, 4.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -15.0f;
-	ZrotationDegrees = 0.0f;
-	
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 0.2f, -4.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	// back handle of monitor on the right side of the objects
-
-	// Scale for the handle
-	scaleXYZ = glm::vec3(1.0f, 4.0f, 1.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(8.0f, 2.0f, -4.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// setting texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0, 1.0);
-
-	// setting object shader
-	SetShaderMaterial("plate");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-
-
-	// screen on right monitor
-	// Scale for the screen
-	scaleXYZ = glm::vec3(10.0f, 5.0f, 0.1f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(7.9f, 6.0f, -3.66f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-
-	// screen on left monitor
-	// Scale for the screen
-	scaleXYZ = glm::vec3(10.0f, 5.0f, 0.1f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 15.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-7.9f, 6.0f, -3.66f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
+/***********************************************************
+ *  GetSceneTextureArray() / GetSceneTextureLayer()
+ *
+ *  These methods are used for getting the texture array and
+ *  layer of a scene file object, or -1 when it has no
+ *  texture.
+ ***********************************************************/
+int SceneManager::GetSceneTextureArray(uint32_t object) const
+{
+	const uint32_t textureField = GetSceneTextureField(object);
+	if (0 == textureField)
+	{
+		return(-1);
+	}
+	return(m_pTextureManager->GetTextureArray(textureField - 1));
 }
 
-void SceneManager::RenderKeyBoard() {
-	/*********************************************************************
-	* This section will be covering the keyboard that will be on the desk
-	*
-	* Will be using box meshes to create the keyboard base and keys
-	*
-	**********************************************************************/
-	
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Keyboard base
-
-	// Scale for the keyboard base
-	scaleXYZ = glm::vec3(10.2f, 0.5f, 4.0f); 
-
-	// Position on the desk
-	positionXYZ = glm::vec3(0.1f, 0.25f, 6.0f); 
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Set the texture for the object
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0f, 1.0f);
-
-	// Set the object material into the shader
-	SetShaderMaterial("plate");
-
-	m_basicMeshes->DrawBoxMesh();
-
-	// Keys
-
-	// Scale for the keys
-	float keyWidth = 0.8f;
-	float keyHeight = 0.2f;
-	float keyDepth = 0.8f;
-
-	// Spacing and number of rows and columns for the keys
-	float spacing = 0.05f; 
-	int numRows = 5;
-	int numCols = 12;
-
-	// Start position for the keys
-	float startX = -5.0f + keyWidth / 2.0f;
-	float startY = 0.2f + 0.25f + keyHeight / 2.0f;
-	float startZ = 8.0f - keyDepth / 2.0f;
-
-	// Using for loop to create each key that will go on top of the keyboard base
-	for (int row = 0; row < numRows; ++row) {
-		for (int col = 0; col < numCols; ++col) {
-			scaleXYZ = glm::vec3(keyWidth, keyHeight, keyDepth);
-			positionXYZ = glm::vec3(startX + col * (keyWidth + spacing), startY, startZ - row * (keyDepth + spacing));
-
-			SetTransformations(
-				scaleXYZ,
-				XrotationDegrees,
-				YrotationDegrees,
-				ZrotationDegrees,
-				positionXYZ);
-
-			// Set the texture for the object
-			SetShaderTexture("body");
-			SetTextureUVScale(1.0, 1.0);
-
-			// Set the object material into the shader
-			SetShaderMaterial("plate");
-
-			m_basicMeshes->DrawBoxMesh();
-		}
+int SceneManager::GetSceneTextureLayer(uint32_t object) const
+{
+	const uint32_t textureField = GetSceneTextureField(object);
+	if (0 == textureField)
+	{
+		return(-1);
 	}
+	return(m_pTextureManager->GetTextureLayer(textureField - 1));
 }
 
-void SceneManager::RenderMouse() {
-	/*********************************************************************
-	* This section will be covering the mouse that will be on the desk
-	*
-	* Will be using a cylinder and half-sphere meshes to create the mouse
-	*
-	**********************************************************************/
-
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = -45.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Mouse base (cylinder)
-
-	// Scale for the cylinder
-	scaleXYZ = glm::vec3(1.5f, 0.5f, 1.0f); 
-
-	// Position on the desk
-	positionXYZ = glm::vec3(7.0f, 0.25f, 6.0f);
-
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Set the texture for the object
-	SetShaderTexture("mouse");
-	SetTextureUVScale(1.0, 1.0);
-
-	// Set the object material into the shader
-	SetShaderMaterial("plate");
-
-	// Drawing a cylinder without the top and bottom faces
-	m_basicMeshes->DrawCylinderMesh(false, true, true); 
-
-	// Mouse top (half-sphere)
-
-	// Scale for the half-sphere
-
-	scaleXYZ = glm::vec3(1.5f, 0.5f, 1.0f); 
-
-	// Position on the desk
-	positionXYZ = glm::vec3(7.0f, 0.75f, 6.0f); 
+/***********************************************************
+ *  DrawQueue()
+ *
+ *  This method is used for drawing the sorted render queue
+ *  one object at a time with the ShapeMeshes shapes, only
+ *  changing the texture and material when they change -
+ *  blended draws are ordered by depth instead of state, so
+ *  those always set them.  Blending is only on for the
+ *  blended draws, and the ShapeMeshes shapes bind their own
+ *  vertex arrays, which the state cache is told about.
+ ***********************************************************/
+void SceneManager::DrawQueue()
+{
+	PROFILE_ZONE("SceneManager::DrawQueue");
 
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	const SceneFile::DRAW_LIST& drawList = m_pSceneFile->GetDrawList();
 
-	// Set the texture for the object
-	SetShaderTexture("mouse");
-	SetTextureUVScale(1.0, 1.0);
+	uint32_t currentTexture = 0;
+	uint32_t currentMaterial = 0;
+	for (int command = 0; command < m_pRenderQueue->GetCommandCount(); command++)
+	{
+		const uint64_t key = m_pRenderQueue->GetCommand(command).key;
+		const uint32_t i = m_pRenderQueue->GetCommand(command).payload;
+		const bool bSortedByState = (RenderQueue::BLEND_OPAQUE == RenderQueue::GetBlendMode(key));
+		const uint32_t textureField = GetSceneTextureField(i);
+		const uint32_t materialField = GetSceneMaterialField(i);
+		const float* uvScale = drawList.uvScale + i * 2;
+		const float* color = drawList.color + i * 4;
+
+		m_pUniformCache->Set(m_modelUniform, m_pTransformStore->GetWorldMatrix(i));
+		m_pStateCache->SetCapability(GL_BLEND, !bSortedByState);
+
+		if (0 == textureField)
+		{
+			// the color is not part of the key
+			SetShaderColor(color[0], color[1], color[2], color[3]);
+		}
+		else if ((textureField != currentTexture) || !bSortedByState)
+		{
+			SetShaderTextureSlot(textureField - 1);
+		}
+		currentTexture = textureField;
+		SetTextureUVScale(uvScale[0], uvScale[1]);
 
-	// Set the object material into the shader
-	SetShaderMaterial("plate");
+		if ((0 != materialField) &&
+			((materialField != currentMaterial) || !bSortedByState))
+		{
+			SetShaderMaterialIndex(materialField - 1);
+		}
+		currentMaterial = materialField;
 
-	m_basicMeshes->DrawHalfSphereMesh(); // Draw half-sphere
+		DrawSceneMesh(drawList.mesh[i]);
+	}
+	m_pStateCache->InvalidateVertexArray();
 }
 
+/***********************************************************
+ *  DrawQueueInstanced()
+ *
+ *  This method is used for drawing the sorted render queue
+ *  with instancing.  Every object becomes an instance with
+ *  its own model matrix, color, UV scale, material and
+ *  texture layer, each run of queued objects with the same
+ *  shape, level, texture array and blend mode becomes one draw
+ *  command, and all the commands between two texture array
+ *  or blend mode changes go out as one multi-draw call.
+ ***********************************************************/
+void SceneManager::DrawQueueInstanced()
+{
+	PROFILE_ZONE("SceneManager::DrawQueueInstanced");
 
+	const SceneFile::DRAW_LIST& drawList = m_pSceneFile->GetDrawList();
+	const int commandCount = m_pRenderQueue->GetCommandCount();
 
+	// the instances are added in queue order, so every run is
+	// a contiguous range of the instance buffer
+	m_pInstancedMeshes->ClearInstances();
+	for (int command = 0; command < commandCount; command++)
+	{
+		const uint32_t i = m_pRenderQueue->GetCommand(command).payload;
+		const float* uvScale = drawList.uvScale + i * 2;
+		const float* color = drawList.color + i * 4;
+
+		InstancedMeshes::INSTANCE_DATA instance;
+		instance.model = m_pTransformStore->GetWorldMatrix(i);
+		instance.color = glm::vec4(color[0], color[1], color[2], color[3]);
+		instance.UVscale = glm::vec2(uvScale[0], uvScale[1]);
+		instance.textureLayer = GetSceneTextureLayer(i);
+		instance.materialIndex = (int)GetSceneMaterialField(i) - 1;
+		m_pInstancedMeshes->AddInstance(instance);
+	}
 
+	// split the queue into draw commands, and the commands into
+	// ranges that can be drawn without changing the texture array
+	m_textureRuns.clear();
+	int runStart = 0;
+	while (runStart < commandCount)
+	{
+		const RenderQueue::RENDER_COMMAND& first = m_pRenderQueue->GetCommand(runStart);
+		const int textureArray = GetSceneTextureArray(first.payload);
+		const uint8_t mesh = drawList.mesh[first.payload];
+		const int level = m_pLodSelector->GetLevel(first.payload);
+		const RenderQueue::BLEND_MODE blendMode = RenderQueue::GetBlendMode(first.key);
+
+		int runEnd = runStart + 1;
+		while (runEnd < commandCount)
+		{
+			const RenderQueue::RENDER_COMMAND& next = m_pRenderQueue->GetCommand(runEnd);
+			if ((drawList.mesh[next.payload] != mesh) ||
+				(m_pLodSelector->GetLevel(next.payload) != level) ||
+				(GetSceneTextureArray(next.payload) != textureArray) ||
+				(RenderQueue::GetBlendMode(next.key) != blendMode))
+			{
+				break;
+			}
+			runEnd++;
+		}
 
+		const int draw = m_pInstancedMeshes->AddDraw(mesh, level, runStart, runEnd - runStart);
+		if (m_textureRuns.empty() ||
+			(m_textureRuns.back().textureArray != textureArray) ||
+			(m_textureRuns.back().blendMode != blendMode))
+		{
+			TEXTURE_RUN textureRun;
+			textureRun.textureArray = textureArray;
+			textureRun.blendMode = blendMode;
+			textureRun.firstDraw = draw;
+			textureRun.drawCount = 0;
+			m_textureRuns.push_back(textureRun);
+		}
+		m_textureRuns.back().drawCount++;
 
+		runStart = runEnd;
+	}
+	m_pInstancedMeshes->UploadInstances();
 
+	m_pInstancedMeshes->BeginDraws();
+	for (size_t run = 0; run < m_textureRuns.size(); run++)
+	{
+		const TEXTURE_RUN& textureRun = m_textureRuns[run];
+		m_pStateCache->SetCapability(GL_BLEND, RenderQueue::BLEND_OPAQUE != textureRun.blendMode);
+		if (textureRun.textureArray < 0)
+		{
+			m_pUniformCache->Set(m_useTextureUniform, false);
+		}
+		else
+		{
+			m_pUniformCache->Set(m_useTextureUniform, true);
+			m_pTextureManager->BindArray(textureRun.textureArray, g_TextureUnit);
+		}
 
-	
+		m_pInstancedMeshes->DrawCommands(textureRun.firstDraw, textureRun.drawCount);
+	}
+}
@@ -11,7 +11,21 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "UniformCache.h"
+#include "GLStateCache.h"
+#include "LightRig.h"
+#include "SceneFile.h"
+#include "TransformStore.h"
+#include "RenderQueue.h"
+#include "InstancedMeshes.h"
+#include "MaterialBuffer.h"
+#include "TextureManager.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include "OcclusionCuller.h"
+#include "LodSelector.h"
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -25,16 +39,10 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderManager *pShaderManager, UniformCache* pUniformCache, GLStateCache* pStateCache, StreamRing* pStreamRing);
 	// destructor
 	~SceneManager();
 
-	struct TEXTURE_INFO
-	{
-		std::string tag;
-		uint32_t ID;
-	};
-
 	struct OBJECT_MATERIAL
 	{
 		glm::vec3 diffuseColor;
@@ -43,38 +51,123 @@ public:
 		std::string tag;
 	};
 
+	// range of instanced draw commands that share a texture
+	// array, -1 for solid color draws, and a blend mode
+	struct TEXTURE_RUN
+	{
+		int textureArray;
+		RenderQueue::BLEND_MODE blendMode;
+		int firstDraw;
+		int drawCount;
+	};
+
+	// box that may be rasterized as an occluder, with the size
+	// it covers on the screen
+	struct OCCLUDER_CANDIDATE
+	{
+		float score;
+		int object;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the cached uniform locations and values
+	UniformCache* m_pUniformCache;
+	// pointer to the cache the OpenGL state changes go through
+	GLStateCache* m_pStateCache;
+	// handles for the uniforms set on every draw
+	UniformHandle<glm::mat4> m_modelUniform;
+	UniformHandle<glm::vec4> m_colorValueUniform;
+	UniformHandle<int> m_textureValueUniform;
+	UniformHandle<int> m_textureLayerUniform;
+	UniformHandle<bool> m_useTextureUniform;
+	UniformHandle<bool> m_useLightingUniform;
+	UniformHandle<glm::vec2> m_UVscaleUniform;
+	UniformHandle<glm::vec3> m_materialDiffuseUniform;
+	UniformHandle<glm::vec3> m_materialSpecularUniform;
+	UniformHandle<float> m_materialShininessUniform;
+	UniformHandle<bool> m_useInstancingUniform;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	// pointer to the scene lights uniform buffer
+	LightRig* m_lightRig;
+	// loaded textures, packed into texture arrays
+	TextureManager* m_pTextureManager;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// memory mapped scene that is rendered every frame
+	SceneFile* m_pSceneFile;
+	// cached world matrices of the scene file objects
+	TransformStore* m_pTransformStore;
+	// draws of the frame sorted by their render state
+	RenderQueue* m_pRenderQueue;
+	// world boxes of the objects, tested against the view
+	FrustumCuller* m_pFrustumCuller;
+	// hierarchy over the world boxes for spatial queries
+	SceneBVH* m_pSceneBVH;
+	// CPU depth buffer of the large occluders of the frame,
+	// hiding the objects behind them
+	OcclusionCuller* m_pOcclusionCuller;
+	bool m_bUseOcclusionCulling;
+	// tessellation level of the round shapes of each object
+	LodSelector* m_pLodSelector;
+	// view projection of the frame, and whether the view has
+	// set one - objects are only culled once it has
+	glm::mat4 m_viewProjection;
+	bool m_bViewProjectionValid;
+	bool m_bUseCulling;
+	// camera position used for the depth of the sort keys
+	glm::vec3 m_viewPosition;
+	// screen pixels one world unit covers, one unit from the
+	// camera for a perspective view, or anywhere for an
+	// orthographic one - zero until the view sets it
+	float m_projectionScale;
+	bool m_bPerspectiveView;
+	// shapes and instance buffer of the instanced draws
+	InstancedMeshes* m_pInstancedMeshes;
+	// material table read by the instanced draws
+	MaterialBuffer* m_pMaterialBuffer;
+	// draw the render queue with instancing, when the
+	// instanced shapes and material table could be created
+	bool m_bUseInstancing;
+	bool m_bInstancingAvailable;
+	// draw calls sent by the last frame
+	unsigned int m_frameDrawCalls;
+	// set when the next frame would not look like the last
+	// presented one even from the same camera, and only
+	// cleared once a frame was presented - it is set from any
+	// thread, and the render thread takes it
+	std::atomic<bool> m_bSceneDirty;
+	// called when the scene changes, to wake up the drawing
+	void (*m_pSceneChangeCallback)();
+	// view projection the last frame was drawn with
+	glm::mat4 m_drawnViewProjection;
+	// draw command ranges of the frame, one per texture or
+	// blend mode change
+	std::vector<TEXTURE_RUN> m_textureRuns;
+	// occluders of the frame, largest first
+	std::vector<OCCLUDER_CANDIDATE> m_occluderCandidates;
+	// texture slot and material index for each of the
+	// texture and material tags used by the scene file
+	std::vector<int> m_sceneTextureSlots;
+	std::vector<int> m_sceneMaterialIndices;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	// pack the loaded textures into OpenGL texture arrays
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
+	// find a loaded texture by tag - the ID is the one of
+	// the texture array that holds it
 	int FindTextureID(std::string tag);
 	int FindTextureSlot(std::string tag);
 	// find a defined material by tag
 	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
-
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
-		glm::vec3 scaleXYZ,
-		float XrotationDegrees,
-		float YrotationDegrees,
-		float ZrotationDegrees,
-		glm::vec3 positionXYZ);
+	int FindMaterialIndex(std::string tag);
+	// mark the scene as changed and wake up the drawing
+	void MarkSceneChanged();
 
 	// set the color values into the shader
 	void SetShaderColor(
@@ -86,6 +179,8 @@ private:
 	// set the texture data into the shader
 	void SetShaderTexture(
 		std::string textureTag);
+	void SetShaderTextureSlot(
+		int textureSlot);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -94,6 +189,39 @@ private:
 	// set the object material into the shader
 	void SetShaderMaterial(
 		std::string materialTag);
+	void SetShaderMaterialIndex(
+		int materialIndex);
+
+	// load the scene file, converting it from the text form
+	// when the binary form is missing or out of date
+	bool LoadSceneFile(
+		const char* textFilename,
+		const char* binaryFilename);
+	// draw one of the basic shapes of the scene file
+	void DrawSceneMesh(
+		int meshID);
+	// get the texture slot and material index of a scene
+	// file object plus one, or zero when it has none
+	uint32_t GetSceneTextureField(uint32_t object) const;
+	uint32_t GetSceneMaterialField(uint32_t object) const;
+	// ask for the texture of a scene file object at the size
+	// it covers on the screen
+	void RequestSceneTextureSize(uint32_t object, int textureSlot, float distance);
+	// pick the tessellation level of a scene file object with
+	// a round shape from the size it covers on the screen
+	int SelectSceneMeshLevel(uint32_t object, float distance);
+	// get the texture array and layer of a scene file object,
+	// or -1 when it has none
+	int GetSceneTextureArray(uint32_t object) const;
+	int GetSceneTextureLayer(uint32_t object) const;
+	// choose the occluders of the frame and start testing the
+	// objects inside the view against them
+	void StartOcclusionCulling();
+	// draw the sorted render queue one object at a time
+	void DrawQueue();
+	// draw the sorted render queue with multi-draw-indirect
+	// calls over the merged instanced shapes
+	void DrawQueueInstanced();
 
 public:
 
@@ -106,14 +234,65 @@ public:
 	void DefineObjectMaterials();
 	void SetupSceneLights();
 
-	void RenderWaterBottle();
-	void RenderPhoneHolder();
-	void RenderDesk();
-	void RenderBook();
-	void RenderBackDrop();
-	void RenderMonitors();
-	void RenderKeyBoard();
-	void RenderMouse();
-
+	// change the transform of a named group of the scene file
+	// relative to its parent, moving all of its objects
+	bool SetSceneGroupTransform(
+		std::string groupTag,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
 
+	// set the camera position used to sort the draws by depth
+	void SetViewPosition(glm::vec3 viewPosition) { m_viewPosition = viewPosition; }
+	// set the projection scale used for the screen size of the
+	// textured draws
+	void SetViewProjectionScale(float projectionScale, bool bPerspective) { m_projectionScale = projectionScale; m_bPerspectiveView = bPerspective; }
+	// set the view projection the objects are culled against
+	void SetViewProjection(const glm::mat4& viewProjection) { m_viewProjection = viewProjection; m_bViewProjectionValid = true; }
+	// switch the view frustum culling on or off
+	void SetCullingEnabled(bool bEnabled) { m_bUseCulling = bEnabled; }
+	// get the visible and culled object counts of the last frame
+	FrustumCuller::CULL_STATS GetCullStats() const { return(m_pFrustumCuller->GetLastCullStats()); }
+	// switch the occlusion culling on or off
+	void SetOcclusionCullingEnabled(bool bEnabled) { m_bUseOcclusionCulling = bEnabled; }
+	// get the occluder and hidden object counts of the last frame
+	OcclusionCuller::OCCLUSION_STATS GetOcclusionStats() const { return(m_pOcclusionCuller->GetLastStats()); }
+	// find the scene file object whose box a ray hits first,
+	// or -1 when it hits none
+	int FindSceneObjectOnRay(glm::vec3 origin, glm::vec3 direction, float maxDistance, float& hitDistance) const { return(m_pSceneBVH->FindFirstHit(origin, direction, maxDistance, hitDistance)); }
+	// find the scene file objects whose box reaches into a
+	// sphere, such as the range of a light, or into a box
+	int FindSceneObjectsInSphere(glm::vec3 center, float radius, std::vector<int>& objects) const { return(m_pSceneBVH->FindInSphere(center, radius, objects)); }
+	int FindSceneObjectsInBox(glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<int>& objects) const { return(m_pSceneBVH->FindInBox(boundsMin, boundsMax, objects)); }
+	// find the scene file objects inside a view frustum
+	int FindSceneObjectsInFrustum(const glm::mat4& viewProjection, std::vector<int>& objects) const { return(m_pSceneBVH->FindInFrustum(viewProjection, objects)); }
+	// get the size, quality and update counts of the hierarchy
+	SceneBVH::BVH_STATS GetSceneBVHStats() const { return(m_pSceneBVH->GetStats()); }
+	// wait until every scene texture is decoded and in its layer
+	void FinishTextureLoading() { m_pTextureManager->FinishUploads(); MarkSceneChanged(); }
+	// set the GPU memory budget of the scene textures
+	void SetTextureBudget(int megabytes) { m_pTextureManager->SetBudgetMegabytes(megabytes); MarkSceneChanged(); }
+	// get the GPU memory use of the scene textures
+	TextureManager::RESIDENCY_STATS GetTextureResidencyStats() const { return(m_pTextureManager->GetResidencyStats()); }
+	// get the draw and state change counts of the last frame
+	RenderQueue::RENDER_QUEUE_STATS GetRenderQueueStats() const { return(m_pRenderQueue->GetLastSortStats()); }
+	// switch between the instanced and the ShapeMeshes draws
+	void SetInstancingEnabled(bool bEnabled) { m_bUseInstancing = bEnabled; MarkSceneChanged(); }
+	// get the instance and draw call counts of the last frame
+	InstancedMeshes::INSTANCE_STATS GetInstanceStats() const { return(m_pInstancedMeshes->GetLastFrameStats()); }
+	// get the draw calls sent by the last RenderScene() call
+	unsigned int GetFrameDrawCalls() const { return(m_frameDrawCalls); }
+	// get whether the next frame has to be drawn even if the
+	// camera stays where it is
+	bool IsSceneDirty() const { return(m_bSceneDirty.load()); }
+	// get the same, clearing it - called once a frame was
+	// presented
+	bool TakeSceneDirty() { return(m_bSceneDirty.exchange(false)); }
+	// set the function called whenever the scene changes
+	void SetSceneChangeCallback(void (*pCallback)()) { m_pSceneChangeCallback = pCallback; }
+	// set the largest screen error, in pixels, of the round
+	// shape levels of the instanced draws
+	void SetLodMaxError(float pixels) { m_pLodSelector->SetMaxError(pixels); MarkSceneChanged(); }
+	// get the objects drawn at each level in the last frame
+	LodSelector::LOD_STATS GetLodStats() const { return(m_pLodSelector->GetLastStats()); }
 };
\ No newline at end of file
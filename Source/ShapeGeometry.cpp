@@ -0,0 +1,440 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.cpp
+// ============
+// build the vertex and index data of the basic 3D shapes on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShapeGeometry.h"
+#include "SceneFile.h"
+
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const float g_Pi = 3.14159265358979f;
+}
+
+/***********************************************************
+ *  BuildMesh()
+ *
+ *  This method is used for building the shape drawn for one
+ *  of the scene file mesh IDs.
+ ***********************************************************/
+bool ShapeGeometry::BuildMesh(int meshID, SHAPE_DATA& shapeData, int slices)
+{
+	shapeData.vertices.clear();
+	shapeData.indices.clear();
+
+	switch (meshID)
+	{
+	case SceneFile::MESH_BOX:
+		BuildBox(shapeData);
+		break;
+	case SceneFile::MESH_PLANE:
+		BuildPlane(shapeData);
+		break;
+	case SceneFile::MESH_CYLINDER:
+		BuildCylinder(shapeData, slices);
+		break;
+	case SceneFile::MESH_CYLINDER_NO_TOP:
+		BuildCylinder(shapeData, slices, false, true, true);
+		break;
+	case SceneFile::MESH_CONE:
+		BuildCone(shapeData, slices);
+		break;
+	case SceneFile::MESH_SPHERE:
+		BuildSphere(shapeData, slices);
+		break;
+	case SceneFile::MESH_HALF_SPHERE:
+		BuildHalfSphere(shapeData, slices);
+		break;
+	case SceneFile::MESH_PYRAMID4:
+		BuildPyramid4(shapeData);
+		break;
+	case SceneFile::MESH_TAPERED_CYLINDER:
+		BuildTaperedCylinder(shapeData, slices);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  This method is used for getting the axis aligned box
+ *  around the shape drawn for one of the scene file mesh
+ *  IDs, from the sizes listed in the class comment.  The
+ *  round shapes fit the same box at any number of slices.
+ ***********************************************************/
+bool ShapeGeometry::GetMeshBounds(int meshID, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	switch (meshID)
+	{
+	case SceneFile::MESH_BOX:
+	case SceneFile::MESH_PYRAMID4:
+		boundsMin = glm::vec3(-0.5f, -0.5f, -0.5f);
+		boundsMax = glm::vec3(0.5f, 0.5f, 0.5f);
+		break;
+	case SceneFile::MESH_PLANE:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 0.0f, 1.0f);
+		break;
+	case SceneFile::MESH_CYLINDER:
+	case SceneFile::MESH_CYLINDER_NO_TOP:
+	case SceneFile::MESH_CONE:
+	case SceneFile::MESH_HALF_SPHERE:
+	case SceneFile::MESH_TAPERED_CYLINDER:
+		boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	case SceneFile::MESH_SPHERE:
+		boundsMin = glm::vec3(-1.0f, -1.0f, -1.0f);
+		boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  This method is used for building a box with its own four
+ *  vertices per face, so every face has a flat normal and
+ *  the whole texture mapped onto it.
+ ***********************************************************/
+void ShapeGeometry::BuildBox(SHAPE_DATA& shapeData)
+{
+	// normal, then the two axes spanning the face
+	const glm::vec3 faces[6][3] =
+	{
+		{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },
+		{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) }
+	};
+
+	for (int face = 0; face < 6; face++)
+	{
+		const glm::vec3& normal = faces[face][0];
+		const glm::vec3& uAxis = faces[face][1];
+		const glm::vec3& vAxis = faces[face][2];
+		const glm::vec3 center = normal * 0.5f;
+
+		uint32_t first = AddVertex(shapeData, center - uAxis * 0.5f - vAxis * 0.5f, normal, glm::vec2(0.0f, 0.0f));
+		AddVertex(shapeData, center + uAxis * 0.5f - vAxis * 0.5f, normal, glm::vec2(1.0f, 0.0f));
+		AddVertex(shapeData, center + uAxis * 0.5f + vAxis * 0.5f, normal, glm::vec2(1.0f, 1.0f));
+		AddVertex(shapeData, center - uAxis * 0.5f + vAxis * 0.5f, normal, glm::vec2(0.0f, 1.0f));
+
+		const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++)
+		{
+			shapeData.indices.push_back(first + quad[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  This method is used for building a plane facing up.
+ ***********************************************************/
+void ShapeGeometry::BuildPlane(SHAPE_DATA& shapeData)
+{
+	const glm::vec3 normal(0.0f, 1.0f, 0.0f);
+
+	uint32_t first = AddVertex(shapeData, glm::vec3(-1.0f, 0.0f, 1.0f), normal, glm::vec2(0.0f, 0.0f));
+	AddVertex(shapeData, glm::vec3(1.0f, 0.0f, 1.0f), normal, glm::vec2(1.0f, 0.0f));
+	AddVertex(shapeData, glm::vec3(1.0f, 0.0f, -1.0f), normal, glm::vec2(1.0f, 1.0f));
+	AddVertex(shapeData, glm::vec3(-1.0f, 0.0f, -1.0f), normal, glm::vec2(0.0f, 1.0f));
+
+	const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i = 0; i < 6; i++)
+	{
+		shapeData.indices.push_back(first + quad[i]);
+	}
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used for building a cylinder, optionally
+ *  without its top, bottom or sides.
+ ***********************************************************/
+void ShapeGeometry::BuildCylinder(SHAPE_DATA& shapeData, int slices, bool bDrawTop, bool bDrawBottom, bool bDrawSides)
+{
+	if (bDrawSides)
+	{
+		AddSides(shapeData, slices, 1.0f, 1.0f);
+	}
+	if (bDrawTop)
+	{
+		AddDisc(shapeData, slices, 1.0f, 1.0f, true);
+	}
+	if (bDrawBottom)
+	{
+		AddDisc(shapeData, slices, 1.0f, 0.0f, false);
+	}
+}
+
+/***********************************************************
+ *  BuildCone()
+ *
+ *  This method is used for building a cone, optionally
+ *  without its bottom.
+ ***********************************************************/
+void ShapeGeometry::BuildCone(SHAPE_DATA& shapeData, int slices, bool bDrawBottom)
+{
+	AddSides(shapeData, slices, 1.0f, 0.0f);
+	if (bDrawBottom)
+	{
+		AddDisc(shapeData, slices, 1.0f, 0.0f, false);
+	}
+}
+
+/***********************************************************
+ *  BuildSphere()
+ *
+ *  This method is used for building a sphere.
+ ***********************************************************/
+void ShapeGeometry::BuildSphere(SHAPE_DATA& shapeData, int slices)
+{
+	AddSphere(shapeData, slices, false);
+}
+
+/***********************************************************
+ *  BuildHalfSphere()
+ *
+ *  This method is used for building the upper half of a
+ *  sphere, closed with a disc at the bottom.
+ ***********************************************************/
+void ShapeGeometry::BuildHalfSphere(SHAPE_DATA& shapeData, int slices)
+{
+	AddSphere(shapeData, slices, true);
+	AddDisc(shapeData, slices, 1.0f, 0.0f, false);
+}
+
+/***********************************************************
+ *  BuildPyramid4()
+ *
+ *  This method is used for building a pyramid with a square
+ *  base and four flat sides.
+ ***********************************************************/
+void ShapeGeometry::BuildPyramid4(SHAPE_DATA& shapeData)
+{
+	const glm::vec3 apex(0.0f, 0.5f, 0.0f);
+	const glm::vec3 corners[4] =
+	{
+		glm::vec3(-0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, -0.5f, -0.5f),
+		glm::vec3(-0.5f, -0.5f, -0.5f)
+	};
+
+	for (int side = 0; side < 4; side++)
+	{
+		const glm::vec3& left = corners[side];
+		const glm::vec3& right = corners[(side + 1) % 4];
+		glm::vec3 normal = glm::normalize(glm::cross(right - left, apex - left));
+
+		uint32_t first = AddVertex(shapeData, left, normal, glm::vec2(0.0f, 0.0f));
+		AddVertex(shapeData, right, normal, glm::vec2(1.0f, 0.0f));
+		AddVertex(shapeData, apex, normal, glm::vec2(0.5f, 1.0f));
+		shapeData.indices.push_back(first);
+		shapeData.indices.push_back(first + 1);
+		shapeData.indices.push_back(first + 2);
+	}
+
+	const glm::vec3 down(0.0f, -1.0f, 0.0f);
+	uint32_t first = AddVertex(shapeData, corners[0], down, glm::vec2(0.0f, 1.0f));
+	AddVertex(shapeData, corners[1], down, glm::vec2(1.0f, 1.0f));
+	AddVertex(shapeData, corners[2], down, glm::vec2(1.0f, 0.0f));
+	AddVertex(shapeData, corners[3], down, glm::vec2(0.0f, 0.0f));
+
+	const uint32_t quad[6] = { 0, 2, 1, 0, 3, 2 };
+	for (int i = 0; i < 6; i++)
+	{
+		shapeData.indices.push_back(first + quad[i]);
+	}
+}
+
+/***********************************************************
+ *  BuildTaperedCylinder()
+ *
+ *  This method is used for building a cylinder that narrows
+ *  to half of its radius at the top.
+ ***********************************************************/
+void ShapeGeometry::BuildTaperedCylinder(SHAPE_DATA& shapeData, int slices, bool bDrawTop, bool bDrawBottom, bool bDrawSides)
+{
+	if (bDrawSides)
+	{
+		AddSides(shapeData, slices, 1.0f, 0.5f);
+	}
+	if (bDrawTop)
+	{
+		AddDisc(shapeData, slices, 0.5f, 1.0f, true);
+	}
+	if (bDrawBottom)
+	{
+		AddDisc(shapeData, slices, 1.0f, 0.0f, false);
+	}
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method is used for adding one vertex to the shape.
+ ***********************************************************/
+uint32_t ShapeGeometry::AddVertex(SHAPE_DATA& shapeData, glm::vec3 position, glm::vec3 normal, glm::vec2 textureCoordinate)
+{
+	SHAPE_VERTEX vertex;
+	vertex.position = position;
+	vertex.normal = normal;
+	vertex.textureCoordinate = textureCoordinate;
+	shapeData.vertices.push_back(vertex);
+
+	return((uint32_t)(shapeData.vertices.size() - 1));
+}
+
+/***********************************************************
+ *  AddDisc()
+ *
+ *  This method is used for adding a disc around the Y axis
+ *  as a fan of triangles, with the texture mapped as a
+ *  circle in the middle of the image.
+ ***********************************************************/
+void ShapeGeometry::AddDisc(SHAPE_DATA& shapeData, int slices, float radius, float height, bool bFacingUp)
+{
+	if (slices < 3)
+	{
+		slices = 3;
+	}
+
+	const glm::vec3 normal(0.0f, bFacingUp ? 1.0f : -1.0f, 0.0f);
+	uint32_t center = AddVertex(shapeData, glm::vec3(0.0f, height, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float angle = 2.0f * g_Pi * (float)slice / (float)slices;
+		float x = cosf(angle);
+		float z = sinf(angle);
+		AddVertex(shapeData, glm::vec3(x * radius, height, z * radius), normal, glm::vec2(0.5f + x * 0.5f, 0.5f + z * 0.5f));
+	}
+
+	for (int slice = 0; slice < slices; slice++)
+	{
+		uint32_t current = center + 1 + slice;
+		shapeData.indices.push_back(center);
+		shapeData.indices.push_back(bFacingUp ? current + 1 : current);
+		shapeData.indices.push_back(bFacingUp ? current : current + 1);
+	}
+}
+
+/***********************************************************
+ *  AddSides()
+ *
+ *  This method is used for adding the sides of a cylinder
+ *  from y = 0 to y = 1.  The texture wraps once around the
+ *  sides, and the seam has its own vertices so the texture
+ *  coordinates do not jump back across the last slice.
+ ***********************************************************/
+void ShapeGeometry::AddSides(SHAPE_DATA& shapeData, int slices, float bottomRadius, float topRadius)
+{
+	if (slices < 3)
+	{
+		slices = 3;
+	}
+
+	// the slope of the side tilts the normals up as the top narrows
+	const float slope = bottomRadius - topRadius;
+	const uint32_t first = (uint32_t)shapeData.vertices.size();
+
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float u = (float)slice / (float)slices;
+		float angle = 2.0f * g_Pi * u;
+		float x = cosf(angle);
+		float z = sinf(angle);
+		glm::vec3 normal = glm::normalize(glm::vec3(x, slope, z));
+
+		AddVertex(shapeData, glm::vec3(x * bottomRadius, 0.0f, z * bottomRadius), normal, glm::vec2(u, 0.0f));
+		AddVertex(shapeData, glm::vec3(x * topRadius, 1.0f, z * topRadius), normal, glm::vec2(u, 1.0f));
+	}
+
+	for (int slice = 0; slice < slices; slice++)
+	{
+		uint32_t bottom = first + slice * 2;
+		uint32_t top = bottom + 1;
+		uint32_t nextBottom = bottom + 2;
+		uint32_t nextTop = bottom + 3;
+
+		shapeData.indices.push_back(bottom);
+		shapeData.indices.push_back(top);
+		shapeData.indices.push_back(nextBottom);
+		shapeData.indices.push_back(nextBottom);
+		shapeData.indices.push_back(top);
+		shapeData.indices.push_back(nextTop);
+	}
+}
+
+/***********************************************************
+ *  AddSphere()
+ *
+ *  This method is used for adding a sphere of stacks and
+ *  slices, with half as many stacks as slices.
+ ***********************************************************/
+void ShapeGeometry::AddSphere(SHAPE_DATA& shapeData, int slices, bool bUpperHalfOnly)
+{
+	if (slices < 4)
+	{
+		slices = 4;
+	}
+
+	const int stacks = bUpperHalfOnly ? (slices / 4) : (slices / 2);
+	// the polar angle runs from the top down to the equator or the bottom
+	const float endAngle = bUpperHalfOnly ? (0.5f * g_Pi) : g_Pi;
+	const uint32_t first = (uint32_t)shapeData.vertices.size();
+
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		float v = (float)stack / (float)stacks;
+		float polarAngle = endAngle * v;
+		float y = cosf(polarAngle);
+		float ringRadius = sinf(polarAngle);
+
+		for (int slice = 0; slice <= slices; slice++)
+		{
+			float u = (float)slice / (float)slices;
+			float angle = 2.0f * g_Pi * u;
+			glm::vec3 position(cosf(angle) * ringRadius, y, sinf(angle) * ringRadius);
+
+			AddVertex(shapeData, position, position, glm::vec2(u, 1.0f - polarAngle / g_Pi));
+		}
+	}
+
+	const uint32_t ringSize = slices + 1;
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			uint32_t upper = first + stack * ringSize + slice;
+			uint32_t lower = upper + ringSize;
+
+			shapeData.indices.push_back(upper);
+			shapeData.indices.push_back(upper + 1);
+			shapeData.indices.push_back(lower);
+			shapeData.indices.push_back(lower);
+			shapeData.indices.push_back(upper + 1);
+			shapeData.indices.push_back(lower + 1);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.h
+// ============
+// build the vertex and index data of the basic 3D shapes on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  ShapeGeometry
+ *
+ *  This class builds the basic shapes with the same size,
+ *  placement and texture mapping as the meshes loaded by
+ *  ShapeMeshes, so that a shape can be drawn from buffers
+ *  owned by the caller - for example with instancing - and
+ *  still look the same as the ShapeMeshes version:
+ *
+ *    box            1 x 1 x 1 around the origin
+ *    plane          2 x 2 in the XZ plane, facing up
+ *    cylinder       radius 1, from y = 0 to y = 1
+ *    cone           radius 1 at y = 0, tip at y = 1
+ *    sphere         radius 1 around the origin
+ *    half sphere    upper half of the sphere, closed at y = 0
+ *    pyramid4       1 x 1 base at y = -0.5, tip at y = 0.5
+ *    tapered        radius 1 at y = 0, radius 0.5 at y = 1
+ *
+ *  The round shapes take the number of slices around the Y
+ *  axis, so they can also be built at other levels of detail.
+ ***********************************************************/
+class ShapeGeometry
+{
+public:
+	// interleaved vertex layout - matches the shader inputs
+	// at locations 0, 1 and 2
+	struct SHAPE_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	struct SHAPE_DATA
+	{
+		std::vector<SHAPE_VERTEX> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// default number of slices around the Y axis
+	static const int DEFAULT_SLICES = 36;
+
+	// build the shape for a scene file mesh ID - returns false
+	// for IDs that are not a shape
+	static bool BuildMesh(int meshID, SHAPE_DATA& shapeData, int slices = DEFAULT_SLICES);
+	// get the box around the shape of a scene file mesh ID -
+	// returns false for IDs that are not a shape
+	static bool GetMeshBounds(int meshID, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	static void BuildBox(SHAPE_DATA& shapeData);
+	static void BuildPlane(SHAPE_DATA& shapeData);
+	static void BuildCylinder(SHAPE_DATA& shapeData, int slices, bool bDrawTop = true, bool bDrawBottom = true, bool bDrawSides = true);
+	static void BuildCone(SHAPE_DATA& shapeData, int slices, bool bDrawBottom = true);
+	static void BuildSphere(SHAPE_DATA& shapeData, int slices);
+	static void BuildHalfSphere(SHAPE_DATA& shapeData, int slices);
+	static void BuildPyramid4(SHAPE_DATA& shapeData);
+	static void BuildTaperedCylinder(SHAPE_DATA& shapeData, int slices, bool bDrawTop = true, bool bDrawBottom = true, bool bDrawSides = true);
+
+private:
+	// add a vertex and get back its index
+	static uint32_t AddVertex(SHAPE_DATA& shapeData, glm::vec3 position, glm::vec3 normal, glm::vec2 textureCoordinate);
+	// add a flat disc facing up or down at the passed in height
+	static void AddDisc(SHAPE_DATA& shapeData, int slices, float radius, float height, bool bFacingUp);
+	// add the sides of a cylinder with different end radii
+	static void AddSides(SHAPE_DATA& shapeData, int slices, float bottomRadius, float topRadius);
+	// add the upper half of a sphere, or the whole sphere
+	static void AddSphere(SHAPE_DATA& shapeData, int slices, bool bUpperHalfOnly);
+};
@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+// streamring.cpp
+// ============
+// persistently mapped ring buffer for the data written every frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StreamRing.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// flags the buffer is created and mapped with - it stays
+	// mapped while the GPU reads it, and the writes are seen
+	// without a flush
+	const GLbitfield g_MapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	// smallest alignment of the allocations, even where the
+	// uniform buffers would allow less
+	const size_t g_MinAlignment = 16;
+	// time a single fence wait may block before it is retried
+	const GLuint64 g_FenceTimeoutNanoseconds = 1000000000;
+}
+
+/***********************************************************
+ *  StreamRing()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StreamRing::StreamRing(GLStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_bufferID = 0;
+	m_pMapped = NULL;
+	m_frameBytes = 0;
+	m_requiredBytes = 0;
+	m_failedFrameBytes = 0;
+	m_alignment = g_MinAlignment;
+	m_currentFrame = 0;
+	m_usedBytes = 0;
+	for (int frame = 0; frame < FRAMES_IN_FLIGHT; frame++)
+	{
+		m_fences[frame] = NULL;
+	}
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+	memset(&m_lastFrameStats, 0, sizeof(m_lastFrameStats));
+}
+
+/***********************************************************
+ *  ~StreamRing()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StreamRing::~StreamRing()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the buffer with a region
+ *  of the passed in size for each frame in flight, and
+ *  mapping all of it once.  It fails without immutable
+ *  buffer storage, and the ring then stays unavailable.
+ ***********************************************************/
+bool StreamRing::Create(size_t frameBytes)
+{
+	Destroy();
+
+	if ((0 == frameBytes) || !(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage))
+	{
+		return false;
+	}
+
+	// the camera block is bound as a range of the buffer, and
+	// the ranges have to start on this alignment
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	m_alignment = std::max((size_t)uniformAlignment, g_MinAlignment);
+
+	return(CreateBuffer((frameBytes + m_alignment - 1) / m_alignment * m_alignment));
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for waiting until the GPU has read
+ *  every region, and then unmapping and freeing the buffer.
+ ***********************************************************/
+void StreamRing::Destroy()
+{
+	for (int frame = 0; frame < FRAMES_IN_FLIGHT; frame++)
+	{
+		WaitForFence(frame);
+	}
+	DestroyBuffer();
+	m_requiredBytes = 0;
+	m_failedFrameBytes = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for moving to the region of a new
+ *  frame.  The fence of the frame that wrote the region
+ *  last is waited for, and when an allocation of the last
+ *  frames did not fit, the regions are grown first, which
+ *  has to wait for every frame in flight.  When the larger
+ *  buffer cannot be created the old one is kept, and that
+ *  size is not tried again.
+ ***********************************************************/
+void StreamRing::BeginFrame()
+{
+	PROFILE_ZONE("StreamRing::BeginFrame");
+
+	m_lastFrameStats = m_frameStats;
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+
+	if (NULL == m_pMapped)
+	{
+		return;
+	}
+
+	size_t frameBytes = m_frameBytes;
+	while (frameBytes < m_requiredBytes)
+	{
+		frameBytes *= 2;
+	}
+	if ((frameBytes > m_frameBytes) &&
+		((0 == m_failedFrameBytes) || (frameBytes < m_failedFrameBytes)))
+	{
+		for (int frame = 0; frame < FRAMES_IN_FLIGHT; frame++)
+		{
+			WaitForFence(frame);
+		}
+
+		if (CreateBuffer(frameBytes))
+		{
+			m_frameStats.regrows++;
+		}
+		else
+		{
+			m_failedFrameBytes = frameBytes;
+		}
+		m_requiredBytes = 0;
+	}
+
+	m_currentFrame = (m_currentFrame + 1) % FRAMES_IN_FLIGHT;
+	WaitForFence(m_currentFrame);
+	m_usedBytes = 0;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for placing a fence after the draws
+ *  of the frame, which signals once the GPU is done reading
+ *  the region of the frame.
+ ***********************************************************/
+void StreamRing::EndFrame()
+{
+	if (NULL == m_pMapped)
+	{
+		return;
+	}
+
+	if (NULL != m_fences[m_currentFrame])
+	{
+		glDeleteSync(m_fences[m_currentFrame]);
+	}
+	m_fences[m_currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for getting space for data of the
+ *  current frame in its region.  The data is written through
+ *  the returned pointer, and drawn from the buffer at the
+ *  returned offset.  When the region is full the size it
+ *  would need is kept for the next frame, and NULL is
+ *  returned.
+ ***********************************************************/
+void* StreamRing::Allocate(size_t bytes, GLintptr& offset)
+{
+	if ((NULL == m_pMapped) || (0 == bytes))
+	{
+		return(NULL);
+	}
+
+	const size_t start = (m_usedBytes + m_alignment - 1) / m_alignment * m_alignment;
+	if (start + bytes > m_frameBytes)
+	{
+		m_requiredBytes = std::max(m_requiredBytes, start + bytes);
+		m_frameStats.failedAllocations++;
+		return(NULL);
+	}
+
+	m_usedBytes = start + bytes;
+	m_frameStats.bytesAllocated += bytes;
+	offset = (GLintptr)(m_currentFrame * m_frameBytes + start);
+
+	return(m_pMapped + offset);
+}
+
+/***********************************************************
+ *  CreateBuffer()
+ *
+ *  This method is used for creating the immutable storage
+ *  of all the regions and mapping it for good.  The new
+ *  buffer replaces the current one only once it is mapped,
+ *  so a buffer that cannot be created leaves the current
+ *  one as it was.
+ ***********************************************************/
+bool StreamRing::CreateBuffer(size_t frameBytes)
+{
+	PROFILE_ZONE("StreamRing::CreateBuffer");
+
+	const GLsizeiptr totalBytes = (GLsizeiptr)(frameBytes * FRAMES_IN_FLIGHT);
+
+	GLuint bufferID = 0;
+	glGenBuffers(1, &bufferID);
+	m_pStateCache->BindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, totalBytes, NULL, g_MapFlags);
+	unsigned char* pMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalBytes, g_MapFlags);
+	if (NULL == pMapped)
+	{
+		std::cout << "Could not map the stream ring buffer" << std::endl;
+		m_pStateCache->DeleteBuffers(1, &bufferID);
+		return false;
+	}
+
+	DestroyBuffer();
+	m_bufferID = bufferID;
+	m_pMapped = pMapped;
+	m_frameBytes = frameBytes;
+	m_currentFrame = 0;
+	m_usedBytes = 0;
+
+	return true;
+}
+
+/***********************************************************
+ *  DestroyBuffer()
+ *
+ *  This method is used for unmapping and freeing the buffer.
+ *  The GPU must be done with every region.
+ ***********************************************************/
+void StreamRing::DestroyBuffer()
+{
+	if (0 != m_bufferID)
+	{
+		if (NULL != m_pMapped)
+		{
+			m_pStateCache->BindBuffer(GL_COPY_WRITE_BUFFER, m_bufferID);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		m_pStateCache->DeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+	m_pMapped = NULL;
+	m_frameBytes = 0;
+	m_usedBytes = 0;
+}
+
+/***********************************************************
+ *  WaitForFence()
+ *
+ *  This method is used for waiting until the fence of the
+ *  passed in region has signaled, and deleting it.  A fence
+ *  that has already signaled costs no wait, and any time
+ *  spent blocked is counted as a stall.
+ ***********************************************************/
+void StreamRing::WaitForFence(int frame)
+{
+	GLsync fence = m_fences[frame];
+	if (NULL == fence)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (GL_TIMEOUT_EXPIRED == result)
+	{
+		PROFILE_ZONE("StreamRing fence stall");
+
+		const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, g_FenceTimeoutNanoseconds);
+		} while (GL_TIMEOUT_EXPIRED == result);
+
+		m_frameStats.fenceStalls++;
+		m_frameStats.stallMilliseconds += std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - waitStart).count();
+	}
+
+	glDeleteSync(fence);
+	m_fences[frame] = NULL;
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// streamring.h
+// ============
+// persistently mapped ring buffer for the data written every frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  StreamRing
+ *
+ *  This class holds one buffer that stays mapped for its
+ *  whole life, split into a region for each frame in flight.
+ *  The data of a frame - the camera block, the instances and
+ *  the draw commands - is written straight into the frame's
+ *  region through the mapped pointer, with no upload call,
+ *  and the draws read it from there.
+ *
+ *  A fence is placed after the draws of every frame, and a
+ *  region is only written again once the fence of the frame
+ *  that last used it has signaled, so the CPU writes the
+ *  next frame while the GPU is still reading the previous
+ *  ones.  The mapping is coherent, so the writes need no
+ *  flush.  The time spent waiting on the fences is counted
+ *  per frame, since any wait means the GPU has fallen more
+ *  than the ring behind.
+ *
+ *  An allocation that does not fit fails, and the caller
+ *  sends that data the way it would without the ring.  The
+ *  regions are then grown at the start of the next frame.
+ *  The ring needs GL 4.4 or ARB_buffer_storage.
+ ***********************************************************/
+class StreamRing
+{
+public:
+	// constructor
+	StreamRing(GLStateCache* pStateCache);
+	// destructor
+	~StreamRing();
+
+	// number of regions - one per frame the GPU may be behind
+	static const int FRAMES_IN_FLIGHT = 3;
+
+	struct RING_STATS
+	{
+		// bytes handed out, and allocations that did not fit
+		size_t bytesAllocated;
+		unsigned int failedAllocations;
+		// fence waits that blocked, and the time they took
+		unsigned int fenceStalls;
+		double stallMilliseconds;
+		// times the regions were grown
+		unsigned int regrows;
+	};
+
+	// create and map the buffer with regions of the passed in
+	// size - the context has to be current
+	bool Create(size_t frameBytes);
+	// unmap and free the buffer, waiting for the GPU first
+	void Destroy();
+
+	// move to the region of a new frame, waiting until the GPU
+	// has finished the frame that used it last
+	void BeginFrame();
+	// place the fence after the draws of the frame
+	void EndFrame();
+
+	// get space for data of the frame, and its offset in the
+	// buffer, or NULL when it does not fit
+	void* Allocate(size_t bytes, GLintptr& offset);
+
+	// get whether the buffer could be created
+	bool IsAvailable() const { return(NULL != m_pMapped); }
+	// get the buffer the allocations are in
+	GLuint GetBufferID() const { return(m_bufferID); }
+
+	// get the fence waits and allocations of the frame so far
+	RING_STATS GetFrameStats() const { return(m_frameStats); }
+	// get the fence waits and allocations of the last frame
+	RING_STATS GetLastFrameStats() const { return(m_lastFrameStats); }
+
+private:
+	// pointer to the cache the buffer binds go through
+	GLStateCache* m_pStateCache;
+	GLuint m_bufferID;
+	// start of the whole mapped buffer
+	unsigned char* m_pMapped;
+	// size of each region, the size the next frame needs, and
+	// the smallest size that could not be created, if any
+	size_t m_frameBytes;
+	size_t m_requiredBytes;
+	size_t m_failedFrameBytes;
+	// offsets are aligned for uniform buffer ranges
+	size_t m_alignment;
+	// region of the current frame, and the bytes used in it
+	int m_currentFrame;
+	size_t m_usedBytes;
+	// fence of the last frame drawn from each region
+	GLsync m_fences[FRAMES_IN_FLIGHT];
+	// counts of the current and the last frame
+	RING_STATS m_frameStats;
+	RING_STATS m_lastFrameStats;
+
+	// create the buffer and map it, replacing the current one
+	bool CreateBuffer(size_t frameBytes);
+	// unmap and free the buffer
+	void DestroyBuffer();
+	// wait for the fence of a region and delete it
+	void WaitForFence(int frame);
+};
@@ -0,0 +1,734 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// on-disk cache of block compressed texture layers and their mipmaps
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// file name extension of the cache files
+	const char* g_CacheExtension = ".btc";
+	// alignment of the levels in a cache file
+	const size_t g_LevelAlignment = 16;
+
+	/***********************************************************
+	 *  GetFileKey()
+	 *
+	 *  This function is used for getting the size and the
+	 *  modification time of a file.
+	 ***********************************************************/
+	bool GetFileKey(const std::string& filename, uint64_t& fileSize, int64_t& fileTime)
+	{
+#ifdef _WIN32
+		struct _stat64 fileInfo;
+		if (0 != _stat64(filename.c_str(), &fileInfo))
+		{
+			return false;
+		}
+#else
+		struct stat fileInfo;
+		if (0 != stat(filename.c_str(), &fileInfo))
+		{
+			return false;
+		}
+#endif
+		fileSize = (uint64_t)fileInfo.st_size;
+		fileTime = (int64_t)fileInfo.st_mtime;
+
+		return true;
+	}
+
+	/***********************************************************
+	 *  PackColor565()
+	 *
+	 *  This function is used for rounding an 8 bit per channel
+	 *  color to the 5:6:5 bit endpoint format of the blocks.
+	 ***********************************************************/
+	uint16_t PackColor565(const int color[3])
+	{
+		const int red = (color[0] * 31 + 127) / 255;
+		const int green = (color[1] * 63 + 127) / 255;
+		const int blue = (color[2] * 31 + 127) / 255;
+
+		return((uint16_t)((red << 11) | (green << 5) | blue));
+	}
+
+	/***********************************************************
+	 *  UnpackColor565()
+	 *
+	 *  This function is used for expanding a 5:6:5 endpoint to
+	 *  8 bits per channel the same way the GPU does.
+	 ***********************************************************/
+	void UnpackColor565(uint16_t packed, int color[3])
+	{
+		const int red = (packed >> 11) & 31;
+		const int green = (packed >> 5) & 63;
+		const int blue = packed & 31;
+
+		color[0] = (red << 3) | (red >> 2);
+		color[1] = (green << 2) | (green >> 4);
+		color[2] = (blue << 3) | (blue >> 2);
+	}
+
+	/***********************************************************
+	 *  FetchBlock()
+	 *
+	 *  This function is used for copying the 4x4 pixels of a
+	 *  block into RGBA form.  Levels smaller than a block repeat
+	 *  their edge pixels, and RGB images get an opaque alpha.
+	 ***********************************************************/
+	void FetchBlock(
+		const unsigned char* pPixels,
+		int levelSize,
+		int channels,
+		int blockX,
+		int blockY,
+		unsigned char block[16][4])
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const int pixelY = std::min(blockY * 4 + y, levelSize - 1);
+			for (int x = 0; x < 4; x++)
+			{
+				const int pixelX = std::min(blockX * 4 + x, levelSize - 1);
+				const unsigned char* pPixel = pPixels + ((size_t)pixelY * levelSize + pixelX) * channels;
+				unsigned char* pOut = block[y * 4 + x];
+
+				pOut[0] = pPixel[0];
+				pOut[1] = pPixel[1];
+				pOut[2] = pPixel[2];
+				pOut[3] = (channels == 4) ? pPixel[3] : 255;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  This function is used for compressing the colors of a
+	 *  block into the 8 byte BC1 layout.  The endpoints are the
+	 *  corners of the bounding box of the block colors, moved
+	 *  in by a sixteenth of its size so the interpolated colors
+	 *  cover the block better, and each pixel then picks the
+	 *  nearest of the four palette colors.  The endpoints are
+	 *  always ordered for the four color mode, which is also
+	 *  the only mode of the color half of a BC3 block.
+	 ***********************************************************/
+	void EncodeColorBlock(const unsigned char block[16][4], unsigned char* pOut)
+	{
+		int minColor[3] = { 255, 255, 255 };
+		int maxColor[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				minColor[c] = std::min(minColor[c], (int)block[i][c]);
+				maxColor[c] = std::max(maxColor[c], (int)block[i][c]);
+			}
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			const int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		uint16_t color0 = PackColor565(maxColor);
+		uint16_t color1 = PackColor565(minColor);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			UnpackColor565(color0, palette[0]);
+			UnpackColor565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestDistance = 0x7FFFFFFF;
+				for (int index = 0; index < 4; index++)
+				{
+					int distance = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						const int delta = (int)block[i][c] - palette[index][c];
+						distance += delta * delta;
+					}
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = index;
+					}
+				}
+				indices |= (uint32_t)bestIndex << (2 * i);
+			}
+		}
+		// with equal endpoints every index of 0 selects the color
+
+		pOut[0] = (unsigned char)(color0 & 0xFF);
+		pOut[1] = (unsigned char)(color0 >> 8);
+		pOut[2] = (unsigned char)(color1 & 0xFF);
+		pOut[3] = (unsigned char)(color1 >> 8);
+		pOut[4] = (unsigned char)(indices & 0xFF);
+		pOut[5] = (unsigned char)((indices >> 8) & 0xFF);
+		pOut[6] = (unsigned char)((indices >> 16) & 0xFF);
+		pOut[7] = (unsigned char)(indices >> 24);
+	}
+
+	/***********************************************************
+	 *  EncodeAlphaBlock()
+	 *
+	 *  This function is used for compressing the alpha values
+	 *  of a block into the 8 byte alpha half of a BC3 block,
+	 *  with the lowest and highest alpha as the endpoints of the
+	 *  eight value palette.
+	 ***********************************************************/
+	void EncodeAlphaBlock(const unsigned char block[16][4], unsigned char* pOut)
+	{
+		int minAlpha = 255;
+		int maxAlpha = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			minAlpha = std::min(minAlpha, (int)block[i][3]);
+			maxAlpha = std::max(maxAlpha, (int)block[i][3]);
+		}
+
+		uint64_t indices = 0;
+		if (maxAlpha != minAlpha)
+		{
+			int palette[8];
+			palette[0] = maxAlpha;
+			palette[1] = minAlpha;
+			for (int index = 2; index < 8; index++)
+			{
+				palette[index] = ((8 - index) * maxAlpha + (index - 1) * minAlpha) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestDistance = 256;
+				for (int index = 0; index < 8; index++)
+				{
+					const int distance = std::abs((int)block[i][3] - palette[index]);
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = index;
+					}
+				}
+				indices |= (uint64_t)bestIndex << (3 * i);
+			}
+		}
+
+		pOut[0] = (unsigned char)maxAlpha;
+		pOut[1] = (unsigned char)minAlpha;
+		for (int i = 0; i < 6; i++)
+		{
+			pOut[2 + i] = (unsigned char)((indices >> (8 * i)) & 0xFF);
+		}
+	}
+
+	/***********************************************************
+	 *  CompressLevel()
+	 *
+	 *  This function is used for compressing a square level,
+	 *  block by block, in the passed in format.
+	 ***********************************************************/
+	void CompressLevel(
+		const unsigned char* pPixels,
+		int levelSize,
+		int channels,
+		TextureCache::CACHE_FORMAT format,
+		unsigned char* pOut)
+	{
+		const int blocks = std::max(1, (levelSize + 3) / 4);
+		unsigned char block[16][4];
+
+		for (int blockY = 0; blockY < blocks; blockY++)
+		{
+			for (int blockX = 0; blockX < blocks; blockX++)
+			{
+				FetchBlock(pPixels, levelSize, channels, blockX, blockY, block);
+				if (TextureCache::FORMAT_BC3 == format)
+				{
+					EncodeAlphaBlock(block, pOut);
+					pOut += 8;
+				}
+				EncodeColorBlock(block, pOut);
+				pOut += 8;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache()
+{
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+	Close();
+}
+
+/***********************************************************
+ *  GetFormat()
+ *
+ *  This method is used for getting the compressed format of
+ *  images with the passed in channel count.
+ ***********************************************************/
+TextureCache::CACHE_FORMAT TextureCache::GetFormat(int channels)
+{
+	return((channels == 4) ? FORMAT_BC3 : FORMAT_BC1);
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ *
+ *  This method is used for getting the number of mipmap
+ *  levels of a square power of two layer.
+ ***********************************************************/
+int TextureCache::GetLevelCount(int size)
+{
+	int levels = 1;
+	while (size > 1)
+	{
+		size /= 2;
+		levels++;
+	}
+	return(levels);
+}
+
+/***********************************************************
+ *  GetLevelBytes()
+ *
+ *  This method is used for getting the compressed size of a
+ *  square level - levels smaller than a block still take up
+ *  a whole block.
+ ***********************************************************/
+size_t TextureCache::GetLevelBytes(CACHE_FORMAT format, int levelSize)
+{
+	const size_t blocks = (size_t)std::max(1, (levelSize + 3) / 4);
+	const size_t blockBytes = (FORMAT_BC3 == format) ? 16 : 8;
+
+	return(blocks * blocks * blockBytes);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method is used for getting the name of the cache
+ *  file of an image, which is kept next to the image.
+ ***********************************************************/
+std::string TextureCache::GetCachePath(const std::string& sourceFilename)
+{
+	return(sourceFilename + g_CacheExtension);
+}
+
+/***********************************************************
+ *  ReadFileBytes()
+ *
+ *  This method is used for reading a whole file into memory.
+ ***********************************************************/
+bool TextureCache::ReadFileBytes(const std::string& filename, std::vector<unsigned char>& bytes)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+
+	const std::streamsize byteCount = file.tellg();
+	file.seekg(0, std::ios::beg);
+	bytes.resize((size_t)byteCount);
+	if ((byteCount > 0) && !file.read((char*)bytes.data(), byteCount))
+	{
+		bytes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This method is used for getting the 64 bit FNV-1a hash
+ *  of a block of memory.
+ ***********************************************************/
+uint64_t TextureCache::HashBytes(const unsigned char* pBytes, size_t byteCount)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		hash ^= pBytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping the cache file of an
+ *  image into memory.  It fails, without a message, when
+ *  there is no cache file yet or when the file does not
+ *  match the image or the passed in layer format, so the
+ *  caller can fall back to decoding the image.
+ ***********************************************************/
+bool TextureCache::Open(const std::string& sourceFilename, int size, int channels, bool bKeepAlphaCoverage)
+{
+	Close();
+
+	const std::string filename = GetCachePath(sourceFilename);
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == fileHandle)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == mappingHandle)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_mappingHandle = mappingHandle;
+	m_mappingSize = (size_t)fileSize.QuadPart;
+	m_pMapping = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+	struct stat fileInfo;
+	fstat(fileDescriptor, &fileInfo);
+	m_mappingSize = (size_t)fileInfo.st_size;
+
+	void* pMapping = MAP_FAILED;
+	if (m_mappingSize > 0)
+	{
+		pMapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(fileDescriptor);
+	m_pMapping = (MAP_FAILED == pMapping) ? NULL : (const unsigned char*)pMapping;
+#endif
+
+	if (NULL == m_pMapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = (const CACHE_HEADER*)m_pMapping;
+	if (!ValidateHeader(m_mappingSize, size, channels, bKeepAlphaCoverage) || !ValidateSource(sourceFilename))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for compressing a decoded square
+ *  layer and the mipmap chain MipChain builds from it.  The
+ *  result is kept in memory, so it can be uploaded right
+ *  away, and is written to the cache file for the next
+ *  launch.  It goes to a temporary file first, so another
+ *  launch never maps a half written cache.  Not being able
+ *  to write the file only costs the next launch a decode.
+ ***********************************************************/
+bool TextureCache::Build(
+	const std::string& sourceFilename,
+	uint64_t sourceHash,
+	const unsigned char* pPixels,
+	int size,
+	int channels,
+	int sourceWidth,
+	int sourceHeight,
+	bool bKeepAlphaCoverage)
+{
+	Close();
+
+	const int levelCount = GetLevelCount(size);
+	if ((NULL == pPixels) || (size <= 0) || (levelCount > MAX_LEVELS))
+	{
+		return false;
+	}
+
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.format = GetFormat(channels);
+	header.size = (uint32_t)size;
+	header.levelCount = (uint32_t)levelCount;
+	header.sourceWidth = (uint32_t)sourceWidth;
+	header.sourceHeight = (uint32_t)sourceHeight;
+	header.flags = bKeepAlphaCoverage ? FLAG_ALPHA_COVERAGE : 0;
+	header.sourceHash = sourceHash;
+	if (!GetFileKey(sourceFilename, header.sourceSize, header.sourceTime))
+	{
+		return false;
+	}
+
+	uint64_t offset = (sizeof(CACHE_HEADER) + g_LevelAlignment - 1) & ~(uint64_t)(g_LevelAlignment - 1);
+	int levelSize = size;
+	for (int level = 0; level < levelCount; level++)
+	{
+		header.levelOffset[level] = offset;
+		header.levelBytes[level] = GetLevelBytes((CACHE_FORMAT)header.format, levelSize);
+		// the block sizes keep every level aligned
+		offset += header.levelBytes[level];
+		levelSize = std::max(1, levelSize / 2);
+	}
+	header.fileSize = offset;
+
+	m_buildData.assign((size_t)header.fileSize, 0);
+	memcpy(m_buildData.data(), &header, sizeof(header));
+
+	std::vector<MipChain::MIP_LEVEL> mipLevels;
+	MipChain::BuildLevels(pPixels, size, channels, bKeepAlphaCoverage, mipLevels);
+
+	CompressLevel(pPixels, size, channels, (CACHE_FORMAT)header.format, m_buildData.data() + header.levelOffset[0]);
+	for (int level = 1; level < levelCount; level++)
+	{
+		const MipChain::MIP_LEVEL& mipLevel = mipLevels[level - 1];
+		CompressLevel(mipLevel.pixels.data(), mipLevel.size, channels, (CACHE_FORMAT)header.format, m_buildData.data() + header.levelOffset[level]);
+	}
+	m_pHeader = (const CACHE_HEADER*)m_buildData.data();
+
+	const std::string filename = GetCachePath(sourceFilename);
+	const std::string temporaryFilename = filename + ".tmp";
+	bool bWritten = false;
+	{
+		std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+		if (file)
+		{
+			file.write((const char*)m_buildData.data(), (std::streamsize)m_buildData.size());
+			bWritten = !file.fail();
+		}
+	}
+	if (bWritten)
+	{
+		// rename does not replace an existing file everywhere
+		std::remove(filename.c_str());
+		bWritten = (0 == std::rename(temporaryFilename.c_str(), filename.c_str()));
+	}
+	if (!bWritten)
+	{
+		std::remove(temporaryFilename.c_str());
+		std::cout << "Could not write texture cache:" << filename << std::endl;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the opened cache file,
+ *  or freeing the built one.
+ ***********************************************************/
+void TextureCache::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pMapping)
+	{
+		UnmapViewOfFile(m_pMapping);
+	}
+	if (NULL != m_mappingHandle)
+	{
+		CloseHandle((HANDLE)m_mappingHandle);
+	}
+	if (NULL != m_fileHandle)
+	{
+		CloseHandle((HANDLE)m_fileHandle);
+	}
+#else
+	if (NULL != m_pMapping)
+	{
+		munmap((void*)m_pMapping, m_mappingSize);
+	}
+#endif
+
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+	std::vector<unsigned char>().swap(m_buildData);
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  GetLevelData()
+ *
+ *  This method is used for getting the compressed data of a
+ *  mipmap level of the opened or built cache.
+ ***********************************************************/
+const unsigned char* TextureCache::GetLevelData(int level) const
+{
+	if ((NULL == m_pHeader) || (level < 0) || (level >= (int)m_pHeader->levelCount))
+	{
+		return(NULL);
+	}
+	return((const unsigned char*)m_pHeader + m_pHeader->levelOffset[level]);
+}
+
+/***********************************************************
+ *  GetDataBytes()
+ *
+ *  This method is used for getting the size of the data of
+ *  all the levels, from the start of level 0.
+ ***********************************************************/
+size_t TextureCache::GetDataBytes() const
+{
+	if (NULL == m_pHeader)
+	{
+		return(0);
+	}
+	return((size_t)(m_pHeader->fileSize - m_pHeader->levelOffset[0]));
+}
+
+/***********************************************************
+ *  ValidateHeader()
+ *
+ *  This method is used for checking that the header of the
+ *  mapped file is a known version, that it holds the layer
+ *  format and mipmaps the caller needs, and that its levels
+ *  have the right sizes and lie inside of the file, one
+ *  after the other.
+ ***********************************************************/
+bool TextureCache::ValidateHeader(size_t fileSize, int size, int channels, bool bKeepAlphaCoverage) const
+{
+	if (fileSize < sizeof(CACHE_HEADER))
+	{
+		return false;
+	}
+
+	const CACHE_HEADER& header = *m_pHeader;
+	if ((header.magic != CACHE_MAGIC) ||
+		(header.version != CACHE_VERSION) ||
+		(header.fileSize != fileSize) ||
+		(header.format != (uint32_t)GetFormat(channels)) ||
+		(header.size != (uint32_t)size) ||
+		(header.flags != (bKeepAlphaCoverage ? (uint32_t)FLAG_ALPHA_COVERAGE : 0)) ||
+		(header.levelCount != (uint32_t)GetLevelCount(size)) ||
+		(header.levelCount > (uint32_t)MAX_LEVELS))
+	{
+		return false;
+	}
+
+	uint64_t offset = header.levelOffset[0];
+	if (offset < sizeof(CACHE_HEADER))
+	{
+		return false;
+	}
+	int levelSize = size;
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		if ((header.levelOffset[level] != offset) ||
+			(header.levelBytes[level] != GetLevelBytes((CACHE_FORMAT)header.format, levelSize)))
+		{
+			return false;
+		}
+		offset += header.levelBytes[level];
+		levelSize = std::max(1, levelSize / 2);
+	}
+
+	return(offset == header.fileSize);
+}
+
+/***********************************************************
+ *  ValidateSource()
+ *
+ *  This method is used for checking that the image is the
+ *  one the mapped file was built from.  A matching size and
+ *  modification time is enough - otherwise, as when a copy
+ *  or checkout touched the image, the image is hashed and
+ *  the file is still used when the contents are the same.
+ ***********************************************************/
+bool TextureCache::ValidateSource(const std::string& sourceFilename) const
+{
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	if (!GetFileKey(sourceFilename, sourceSize, sourceTime) ||
+		(sourceSize != m_pHeader->sourceSize))
+	{
+		return false;
+	}
+	if (sourceTime == m_pHeader->sourceTime)
+	{
+		return true;
+	}
+
+	std::vector<unsigned char> sourceBytes;
+	if (!ReadFileBytes(sourceFilename, sourceBytes))
+	{
+		return false;
+	}
+	return(HashBytes(sourceBytes.data(), sourceBytes.size()) == m_pHeader->sourceHash);
+}
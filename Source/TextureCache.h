@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// on-disk cache of block compressed texture layers and their mipmaps
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class holds one texture layer and its whole mipmap
+ *  chain in a GPU block compressed format - BC1 for RGB
+ *  images and BC3 for RGBA images - so the levels can be
+ *  passed to the driver as they are.
+ *
+ *  The first time an image is loaded, Build() compresses the
+ *  decoded layer and writes the result next to the image,
+ *  as "<image file>.btc".  Later loads Open() that file,
+ *  which maps it into memory without decoding anything.  A
+ *  cache file is keyed by the size, modification time and
+ *  content hash of its image - it is still used when only the
+ *  modification time changed but the bytes are the same, and
+ *  is ignored, to be rebuilt, when the image changed.
+ *
+ *  The class makes no OpenGL calls, so it can be used on the
+ *  texture decode worker threads.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache();
+	// destructor
+	~TextureCache();
+
+	// block compressed formats - stored in the file
+	enum CACHE_FORMAT
+	{
+		FORMAT_BC1 = 1,		// RGB, 8 bytes per 4x4 block
+		FORMAT_BC3 = 3		// RGBA, 16 bytes per 4x4 block
+	};
+
+	// identifies a cache file and its layout version
+	static const uint32_t CACHE_MAGIC = 0x43544342;	// "BCTC"
+	static const uint32_t CACHE_VERSION = 2;
+	// flags of the options the mipmaps were built with
+	static const uint32_t FLAG_ALPHA_COVERAGE = 1;
+	// most mipmap levels a cache file can hold
+	static const int MAX_LEVELS = 16;
+
+	// header at the start of a cache file - the offsets are in
+	// bytes from the start of the file, and every level starts
+	// on a 16 byte boundary
+	struct CACHE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;
+		uint32_t size;					// square size of level 0
+		uint32_t levelCount;
+		uint32_t sourceWidth;
+		uint32_t sourceHeight;
+		uint32_t flags;
+		// key of the image the file was built from
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+		uint64_t levelOffset[MAX_LEVELS];
+		uint64_t levelBytes[MAX_LEVELS];
+		uint64_t fileSize;
+	};
+
+	// get the format used for images with a channel count
+	static CACHE_FORMAT GetFormat(int channels);
+	// get the number of mipmap levels of a square power of two size
+	static int GetLevelCount(int size);
+	// get the compressed byte count of one square level
+	static size_t GetLevelBytes(CACHE_FORMAT format, int levelSize);
+	// get the name of the cache file of an image
+	static std::string GetCachePath(const std::string& sourceFilename);
+
+	// read a whole file into memory
+	static bool ReadFileBytes(const std::string& filename, std::vector<unsigned char>& bytes);
+	// get the 64 bit FNV-1a hash of a block of memory
+	static uint64_t HashBytes(const unsigned char* pBytes, size_t byteCount);
+
+	// map the cache file of an image when it is valid for that
+	// image and for the passed in layer size, channel count and
+	// mipmap option
+	bool Open(const std::string& sourceFilename, int size, int channels, bool bKeepAlphaCoverage);
+	// compress a decoded square layer and its mipmaps, keep the
+	// result in memory and write it to the cache file
+	bool Build(
+		const std::string& sourceFilename,
+		uint64_t sourceHash,
+		const unsigned char* pPixels,
+		int size,
+		int channels,
+		int sourceWidth,
+		int sourceHeight,
+		bool bKeepAlphaCoverage);
+	// unmap or free the current cache data
+	void Close();
+
+	// get the header of the opened or built cache
+	const CACHE_HEADER* GetHeader() const { return(m_pHeader); }
+	// get the compressed data of a mipmap level
+	const unsigned char* GetLevelData(int level) const;
+	// get the bytes from the start of level 0 to the end of the
+	// last level, which are contiguous
+	size_t GetDataBytes() const;
+
+private:
+	// start and size of the mapped file
+	const unsigned char* m_pMapping;
+	size_t m_mappingSize;
+	// operating system handles of the mapping
+	void* m_fileHandle;
+	void* m_mappingHandle;
+	// file contents built in memory by Build()
+	std::vector<unsigned char> m_buildData;
+	// header of the mapped or built file
+	const CACHE_HEADER* m_pHeader;
+
+	// check that the header describes a valid file of the
+	// expected format, size, mipmap option and length
+	bool ValidateHeader(size_t fileSize, int size, int channels, bool bKeepAlphaCoverage) const;
+	// check that the image is the one the file was built from
+	bool ValidateSource(const std::string& sourceFilename) const;
+};
@@ -0,0 +1,1201 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturemanager.cpp
+// ============
+// load the scene textures into layers of 2D texture arrays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureManager.h"
+#include "Profiler.h"
+
+#include "MipChain.h"
+
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// bytes of decoded images uploaded per frame - at least one
+	// image is always uploaded, however large it is
+	const size_t g_UploadBudgetBytes = 16 * 1024 * 1024;
+	// the scene blends its RGBA textures instead of testing
+	// their alpha against a cutoff, so their mipmaps keep the
+	// average alpha rather than the alpha coverage
+	const bool g_KeepAlphaCoverage = false;
+	// most anisotropic samples of a texture lookup
+	const float g_MaxAnisotropy = 8.0f;
+	// gray value of the placeholder layers
+	const unsigned char g_PlaceholderValue = 128;
+	// the same gray as a BC1 block, and as a BC3 block with
+	// an opaque alpha half - both 5:6:5 endpoints are the gray
+	// and every index selects the first one
+	const unsigned char g_PlaceholderBC1Block[8] = { 0x10, 0x84, 0x10, 0x84, 0, 0, 0, 0 };
+	const unsigned char g_PlaceholderBC3Block[16] = { 0xFF, 0xFF, 0, 0, 0, 0, 0, 0, 0x10, 0x84, 0x10, 0x84, 0, 0, 0, 0 };
+
+	/***********************************************************
+	 *  GetSeconds()
+	 *
+	 *  This function is used for getting a steady time stamp.
+	 ***********************************************************/
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  IsCompressedFormat()
+	 *
+	 *  This function is used for checking whether an array
+	 *  format is one of the block compressed cache formats.
+	 ***********************************************************/
+	bool IsCompressedFormat(GLenum internalFormat)
+	{
+		return((GL_COMPRESSED_RGB_S3TC_DXT1_EXT == internalFormat) ||
+			(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT == internalFormat));
+	}
+
+	/***********************************************************
+	 *  GetLevelForSize()
+	 *
+	 *  This function is used for getting the smallest mipmap
+	 *  level of a square layer that is still at least the
+	 *  passed in number of pixels across.
+	 ***********************************************************/
+	int GetLevelForSize(int size, float pixels)
+	{
+		int level = 0;
+		while ((size > 1) && ((float)(size / 2) >= pixels))
+		{
+			size /= 2;
+			level++;
+		}
+		return(level);
+	}
+
+	/***********************************************************
+	 *  GetLayerSize()
+	 *
+	 *  This function is used for getting the square layer size
+	 *  of an image - its larger side rounded up to a power of
+	 *  two, so that no detail is lost, and clamped to the
+	 *  largest size the layers may have.
+	 ***********************************************************/
+	int GetLayerSize(int width, int height, int maxSize)
+	{
+		const int largerSide = (width > height) ? width : height;
+
+		int size = 1;
+		while ((size < largerSide) && (size < maxSize))
+		{
+			size *= 2;
+		}
+
+		return(size);
+	}
+
+	/***********************************************************
+	 *  ResizeImage()
+	 *
+	 *  This function is used for resizing an image with
+	 *  bilinear filtering.  The texture coordinates of the
+	 *  layer map to the same place of the image as they did
+	 *  on the original, so the aspect ratio does not matter.
+	 ***********************************************************/
+	void ResizeImage(
+		const unsigned char* pSource,
+		int sourceWidth,
+		int sourceHeight,
+		int channels,
+		unsigned char* pDestination,
+		int destinationWidth,
+		int destinationHeight)
+	{
+		const float scaleX = (float)sourceWidth / (float)destinationWidth;
+		const float scaleY = (float)sourceHeight / (float)destinationHeight;
+
+		for (int y = 0; y < destinationHeight; y++)
+		{
+			// sample at the pixel centers
+			float sourceY = ((float)y + 0.5f) * scaleY - 0.5f;
+			sourceY = std::min(std::max(sourceY, 0.0f), (float)(sourceHeight - 1));
+			const int y0 = (int)sourceY;
+			const int y1 = std::min(y0 + 1, sourceHeight - 1);
+			const float fy = sourceY - (float)y0;
+
+			for (int x = 0; x < destinationWidth; x++)
+			{
+				float sourceX = ((float)x + 0.5f) * scaleX - 0.5f;
+				sourceX = std::min(std::max(sourceX, 0.0f), (float)(sourceWidth - 1));
+				const int x0 = (int)sourceX;
+				const int x1 = std::min(x0 + 1, sourceWidth - 1);
+				const float fx = sourceX - (float)x0;
+
+				const unsigned char* p00 = pSource + ((size_t)y0 * sourceWidth + x0) * channels;
+				const unsigned char* p10 = pSource + ((size_t)y0 * sourceWidth + x1) * channels;
+				const unsigned char* p01 = pSource + ((size_t)y1 * sourceWidth + x0) * channels;
+				const unsigned char* p11 = pSource + ((size_t)y1 * sourceWidth + x1) * channels;
+				unsigned char* pOut = pDestination + ((size_t)y * destinationWidth + x) * channels;
+
+				for (int c = 0; c < channels; c++)
+				{
+					const float top = p00[c] + (p10[c] - p00[c]) * fx;
+					const float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+					pOut[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  DecodeImage()
+	 *
+	 *  This function is used for decoding an image file and
+	 *  resizing it to its square layer.  The hash of the file
+	 *  bytes is passed back, as the key of a cache built from
+	 *  the image.
+	 ***********************************************************/
+	bool DecodeImage(
+		const std::string& filename,
+		int size,
+		int channels,
+		std::vector<unsigned char>& pixels,
+		int& width,
+		int& height,
+		uint64_t& fileHash)
+	{
+		std::vector<unsigned char> fileBytes;
+		if (!TextureCache::ReadFileBytes(filename, fileBytes))
+		{
+			return false;
+		}
+		fileHash = TextureCache::HashBytes(fileBytes.data(), fileBytes.size());
+
+		int colorChannels = 0;
+		unsigned char* image = stbi_load_from_memory(
+			fileBytes.data(),
+			(int)fileBytes.size(),
+			&width,
+			&height,
+			&colorChannels,
+			channels);
+		if (NULL == image)
+		{
+			return false;
+		}
+
+		pixels.resize((size_t)size * size * channels);
+		if ((width == size) && (height == size))
+		{
+			memcpy(pixels.data(), image, pixels.size());
+		}
+		else
+		{
+			ResizeImage(image, width, height, channels, pixels.data(), size, size);
+		}
+
+		// free the image data from local memory
+		stbi_image_free(image);
+
+		return true;
+	}
+}
+
+/***********************************************************
+ *  TextureManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureManager::TextureManager(GLStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_nextJob = 0;
+	m_pendingUploads = 0;
+	m_bCancel = false;
+	m_uploadBufferID = 0;
+	m_loadStartSeconds = 0.0;
+	m_loadMilliseconds = 0.0;
+	m_workerCount = 0;
+	m_cachedCount = 0;
+	m_builtCount = 0;
+	m_budgetBytes = (size_t)DEFAULT_BUDGET_MEGABYTES * 1024 * 1024;
+	m_residencyFrame = 0;
+	m_pageIns = 0;
+	m_evictions = 0;
+}
+
+/***********************************************************
+ *  ~TextureManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureManager::~TextureManager()
+{
+	DestroyTextures();
+}
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for queueing a texture image file.
+ *  Only the image header is read here, for the size of the
+ *  layer - the image is decoded on a worker thread once
+ *  CreateArrays() has created its layer.
+ ***********************************************************/
+bool TextureManager::LoadTexture(const char* filename, std::string tag)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	if (0 == stbi_info(filename, &width, &height, &colorChannels))
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return false;
+	}
+
+	// only RGB and RGBA images are supported - RGBA supports transparency
+	if ((colorChannels != 3) && (colorChannels != 4))
+	{
+		std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+		return false;
+	}
+
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	const int maxSize = std::min((int)maxTextureSize, (int)MAX_LAYER_SIZE);
+
+	TEXTURE_ENTRY texture;
+	texture.tag = tag;
+	texture.filename = filename;
+	texture.size = GetLayerSize(width, height, maxSize);
+	texture.channels = colorChannels;
+	if (GLEW_EXT_texture_compression_s3tc)
+	{
+		texture.internalFormat = (colorChannels == 4) ?
+			GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+	else
+	{
+		texture.internalFormat = (colorChannels == 4) ? GL_RGBA8 : GL_RGB8;
+	}
+	texture.array = -1;
+	texture.layer = -1;
+	texture.bUploaded = false;
+	texture.pCache = NULL;
+
+	m_textures.push_back(texture);
+
+	return true;
+}
+
+/***********************************************************
+ *  CreateArrays()
+ *
+ *  This method is used for creating the texture arrays for
+ *  all the queued textures that are not in an array yet.
+ *  Those textures are ordered by layer size and format, and
+ *  every run with the same size and format becomes one
+ *  array - or several, when the run has more textures than
+ *  an array can have layers.  Textures that were already in
+ *  an array keep their index.
+ *
+ *  The arrays start out with placeholder layers, and the
+ *  images are decoded by one worker thread per core.
+ ***********************************************************/
+bool TextureManager::CreateArrays()
+{
+	// the job list is reused, so any earlier load must be done
+	FinishUploads();
+
+	m_loadStartSeconds = GetSeconds();
+	m_loadMilliseconds = 0.0;
+
+	// new textures are always appended, so they are at the end
+	int firstNew = 0;
+	while ((firstNew < (int)m_textures.size()) && (m_textures[firstNew].array >= 0))
+	{
+		firstNew++;
+	}
+	if (firstNew == (int)m_textures.size())
+	{
+		return true;
+	}
+
+	std::stable_sort(
+		m_textures.begin() + firstNew,
+		m_textures.end(),
+		CompareLayerFormat);
+
+	// the placeholders are uploaded from the upload buffer
+	if (0 == m_uploadBufferID)
+	{
+		glGenBuffers(1, &m_uploadBufferID);
+	}
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	bool bReturn = true;
+	int runStart = firstNew;
+	while (runStart < (int)m_textures.size())
+	{
+		int runEnd = runStart + 1;
+		while ((runEnd < (int)m_textures.size()) &&
+			((runEnd - runStart) < maxLayers) &&
+			(m_textures[runEnd].size == m_textures[runStart].size) &&
+			(m_textures[runEnd].internalFormat == m_textures[runStart].internalFormat))
+		{
+			runEnd++;
+		}
+
+		if (false == CreateArray(runStart, runEnd - runStart))
+		{
+			bReturn = false;
+		}
+		runStart = runEnd;
+	}
+
+	// queue the images of the new textures and start the workers
+	m_jobs.clear();
+	for (int texture = firstNew; texture < (int)m_textures.size(); texture++)
+	{
+		DECODE_JOB job;
+		job.texture = texture;
+		job.filename = m_textures[texture].filename;
+		job.size = m_textures[texture].size;
+		job.channels = m_textures[texture].channels;
+		job.bCompressed = IsCompressedFormat(m_textures[texture].internalFormat);
+		job.width = 0;
+		job.height = 0;
+		job.pCache = NULL;
+		job.bFromCache = false;
+		job.uploadBytes = 0;
+		m_jobs.push_back(job);
+	}
+	m_pendingUploads = (int)m_jobs.size();
+	m_nextJob = 0;
+	m_bCancel = false;
+
+	// indicate to always flip images vertically when loaded -
+	// set before the workers start, since it is shared by them
+	stbi_set_flip_vertically_on_load(true);
+
+	int workerCount = (int)std::thread::hardware_concurrency();
+	workerCount = std::max(1, std::min(workerCount, (int)m_jobs.size()));
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureManager::DecodeJobs, this));
+	}
+	m_workerCount = workerCount;
+
+	return(bReturn);
+}
+
+/***********************************************************
+ *  CompareLayerFormat()
+ *
+ *  This method is used for ordering textures by layer size,
+ *  largest first, and then by format.
+ ***********************************************************/
+bool TextureManager::CompareLayerFormat(const TEXTURE_ENTRY& a, const TEXTURE_ENTRY& b)
+{
+	if (a.size != b.size)
+	{
+		return(a.size > b.size);
+	}
+	return(a.internalFormat < b.internalFormat);
+}
+
+/***********************************************************
+ *  CreateArray()
+ *
+ *  This method is used for creating one texture array for
+ *  the passed in textures.  It starts out with only the
+ *  levels from MIN_RESIDENT_SIZE down, and every layer shows
+ *  the placeholder until its image is uploaded.
+ ***********************************************************/
+bool TextureManager::CreateArray(int firstTexture, int layerCount)
+{
+	TEXTURE_ARRAY textureArray;
+	textureArray.ID = 0;
+	textureArray.size = m_textures[firstTexture].size;
+	textureArray.channels = m_textures[firstTexture].channels;
+	textureArray.internalFormat = m_textures[firstTexture].internalFormat;
+	textureArray.firstTexture = firstTexture;
+	textureArray.layerCount = layerCount;
+	textureArray.residentLevel = GetLevelForSize(textureArray.size, (float)MIN_RESIDENT_SIZE);
+	textureArray.requestedLevel = -1;
+	textureArray.lastUsedFrame = m_residencyFrame;
+
+	AllocateArray(textureArray);
+
+	const int array = (int)m_arrays.size();
+	for (int layer = 0; layer < layerCount; layer++)
+	{
+		m_textures[firstTexture + layer].array = array;
+		m_textures[firstTexture + layer].layer = layer;
+	}
+	m_arrays.push_back(textureArray);
+
+	return(GL_NO_ERROR == glGetError());
+}
+
+/***********************************************************
+ *  AllocateArray()
+ *
+ *  This method is used for creating the OpenGL texture of an
+ *  array with the levels from its resident level down, with
+ *  immutable storage where the driver has it, and filling
+ *  every level of every layer with a gray placeholder
+ *  through the upload buffer.
+ ***********************************************************/
+void TextureManager::AllocateArray(TEXTURE_ARRAY& textureArray)
+{
+	const int size = std::max(1, textureArray.size >> textureArray.residentLevel);
+	const int channels = textureArray.channels;
+	const int layerCount = textureArray.layerCount;
+	const GLenum internalFormat = textureArray.internalFormat;
+	const bool bCompressed = IsCompressedFormat(internalFormat);
+	const TextureCache::CACHE_FORMAT cacheFormat = TextureCache::GetFormat(channels);
+	const GLenum format = (channels == 4) ? GL_RGBA : GL_RGB;
+	const GLsizei levels = TextureCache::GetLevelCount(size);
+
+	// one placeholder level 0 in the format of the array - the
+	// smaller levels read the start of it
+	std::vector<unsigned char> placeholder;
+	if (bCompressed)
+	{
+		const bool bBC3 = (TextureCache::FORMAT_BC3 == cacheFormat);
+		const unsigned char* pBlock = bBC3 ? g_PlaceholderBC3Block : g_PlaceholderBC1Block;
+		const size_t blockBytes = bBC3 ? sizeof(g_PlaceholderBC3Block) : sizeof(g_PlaceholderBC1Block);
+		placeholder.resize(TextureCache::GetLevelBytes(cacheFormat, size));
+		for (size_t offset = 0; offset < placeholder.size(); offset += blockBytes)
+		{
+			memcpy(placeholder.data() + offset, pBlock, blockBytes);
+		}
+	}
+	else
+	{
+		placeholder.assign((size_t)size * size * channels, g_PlaceholderValue);
+	}
+	m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBufferID);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, placeholder.size(), placeholder.data(), GL_STREAM_DRAW);
+	std::vector<unsigned char>().swap(placeholder);
+
+	glGenTextures(1, &textureArray.ID);
+	m_pStateCache->BindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters - trilinear, so that
+	// minified surfaces read the mipmaps instead of aliasing
+	// across the full size level, and anisotropic where the
+	// driver has it, for the surfaces seen at a grazing angle
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (GLEW_ARB_texture_filter_anisotropic || GLEW_EXT_texture_filter_anisotropic)
+	{
+		GLfloat maxAnisotropy = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+		glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(maxAnisotropy, g_MaxAnisotropy));
+	}
+
+	if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, size, size, layerCount);
+	}
+	else
+	{
+		// allocate every level without reading the upload buffer,
+		// which only holds a single layer
+		m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		int levelSize = size;
+		for (GLint level = 0; level < levels; level++)
+		{
+			if (bCompressed)
+			{
+				const GLsizei levelBytes = (GLsizei)(TextureCache::GetLevelBytes(cacheFormat, levelSize) * layerCount);
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelSize, levelSize, layerCount, 0, levelBytes, NULL);
+			}
+			else
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelSize, levelSize, layerCount, 0, format, GL_UNSIGNED_BYTE, NULL);
+			}
+			levelSize = std::max(1, levelSize / 2);
+		}
+		m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBufferID);
+	}
+
+	// RGB rows of small levels are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	int levelSize = size;
+	for (GLint level = 0; level < levels; level++)
+	{
+		for (int layer = 0; layer < layerCount; layer++)
+		{
+			if (bCompressed)
+			{
+				const GLsizei levelBytes = (GLsizei)TextureCache::GetLevelBytes(cacheFormat, levelSize);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize, levelSize, 1, internalFormat, levelBytes, NULL);
+			}
+			else
+			{
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize, levelSize, 1, format, GL_UNSIGNED_BYTE, NULL);
+			}
+		}
+		levelSize = std::max(1, levelSize / 2);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	// the array is left bound, but the upload buffer must not
+	// be read by uploads from client memory
+	m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/***********************************************************
+ *  ResizeArray()
+ *
+ *  This method is used for recreating an array with another
+ *  finest level - larger to page levels in, or smaller to
+ *  free GPU memory.  Every layer that has its image gets its
+ *  levels again from the kept copy, the others keep the
+ *  placeholder until their image arrives.
+ ***********************************************************/
+void TextureManager::ResizeArray(int array, int residentLevel)
+{
+	TEXTURE_ARRAY& textureArray = m_arrays[array];
+	if (residentLevel < textureArray.residentLevel)
+	{
+		m_pageIns++;
+	}
+	else
+	{
+		m_evictions++;
+	}
+
+	const GLuint oldID = textureArray.ID;
+	textureArray.residentLevel = residentLevel;
+	AllocateArray(textureArray);
+
+	for (int layer = 0; layer < textureArray.layerCount; layer++)
+	{
+		const TEXTURE_ENTRY& texture = m_textures[textureArray.firstTexture + layer];
+		if (texture.bUploaded)
+		{
+			UploadLayer(texture, textureArray);
+		}
+	}
+
+	m_pStateCache->DeleteTextures(1, &oldID);
+}
+
+/***********************************************************
+ *  GetArrayBytes()
+ *
+ *  This method is used for getting the GPU memory an array
+ *  takes with the passed in finest level.  Uncompressed RGB
+ *  is counted at four bytes a texel, as drivers store it.
+ ***********************************************************/
+size_t TextureManager::GetArrayBytes(const TEXTURE_ARRAY& textureArray, int residentLevel) const
+{
+	const bool bCompressed = IsCompressedFormat(textureArray.internalFormat);
+	const TextureCache::CACHE_FORMAT cacheFormat = TextureCache::GetFormat(textureArray.channels);
+
+	size_t layerBytes = 0;
+	for (int levelSize = std::max(1, textureArray.size >> residentLevel); ; levelSize /= 2)
+	{
+		layerBytes += bCompressed ?
+			TextureCache::GetLevelBytes(cacheFormat, levelSize) :
+			(size_t)levelSize * levelSize * 4;
+		if (1 == levelSize)
+		{
+			break;
+		}
+	}
+
+	return(layerBytes * textureArray.layerCount);
+}
+
+/***********************************************************
+ *  DecodeJobs()
+ *
+ *  This method is used by each worker thread for decoding
+ *  and resizing the queued images and building their
+ *  mipmaps, or loading their compressed caches, one claimed
+ *  job at a time, until no jobs are left.  It makes no
+ *  OpenGL calls.
+ ***********************************************************/
+void TextureManager::DecodeJobs()
+{
+	Profiler::SetThreadName("Texture decoder");
+
+	while (false == m_bCancel)
+	{
+		const int jobIndex = m_nextJob++;
+		if (jobIndex >= (int)m_jobs.size())
+		{
+			break;
+		}
+
+		PROFILE_ZONE("TextureManager::DecodeJob");
+
+		DECODE_JOB& job = m_jobs[jobIndex];
+		if (job.bCompressed)
+		{
+			LoadCompressedJob(job);
+		}
+		else
+		{
+			uint64_t fileHash = 0;
+			job.uploadBytes = 0;
+			if (DecodeImage(job.filename, job.size, job.channels, job.pixels, job.width, job.height, fileHash))
+			{
+				MipChain::BuildLevels(job.pixels.data(), job.size, job.channels, g_KeepAlphaCoverage, job.mipLevels);
+				job.uploadBytes = job.pixels.size();
+				for (size_t level = 0; level < job.mipLevels.size(); level++)
+				{
+					job.uploadBytes += job.mipLevels[level].pixels.size();
+				}
+			}
+			else
+			{
+				job.pixels.clear();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_finishedMutex);
+		m_finishedJobs.push_back(jobIndex);
+	}
+}
+
+/***********************************************************
+ *  LoadCompressedJob()
+ *
+ *  This method is used for getting the compressed levels of
+ *  a job.  A valid cache file is only mapped - otherwise the
+ *  image is decoded and compressed into a new cache file.
+ ***********************************************************/
+void TextureManager::LoadCompressedJob(DECODE_JOB& job)
+{
+	job.pCache = new TextureCache();
+
+	if (job.pCache->Open(job.filename, job.size, job.channels, g_KeepAlphaCoverage))
+	{
+		job.bFromCache = true;
+		job.width = (int)job.pCache->GetHeader()->sourceWidth;
+		job.height = (int)job.pCache->GetHeader()->sourceHeight;
+	}
+	else
+	{
+		std::vector<unsigned char> pixels;
+		uint64_t fileHash = 0;
+		if (!DecodeImage(job.filename, job.size, job.channels, pixels, job.width, job.height, fileHash) ||
+			!job.pCache->Build(job.filename, fileHash, pixels.data(), job.size, job.channels, job.width, job.height, g_KeepAlphaCoverage))
+		{
+			delete job.pCache;
+			job.pCache = NULL;
+		}
+	}
+
+	job.uploadBytes = (NULL != job.pCache) ? job.pCache->GetDataBytes() : 0;
+}
+
+/***********************************************************
+ *  JoinWorkers()
+ *
+ *  This method is used for waiting for all the worker
+ *  threads to end.
+ ***********************************************************/
+void TextureManager::JoinWorkers()
+{
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+}
+
+/***********************************************************
+ *  UpdateUploads()
+ *
+ *  This method is used for uploading the images the workers
+ *  decoded since the last frame.  The uploads of one frame
+ *  stop after the upload budget, so a frame never waits for
+ *  more than a few layers.
+ ***********************************************************/
+void TextureManager::UpdateUploads()
+{
+	PROFILE_ZONE("TextureManager::UpdateUploads");
+
+	if (0 == m_pendingUploads)
+	{
+		return;
+	}
+
+	std::vector<int> readyJobs;
+	{
+		std::lock_guard<std::mutex> lock(m_finishedMutex);
+		size_t budget = 0;
+		size_t count = 0;
+		while ((count < m_finishedJobs.size()) && (budget < g_UploadBudgetBytes))
+		{
+			budget += m_jobs[m_finishedJobs[count]].uploadBytes;
+			count++;
+		}
+		readyJobs.assign(m_finishedJobs.begin(), m_finishedJobs.begin() + count);
+		m_finishedJobs.erase(m_finishedJobs.begin(), m_finishedJobs.begin() + count);
+	}
+
+	for (size_t i = 0; i < readyJobs.size(); i++)
+	{
+		UploadJob(m_jobs[readyJobs[i]]);
+	}
+
+	if (0 == m_pendingUploads)
+	{
+		// every job is claimed, so the workers are ending
+		JoinWorkers();
+		m_loadMilliseconds = (GetSeconds() - m_loadStartSeconds) * 1000.0;
+	}
+}
+
+/***********************************************************
+ *  FinishUploads()
+ *
+ *  This method is used for waiting until every queued image
+ *  is decoded and uploaded, for callers that need the final
+ *  textures before drawing.
+ ***********************************************************/
+void TextureManager::FinishUploads()
+{
+	JoinWorkers();
+
+	while (m_pendingUploads > 0)
+	{
+		UpdateUploads();
+	}
+}
+
+/***********************************************************
+ *  UploadJob()
+ *
+ *  This method is used for keeping the levels of a finished
+ *  job with its texture, for paging them in again later, and
+ *  uploading the resident ones into its layer.
+ ***********************************************************/
+void TextureManager::UploadJob(DECODE_JOB& job)
+{
+	TEXTURE_ENTRY& texture = m_textures[job.texture];
+	const TEXTURE_ARRAY& textureArray = m_arrays[texture.array];
+
+	if (job.bCompressed ? (NULL == job.pCache) : job.pixels.empty())
+	{
+		// the layer keeps showing the placeholder
+		std::cout << "Could not load image:" << job.filename << std::endl;
+	}
+	else
+	{
+		if (job.bFromCache)
+		{
+			std::cout << "Successfully loaded cached image:" << TextureCache::GetCachePath(job.filename) << ", width:" << job.width << ", height:" << job.height << ", channels:" << job.channels << std::endl;
+			m_cachedCount++;
+		}
+		else if (job.bCompressed)
+		{
+			std::cout << "Successfully loaded image:" << job.filename << ", width:" << job.width << ", height:" << job.height << ", channels:" << job.channels << ", cached as:" << TextureCache::GetCachePath(job.filename) << std::endl;
+			m_builtCount++;
+		}
+		else
+		{
+			std::cout << "Successfully loaded image:" << job.filename << ", width:" << job.width << ", height:" << job.height << ", channels:" << job.channels << std::endl;
+		}
+
+		if (job.bCompressed)
+		{
+			texture.pCache = job.pCache;
+			job.pCache = NULL;
+		}
+		else
+		{
+			// level 0 goes in front of the mipmaps
+			texture.levels.resize(1 + job.mipLevels.size());
+			texture.levels[0].size = job.size;
+			texture.levels[0].pixels.swap(job.pixels);
+			for (size_t level = 0; level < job.mipLevels.size(); level++)
+			{
+				texture.levels[level + 1].size = job.mipLevels[level].size;
+				texture.levels[level + 1].pixels.swap(job.mipLevels[level].pixels);
+			}
+		}
+
+		UploadLayer(texture, textureArray);
+	}
+
+	std::vector<unsigned char>().swap(job.pixels);
+	std::vector<MipChain::MIP_LEVEL>().swap(job.mipLevels);
+	texture.bUploaded = true;
+	m_pendingUploads--;
+}
+
+/***********************************************************
+ *  UploadLayer()
+ *
+ *  This method is used for copying the levels of a texture
+ *  from the resident level of its array down into its layer.
+ *  All of them go into the upload buffer with one mapping -
+ *  a mapped cache file is read straight from the mapping, so
+ *  only the levels that are uploaded get paged in.  The
+ *  buffer is orphaned first, so the copy never waits for an
+ *  upload the driver has not finished yet.  The array is
+ *  left bound.
+ ***********************************************************/
+void TextureManager::UploadLayer(const TEXTURE_ENTRY& texture, const TEXTURE_ARRAY& textureArray)
+{
+	const bool bCompressed = IsCompressedFormat(textureArray.internalFormat);
+	const GLenum format = (texture.channels == 4) ? GL_RGBA : GL_RGB;
+	const int levelCount = TextureCache::GetLevelCount(texture.size);
+
+	// the source of each uploaded level
+	std::vector<const unsigned char*> levelData;
+	std::vector<size_t> levelBytes;
+	size_t byteCount = 0;
+	for (int level = textureArray.residentLevel; level < levelCount; level++)
+	{
+		if (NULL != texture.pCache)
+		{
+			levelData.push_back(texture.pCache->GetLevelData(level));
+			levelBytes.push_back((size_t)texture.pCache->GetHeader()->levelBytes[level]);
+		}
+		else if (level < (int)texture.levels.size())
+		{
+			levelData.push_back(texture.levels[level].pixels.data());
+			levelBytes.push_back(texture.levels[level].pixels.size());
+		}
+		else
+		{
+			break;
+		}
+		byteCount += levelBytes.back();
+	}
+	if (levelData.empty())
+	{
+		return;
+	}
+
+	m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBufferID);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, byteCount, NULL, GL_STREAM_DRAW);
+	unsigned char* pMapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, byteCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (NULL != pMapped)
+	{
+		// every level follows the one above it in the buffer
+		size_t offset = 0;
+		for (size_t i = 0; i < levelData.size(); i++)
+		{
+			memcpy(pMapped + offset, levelData[i], levelBytes[i]);
+			offset += levelBytes[i];
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		// upload straight from the kept levels instead
+		m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	m_pStateCache->BindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	int levelSize = std::max(1, texture.size >> textureArray.residentLevel);
+	size_t offset = 0;
+	for (size_t i = 0; i < levelData.size(); i++)
+	{
+		const unsigned char* pSource = (NULL != pMapped) ? ((const unsigned char*)NULL + offset) : levelData[i];
+		if (bCompressed)
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, texture.layer, levelSize, levelSize, 1, textureArray.internalFormat, (GLsizei)levelBytes[i], pSource);
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, texture.layer, levelSize, levelSize, 1, format, GL_UNSIGNED_BYTE, pSource);
+		}
+		offset += levelBytes[i];
+		levelSize = std::max(1, levelSize / 2);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	m_pStateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DestroyTextures()
+ *
+ *  This method is used for stopping any running decode and
+ *  freeing all the texture arrays and decoded images.
+ ***********************************************************/
+void TextureManager::DestroyTextures()
+{
+	m_bCancel = true;
+	JoinWorkers();
+	for (size_t i = 0; i < m_jobs.size(); i++)
+	{
+		delete m_jobs[i].pCache;
+	}
+	m_jobs.clear();
+	m_finishedJobs.clear();
+	m_pendingUploads = 0;
+	m_cachedCount = 0;
+	m_builtCount = 0;
+	m_pageIns = 0;
+	m_evictions = 0;
+
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		m_pStateCache->DeleteTextures(1, &m_arrays[i].ID);
+	}
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		delete m_textures[i].pCache;
+	}
+	m_arrays.clear();
+	m_textures.clear();
+
+	if (0 != m_uploadBufferID)
+	{
+		m_pStateCache->DeleteBuffers(1, &m_uploadBufferID);
+		m_uploadBufferID = 0;
+	}
+}
+
+/***********************************************************
+ *  RequestTextureSize()
+ *
+ *  This method is used for noting the screen size a draw of
+ *  this frame shows a texture at, so that the next residency
+ *  update gives its array the level with at least that many
+ *  texels across.
+ ***********************************************************/
+void TextureManager::RequestTextureSize(int texture, float pixels)
+{
+	if ((texture < 0) || (texture >= (int)m_textures.size()) || (m_textures[texture].array < 0))
+	{
+		return;
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[m_textures[texture].array];
+	const int level = GetLevelForSize(textureArray.size, pixels);
+	if ((textureArray.requestedLevel < 0) || (level < textureArray.requestedLevel))
+	{
+		textureArray.requestedLevel = level;
+	}
+	textureArray.lastUsedFrame = m_residencyFrame;
+}
+
+/***********************************************************
+ *  UpdateResidency()
+ *
+ *  This method is used for changing the resident levels of
+ *  the arrays to the sizes the draws asked for since the last
+ *  update.  Arrays only grow on request - an array that was
+ *  not drawn, or was drawn smaller, keeps its levels while
+ *  they fit in the budget.  When the arrays need more than
+ *  the budget, levels are dropped from the least recently
+ *  drawn arrays first, at first only the levels above what
+ *  the draws asked for and then, if that is not enough, the
+ *  requested ones too, down to MIN_RESIDENT_SIZE.
+ *
+ *  Shrinking arrays are recreated right away, since that
+ *  frees memory, but only one array grows per frame, so the
+ *  uploads of paging levels in are spread over frames.
+ ***********************************************************/
+void TextureManager::UpdateResidency()
+{
+	PROFILE_ZONE("TextureManager::UpdateResidency");
+
+	const int arrayCount = (int)m_arrays.size();
+	if (0 == arrayCount)
+	{
+		return;
+	}
+
+	// the wanted and the new finest level of each array
+	std::vector<int> wantedLevels(arrayCount);
+	std::vector<int> targetLevels(arrayCount);
+	std::vector<int> arrayOrder(arrayCount);
+	size_t totalBytes = 0;
+	for (int array = 0; array < arrayCount; array++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[array];
+		const int coarsestLevel = GetLevelForSize(textureArray.size, (float)MIN_RESIDENT_SIZE);
+
+		if (textureArray.requestedLevel >= 0)
+		{
+			wantedLevels[array] = std::min(textureArray.requestedLevel, coarsestLevel);
+			targetLevels[array] = std::min(textureArray.residentLevel, wantedLevels[array]);
+		}
+		else
+		{
+			wantedLevels[array] = coarsestLevel;
+			targetLevels[array] = textureArray.residentLevel;
+		}
+		totalBytes += GetArrayBytes(textureArray, targetLevels[array]);
+		arrayOrder[array] = array;
+	}
+
+	// least recently drawn first
+	for (int i = 1; i < arrayCount; i++)
+	{
+		const int array = arrayOrder[i];
+		int j = i;
+		while ((j > 0) && (m_arrays[arrayOrder[j - 1]].lastUsedFrame > m_arrays[array].lastUsedFrame))
+		{
+			arrayOrder[j] = arrayOrder[j - 1];
+			j--;
+		}
+		arrayOrder[j] = array;
+	}
+
+	for (int pass = 0; (pass < 2) && (totalBytes > m_budgetBytes); pass++)
+	{
+		for (int i = 0; (i < arrayCount) && (totalBytes > m_budgetBytes); i++)
+		{
+			const int array = arrayOrder[i];
+			const TEXTURE_ARRAY& textureArray = m_arrays[array];
+			const int limitLevel = (0 == pass) ?
+				wantedLevels[array] :
+				GetLevelForSize(textureArray.size, (float)MIN_RESIDENT_SIZE);
+
+			while ((targetLevels[array] < limitLevel) && (totalBytes > m_budgetBytes))
+			{
+				totalBytes -= GetArrayBytes(textureArray, targetLevels[array]);
+				targetLevels[array]++;
+				totalBytes += GetArrayBytes(textureArray, targetLevels[array]);
+			}
+		}
+	}
+
+	// shrink right away, and grow the most recently drawn array
+	int growArray = -1;
+	for (int i = 0; i < arrayCount; i++)
+	{
+		const int array = arrayOrder[i];
+		if (targetLevels[array] > m_arrays[array].residentLevel)
+		{
+			ResizeArray(array, targetLevels[array]);
+		}
+		else if (targetLevels[array] < m_arrays[array].residentLevel)
+		{
+			growArray = array;
+		}
+	}
+	if (growArray >= 0)
+	{
+		ResizeArray(growArray, targetLevels[growArray]);
+	}
+
+	for (int array = 0; array < arrayCount; array++)
+	{
+		m_arrays[array].requestedLevel = -1;
+	}
+	m_residencyFrame++;
+}
+
+/***********************************************************
+ *  SetBudgetMegabytes()
+ *
+ *  This method is used for setting the GPU memory budget of
+ *  the arrays, which the next residency update keeps to.
+ ***********************************************************/
+void TextureManager::SetBudgetMegabytes(int megabytes)
+{
+	m_budgetBytes = (size_t)std::max(0, megabytes) * 1024 * 1024;
+}
+
+/***********************************************************
+ *  BindArray()
+ *
+ *  This method is used for binding a texture array to the
+ *  passed in texture unit.  The state cache skips the unit
+ *  selection and the bind when the array is already bound.
+ ***********************************************************/
+void TextureManager::BindArray(int array, int textureUnit)
+{
+	if ((array < 0) || (array >= (int)m_arrays.size()) || (textureUnit < 0))
+	{
+		return;
+	}
+
+	m_pStateCache->BindTextureUnit((GLuint)textureUnit, GL_TEXTURE_2D_ARRAY, m_arrays[array].ID);
+}
+
+/***********************************************************
+ *  FindTexture()
+ *
+ *  This method is used for getting the index of the loaded
+ *  texture associated with the passed in tag.
+ ***********************************************************/
+int TextureManager::FindTexture(std::string tag) const
+{
+	for (int index = 0; index < (int)m_textures.size(); index++)
+	{
+		if (m_textures[index].tag.compare(tag) == 0)
+		{
+			return(index);
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  GetLoadStats()
+ *
+ *  This method is used for getting the progress of the
+ *  texture loading.
+ ***********************************************************/
+TextureManager::LOAD_STATS TextureManager::GetLoadStats() const
+{
+	LOAD_STATS stats;
+	stats.textureCount = (int)m_textures.size();
+	stats.uploadedCount = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		stats.uploadedCount += m_textures[i].bUploaded ? 1 : 0;
+	}
+	stats.cachedCount = m_cachedCount;
+	stats.builtCount = m_builtCount;
+	stats.workerCount = m_workerCount;
+	stats.loadMilliseconds = m_loadMilliseconds;
+
+	return(stats);
+}
+
+/***********************************************************
+ *  GetResidencyStats()
+ *
+ *  This method is used for getting the GPU memory the arrays
+ *  take at their resident and at their full size.
+ ***********************************************************/
+TextureManager::RESIDENCY_STATS TextureManager::GetResidencyStats() const
+{
+	RESIDENCY_STATS stats;
+	stats.residentBytes = 0;
+	stats.fullBytes = 0;
+	stats.budgetBytes = m_budgetBytes;
+	stats.reducedArrays = 0;
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		stats.residentBytes += GetArrayBytes(m_arrays[i], m_arrays[i].residentLevel);
+		stats.fullBytes += GetArrayBytes(m_arrays[i], 0);
+		stats.reducedArrays += (m_arrays[i].residentLevel > 0) ? 1 : 0;
+	}
+	stats.pageIns = m_pageIns;
+	stats.evictions = m_evictions;
+
+	return(stats);
+}
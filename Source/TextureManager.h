@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturemanager.h
+// ============
+// load the scene textures into layers of 2D texture arrays
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "MipChain.h"
+#include "TextureCache.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureManager
+ *
+ *  This class loads any number of texture images and packs
+ *  them into GL_TEXTURE_2D_ARRAY layers.  Every image is
+ *  resized to a square power of two layer, from its larger
+ *  side rounded up and at most MAX_LAYER_SIZE, and all the
+ *  images with the same layer size and format share one
+ *  array.  A draw then selects its texture with a layer
+ *  index instead of a texture unit, so draws whose textures
+ *  share an array need no texture change between them, and
+ *  there is no fixed limit on the number of textures.
+ *
+ *  Loading is asynchronous.  LoadTexture() only reads the
+ *  image size, which is enough for CreateArrays() to create
+ *  the arrays with a gray placeholder in every layer and to
+ *  start decoding all the images on a pool of worker threads.
+ *  The render thread then calls UpdateUploads() once per
+ *  frame, which streams the decoded images through a pixel
+ *  buffer object into their layers, so frames are drawn with
+ *  the placeholders until the real images arrive.  The
+ *  workers also build the mipmaps of each image with
+ *  MipChain, which filters in linear color space, and the
+ *  arrays are sampled trilinearly from them.
+ *
+ *  Where the driver samples S3TC formats, the layers are
+ *  block compressed - BC1 for RGB images and BC3 for RGBA
+ *  images - from a TextureCache built next to each image the
+ *  first time it is loaded.  Later launches map the cache
+ *  files instead of decoding the images, and upload all the
+ *  mipmap levels from them as they are.  A missing or stale
+ *  cache file falls back to decoding the image, and rebuilds
+ *  the file.
+ *
+ *  Residency is streamed per array.  An array starts out
+ *  with only its small mipmap levels on the GPU, and the
+ *  renderer reports the screen size every draw needs its
+ *  texture at with RequestTextureSize().  UpdateResidency()
+ *  then pages the larger levels in, and keeps the GPU memory
+ *  of all the arrays under a budget by dropping the larger
+ *  levels of the least recently used arrays first.  The
+ *  levels come back from the mapped cache file, or from the
+ *  decoded levels kept in memory, and an array is recreated
+ *  at its new size, so only its OpenGL ID changes - texture
+ *  indices, arrays and layers stay the same.
+ *
+ *  Texture indices are final once CreateArrays() has run -
+ *  it orders the textures by array and layer, so that
+ *  sorting draws by texture index also groups them by array.
+ ***********************************************************/
+class TextureManager
+{
+public:
+	// constructor
+	TextureManager(GLStateCache* pStateCache);
+	// destructor
+	~TextureManager();
+
+	// largest width and height of a texture layer
+	static const int MAX_LAYER_SIZE = 2048;
+
+	struct LOAD_STATS
+	{
+		int textureCount;
+		// textures whose images are in their layers
+		int uploadedCount;
+		// textures loaded from their compressed cache files, and
+		// textures whose cache files had to be built
+		int cachedCount;
+		int builtCount;
+		// worker threads used by the last CreateArrays()
+		int workerCount;
+		// time from CreateArrays() until the last upload
+		double loadMilliseconds;
+	};
+
+	struct RESIDENCY_STATS
+	{
+		// GPU memory of the arrays at their resident size, at
+		// their full size, and the budget
+		size_t residentBytes;
+		size_t fullBytes;
+		size_t budgetBytes;
+		// arrays below their full size
+		int reducedArrays;
+		// array growths and shrinks since the arrays were created
+		int pageIns;
+		int evictions;
+	};
+
+	// GPU memory the arrays may use unless set otherwise
+	static const int DEFAULT_BUDGET_MEGABYTES = 64;
+	// smallest size an array is ever reduced to
+	static const int MIN_RESIDENT_SIZE = 64;
+
+	// read the size of an image file and queue it for loading
+	bool LoadTexture(const char* filename, std::string tag);
+	// create the texture arrays for all the queued images that
+	// are not in an array yet, and start decoding them
+	bool CreateArrays();
+	// upload the images decoded since the last call, up to a
+	// per-frame budget - called by the render thread
+	void UpdateUploads();
+	// wait for the workers and upload all remaining images
+	void FinishUploads();
+	// free all the texture arrays and decoded images
+	void DestroyTextures();
+
+	// note that a draw this frame needs a texture shown at the
+	// passed in number of pixels across
+	void RequestTextureSize(int texture, float pixels);
+	// page array levels in and out for the sizes requested
+	// since the last call - called once per frame
+	void UpdateResidency();
+	// set the GPU memory budget of the arrays
+	void SetBudgetMegabytes(int megabytes);
+
+	// bind a texture array to a texture unit, skipping the bind
+	// when it is already bound there
+	void BindArray(int array, int textureUnit);
+
+	// get the index of the texture with the passed in tag, or
+	// -1 when no texture has that tag
+	int FindTexture(std::string tag) const;
+	// get the array and layer that hold a texture
+	int GetTextureArray(int texture) const { return(m_textures[texture].array); }
+	int GetTextureLayer(int texture) const { return(m_textures[texture].layer); }
+
+	// get the OpenGL ID of a texture array - it changes when
+	// the residency of the array changes
+	GLuint GetArrayID(int array) const { return(m_arrays[array].ID); }
+
+	// get the number of loaded textures and created arrays
+	int GetTextureCount() const { return((int)m_textures.size()); }
+	int GetArrayCount() const { return((int)m_arrays.size()); }
+
+	// get the progress of the texture loading
+	LOAD_STATS GetLoadStats() const;
+	// get whether images are still being decoded or uploaded
+	bool HasPendingUploads() const { return(m_pendingUploads > 0); }
+	// get the GPU memory use of the arrays
+	RESIDENCY_STATS GetResidencyStats() const;
+
+private:
+	struct TEXTURE_ENTRY
+	{
+		std::string tag;
+		std::string filename;
+		// square size and channel count of the layer
+		int size;
+		int channels;
+		// format of the array the layer is in
+		GLenum internalFormat;
+		// array and layer, -1 until CreateArrays()
+		int array;
+		int layer;
+		// set once the image is in its layer
+		bool bUploaded;
+		// every level of the image, for paging them in again -
+		// the mapped cache, or the decoded levels
+		TextureCache* pCache;
+		std::vector<MipChain::MIP_LEVEL> levels;
+	};
+
+	struct TEXTURE_ARRAY
+	{
+		GLuint ID;
+		int size;
+		int channels;
+		GLenum internalFormat;
+		int firstTexture;
+		int layerCount;
+		// finest level on the GPU, which is level 0 of the
+		// OpenGL texture, and the finest level any draw asked
+		// for since the last residency update
+		int residentLevel;
+		int requestedLevel;
+		// last residency update the array was drawn before
+		int lastUsedFrame;
+	};
+
+	// one image to decode - only touched by the worker that
+	// claimed it until it is on the finished list
+	struct DECODE_JOB
+	{
+		int texture;
+		std::string filename;
+		int size;
+		int channels;
+		// load the compressed cache instead of the pixels
+		bool bCompressed;
+		// size of the image file
+		int width;
+		int height;
+		// resized image, empty when the decode failed
+		std::vector<unsigned char> pixels;
+		// mipmaps built from the resized image
+		std::vector<MipChain::MIP_LEVEL> mipLevels;
+		// opened or built cache, NULL when the load failed
+		TextureCache* pCache;
+		// set when the cache file was valid
+		bool bFromCache;
+		// bytes the upload will copy
+		size_t uploadBytes;
+	};
+
+	// loaded textures, ordered by array and layer
+	std::vector<TEXTURE_ENTRY> m_textures;
+	// created texture arrays
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// cache the texture and buffer binds go through
+	GLStateCache* m_pStateCache;
+
+	// jobs of the running decode, claimed by the workers in order
+	std::vector<DECODE_JOB> m_jobs;
+	std::atomic<int> m_nextJob;
+	// decoded jobs waiting for the render thread
+	std::vector<int> m_finishedJobs;
+	std::mutex m_finishedMutex;
+	// jobs not uploaded yet
+	int m_pendingUploads;
+	// worker threads of the running decode
+	std::vector<std::thread> m_workers;
+	// set to make the workers stop early
+	std::atomic<bool> m_bCancel;
+
+	// pixel buffer object the uploads are streamed through
+	GLuint m_uploadBufferID;
+	// start time of the last CreateArrays() and load duration
+	double m_loadStartSeconds;
+	double m_loadMilliseconds;
+	int m_workerCount;
+	int m_cachedCount;
+	int m_builtCount;
+
+	// GPU memory budget of the arrays
+	size_t m_budgetBytes;
+	// residency updates so far
+	int m_residencyFrame;
+	int m_pageIns;
+	int m_evictions;
+
+	// order textures by layer size and format
+	static bool CompareLayerFormat(const TEXTURE_ENTRY& a, const TEXTURE_ENTRY& b);
+	// create one array with placeholder layers for the passed in textures
+	bool CreateArray(int firstTexture, int layerCount);
+	// create the OpenGL texture of an array at its resident
+	// size, with a placeholder in every layer
+	void AllocateArray(TEXTURE_ARRAY& textureArray);
+	// recreate an array with another finest level
+	void ResizeArray(int array, int residentLevel);
+	// get the GPU memory of an array with a finest level
+	size_t GetArrayBytes(const TEXTURE_ARRAY& textureArray, int residentLevel) const;
+	// decode jobs until none are left - run by each worker
+	void DecodeJobs();
+	// load the compressed levels of a job from its cache
+	void LoadCompressedJob(DECODE_JOB& job);
+	// wait for the worker threads to end
+	void JoinWorkers();
+	// keep the levels of a finished job and upload them
+	void UploadJob(DECODE_JOB& job);
+	// copy the resident levels of a texture into its layer
+	// through the upload buffer
+	void UploadLayer(const TEXTURE_ENTRY& texture, const TEXTURE_ARRAY& textureArray);
+};
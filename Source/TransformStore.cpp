@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformstore.cpp
+// ============
+// cached world matrices for a hierarchy of scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformStore.h"
+#include "Profiler.h"
+
+#include <glm/gtx/transform.hpp>
+
+/***********************************************************
+ *  TransformStore()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformStore::TransformStore()
+{
+	m_bAnyDirty = false;
+	m_lastUpdateCount = 0;
+}
+
+/***********************************************************
+ *  ~TransformStore()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransformStore::~TransformStore()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all the nodes.
+ ***********************************************************/
+void TransformStore::Clear()
+{
+	m_nodes.clear();
+	m_worldMatrices.clear();
+	m_dirtyFlags.clear();
+	m_bAnyDirty = false;
+	m_lastUpdateCount = 0;
+	m_updatedNodes.clear();
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method is used for reserving the memory for the
+ *  passed in number of nodes.
+ ***********************************************************/
+void TransformStore::Reserve(int nodeCount)
+{
+	m_nodes.reserve(nodeCount);
+	m_worldMatrices.reserve(nodeCount);
+	m_dirtyFlags.reserve(nodeCount);
+	m_updatedNodes.reserve(nodeCount);
+}
+
+/***********************************************************
+ *  AddNode()
+ *
+ *  This method is used for adding a node to the store.  A
+ *  parent that does not exist yet turns the node into a
+ *  root node, which keeps the parents-first order intact.
+ ***********************************************************/
+int TransformStore::AddNode(
+	int parent,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	int node = (int)m_nodes.size();
+
+	TRANSFORM_NODE newNode;
+	newNode.scale = scaleXYZ;
+	newNode.rotationDegrees = rotationDegreesXYZ;
+	newNode.position = positionXYZ;
+	newNode.parent = ((parent >= 0) && (parent < node)) ? parent : -1;
+
+	m_nodes.push_back(newNode);
+	m_worldMatrices.push_back(glm::mat4(1.0f));
+	m_dirtyFlags.push_back(0);
+	MarkDirty(node);
+
+	return(node);
+}
+
+/***********************************************************
+ *  SetLocalTransform()
+ *
+ *  This method is used for changing the whole local
+ *  transform of an existing node.
+ ***********************************************************/
+void TransformStore::SetLocalTransform(
+	int node,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()))
+	{
+		return;
+	}
+
+	m_nodes[node].scale = scaleXYZ;
+	m_nodes[node].rotationDegrees = rotationDegreesXYZ;
+	m_nodes[node].position = positionXYZ;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  SetLocalPosition()
+ *
+ *  This method is used for moving an existing node.
+ ***********************************************************/
+void TransformStore::SetLocalPosition(int node, glm::vec3 positionXYZ)
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()))
+	{
+		return;
+	}
+
+	m_nodes[node].position = positionXYZ;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  SetLocalRotation()
+ *
+ *  This method is used for turning an existing node.
+ ***********************************************************/
+void TransformStore::SetLocalRotation(int node, glm::vec3 rotationDegreesXYZ)
+{
+	if ((node < 0) || (node >= (int)m_nodes.size()))
+	{
+		return;
+	}
+
+	m_nodes[node].rotationDegrees = rotationDegreesXYZ;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  UpdateWorldMatrices()
+ *
+ *  This method is used for rebuilding the world matrices of
+ *  the dirty nodes.  A node is rebuilt when it is dirty
+ *  itself or when its parent was rebuilt in this pass, and
+ *  the flag is left set on the rebuilt nodes until the end
+ *  of the pass so their children can see it.
+ ***********************************************************/
+void TransformStore::UpdateWorldMatrices()
+{
+	PROFILE_ZONE("TransformStore::UpdateWorldMatrices");
+
+	m_lastUpdateCount = 0;
+	m_updatedNodes.clear();
+
+	if (false == m_bAnyDirty)
+	{
+		return;
+	}
+
+	const int nodeCount = (int)m_nodes.size();
+	for (int i = 0; i < nodeCount; i++)
+	{
+		const int parent = m_nodes[i].parent;
+		if ((parent >= 0) && (0 != m_dirtyFlags[parent]))
+		{
+			m_dirtyFlags[i] = 1;
+		}
+
+		if (0 != m_dirtyFlags[i])
+		{
+			if (parent >= 0)
+			{
+				m_worldMatrices[i] = m_worldMatrices[parent] * BuildLocalMatrix(m_nodes[i]);
+			}
+			else
+			{
+				m_worldMatrices[i] = BuildLocalMatrix(m_nodes[i]);
+			}
+			m_updatedNodes.push_back(i);
+			m_lastUpdateCount++;
+		}
+	}
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		m_dirtyFlags[i] = 0;
+	}
+	m_bAnyDirty = false;
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method is used for flagging a node whose world
+ *  matrix has to be rebuilt.
+ ***********************************************************/
+void TransformStore::MarkDirty(int node)
+{
+	m_dirtyFlags[node] = 1;
+	m_bAnyDirty = true;
+}
+
+/***********************************************************
+ *  BuildLocalMatrix()
+ *
+ *  This method is used for building the local matrix of a
+ *  node - scale first, then the X, Y and Z rotations, and
+ *  the translation last.
+ ***********************************************************/
+glm::mat4 TransformStore::BuildLocalMatrix(const TRANSFORM_NODE& node)
+{
+	glm::mat4 scale = glm::scale(node.scale);
+	glm::mat4 rotationX = glm::rotate(glm::radians(node.rotationDegrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(node.rotationDegrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(node.rotationDegrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(node.position);
+
+	return(translation * rotationZ * rotationY * rotationX * scale);
+}
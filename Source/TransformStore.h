@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformstore.h
+// ============
+// cached world matrices for a hierarchy of scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  TransformStore
+ *
+ *  This class keeps the local transform of every scene node
+ *  together with its cached world matrix.  Changing a local
+ *  transform only marks the node as dirty - the matrices of
+ *  the dirty nodes and their children are rebuilt by the
+ *  next call to UpdateWorldMatrices(), and when nothing has
+ *  changed that call returns without any matrix math.
+ *
+ *  Every parent must be added before its children, so one
+ *  pass over the nodes in order always sees an up to date
+ *  parent matrix.
+ ***********************************************************/
+class TransformStore
+{
+public:
+	// constructor
+	TransformStore();
+	// destructor
+	~TransformStore();
+
+	// local transform of a node relative to its parent
+	struct TRANSFORM_NODE
+	{
+		glm::vec3 scale;
+		glm::vec3 rotationDegrees;
+		glm::vec3 position;
+		int parent;
+	};
+
+	// remove all the nodes
+	void Clear();
+	// reserve space for the passed in number of nodes
+	void Reserve(int nodeCount);
+
+	// add a node and get back its index - the parent must
+	// already exist, or be -1 for a root node
+	int AddNode(
+		int parent,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+
+	// change the local transform of an existing node
+	void SetLocalTransform(
+		int node,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+	void SetLocalPosition(int node, glm::vec3 positionXYZ);
+	void SetLocalRotation(int node, glm::vec3 rotationDegreesXYZ);
+	// get the local transform of a node
+	const TRANSFORM_NODE& GetLocalTransform(int node) const { return(m_nodes[node]); }
+
+	// rebuild the world matrices of the changed subtrees
+	void UpdateWorldMatrices();
+	// get the cached world matrix of a node
+	const glm::mat4& GetWorldMatrix(int node) const { return(m_worldMatrices[node]); }
+
+	// get the number of nodes in the store
+	int GetNodeCount() const { return((int)m_nodes.size()); }
+	// get the number of world matrices rebuilt by the last update
+	int GetLastUpdateCount() const { return(m_lastUpdateCount); }
+	// get one of the nodes rebuilt by the last update, for an
+	// index below GetLastUpdateCount()
+	int GetLastUpdatedNode(int index) const { return(m_updatedNodes[index]); }
+
+private:
+	// local transforms of the nodes
+	std::vector<TRANSFORM_NODE> m_nodes;
+	// cached world matrices of the nodes
+	std::vector<glm::mat4> m_worldMatrices;
+	// nodes whose local transform changed since the last update,
+	// reused during the update to flag the rebuilt nodes
+	std::vector<uint8_t> m_dirtyFlags;
+	// set when at least one node is dirty
+	bool m_bAnyDirty;
+	// number of world matrices rebuilt by the last update, and
+	// the nodes they belong to
+	int m_lastUpdateCount;
+	std::vector<int> m_updatedNodes;
+
+	// mark a node as needing a new world matrix
+	void MarkDirty(int node);
+	// build the local matrix of a node
+	static glm::mat4 BuildLocalMatrix(const TRANSFORM_NODE& node);
+};
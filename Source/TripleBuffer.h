@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// triplebuffer.h
+// ============
+// hand the latest complete value from one thread to another without a lock
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/***********************************************************
+ *  TripleBuffer
+ *
+ *  This class passes values from a single writer thread to
+ *  a single reader thread.  Each side owns one of the three
+ *  slots, and the third is the one in between - the writer
+ *  publishes by swapping its slot with it, and the reader
+ *  takes the newest value by swapping its slot with it when
+ *  the writer published since.  Neither side ever waits for
+ *  the other, the reader always sees a complete value, and
+ *  values the reader was too slow for are skipped.
+ ***********************************************************/
+template <typename T>
+class TripleBuffer
+{
+public:
+	// constructor
+	TripleBuffer()
+	{
+		m_writeIndex = 0;
+		m_readIndex = 1;
+		m_middle.store(2, std::memory_order_relaxed);
+	}
+
+	// get the slot the writer fills in before publishing
+	T& GetWriteBuffer() { return(m_slots[m_writeIndex]); }
+
+	// make the filled in slot the newest value, and take the
+	// one in between to write the next value into
+	void Publish()
+	{
+		const uint8_t previous = m_middle.exchange(m_writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+		m_writeIndex = previous & INDEX_MASK;
+	}
+
+	// take the newest published value for the reader, and get
+	// whether there was a value it had not seen yet
+	bool Update()
+	{
+		if (0 == (m_middle.load(std::memory_order_relaxed) & FRESH_BIT))
+		{
+			return(false);
+		}
+		const uint8_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+		m_readIndex = previous & INDEX_MASK;
+		return(true);
+	}
+
+	// get the value the reader took with the last update
+	const T& GetReadBuffer() const { return(m_slots[m_readIndex]); }
+
+private:
+	// the slot in between is marked when it holds a value the
+	// reader has not taken yet
+	static const uint8_t INDEX_MASK = 0x3;
+	static const uint8_t FRESH_BIT = 0x4;
+
+	T m_slots[3];
+	// slot only touched by the writer thread
+	uint8_t m_writeIndex;
+	// slot only touched by the reader thread
+	uint8_t m_readIndex;
+	// slot in between, with the fresh bit
+	std::atomic<uint8_t> m_middle;
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+};
@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// resolve shader uniform locations once and skip redundant uniform uploads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+#include <iostream>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+	m_frameStats.uploadsIssued = 0;
+	m_frameStats.uploadsSkipped = 0;
+	m_lastFrameStats = m_frameStats;
+}
+
+/***********************************************************
+ *  ~UniformCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformCache::~UniformCache()
+{
+	m_uniforms.clear();
+}
+
+/***********************************************************
+ *  RegisterSlot()
+ *
+ *  This method is used for adding a uniform name to the
+ *  cache.  If the shader program is already known then the
+ *  location is resolved right away, otherwise it is looked
+ *  up by the next call to ResolveLocations().
+ ***********************************************************/
+int UniformCache::RegisterSlot(const char* uniformName)
+{
+	// the scene and view managers may register the same name
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		if (m_uniforms[i].name.compare(uniformName) == 0)
+		{
+			return((int)i);
+		}
+	}
+
+	UNIFORM_SLOT uniform;
+	uniform.name = uniformName;
+	uniform.location = -1;
+	uniform.bShadowValid = false;
+	memset(uniform.shadow, 0, sizeof(uniform.shadow));
+
+	if (0 != m_programID)
+	{
+		uniform.location = glGetUniformLocation(m_programID, uniformName);
+	}
+
+	m_uniforms.push_back(uniform);
+
+	return((int)m_uniforms.size() - 1);
+}
+
+/***********************************************************
+ *  ResolveLocations()
+ *
+ *  This method is used for looking up the locations of all
+ *  the registered uniform names.  It needs to be called once
+ *  after the shaders have been loaded and linked.
+ ***********************************************************/
+void UniformCache::ResolveLocations(GLuint programID)
+{
+	m_programID = programID;
+
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		m_uniforms[i].location = glGetUniformLocation(
+			m_programID,
+			m_uniforms[i].name.c_str());
+
+		if (m_uniforms[i].location < 0)
+		{
+			std::cout << "Uniform not found in shader program:" << m_uniforms[i].name << std::endl;
+		}
+	}
+
+	// the program uniforms are reset whenever it is linked
+	InvalidateShadowValues();
+}
+
+/***********************************************************
+ *  InvalidateShadowValues()
+ *
+ *  This method is used for forgetting the last uploaded
+ *  values, which is needed whenever the uniforms have been
+ *  changed without going through this cache.
+ ***********************************************************/
+void UniformCache::InvalidateShadowValues()
+{
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		m_uniforms[i].bShadowValid = false;
+	}
+}
+
+/***********************************************************
+ *  ShouldUpload()
+ *
+ *  This method is used for comparing a new uniform value
+ *  against the shadow copy of the last uploaded value.  It
+ *  returns true and updates the shadow when the value has
+ *  changed, or false when the upload can be skipped.
+ ***********************************************************/
+bool UniformCache::ShouldUpload(int slot, const void* value, size_t size)
+{
+	if ((slot < 0) || (slot >= (int)m_uniforms.size()))
+	{
+		return(false);
+	}
+
+	UNIFORM_SLOT& uniform = m_uniforms[slot];
+
+	// uniforms that are not active in the program are ignored
+	if (uniform.location < 0)
+	{
+		return(false);
+	}
+
+	if ((true == uniform.bShadowValid) &&
+		(memcmp(uniform.shadow, value, size) == 0))
+	{
+		m_frameStats.uploadsSkipped++;
+		return(false);
+	}
+
+	memcpy(uniform.shadow, value, size);
+	uniform.bShadowValid = true;
+	m_frameStats.uploadsIssued++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Set()
+ *
+ *  These methods are used for uploading a uniform value
+ *  through its handle when it differs from the last value.
+ ***********************************************************/
+void UniformCache::Set(UniformHandle<bool> handle, bool value)
+{
+	int intValue = value ? 1 : 0;
+	if (ShouldUpload(handle.slot, &intValue, sizeof(intValue)))
+	{
+		glUniform1i(m_uniforms[handle.slot].location, intValue);
+	}
+}
+
+void UniformCache::Set(UniformHandle<int> handle, int value)
+{
+	if (ShouldUpload(handle.slot, &value, sizeof(value)))
+	{
+		glUniform1i(m_uniforms[handle.slot].location, value);
+	}
+}
+
+void UniformCache::Set(UniformHandle<float> handle, float value)
+{
+	if (ShouldUpload(handle.slot, &value, sizeof(value)))
+	{
+		glUniform1f(m_uniforms[handle.slot].location, value);
+	}
+}
+
+void UniformCache::Set(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+{
+	if (ShouldUpload(handle.slot, glm::value_ptr(value), sizeof(glm::vec2)))
+	{
+		glUniform2fv(m_uniforms[handle.slot].location, 1, glm::value_ptr(value));
+	}
+}
+
+void UniformCache::Set(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+	if (ShouldUpload(handle.slot, glm::value_ptr(value), sizeof(glm::vec3)))
+	{
+		glUniform3fv(m_uniforms[handle.slot].location, 1, glm::value_ptr(value));
+	}
+}
+
+void UniformCache::Set(UniformHandle<glm::vec4> handle, const glm::vec4& value)
+{
+	if (ShouldUpload(handle.slot, glm::value_ptr(value), sizeof(glm::vec4)))
+	{
+		glUniform4fv(m_uniforms[handle.slot].location, 1, glm::value_ptr(value));
+	}
+}
+
+void UniformCache::Set(UniformHandle<glm::mat4> handle, const glm::mat4& value)
+{
+	if (ShouldUpload(handle.slot, glm::value_ptr(value), sizeof(glm::mat4)))
+	{
+		glUniformMatrix4fv(m_uniforms[handle.slot].location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for saving the upload counts of the
+ *  frame that just finished and resetting the counters.
+ ***********************************************************/
+void UniformCache::BeginFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats.uploadsIssued = 0;
+	m_frameStats.uploadsSkipped = 0;
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// resolve shader uniform locations once and skip redundant uniform uploads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// GLM Math Header inclusions
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  Typed handle for a uniform registered with the uniform
+ *  cache.  The type parameter only exists so that a handle
+ *  can not be passed to the wrong Set() overload.
+ ***********************************************************/
+template <typename T>
+struct UniformHandle
+{
+	int slot = -1;
+
+	bool IsValid() const { return(slot >= 0); }
+};
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class resolves the uniform names used by the scene
+ *  and view managers into locations a single time after the
+ *  shaders are loaded, and keeps a shadow copy of the last
+ *  value uploaded for each uniform so that repeated uploads
+ *  of the same value never reach the driver.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+	// destructor
+	~UniformCache();
+
+	struct UNIFORM_STATS
+	{
+		unsigned int uploadsIssued;
+		unsigned int uploadsSkipped;
+	};
+
+	// register a uniform name and get back a typed handle
+	template <typename T>
+	UniformHandle<T> Register(const char* uniformName)
+	{
+		UniformHandle<T> handle;
+		handle.slot = RegisterSlot(uniformName);
+		return(handle);
+	}
+
+	// look up the locations of all registered uniforms
+	void ResolveLocations(GLuint programID);
+	// forget the shadowed values so the next uploads are issued
+	void InvalidateShadowValues();
+	// get the program the locations were resolved against
+	GLuint GetProgramID() const { return(m_programID); }
+
+	// upload the values through their handles - unchanged
+	// values are skipped and counted
+	void Set(UniformHandle<bool> handle, bool value);
+	void Set(UniformHandle<int> handle, int value);
+	void Set(UniformHandle<float> handle, float value);
+	void Set(UniformHandle<glm::vec2> handle, const glm::vec2& value);
+	void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+	void Set(UniformHandle<glm::vec4> handle, const glm::vec4& value);
+	void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value);
+
+	// start counting the uploads for a new frame
+	void BeginFrame();
+	// get the upload counts of the last completed frame
+	UNIFORM_STATS GetLastFrameStats() const { return(m_lastFrameStats); }
+
+private:
+	struct UNIFORM_SLOT
+	{
+		std::string name;
+		GLint location;
+		bool bShadowValid;
+		unsigned char shadow[sizeof(glm::mat4)];
+	};
+
+	// program the locations were resolved against
+	GLuint m_programID;
+	// registered uniforms, indexed by handle slot
+	std::vector<UNIFORM_SLOT> m_uniforms;
+	// upload counts of the current and last frame
+	UNIFORM_STATS m_frameStats;
+	UNIFORM_STATS m_lastFrameStats;
+
+	// add a uniform name, reusing the slot of a known name
+	int RegisterSlot(const char* uniformName);
+	// compare against the shadow copy and update it when changed
+	bool ShouldUpload(int slot, const void* value, size_t size);
+};
@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "Profiler.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
@@ -20,8 +21,11 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
+	// near and far clipping planes of the projection
+	const float g_NearPlane = 0.1f;
+	const float g_FarPlane = 100.0f;
+	// half of the visible height of the orthographic projection
+	const float g_OrthoHalfHeight = 8.0f;
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -32,6 +36,11 @@ namespace
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
+	// set by the input and the window callbacks when the frame
+	// has to be drawn again, or only shown again
+	bool gViewChanged = true;
+	bool gRefreshRequested = false;
+
 	// time between current frame and last frame
 	float gDeltaTime = 0.0f; 
 	float gLastFrame = 0.0f;
@@ -47,11 +56,25 @@ namespace
  *  The constructor for the class
  ***********************************************************/
 ViewManager::ViewManager(
-	ShaderManager *pShaderManager)
+	ShaderManager *pShaderManager,
+	UniformCache* pUniformCache,
+	GLStateCache* pStateCache,
+	StreamRing* pStreamRing)
 {
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
+	m_pUniformCache = pUniformCache;
+	m_pStateCache = pStateCache;
+	m_pCameraBuffer = new CameraBuffer(pStateCache, pStreamRing);
+	m_bProjectionValid = false;
+	m_viewProjection = glm::mat4(1.0f);
+	m_viewPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_projectionZoom = 0.0f;
+	m_bProjectionOrthographic = false;
+	m_framebufferWidth = WINDOW_WIDTH;
+	m_framebufferHeight = WINDOW_HEIGHT;
 	m_pWindow = NULL;
+	m_fixedFrameTime = 0.0f;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -70,7 +93,14 @@ ViewManager::~ViewManager()
 {
 	// free up allocated memory
 	m_pShaderManager = NULL;
+	m_pUniformCache = NULL;
+	m_pStateCache = NULL;
 	m_pWindow = NULL;
+	if (NULL != m_pCameraBuffer)
+	{
+		delete m_pCameraBuffer;
+		m_pCameraBuffer = NULL;
+	}
 	if (NULL != g_pCamera)
 	{
 		delete g_pCamera;
@@ -85,6 +115,8 @@ ViewManager::~ViewManager()
  ***********************************************************/
 GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 {
+	PROFILE_ZONE("ViewManager::CreateDisplayWindow");
+
 	GLFWwindow* window = nullptr;
 
 	// try to create the displayed OpenGL window
@@ -110,15 +142,64 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	//this callback will be used to adjust scroll movement speeds
 	glfwSetScrollCallback(window, &ViewManager::Scroll_Callback);
 
+	// these callbacks are used to tell when the window needs a
+	// new frame or the kept one shown again
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Framebuffer_Size_Callback);
+	glfwSetWindowRefreshCallback(window, &ViewManager::Window_Refresh_Callback);
+
 	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	m_pStateCache->Enable(GL_BLEND);
+	m_pStateCache->SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
 
 	return(window);
 }
 
+/***********************************************************
+ *  CreateOffscreenView()
+ *
+ *  This method is used for setting up the view for a bound
+ *  offscreen framebuffer instead of a window.  There is no
+ *  keyboard or mouse input, and the projection is built for
+ *  the passed in framebuffer size.
+ ***********************************************************/
+void ViewManager::CreateOffscreenView(int width, int height)
+{
+	m_pWindow = NULL;
+	m_framebufferWidth = width;
+	m_framebufferHeight = height;
+	m_bProjectionValid = false;
+	glViewport(0, 0, width, height);
+
+	// enable blending for supporting tranparent rendering
+	m_pStateCache->Enable(GL_BLEND);
+	m_pStateCache->SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  This method is used for placing the camera and picking
+ *  the projection directly, the same settings the O and P
+ *  keys change.  The projection is rebuilt on the next
+ *  frame only if the zoom or the projection mode changed.
+ ***********************************************************/
+void ViewManager::SetCameraPose(glm::vec3 position, glm::vec3 front, float zoom, bool bOrthographic)
+{
+	if (NULL == g_pCamera)
+	{
+		return;
+	}
+
+	g_pCamera->Position = position;
+	g_pCamera->Front = front;
+	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	g_pCamera->Zoom = zoom;
+	bOrthographicProjection = bOrthographic;
+	gViewChanged = true;
+}
+
 /***********************************************************
  *  Mouse_Position_Callback()
  *
@@ -147,6 +228,7 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 
 	// move the 3D camera according to the calculated offsets
 	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+	gViewChanged = true;
 }
 
 
@@ -162,9 +244,34 @@ void ViewManager::Scroll_Callback(GLFWwindow* window, double xOffset, double yOf
 	{
 		//scroll wheel down will increase the speed and scroll wheel up with decrease the speed for mouse movement
 		g_pCamera->ProcessMouseScroll(static_cast<float>(yOffset));
+		gViewChanged = true;
 	}
 }
 
+/***********************************************************
+ *  Framebuffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the framebuffer of the window is resized, which needs a
+ *  new frame at the new size.
+ ***********************************************************/
+void ViewManager::Framebuffer_Size_Callback(GLFWwindow* window, int width, int height)
+{
+	gViewChanged = true;
+}
+
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the contents of the window were damaged, such as when it
+ *  is uncovered, and have to be shown again.
+ ***********************************************************/
+void ViewManager::Window_Refresh_Callback(GLFWwindow* window)
+{
+	gRefreshRequested = true;
+}
+
 
 /***********************************************************
  *  ProcessKeyboardEvents()
@@ -174,6 +281,14 @@ void ViewManager::Scroll_Callback(GLFWwindow* window, double xOffset, double yOf
  ***********************************************************/
 void ViewManager::ProcessKeyboardEvents()
 {
+	PROFILE_ZONE("ViewManager::ProcessKeyboardEvents");
+
+	// an offscreen view has no keyboard
+	if (NULL == m_pWindow)
+	{
+		return;
+	}
+
 	// close the window if the escape key has been pressed
 	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
@@ -184,30 +299,36 @@ void ViewManager::ProcessKeyboardEvents()
 	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		gViewChanged = true;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		gViewChanged = true;
 	}
 
 	// process camera panning left and right
 	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		gViewChanged = true;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		gViewChanged = true;
 	}
 
 	//process camera to go up and down
 	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+		gViewChanged = true;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
 	{
 		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+		gViewChanged = true;
 	}
 
 	// process camera to change to different projection views
@@ -222,6 +343,7 @@ void ViewManager::ProcessKeyboardEvents()
 		g_pCamera->Position = glm::vec3(0.0f, 4.0f, 10.0f);
 		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 		g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f);
+		gViewChanged = true;
 	}
 
 	//this will give a perspective view of the object
@@ -236,24 +358,103 @@ void ViewManager::ProcessKeyboardEvents()
 		g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
 		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 		g_pCamera->Zoom = 100;
+		gViewChanged = true;
 	}
 }
 
 
 /***********************************************************
- *  PrepareSceneView()
+ *  CreateCameraBuffers()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  This method is used for creating the uniform buffers that
+ *  carry the camera block.  It needs to be called after the
+ *  shaders have been loaded and the uniforms resolved.
  ***********************************************************/
-void ViewManager::PrepareSceneView()
+bool ViewManager::CreateCameraBuffers()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
+	return(m_pCameraBuffer->CreateCameraBuffers(m_pUniformCache->GetProgramID()));
+}
 
+/***********************************************************
+ *  UpdateProjection()
+ *
+ *  This method is used for rebuilding the projection matrix
+ *  and its inverse, but only when the zoom, the projection
+ *  mode or the framebuffer size of the passed in camera
+ *  state has changed since the last time it was built.
+ ***********************************************************/
+void ViewManager::UpdateProjection(const VIEW_SNAPSHOT& snapshot)
+{
+	PROFILE_ZONE("ViewManager::UpdateProjection");
+
+	const int framebufferWidth = snapshot.framebufferWidth;
+	const int framebufferHeight = snapshot.framebufferHeight;
+
+	// a minimized window reports a zero sized framebuffer
+	if ((framebufferWidth <= 0) || (framebufferHeight <= 0))
+	{
+		return;
+	}
+
+	if ((true == m_bProjectionValid) &&
+		(m_projectionZoom == snapshot.zoom) &&
+		(m_bProjectionOrthographic == snapshot.bOrthographic) &&
+		(m_framebufferWidth == framebufferWidth) &&
+		(m_framebufferHeight == framebufferHeight))
+	{
+		return;
+	}
+
+	// the viewport follows the framebuffer size
+	if ((m_framebufferWidth != framebufferWidth) ||
+		(m_framebufferHeight != framebufferHeight))
+	{
+		glViewport(0, 0, framebufferWidth, framebufferHeight);
+	}
+
+	m_projectionZoom = snapshot.zoom;
+	m_bProjectionOrthographic = snapshot.bOrthographic;
+	m_framebufferWidth = framebufferWidth;
+	m_framebufferHeight = framebufferHeight;
+
+	GLfloat aspectRatio = (GLfloat)m_framebufferWidth / (GLfloat)m_framebufferHeight;
+
+	if (true == m_bProjectionOrthographic)
+	{
+		m_projection = glm::ortho(
+			-g_OrthoHalfHeight * aspectRatio, g_OrthoHalfHeight * aspectRatio,
+			-g_OrthoHalfHeight, g_OrthoHalfHeight,
+			g_NearPlane, g_FarPlane);
+	}
+	else
+	{
+		m_projection = glm::perspective(glm::radians(m_projectionZoom), aspectRatio, g_NearPlane, g_FarPlane);
+	}
+	m_inverseProjection = glm::inverse(m_projection);
+
+	m_bProjectionValid = true;
+}
+
+/***********************************************************
+ *  UpdateView()
+ *
+ *  This method is used for moving the clock to the current
+ *  frame, processing the keyboard input over the time since
+ *  the last frame and getting the camera state to draw, for
+ *  a loop that updates and draws in lockstep.
+ ***********************************************************/
+ViewManager::VIEW_SNAPSHOT ViewManager::UpdateView()
+{
 	// per-frame timing
-	float currentFrame = glfwGetTime();
+	float currentFrame = 0.0f;
+	if (m_fixedFrameTime > 0.0f)
+	{
+		currentFrame = gLastFrame + m_fixedFrameTime;
+	}
+	else
+	{
+		currentFrame = glfwGetTime();
+	}
 	gDeltaTime = currentFrame - gLastFrame;
 	gLastFrame = currentFrame;
 
@@ -261,20 +462,143 @@ void ViewManager::PrepareSceneView()
 	// event queue
 	ProcessKeyboardEvents();
 
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
+	return(GetSnapshot());
+}
+
+/***********************************************************
+ *  UpdateSimulation()
+ *
+ *  This method is used for moving the clock forward by one
+ *  fixed simulation step and processing the keyboard input
+ *  over it, so the camera moves the same way at any frame
+ *  rate.  It has to be called on the thread that polls the
+ *  GLFW events.
+ ***********************************************************/
+void ViewManager::UpdateSimulation(float stepSeconds)
+{
+	gDeltaTime = stepSeconds;
+	gLastFrame += stepSeconds;
+
+	ProcessKeyboardEvents();
+}
+
+/***********************************************************
+ *  GetSnapshot()
+ *
+ *  This method is used for getting the camera state as the
+ *  updates have left it, with the framebuffer size to draw
+ *  it at.
+ ***********************************************************/
+ViewManager::VIEW_SNAPSHOT ViewManager::GetSnapshot() const
+{
+	VIEW_SNAPSHOT snapshot;
+	snapshot.view = g_pCamera->GetViewMatrix();
+	snapshot.position = g_pCamera->Position;
+	snapshot.zoom = g_pCamera->Zoom;
+	snapshot.bOrthographic = bOrthographicProjection;
+	if (NULL != m_pWindow)
+	{
+		glfwGetFramebufferSize(m_pWindow, &snapshot.framebufferWidth, &snapshot.framebufferHeight);
+	}
+	else
+	{
+		// an offscreen view keeps the size it was created with
+		snapshot.framebufferWidth = m_framebufferWidth;
+		snapshot.framebufferHeight = m_framebufferHeight;
+	}
+	snapshot.time = gLastFrame;
+	snapshot.deltaTime = gDeltaTime;
+
+	return(snapshot);
+}
+
+/***********************************************************
+ *  ConsumeViewChange()
+ *
+ *  This method is used for getting whether the mouse, the
+ *  keyboard, a camera pose or a resize changed the frame
+ *  since the last call, and clearing the flag, so an on
+ *  demand loop only draws when there is something new.  It
+ *  has to be called on the thread that polls the events.
+ ***********************************************************/
+bool ViewManager::ConsumeViewChange()
+{
+	const bool bChanged = gViewChanged;
+	gViewChanged = false;
+	return(bChanged);
+}
 
-	// define the current projection matrix
-	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+/***********************************************************
+ *  ConsumeRefreshRequest()
+ *
+ *  This method is used for getting whether the window asked
+ *  for its contents to be shown again since the last call,
+ *  and clearing the flag.
+ ***********************************************************/
+bool ViewManager::ConsumeRefreshRequest()
+{
+	const bool bRequested = gRefreshRequested;
+	gRefreshRequested = false;
+	return(bRequested);
+}
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
+/***********************************************************
+ *  PrepareSceneView()
+ *
+ *  This method is used for preparing the projection and the
+ *  camera block of a frame from the passed in camera state.
+ *  It only reads the snapshot and the members it writes, so
+ *  it can run on a render thread while the input thread
+ *  moves the camera.
+ ***********************************************************/
+void ViewManager::PrepareSceneView(const VIEW_SNAPSHOT& snapshot)
+{
+	PROFILE_ZONE("ViewManager::PrepareSceneView");
+
+	CameraBuffer::CAMERA_BLOCK cameraBlock;
+
+	// the projection is only rebuilt when its inputs change
+	UpdateProjection(snapshot);
+
+	// the view matrix was taken from the camera at the update
+	cameraBlock.view = snapshot.view;
+	cameraBlock.projection = m_projection;
+	cameraBlock.viewProjection = m_projection * cameraBlock.view;
+	m_viewProjection = cameraBlock.viewProjection;
+	m_viewPosition = snapshot.position;
+	cameraBlock.inverseView = glm::inverse(cameraBlock.view);
+	cameraBlock.inverseProjection = m_inverseProjection;
+	cameraBlock.viewPosition = glm::vec4(snapshot.position, 1.0f);
+	cameraBlock.frameTime = glm::vec4(snapshot.time, snapshot.deltaTime, 0.0f, 0.0f);
+
+	// write the whole camera block into the next ring buffer
+	m_pCameraBuffer->WriteFrame(cameraBlock);
+}
+
+/***********************************************************
+ *  GetViewPosition()
+ *
+ *  This method is used for getting the position of the
+ *  camera in world space, as the last frame was prepared.
+ ***********************************************************/
+glm::vec3 ViewManager::GetViewPosition() const
+{
+	return(m_viewPosition);
+}
+
+/***********************************************************
+ *  GetProjectionScale()
+ *
+ *  This method is used for getting the number of framebuffer
+ *  pixels one world unit covers - at a distance of one unit
+ *  for a perspective projection, which is then divided by
+ *  the distance, and anywhere for an orthographic one.
+ ***********************************************************/
+float ViewManager::GetProjectionScale() const
+{
+	if (false == m_bProjectionValid)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		return(0.0f);
 	}
-}
\ No newline at end of file
+	return(m_projection[1][1] * (float)m_framebufferHeight * 0.5f);
+}
@@ -10,6 +10,9 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "CameraBuffer.h"
+#include "GLStateCache.h"
 #include "camera.h"
 
 // GLFW library
@@ -20,28 +23,115 @@ class ViewManager
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderManager* pShaderManager,
+		UniformCache* pUniformCache,
+		GLStateCache* pStateCache,
+		StreamRing* pStreamRing);
 	// destructor
 	~ViewManager();
 
+	// state of the camera after one update, with everything
+	// a frame of it is drawn from, so that the frame does not
+	// read the camera while the input is moving it
+	struct VIEW_SNAPSHOT
+	{
+		glm::mat4 view;
+		glm::vec3 position;
+		float zoom;
+		bool bOrthographic;
+		// framebuffer size at the time of the update
+		int framebufferWidth;
+		int framebufferHeight;
+		// clock at the update and the time it moved by
+		float time;
+		float deltaTime;
+	};
+
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
 	//added mouse scroll for speed
 	static void Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
+	// framebuffer size callback for redrawing a resized window
+	static void Framebuffer_Size_Callback(GLFWwindow* window, int width, int height);
+	// window refresh callback for showing a damaged window again
+	static void Window_Refresh_Callback(GLFWwindow* window);
 
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// active OpenGL display window
+	// pointer to the cached uniform locations and values
+	UniformCache* m_pUniformCache;
+	// pointer to the cache the OpenGL state changes go through
+	GLStateCache* m_pStateCache;
+	// ring of uniform buffers holding the camera block
+	CameraBuffer* m_pCameraBuffer;
+
+	// the projection matrix is only rebuilt when one of the
+	// values it was built from changes
+	glm::mat4 m_projection;
+	glm::mat4 m_inverseProjection;
+	// projection times view and camera position of the last
+	// prepared frame
+	glm::mat4 m_viewProjection;
+	glm::vec3 m_viewPosition;
+	bool m_bProjectionValid;
+	float m_projectionZoom;
+	bool m_bProjectionOrthographic;
+	int m_framebufferWidth;
+	int m_framebufferHeight;
+	// active OpenGL display window, NULL when the scene is
+	// drawn into an offscreen framebuffer
 	GLFWwindow* m_pWindow;
+	// time each frame moves the clock forward by, or zero to
+	// follow the real time
+	float m_fixedFrameTime;
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
+	// rebuild the projection matrix when its inputs have changed
+	void UpdateProjection(const VIEW_SNAPSHOT& snapshot);
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// set up the view for an offscreen framebuffer of the
+	// passed in size instead of a window
+	void CreateOffscreenView(int width, int height);
+	// move the clock forward by the same time every frame,
+	// so that the frames do not depend on the real time
+	void SetFixedFrameTime(float seconds) { m_fixedFrameTime = seconds; }
+	// place the camera and pick the projection, as a scripted
+	// camera path does before each frame
+	void SetCameraPose(glm::vec3 position, glm::vec3 front, float zoom, bool bOrthographic);
 	
-	// prepare the conversion from 3D object display to 2D scene display
-	void PrepareSceneView();
+	// create the camera uniform buffers once the shaders are loaded
+	bool CreateCameraBuffers();
+
+	// move the clock to the current frame, apply the keyboard
+	// input and get the camera state to draw
+	VIEW_SNAPSHOT UpdateView();
+	// move the clock forward by one simulation step and apply
+	// the keyboard input over it
+	void UpdateSimulation(float stepSeconds);
+	// get the camera state as the updates have left it
+	VIEW_SNAPSHOT GetSnapshot() const;
+	// get whether the camera, the projection or the window size
+	// changed since the last call, clearing the flag
+	bool ConsumeViewChange();
+	// get whether the window asked to be shown again since the
+	// last call with nothing in it changed, clearing the flag
+	bool ConsumeRefreshRequest();
+
+	// prepare the conversion from 3D object display to 2D scene
+	// display for the passed in camera state
+	void PrepareSceneView(const VIEW_SNAPSHOT& snapshot);
+	// get the camera position of the last prepared frame
+	glm::vec3 GetViewPosition() const;
+	// get the screen pixels one world unit covers, one unit from
+	// the camera for a perspective projection
+	float GetProjectionScale() const;
+	// get the view projection matrix of the last prepared frame
+	const glm::mat4& GetViewProjection() const { return(m_viewProjection); }
+	// get whether the projection is a perspective one
+	bool IsPerspective() const { return(!m_bProjectionOrthographic); }
 };
\ No newline at end of file
@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////
+// fragmentShader.glsl
+// ============
+// phong lighting for the scene - the light rig is read from a uniform block
+///////////////////////////////////////////////////////////////////////////////
+#version 330 core
+
+// must match LightRig::MAX_POINT_LIGHTS
+#define MAX_POINT_LIGHTS 16
+// must match MaterialBuffer::MAX_MATERIALS
+#define MAX_MATERIALS 64
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentInstanceColor;
+flat in vec2 fragmentInstanceUVscale;
+flat in int fragmentInstanceMaterial;
+flat in int fragmentInstanceLayer;
+
+out vec4 outFragmentColor;
+
+struct Material
+{
+	vec3 diffuseColor;
+	vec3 specularColor;
+	float shininess;
+};
+
+// std140 layout of a material block entry - see MaterialBuffer.h
+struct MaterialEntry
+{
+	vec3 diffuseColor;
+	float shininess;
+	vec3 specularColor;
+};
+
+// the member order of the light structures is chosen so that
+// the std140 layout has no holes - see LightRig.h
+struct DirectionalLight
+{
+	vec3 direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	bool bActive;
+};
+
+struct PointLight
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	bool bActive;
+};
+
+struct SpotLight
+{
+	vec3 position;
+	float cutOff;
+	vec3 direction;
+	float outerCutOff;
+	vec3 ambient;
+	float constant;
+	vec3 diffuse;
+	float linear;
+	vec3 specular;
+	float quadratic;
+	bool bActive;
+};
+
+layout (std140) uniform LightBlock
+{
+	DirectionalLight directionalLight;
+	SpotLight spotLight;
+	int numPointLights;
+	PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+// table of all the object materials, indexed per instance
+layout (std140) uniform MaterialBlock
+{
+	MaterialEntry materials[MAX_MATERIALS];
+};
+
+// per-frame camera values - see CameraBuffer.h
+layout (std140) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	vec4 viewPosition;
+	vec4 frameTime;
+};
+
+uniform bool bUseTexture = false;
+uniform bool bUseLighting = false;
+uniform vec4 objectColor = vec4(1.0);
+// textures are layers of texture arrays - see TextureManager.h
+uniform sampler2DArray objectTexture;
+uniform int textureLayer = 0;
+uniform vec2 UVscale = vec2(1.0, 1.0);
+uniform Material material;
+uniform bool bUseInstancing = false;
+
+// material of the current fragment - from the material uniform,
+// or from the material block for instanced draws
+Material surfaceMaterial;
+
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDirection, vec3 surfaceColor)
+{
+	vec3 lightDirection = normalize(-light.direction);
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0), max(surfaceMaterial.shininess, 0.001));
+
+	vec3 ambient = light.ambient * surfaceColor;
+	vec3 diffuse = light.diffuse * diffuseImpact * surfaceMaterial.diffuseColor * surfaceColor;
+	vec3 specular = light.specular * specularImpact * surfaceMaterial.specularColor;
+
+	return(ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDirection, vec3 surfaceColor)
+{
+	vec3 lightDirection = normalize(light.position - fragmentPosition);
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0), max(surfaceMaterial.shininess, 0.001));
+
+	vec3 ambient = light.ambient * surfaceColor;
+	vec3 diffuse = light.diffuse * diffuseImpact * surfaceMaterial.diffuseColor * surfaceColor;
+	vec3 specular = light.specular * specularImpact * surfaceMaterial.specularColor;
+
+	return(ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDirection, vec3 surfaceColor)
+{
+	vec3 lightDirection = normalize(light.position - fragmentPosition);
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0), max(surfaceMaterial.shininess, 0.001));
+
+	// attenuation over the distance to the light
+	float distance = length(light.position - fragmentPosition);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	// soft edge between the inner and outer cone
+	float theta = dot(lightDirection, normalize(-light.direction));
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	vec3 ambient = light.ambient * surfaceColor;
+	vec3 diffuse = light.diffuse * diffuseImpact * surfaceMaterial.diffuseColor * surfaceColor;
+	vec3 specular = light.specular * specularImpact * surfaceMaterial.specularColor;
+
+	return((ambient + (diffuse + specular) * intensity) * attenuation);
+}
+
+void main()
+{
+	vec4 baseColor = objectColor;
+	vec2 textureScale = UVscale;
+	int layer = textureLayer;
+	surfaceMaterial = material;
+	if (bUseInstancing == true)
+	{
+		baseColor = fragmentInstanceColor;
+		textureScale = fragmentInstanceUVscale;
+		layer = fragmentInstanceLayer;
+		if (fragmentInstanceMaterial >= 0)
+		{
+			surfaceMaterial.diffuseColor = materials[fragmentInstanceMaterial].diffuseColor;
+			surfaceMaterial.specularColor = materials[fragmentInstanceMaterial].specularColor;
+			surfaceMaterial.shininess = materials[fragmentInstanceMaterial].shininess;
+		}
+	}
+
+	vec4 surfaceColor = baseColor;
+	if (bUseTexture == true)
+	{
+		surfaceColor = texture(objectTexture, vec3(fragmentTextureCoordinate * textureScale, float(layer)));
+	}
+
+	if (bUseLighting == false)
+	{
+		outFragmentColor = surfaceColor;
+		return;
+	}
+
+	vec3 normal = normalize(fragmentVertexNormal);
+	vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+	vec3 lightingResult = vec3(0.0);
+
+	if (directionalLight.bActive == true)
+	{
+		lightingResult += CalcDirectionalLight(directionalLight, normal, viewDirection, surfaceColor.rgb);
+	}
+
+	for (int i = 0; i < numPointLights; i++)
+	{
+		if (pointLights[i].bActive == true)
+		{
+			lightingResult += CalcPointLight(pointLights[i], normal, viewDirection, surfaceColor.rgb);
+		}
+	}
+
+	if (spotLight.bActive == true)
+	{
+		lightingResult += CalcSpotLight(spotLight, normal, viewDirection, surfaceColor.rgb);
+	}
+
+	outFragmentColor = vec4(lightingResult, surfaceColor.a);
+}
@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexShader.glsl
+// ============
+// transform the mesh vertices and pass the surface data to the fragment shader
+///////////////////////////////////////////////////////////////////////////////
+#version 330 core
+
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance values of the instanced draws - see InstancedMeshes.h
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in vec2 inInstanceUVscale;
+layout (location = 9) in ivec2 inInstanceIndices;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentInstanceColor;
+flat out vec2 fragmentInstanceUVscale;
+flat out int fragmentInstanceMaterial;
+flat out int fragmentInstanceLayer;
+
+uniform mat4 model;
+uniform bool bUseInstancing = false;
+
+// per-frame camera values - see CameraBuffer.h
+layout (std140) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	vec4 viewPosition;
+	vec4 frameTime;
+};
+
+void main()
+{
+	mat4 objectModel = model;
+	if (bUseInstancing == true)
+	{
+		objectModel = inInstanceModel;
+	}
+	fragmentInstanceColor = inInstanceColor;
+	fragmentInstanceUVscale = inInstanceUVscale;
+	fragmentInstanceMaterial = inInstanceIndices.y;
+	fragmentInstanceLayer = inInstanceIndices.x;
+
+	// vertex position in world space for the lighting calculations
+	fragmentPosition = vec3(objectModel * vec4(inVertexPosition, 1.0));
+	// normals are transformed by the inverse transpose of the model matrix
+	fragmentVertexNormal = mat3(transpose(inverse(objectModel))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+
+	gl_Position = viewProjection * vec4(fragmentPosition, 1.0);
+}